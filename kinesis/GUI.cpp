@@ -1,4 +1,17 @@
 #include "GUI.h"
+#include "memorybudget.h"
+#include "residency.h"
+#include "geometrypool.h"
+#include "deletionqueue.h"
+#include "framearena.h"
+#include "uniformring.h"
+#include "bindlessheap.h"
+#include "raytracer/raytracermanager.h"
+#include "raytracer/asbuildscheduler.h"
+#include "raytracer/blascache.h"
+#include "raytracer/accumulation.h"
+#include "raytracer/denoiser.h"
+#include "raytracer/lightlist.h"
 #include <iostream>
 
 namespace Kinesis::GUI
@@ -8,13 +21,17 @@ namespace Kinesis::GUI
     bool show_scene = false;
     bool show_rendering = false;
     bool show_gameobject = false;
+    bool show_memory = false;
     bool show_toolbar = true;
     bool dark_mode = true;
     bool raytracing_available = false;
+    bool rayquery_available = false;
+    bool traceindirect_available = false;
     bool enable_raytracing_pass = false;
     int gbuffer_debug_mode = 0; // 0=Off, 1=Position, 2=Normal, 3=Albedo, 4=Properties
-    int samples_per_pixel = 8; // Default SPP
+    int samples_per_pixel = 1; // Default SPP, a still camera accumulates more every frame
     int max_ray_depth = 12; // Default max bounces
+    bool hybrid_primary_rays = true; // Primary visibility from the G-buffer
     ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 0.0f);
 
     void HelpMarker(const char *desc)
@@ -39,6 +56,7 @@ namespace Kinesis::GUI
                 ImGui::MenuItem("Scene Viewer", "", &show_scene);
                 ImGui::MenuItem("Render Editor", "", &show_rendering);
                 ImGui::MenuItem("GameObject Manager", "", &show_gameobject);
+                ImGui::MenuItem("Memory Budget", "", &show_memory);
                 ImGui::EndMenu();
             }
             if (ImGui::BeginMenu("Options"))
@@ -113,11 +131,108 @@ namespace Kinesis::GUI
             
             // Samples Per Pixel slider
             ImGui::SliderInt("Samples Per Pixel", &samples_per_pixel, 1, 32);
-            HelpMarker("Number of rays traced per pixel. Higher = better quality but slower.");
+            HelpMarker("Number of rays traced per pixel each frame. Higher = less noise per frame but slower; accumulation averages more frames over time.");
             
             // Max Ray Depth slider
             ImGui::SliderInt("Max Ray Depth", &max_ray_depth, 1, 20);
             HelpMarker("Maximum number of ray bounces. Higher = more accurate indirect lighting but slower.");
+
+            // Hybrid: the G-buffer pass already found every pixel's first hit
+            if (ImGui::Checkbox("Hybrid Primary Rays", &hybrid_primary_rays))
+                Accumulation::reset(); // Also restarts a converged image, which would otherwise never trace again
+            HelpMarker("Start paths at the rasterized first hit (G-buffer position, normal and material) instead of tracing a primary ray per sample. Saves one full TLAS traversal per sample, but the first hit is no longer jittered for anti-aliasing.");
+
+            // Reduced resolution: trace one pixel per block, upsample guided by the G-buffer
+            if (raytracing_available)
+            {
+                const char *resolutions[] = {"Full", "Half (2x1)", "Quarter (2x2)"};
+                int resolution = static_cast<int>(RayTracerManager::traceResolution);
+                if (ImGui::Combo("RT Resolution", &resolution, resolutions, IM_ARRAYSIZE(resolutions)))
+                    RayTracerManager::traceResolution = static_cast<RayTracerManager::TraceResolution>(resolution);
+                HelpMarker("Trace one pixel per block each frame and reconstruct the rest with an edge-aware upsample (G-buffer depth and normals). Costs 2-4x less; a still view with accumulation reaches full resolution after 2-4 frames.");
+
+                const char *patterns[] = {"Checkerboard", "Rotating"};
+                int pattern = static_cast<int>(RayTracerManager::subpixelPattern);
+                ImGui::BeginDisabled(RayTracerManager::traceResolution == RayTracerManager::TraceResolution::Full);
+                if (ImGui::Combo("Sub-pixel Pattern", &pattern, patterns, IM_ARRAYSIZE(patterns)))
+                    RayTracerManager::subpixelPattern = static_cast<RayTracerManager::SubpixelPattern>(pattern);
+                ImGui::EndDisabled();
+                HelpMarker("Checkerboard: neighbouring blocks trace different pixels. Rotating: every block traces the same pixel, which moves each frame.");
+            }
+
+            // Adaptive sampling: same total rays, spent where the image is noisy
+            if (raytracing_available)
+            {
+                if (ImGui::Checkbox("Adaptive Sampling", &RayTracerManager::adaptiveSampling))
+                    Accumulation::reset(); // Converged pixels are skipped, a new budget must start from a fresh average
+                HelpMarker("Distribute Samples Per Pixel x traced pixels by estimated noise instead of evenly: glass edges get more samples, flat mirrors fewer. While accumulating, converged pixels may skip frames.");
+                ImGui::BeginDisabled(!RayTracerManager::adaptiveSampling);
+                if (ImGui::SliderInt("Max Samples Per Pixel", &RayTracerManager::adaptiveMaxSamples, 1, 64))
+                    Accumulation::reset();
+                ImGui::EndDisabled();
+            }
+
+            // Next-event estimation towards the emissive triangles of the scene
+            if (raytracing_available)
+            {
+                if (ImGui::Checkbox("Light Sampling", &LightList::enabled))
+                    Accumulation::reset();
+                HelpMarker("At every diffuse and rough bounce, sample a point on an emissive triangle (picked by power) and trace a shadow ray to it, weighted against the bounce itself (MIS). Lit interiors converge far faster than waiting for paths to hit a light.");
+                ImGui::Text("Lights: %u emissive triangles", LightList::getLightCount());
+
+                ImGui::BeginDisabled(!hybrid_primary_rays || !LightList::enabled);
+                bool restirChanged = ImGui::Checkbox("ReSTIR Direct Lighting", &RayTracerManager::restirEnabled);
+                restirChanged |= ImGui::SliderInt("Light Candidates", &RayTracerManager::restirCandidates, 1, 64);
+                ImGui::EndDisabled();
+                if (restirChanged)
+                    Accumulation::reset();
+                HelpMarker("Light rough metal seen directly through reservoirs: each pixel weighs many light samples, keeps one, and shares it with the next frame and its neighbours, then traces a single shadow ray. Needs Hybrid Primary Rays and Light Sampling.");
+            }
+
+            // These settings are compiled into the pipeline, new combinations compile in the background
+            if (raytracing_available)
+            {
+                ImGui::Text("Pipeline variants: %zu%s, switches: %u", RayTracerManager::getPipelineVariantCount(),
+                            RayTracerManager::isCompilingPipelineVariant() ? " (compiling)" : "", RayTracerManager::pipelineVariantSwitches);
+            }
+
+            // Progressive accumulation: a still view averages frames until it converges
+            ImGui::Checkbox("Accumulate Frames", &Accumulation::enabled);
+            HelpMarker("Average the ray traced image over frames while the camera, scene and settings stay the same. Any change starts over.");
+            ImGui::SliderInt("Max Accumulated Frames", &Accumulation::maxFrames, 1, 4096);
+            HelpMarker("Once this many frames are averaged the image counts as converged and ray tracing pauses.");
+            ImGui::Text("Accumulated: %u frames%s, resets: %llu", Accumulation::getFrameCount(),
+                        Accumulation::isConverged() ? " (converged)" : "", (unsigned long long)Accumulation::getResetCount());
+
+            // Trace backend: RT pipeline or ray queries from a compute shader (same output)
+            if (raytracing_available)
+            {
+                ImGui::BeginDisabled(!rayquery_available);
+                ImGui::Checkbox("Ray Query Backend", &RayTracerManager::useRayQuery);
+                ImGui::EndDisabled();
+                HelpMarker(rayquery_available ? "Trace with inline ray queries in a compute shader instead of the ray tracing pipeline. The image is the same, compare the GPU times below."
+                                              : "VK_KHR_ray_query is not supported by this device.");
+                ImGui::Text("Trace GPU time: pipeline %.2f ms, ray query %.2f ms", RayTracerManager::pipelineTraceMs, RayTracerManager::rayQueryTraceMs);
+
+                ImGui::BeginDisabled(!rayquery_available && !traceindirect_available);
+                ImGui::Checkbox("Compacted Dispatch", &RayTracerManager::compactDispatch);
+                ImGui::EndDisabled();
+                HelpMarker("List the metal and glass pixels on the GPU first and launch rays only for them, instead of one invocation per pixel. The RT pipeline needs indirect trace support, otherwise it falls back to the full launch.");
+            }
+
+            // Spatiotemporal denoiser on the RT output
+            ImGui::Separator();
+            bool denoiserChanged = ImGui::Checkbox("Denoise", &Denoiser::enabled);
+            HelpMarker("Filter the ray traced image: reproject and blend the previous frames, then smooth with edge-aware wavelet passes guided by the G-buffer.");
+            denoiserChanged |= ImGui::SliderInt("Wavelet Passes", &Denoiser::atrousIterations, 1, 5);
+            HelpMarker("Each pass doubles the filter radius. More passes remove more noise but blur fine reflections.");
+            denoiserChanged |= ImGui::SliderFloat("Temporal Alpha", &Denoiser::temporalAlpha, 0.02f, 1.0f);
+            HelpMarker("Minimum weight of the new frame. Lower = smoother but slower to react to changes.");
+            denoiserChanged |= ImGui::SliderFloat("Color Edge Stopping", &Denoiser::phiColor, 0.5f, 16.0f);
+            HelpMarker("How many standard deviations of noise a luminance difference may be before it counts as an edge.");
+            if (denoiserChanged)
+                Accumulation::reset(); // A converged image is no longer traced, so it would never be filtered again
+            ImGui::Text("Denoiser GPU time: %.2f ms", Denoiser::lastFrameGpuMs);
             
             ImGui::Separator();
             
@@ -136,6 +251,138 @@ namespace Kinesis::GUI
         ImGui::End();
     }
 
+    void memory_panel(bool *p_open)
+    {
+        if (!ImGui::Begin("Memory Budget", p_open))
+        {
+            ImGui::End();
+            return;
+        }
+
+        const float toMB = 1.0f / (1024.0f * 1024.0f);
+
+        if (ImGui::CollapsingHeader("Heaps", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            ImGui::Text("Source: %s", MemoryBudget::budgetExtensionEnabled ? "VK_EXT_memory_budget" : "estimate (extension unavailable)");
+            const auto &heaps = MemoryBudget::getHeaps();
+            for (size_t i = 0; i < heaps.size(); ++i)
+            {
+                const auto &heap = heaps[i];
+                float fraction = heap.budget > 0 ? static_cast<float>(heap.usage) / static_cast<float>(heap.budget) : 0.0f;
+                char overlay[64];
+                snprintf(overlay, sizeof(overlay), "%.1f / %.1f MB", heap.usage * toMB, heap.budget * toMB);
+                ImGui::Text("Heap %zu%s (engine: %.1f MB)", i, heap.deviceLocal ? " [device local]" : "", heap.tracked * toMB);
+                ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay);
+            }
+        }
+
+        if (ImGui::CollapsingHeader("Categories", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            if (ImGui::BeginTable("memory_categories", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+            {
+                ImGui::TableSetupColumn("Category");
+                ImGui::TableSetupColumn("Allocations");
+                ImGui::TableSetupColumn("MB");
+                ImGui::TableHeadersRow();
+                for (int c = 0; c < static_cast<int>(MemoryBudget::Category::Count); ++c)
+                {
+                    auto category = static_cast<MemoryBudget::Category>(c);
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(MemoryBudget::categoryName(category));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%u", MemoryBudget::getAllocationCount(category));
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.2f", MemoryBudget::getUsage(category) * toMB);
+                }
+                ImGui::EndTable();
+            }
+            ImGui::Text("Total tracked: %.2f MB", MemoryBudget::getTotalTracked() * toMB);
+        }
+
+        if (ImGui::CollapsingHeader("Frame Allocations"))
+        {
+            ImGui::Text("Heap allocations last frame: %llu", (unsigned long long)FrameArena::getHeapAllocationsLastFrame());
+            HelpMarker("Counted by the global operator new. Should stay at 0 once the scene and GUI have settled.");
+            ImGui::Text("Frame arena: %.1f / %.1f KiB (peak %.1f KiB)", FrameArena::getUsedBytes() / 1024.0,
+                        FrameArena::getCapacity() / 1024.0, FrameArena::getHighWaterMark() / 1024.0);
+            ImGui::Text("Uniform ring: %.1f / %.1f KiB per frame", UniformRing::getUsedBytes() / 1024.0,
+                        UniformRing::getBytesPerFrame() / 1024.0);
+        }
+
+        if (ImGui::CollapsingHeader("Geometry Pool"))
+        {
+            ImGui::Text("Vertices: %u / %u", GeometryPool::getUsedVertices(), GeometryPool::getVertexCapacity());
+            ImGui::Text("Indices: %u / %u", GeometryPool::getUsedIndices(), GeometryPool::getIndexCapacity());
+            ImGui::Text("Reallocations: %u", GeometryPool::getGeneration());
+            HelpMarker("Evicted models return their ranges to the pool's free lists. Once at most half of a buffer is in use, the pool is compacted into smaller buffers.");
+        }
+
+        if (ImGui::CollapsingHeader("Bindless Heap"))
+        {
+            using BindlessHeap::Type;
+            ImGui::Text("Storage Buffers: %u / %u", BindlessHeap::getUsedCount(Type::StorageBuffer), BindlessHeap::getCapacity(Type::StorageBuffer));
+            ImGui::Text("Sampled Images: %u / %u", BindlessHeap::getUsedCount(Type::SampledImage), BindlessHeap::getCapacity(Type::SampledImage));
+            ImGui::Text("Samplers: %u / %u", BindlessHeap::getUsedCount(Type::Sampler), BindlessHeap::getCapacity(Type::Sampler));
+            HelpMarker("Released slots are reused only after the frames that may still read them have retired.");
+        }
+
+        if (raytracing_available && ImGui::CollapsingHeader("Acceleration Structures"))
+        {
+            ImGui::Text("BLAS: %zu", RayTracerManager::blas.size());
+            ImGui::Checkbox("Compact BLAS", &RayTracerManager::compactBlas);
+            HelpMarker("Copies each BLAS into an allocation of its compacted size after it is built. Applies to later builds (e.g. residency restores).");
+            ImGui::Text("Saved by compaction: %.2f MB", RayTracerManager::blasCompactionSavedBytes * toMB);
+            ImGui::Checkbox("BLAS Disk Cache", &BlasCache::enabled);
+            HelpMarker("Loads static BLAS serialized by an earlier run instead of building them, and stores newly built ones. Data from another GPU/driver is rejected and rebuilt.");
+            {
+                auto cacheStats = BlasCache::getStats();
+                ImGui::Text("BLAS cache: %u loaded (%.2f MB), %u stored (%.2f MB), %u incompatible", cacheStats.loaded, cacheStats.bytesRead * toMB,
+                            cacheStats.stored, cacheStats.bytesWritten * toMB, cacheStats.incompatible);
+            }
+            ImGui::Separator();
+            ImGui::SliderInt("TLAS Rebuild Interval", &RayTracerManager::tlasRebuildInterval, 0, 1000);
+            HelpMarker("Number of in-place TLAS updates (refits) before the TLAS is rebuilt to restore trace performance. 0 = never.");
+            ImGui::Text("Instances updated last frame: %u", RayTracerManager::tlasUpdatedInstancesLastFrame);
+            ImGui::Text("TLAS updates: %llu, rebuilds: %llu", (unsigned long long)RayTracerManager::tlasUpdateCount,
+                        (unsigned long long)RayTracerManager::tlasRebuildCount);
+            ImGui::Separator();
+            ImGui::SliderInt("BLAS Refit Limit", &RayTracerManager::blasRefitLimit, 0, 500);
+            HelpMarker("Refits of a dynamic (deforming) model's BLAS before it is rebuilt. 0 = only rebuild on bounds growth.");
+            ImGui::SliderFloat("Rebuild Bounds Growth", &RayTracerManager::blasRebuildBoundsGrowth, 1.0f, 4.0f, "%.2fx");
+            HelpMarker("A dynamic BLAS is rebuilt once its bounding sphere grew by this factor since its last build.");
+            ImGui::Text("Dynamic BLAS last frame: %u refit, %u rebuilt", RayTracerManager::blasRefitsLastFrame, RayTracerManager::blasRebuildsLastFrame);
+            ImGui::Separator();
+            ImGui::SliderFloat("BLAS Build Budget (ms)", &ASBuildScheduler::budgetMs, 0.1f, 8.0f, "%.1f");
+            HelpMarker("GPU time per frame for queued BLAS builds (e.g. models restored by the residency manager). Closest / largest on screen first; at least one build per frame.");
+            ImGui::Text("Queued BLAS builds: %zu", ASBuildScheduler::getPendingCount());
+            ImGui::Text("Builds last frame: %u, last measured: %.3f ms (%.2f ns/triangle)", ASBuildScheduler::buildsLastFrame,
+                        ASBuildScheduler::lastFrameGpuMs, ASBuildScheduler::estimatedNsPerTriangle);
+        }
+
+        if (ImGui::CollapsingHeader("Residency", ImGuiTreeNodeFlags_DefaultOpen))
+        {
+            auto stats = Residency::getStats();
+            ImGui::Checkbox("Enable Residency Manager", &Residency::enabled);
+            ImGui::SliderFloat("Budget Threshold", &MemoryBudget::budgetThreshold, 0.5f, 1.0f, "%.2f");
+            HelpMarker("Fraction of a heap's budget that may be used before least-recently-visible models are evicted.");
+            ImGui::SliderInt("Min Idle Frames", &Residency::minIdleFrames, 1, 1000);
+            HelpMarker("A model must be outside the view frustum for this many frames before it can be evicted.");
+            ImGui::InputInt("Budget Override (MB)", &MemoryBudget::budgetOverrideMB);
+            HelpMarker("When > 0, all tracked allocations are compared against this budget instead of the driver's. Useful to test eviction.");
+            if (MemoryBudget::budgetOverrideMB < 0)
+                MemoryBudget::budgetOverrideMB = 0;
+
+            ImGui::Separator();
+            ImGui::Text("Over budget: %s", MemoryBudget::isOverBudget() ? "yes" : "no");
+            ImGui::Text("Models resident: %u, evicted: %u (%.2f MB released)", stats.residentModels, stats.evictedModels, stats.evictedBytes * toMB);
+            ImGui::Text("Evictions: %llu, restores: %llu", (unsigned long long)stats.totalEvictions, (unsigned long long)stats.totalRestores);
+            ImGui::Text("Retired resources awaiting frame completion: %zu", DeletionQueue::getPendingCount());
+        }
+
+        ImGui::End();
+    }
+
     void initialize()
     {
         ImGui::StyleColorsDark();
@@ -143,13 +390,15 @@ namespace Kinesis::GUI
         show_scene = false;
         show_rendering = false;
         show_gameobject = false;
+        show_memory = false;
         show_toolbar = true;
         dark_mode = true;
         clear_color = ImVec4(0.45f, 0.55f, 0.60f, 0.0f);
         enable_raytracing_pass = false;
         gbuffer_debug_mode = 0;
-        samples_per_pixel = 8;
+        samples_per_pixel = 1;
         max_ray_depth = 12;
+        hybrid_primary_rays = true;
     }
 
     void update_imgui()
@@ -163,6 +412,7 @@ namespace Kinesis::GUI
         show_gameobject ? gameobject_manager(&show_gameobject) : void();
         show_scene ? scene_viewer(&show_scene) : void();
         show_rendering ? rendering_editor(&show_rendering) : void();
+        show_memory ? memory_panel(&show_memory) : void();
         dark_mode ? ImGui::StyleColorsDark() : ImGui::StyleColorsLight();
 
         ImGui::Render();
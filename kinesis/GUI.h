@@ -10,13 +10,17 @@ namespace Kinesis::GUI
     extern bool show_scene;
     extern bool show_rendering;
     extern bool show_gameobject;
+    extern bool show_memory;
     extern bool show_toolbar;
     extern bool dark_mode;
     extern bool raytracing_available;
+    extern bool rayquery_available; // VK_KHR_ray_query enabled, the RT pass can run as a compute shader
+    extern bool traceindirect_available; // rayTracingPipelineTraceRaysIndirect enabled (compacted dispatch with the RT pipeline)
     extern bool enable_raytracing_pass;
     extern int gbuffer_debug_mode; // 0=Off, 1=Position, 2=Normal, 3=Albedo, 4=Properties
     extern int samples_per_pixel; // SPP for ray tracing
     extern int max_ray_depth; // Maximum ray bounces
+    extern bool hybrid_primary_rays; // Start RT paths at the G-buffer's first hit instead of tracing primary rays
     extern ImVec4 clear_color;
 
     /**
@@ -48,6 +52,12 @@ namespace Kinesis::GUI
      */
     void rendering_editor(bool *p_open);
 
+    /**
+     * @brief Renders the Memory Budget window (per-category usage, heap budgets, residency)
+     * @param p_open Pointer to the window's visibility state
+     */
+    void memory_panel(bool *p_open);
+
     /**
      * @brief Initializes the GUI system with default settings
      */
@@ -0,0 +1,85 @@
+// denoise.glsl - Bindings and helpers shared by the denoiser passes
+// (denoise_temporal.comp, denoise_atrous.comp). All images are in image coordinates of the RT output,
+// which match the G-buffer texels (see renderPixel in rtpath.glsl).
+
+#ifndef DENOISE_GLSL
+#define DENOISE_GLSL
+
+// Must match GROUP_SIZE in denoiser.cpp
+layout(local_size_x = 8, local_size_y = 8, local_size_z = 1) in;
+
+// --- Bindings (Denoiser::createLayouts) ---
+layout(set = 0, binding = 0, rgba16f) uniform image2D outputImage; // RT output, denoised in place
+layout(set = 0, binding = 1) uniform sampler2D gbuffer_position;   // xyz: world position, w: 1 on geometry
+layout(set = 0, binding = 2) uniform sampler2D gbuffer_normal;     // xyz: normal, a: roughness
+layout(set = 0, binding = 3) uniform sampler2D gbuffer_albedo;     // rgb: albedo, a: 0 = dielectric
+layout(set = 0, binding = 4) uniform sampler2D gbuffer_properties; // r: metallic, g: (ior-1)/2, b: type/2
+layout(set = 0, binding = 5, rgba16f) uniform image2D historyColor0;    // rgb: color, a: history length
+layout(set = 0, binding = 6, rgba16f) uniform image2D historyColor1;
+layout(set = 0, binding = 7, rgba16f) uniform image2D historyMoments0;  // r: luminance, g: luminance^2
+layout(set = 0, binding = 8, rgba16f) uniform image2D historyMoments1;
+layout(set = 0, binding = 9, rgba16f) uniform image2D historyGeometry0; // xyz: normal, w: camera distance
+layout(set = 0, binding = 10, rgba16f) uniform image2D historyGeometry1;
+layout(set = 0, binding = 11, rgba16f) uniform image2D filter0;         // rgb: color, a: variance
+layout(set = 0, binding = 12, rgba16f) uniform image2D filter1;
+
+// Must match DenoisePushConstants in denoiser.cpp
+layout(push_constant) uniform DenoiseParameters {
+    mat4 prevViewProjection;
+    vec4 cameraPosition;
+    vec4 prevCameraPosition; // w = 1 if the history is usable
+    ivec2 size;
+    uint current;            // History slot written this frame, the other one is read
+    int stepSize;            // A-trous tap distance in pixels
+    uint source;             // Filter image read
+    uint target;             // Filter image written, OUTPUT_TARGET = the RT output
+    float temporalAlpha;
+    float phiColor;
+} params;
+
+const uint OUTPUT_TARGET = 2u;
+
+// Image selection by uniform index; no descriptor arrays, so no dynamic indexing needed
+vec4 loadHistoryColor(uint slot, ivec2 p) { return slot == 0u ? imageLoad(historyColor0, p) : imageLoad(historyColor1, p); }
+vec4 loadHistoryMoments(uint slot, ivec2 p) { return slot == 0u ? imageLoad(historyMoments0, p) : imageLoad(historyMoments1, p); }
+vec4 loadHistoryGeometry(uint slot, ivec2 p) { return slot == 0u ? imageLoad(historyGeometry0, p) : imageLoad(historyGeometry1, p); }
+vec4 loadFilter(uint index, ivec2 p) { return index == 0u ? imageLoad(filter0, p) : imageLoad(filter1, p); }
+
+void storeHistory(uint slot, ivec2 p, vec4 color, vec4 moments, vec4 geometry) {
+    if (slot == 0u) {
+        imageStore(historyColor0, p, color);
+        imageStore(historyMoments0, p, moments);
+        imageStore(historyGeometry0, p, geometry);
+    } else {
+        imageStore(historyColor1, p, color);
+        imageStore(historyMoments1, p, moments);
+        imageStore(historyGeometry1, p, geometry);
+    }
+}
+
+// Filter result; the RT output keeps alpha 1 like the trace writes it
+void storeFilter(uint target, ivec2 p, vec4 value) {
+    if (target == OUTPUT_TARGET) {
+        imageStore(outputImage, p, vec4(value.rgb, 1.0));
+    } else if (target == 0u) {
+        imageStore(filter0, p, value);
+    } else {
+        imageStore(filter1, p, value);
+    }
+}
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Material class as renderPixel decides it: 0 = not traced (diffuse, background), 1 = metal, 2 = dielectric
+int tracedClass(ivec2 p) {
+    if (texelFetch(gbuffer_position, p, 0).w < 0.5)
+        return 0;
+    if (texelFetch(gbuffer_albedo, p, 0).a < 0.5)
+        return 2;
+    int materialType = int(texelFetch(gbuffer_properties, p, 0).b * 2.0 + 0.5);
+    return materialType == 1 ? 1 : 0;
+}
+
+#endif // DENOISE_GLSL
@@ -1,5 +1,7 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+#extension GL_EXT_scalar_block_layout : require
 
 // Input from Vertex Shader
 layout(location = 0) in vec3 fragWorldPos;
@@ -14,29 +16,38 @@ layout(location = 2) out vec4 outAlbedo;      // Attachment 2: Albedo/Base Color
 layout(location = 3) out vec4 outProperties;  // Attachment 3: Metallic(R), IOR(G), Type(B), ?(A)
 
 
-// --- Material Information (Example: Pass via Push Constant or UBO/SSBO) ---
-// This is a placeholder. Ideally, get material properties from a buffer
-// based on the primitive/object being rendered.
-// Using push constants is simpler for now but limited in size.
+// --- Material Information ---
+// Materials live in a storage buffer of the bindless heap (set 1). The push constants only carry
+// the per-instance handles: which heap buffer, and which element in it.
 layout(push_constant) uniform PushConstants {
     mat4 modelMatrix;
     mat4 normalMatrix;
-    vec3 baseColor;       // Passed instead of using vertex color directly?
-    float roughness;
-    float metallic;        // 0 for dielectric, 1 for metal
-    float ior;             // Index of Refraction (relevant for dielectrics)
-    int materialType;      // 0: Diffuse, 1: Metal, 2: Dielectric
-} material;
+    uint materialBuffer;   // BindlessHeap storage buffer handle
+    uint materialIndex;    // Element in that buffer
+} instance;
+
+// Must match MaterialData in kinesis.cpp (and raytrace.rchit)
+struct MaterialData {
+   vec4 baseColor;
+   vec4 emissiveColor;
+   float roughness;
+   float metallic;        // 0 for dielectric, 1 for metal
+   float ior;             // Index of Refraction (relevant for dielectrics)
+   int type;              // 0: Diffuse, 1: Metal, 2: Dielectric
+};
+// Bindless heap, binding 0: every storage buffer; this declaration views them as material arrays
+layout(set = 1, binding = 0, scalar) readonly buffer MaterialHeap { MaterialData m[]; } materialHeap[];
 // ----------------------------------------------------------------------
 
-// Example texture sampler (if materials use textures)
-// layout(set = 1, binding = 0) uniform sampler2D texSampler;
+// Example texture sampler (if materials use textures): heap bindings 1 (texture2D[]) and 2 (sampler[])
 
 
 void main() {
+    MaterialData material = materialHeap[instance.materialBuffer].m[instance.materialIndex];
+
     // --- 1. Calculate Final Albedo ---
     // vec3 finalAlbedo = texture(texSampler, fragTexCoord).rgb * fragColor; // Example with texture * vertex color
-    vec3 finalAlbedo = material.baseColor; // Using push constant base color directly for simplicity
+    vec3 finalAlbedo = material.baseColor.rgb; // Using the material base color directly for simplicity
 
     // --- 2. Write to G-Buffer ---
 
@@ -50,7 +61,7 @@ void main() {
 
     // Attachment 2: Albedo
     // Store the final base color. Alpha = 0.0 for dielectrics (transparent), 1.0 for opaque
-    float alphaValue = (material.materialType == 2) ? 0.0 : 1.0; // Type 2 = DIELECTRIC
+    float alphaValue = (material.type == 2) ? 0.0 : 1.0; // Type 2 = DIELECTRIC
     outAlbedo = vec4(finalAlbedo, alphaValue);
 
     // Attachment 3: Properties
@@ -60,7 +71,7 @@ void main() {
     // B: Material Type ID (e.g., 0.0, 0.5, 1.0 corresponding to types 0, 1, 2)
     // A: Could be emissive mask, transparency, etc. (unused for now)
     float packedIor = (material.ior - 1.0) * 0.5; // Example remapping IOR (1.0 to 3.0 -> 0.0 to 1.0)
-    float packedType = float(material.materialType) / 2.0; // Map 0,1,2 -> 0.0, 0.5, 1.0
+    float packedType = float(material.type) / 2.0; // Map 0,1,2 -> 0.0, 0.5, 1.0
     outProperties = vec4(material.metallic, packedIor, packedType, 1.0);
 
 }
\ No newline at end of file
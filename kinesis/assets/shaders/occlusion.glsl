@@ -0,0 +1,75 @@
+// occlusion.glsl - Visibility queries through the occlusion ray type
+// Include in any ray tracing stage that traces rays, after declaring `topLevelAS`.
+// Occlusion rays skip closest hit shading and stop at the first hit found, with a 4-byte payload
+// that only the occlusion miss shader (raytrace_occlusion.rmiss) writes, so they cost a fraction
+// of a shading ray. Use them for shadow rays towards lights and for ambient occlusion.
+// Compute shaders using ray queries define OCCLUSION_RAY_QUERY before including; the same functions
+// then traverse inline with a rayQueryEXT.
+
+#ifndef OCCLUSION_GLSL
+#define OCCLUSION_GLSL
+
+// Must match the SBT layout in raytracermanager.cpp: miss record 0 shades, miss record 1 is occlusion
+#define OCCLUSION_MISS_INDEX 1
+// Location 0 is the shading payload (HitPayload)
+#define OCCLUSION_PAYLOAD_LOCATION 1
+
+// True if nothing is hit between origin + direction * tMin and origin + direction * tMax.
+// direction doesn't need to be normalized; t is in units of its length.
+#ifdef OCCLUSION_RAY_QUERY
+bool traceVisibility(vec3 origin, vec3 direction, float tMin, float tMax) {
+    rayQueryEXT rayQuery;
+    rayQueryInitializeEXT(rayQuery, topLevelAS, gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT,
+                          0xFF, origin, tMin, direction, tMax);
+    while (rayQueryProceedEXT(rayQuery)) {
+        // Opaque only, nothing to confirm
+    }
+    return rayQueryGetIntersectionTypeEXT(rayQuery, true) == gl_RayQueryCommittedIntersectionNoneEXT;
+}
+#else
+layout(location = OCCLUSION_PAYLOAD_LOCATION) rayPayloadEXT uint occlusionPayload;
+
+bool traceVisibility(vec3 origin, vec3 direction, float tMin, float tMax) {
+    occlusionPayload = 1u; // Occluded unless the miss shader runs
+    traceRayEXT(topLevelAS,
+                gl_RayFlagsOpaqueEXT | gl_RayFlagsTerminateOnFirstHitEXT | gl_RayFlagsSkipClosestHitShaderEXT,
+                0xFF,                 // Cull mask
+                0, 0,                 // No hit group is invoked, SBT offset/stride don't matter
+                OCCLUSION_MISS_INDEX,
+                origin, tMin, direction, tMax,
+                OCCLUSION_PAYLOAD_LOCATION);
+    return occlusionPayload == 0u;
+}
+#endif
+
+// True if the segment between two points is unobstructed, e.g. a surface point and a point on a light.
+// The ends are shortened by epsilon so neither surface occludes itself.
+bool isVisible(vec3 from, vec3 to, float epsilon) {
+    vec3 delta = to - from;
+    float dist = length(delta);
+    if (dist <= 2.0 * epsilon) {
+        return true;
+    }
+    return traceVisibility(from, delta / dist, epsilon, dist - epsilon);
+}
+
+// True if nothing is hit within maxDistance along a direction, e.g. a directional light or the sky.
+bool isDirectionVisible(vec3 origin, vec3 direction, float maxDistance) {
+    return traceVisibility(origin, direction, 0.001, maxDistance);
+}
+
+// One ambient occlusion sample: 1 if a cosine-distributed ray from the surface escapes within radius,
+// 0 otherwise. Averaging over samples gives the ambient visibility. xi are two uniform random numbers in [0, 1).
+float ambientOcclusionSample(vec3 position, vec3 normal, float radius, vec2 xi) {
+    float phi = 2.0 * 3.14159265359 * xi.x;
+    float sinTheta = sqrt(1.0 - xi.y);
+    vec3 local = vec3(sinTheta * cos(phi), sinTheta * sin(phi), sqrt(xi.y));
+
+    vec3 u = normalize(cross(abs(normal.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0), normal));
+    vec3 v = cross(normal, u);
+    vec3 direction = local.x * u + local.y * v + local.z * normal;
+
+    return traceVisibility(position + normal * 0.001, direction, 0.0, radius) ? 1.0 : 0.0;
+}
+
+#endif // OCCLUSION_GLSL
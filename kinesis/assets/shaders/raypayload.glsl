@@ -0,0 +1,40 @@
+// raypayload.glsl - Shading ray payload and sky shading
+// Shared by the ray tracing pipeline shaders (payload location 0) and the ray query compute backend,
+// which passes the same struct around as a local variable.
+
+#ifndef RAYPAYLOAD_GLSL
+#define RAYPAYLOAD_GLSL
+
+#include "skybox.glsl"
+
+// How nextRayDir was sampled, so the path loop can sample lights and weigh them against it (MIS)
+const int LOBE_SPECULAR = 0; // Delta reflection/refraction (or no hit): lights can't be sampled
+const int LOBE_DIFFUSE = 1;  // Cosine-weighted hemisphere around hitNormal
+const int LOBE_GLOSSY = 2;   // Normalized Phong lobe around the mirror direction, lobeExponent
+const int LOBE_EMITTER = 3;  // The hit is a light, hitColor is its emission
+
+struct HitPayload {
+    vec3 hitColor;      // Emission/Light from the hit
+    vec3 attenuation;   // Throughput color (albedo)
+    vec3 nextRayOrigin; // Origin for next bounce
+    vec3 nextRayDir;    // Direction for next bounce
+    int done;           // 0 = continue, 1 = stop
+    uint seed;          // Random seed
+    vec3 hitNormal;     // Shading normal the bounce was sampled around
+    float hitT;         // Distance to the hit
+    int lobe;           // LOBE_*
+    vec3 lobeAxis;      // Mirror direction, center of LOBE_GLOSSY
+    float lobeExponent; // Phong exponent of LOBE_GLOSSY
+};
+
+// A shading ray that hit nothing sees the sky and ends the path
+void shadeMiss(vec3 rayDirection, inout HitPayload p) {
+    vec3 rayDir = normalize(rayDirection);
+    vec3 skyColor = getSkyColor(rayDir);
+
+    p.hitColor = skyColor;
+    p.attenuation = vec3(0.0);
+    p.done = 1; // Stop tracing
+}
+
+#endif // RAYPAYLOAD_GLSL
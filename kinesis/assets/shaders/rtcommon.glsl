@@ -0,0 +1,116 @@
+// rtcommon.glsl - Declarations shared by the RT pass shaders
+// The path tracer (rtpath.glsl), the upsampler (raytrace_upsample.comp) and the other RT compute passes
+// use the same pipeline layout and descriptor sets, so they share the camera, push constants, images,
+// random numbers and the reduced resolution pattern from here.
+
+#ifndef RTCOMMON_GLSL
+#define RTCOMMON_GLSL
+
+// --- Camera Uniform ---
+layout(set = 0, binding = 0, std140) uniform CameraBufferObject {
+    mat4 projection;
+    mat4 view;
+    mat4 inverseProjection;
+    mat4 inverseView;
+    uint frameNumber;   // Frames rendered so far, decorrelates the samples of consecutive frames
+    float time;         // Seconds since start
+} cam;
+
+// --- Per-Frame Parameters ---
+// Must match TracePushConstants in raytracermanager.cpp
+layout(push_constant) uniform RtPushConstants {
+    uvec2 launchSize;        // Ray query backend only, the pipeline has gl_LaunchSizeEXT
+    uint accumulatedFrames;  // Frames already averaged into accumulationImage, 0 = start over
+    uint pattern;            // Sub-pixel pattern at reduced resolution: PATTERN_*
+    uvec2 blockSize;         // Image pixels per traced pixel: (1,1) full, (2,1) half, (2,2) quarter
+    uint budgetSamples;      // Average samples per traced pixel (the variant's SAMPLES_PER_PIXEL)
+    uint maxSamples;         // Adaptive sampling: per-pixel limit of sampleBudgetImage, 0 = off
+    uint compacted;          // 1 = the trace runs over pixelList instead of the launch grid
+    uint sampleLights;       // 1 = next-event estimation with lightList (rtpath.glsl)
+    uint restir;             // 1 = primary hits take their direct light from the ReSTIR reservoirs
+    uint restirCandidates;   // Light samples per pixel resampled by raytrace_restir.comp
+    uint restirHistory;      // 1 = last frame's reservoirs are valid for temporal reuse
+    uint _pad0;
+    uint _pad1;
+    mat4 prevViewProjection; // Camera of last frame's reservoirs
+} rtParams;
+
+const uint PATTERN_CHECKERBOARD = 0u; // Neighbouring blocks trace different sub-pixels
+const uint PATTERN_ROTATING = 1u;     // All blocks trace the same sub-pixel, which moves every frame
+
+// --- Images ---
+// Both are full resolution; at reduced resolution each frame only traces one pixel per block
+layout(set = 1, binding = 1, rgba16f) uniform image2D outputImage;
+layout(set = 1, binding = 10, rgba32f) uniform image2D accumulationImage; // rgb: running average, a: samples in it
+
+// --- Adaptive Sampling ---
+// Per-sample luminance statistics over the last STATISTICS_WINDOW samples (not reset with the accumulation)
+layout(set = 1, binding = 11, rgba32f) uniform image2D statisticsImage; // r: mean, g: mean of squares, b: samples
+// Samples each pixel traces next frame plus one, written by raytrace_budget.comp (0 = no budget yet)
+layout(set = 1, binding = 12, r32ui) uniform uimage2D sampleBudgetImage;
+const float STATISTICS_WINDOW = 64.0;
+
+// --- Compacted Dispatch ---
+// Pixels of this frame that need rays, written by raytrace_compact.comp; the header doubles as the
+// indirect arguments of the trace (offsets must match RtPixelList in raytracermanager.cpp)
+layout(set = 1, binding = 14, std430) buffer RtPixelList {
+    uint traceArgs[3];    // VkTraceRaysIndirectCommandKHR: LIST_ROW_LENGTH wide rows
+    uint dispatchArgs[3]; // VkDispatchIndirectCommand of the ray query backend: LIST_ROW_GROUPS wide rows
+    uint count;
+    uint padding;
+    uint pixels[];        // Image pixels, x | y << 16
+} pixelList;
+const uint LIST_ROW_LENGTH = 4096u;
+const uint LIST_ROW_GROUPS = 65535u;   // maxComputeWorkGroupCount[0] guaranteed minimum
+
+// --- Random Number Generator (Improved) ---
+uint pcg_hash(uint seed) {
+    uint state = seed * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float rnd(inout uint state) {
+    state = pcg_hash(state);
+    return float(state) / float(0xFFFFFFFFu);
+}
+
+// --- G-Buffer Samplers (for optimization) ---
+// Based on descriptor layout: 3=Pos, 4=Norm, 5=Alb, 6=Prop
+layout(set = 1, binding = 3) uniform sampler2D gbuffer_position;
+layout(set = 1, binding = 4) uniform sampler2D gbuffer_normal;
+layout(set = 1, binding = 5) uniform sampler2D gbuffer_albedo;
+layout(set = 1, binding = 6) uniform sampler2D gbuffer_properties;
+
+// --- Reduced Resolution ---
+uint blockPixelCount() {
+    return rtParams.blockSize.x * rtParams.blockSize.y;
+}
+
+// Image pixel traced this frame in block (in image coordinates). The pattern repeats every
+// blockPixelCount() frames, so after that many consecutive frames every pixel was traced once.
+ivec2 tracedPixelInBlock(ivec2 block) {
+    uint count = blockPixelCount();
+    uint index = rtParams.pattern == PATTERN_CHECKERBOARD
+        ? (uint(block.x + block.y) + cam.frameNumber) % count
+        : cam.frameNumber % count;
+    // Quarter resolution visits the diagonal first, so two consecutive frames already cover both axes
+    const ivec2 quarterOrder[4] = ivec2[](ivec2(0, 0), ivec2(1, 1), ivec2(1, 0), ivec2(0, 1));
+    ivec2 offset = count == 4u ? quarterOrder[index] : ivec2(index % rtParams.blockSize.x, index / rtParams.blockSize.x);
+    return block * ivec2(rtParams.blockSize) + offset;
+}
+
+bool isTracedThisFrame(ivec2 pixel) {
+    return tracedPixelInBlock(pixel / ivec2(rtParams.blockSize)) == pixel;
+}
+
+// Material class the RT pass shades at an image pixel: 0 = none (diffuse, background; compositing uses
+// the raster result), 1 = metal, 2 = dielectric. Same decision as renderPixel.
+int rtMaterialClass(ivec2 pixel) {
+    if (texelFetch(gbuffer_albedo, pixel, 0).a < 0.5)
+        return 2; // The alpha flag is exact, the packed type is not
+    int materialType = int(texelFetch(gbuffer_properties, pixel, 0).b * 2.0 + 0.5);
+    return materialType == 1 ? 1 : 0;
+}
+
+#endif // RTCOMMON_GLSL
@@ -0,0 +1,75 @@
+// rtlights.glsl - Emissive triangles of the scene and the pdfs of sampling them
+// Used by the path tracer's next-event estimation (rtpath.glsl) and by the ReSTIR candidate and reuse
+// passes (raytrace_restir.comp). Requires raypayload.glsl (LOBE_*) included first.
+
+#ifndef RTLIGHTS_GLSL
+#define RTLIGHTS_GLSL
+
+// --- Light List ---
+// Every emissive triangle in world space, with an alias table selecting them by power (LightList::update).
+// Must match GpuLight/GpuHeader in lightlist.cpp
+struct LightTriangle {
+    vec4 position0; // xyz, w = area
+    vec4 position1; // xyz, w = selection probability
+    vec4 position2; // xyz, w = probability of keeping this entry in the alias table
+    vec4 emission;  // rgb
+    uint alias;     // Entry taken otherwise
+    uint _pad0;
+    uint _pad1;
+    uint _pad2;
+};
+layout(set = 1, binding = 15, std430) readonly buffer LightListBuffer {
+    uint count;
+    float totalPower; // Sum of emitted luminance x area
+    uint _pad0;
+    uint _pad1;
+    LightTriangle lights[];
+} lightList;
+
+float luminance(vec3 c) {
+    return dot(c, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Alias table lookup: a uniform entry (u0), kept or swapped for its alias (u1). Picks each triangle
+// with probability position1.w. The list must not be empty.
+uint pickLight(float u0, float u1) {
+    uint index = min(uint(u0 * float(lightList.count)), lightList.count - 1u);
+    if (u1 >= lightList.lights[index].position2.w) {
+        index = lightList.lights[index].alias;
+    }
+    return index;
+}
+
+// Uniform point on the triangle for two uniform numbers; the pdf per area is 1 / area
+vec3 pointOnLight(LightTriangle light, vec2 u) {
+    float su = sqrt(u.x);
+    return light.position0.xyz * (1.0 - su) + light.position1.xyz * (su * (1.0 - u.y)) + light.position2.xyz * (su * u.y);
+}
+
+vec3 lightNormal(LightTriangle light) {
+    return normalize(cross(light.position1.xyz - light.position0.xyz, light.position2.xyz - light.position0.xyz));
+}
+
+// Light sampling picks a triangle with probability power / totalPower and a uniform point on it, so the
+// solid angle pdf of reaching an emitter this way is the same for every triangle of that emitter:
+// luminance(emission) * distance^2 / (totalPower * cosine at the light). Emitters are two-sided, like
+// the instances (culling disabled).
+float lightSolidAnglePdf(float emittedLuminance, float dist, float lightCosine) {
+    return emittedLuminance * dist * dist / (lightList.totalPower * max(lightCosine, 1e-6));
+}
+
+// Solid angle pdf of direction dir under the lobe a surface sampled its bounce from (rtshading.glsl).
+// Both lobes are sampled in proportion to f * cos, so f * cos = attenuation * pdf.
+float lobePdf(int lobe, vec3 normal, vec3 axis, float exponent, vec3 dir) {
+    if (lobe == LOBE_DIFFUSE) {
+        return max(dot(normal, dir), 0.0) / 3.14159265359;
+    }
+    return (exponent + 1.0) / (2.0 * 3.14159265359) * pow(max(dot(axis, dir), 0.0), exponent);
+}
+
+// Power heuristic
+float misWeight(float pdf, float otherPdf) {
+    return pdf * pdf / (pdf * pdf + otherPdf * otherPdf);
+}
+
+#endif // RTLIGHTS_GLSL
@@ -0,0 +1,313 @@
+// rtpath.glsl - Per-pixel path tracing loop of the RT pass
+// Shared by raytrace.rgen (ray tracing pipeline) and raytrace_query.comp (ray query backend). The
+// including shader defines traceShadingRay, everything else is identical so both backends match.
+// Requires raypayload.glsl and rtshading.glsl included first.
+
+#ifndef RTPATH_GLSL
+#define RTPATH_GLSL
+
+// --- Specialization Constants ---
+// Set per pipeline variant (RayTracerManager::compilePipelineVariant), so both loops have constant trip counts
+// (with adaptive sampling the sample count comes from sampleBudgetImage instead)
+layout(constant_id = 0) const int SAMPLES_PER_PIXEL = 8;
+layout(constant_id = 1) const int MAX_DEPTH = 12;
+// Hybrid rendering: the first hit comes from the G-buffer (rasterized) instead of a traced primary ray
+layout(constant_id = 2) const bool HYBRID_PRIMARY = false;
+
+// Camera, push constants, output images, G-buffer and the reduced resolution pattern
+#include "rtcommon.glsl"
+
+// --- Ray Tracing Bindings ---
+layout(set = 1, binding = 0) uniform accelerationStructureEXT topLevelAS;
+// Materials and geometry: bindless heap at set 2 (rtshading.glsl)
+
+// Shadow rays towards sampled lights (the ray query backend defines OCCLUSION_RAY_QUERY)
+#include "occlusion.glsl"
+
+// Emissive triangles and the lobe pdfs for light sampling
+#include "rtlights.glsl"
+// Reservoirs of the ReSTIR direct lighting passes (raytrace_restir.comp)
+#include "rtrestir.glsl"
+
+vec3 randomInUnitDisk(inout uint seed) {
+    float r = sqrt(rnd(seed));
+    float theta = 2.0 * 3.14159265359 * rnd(seed);
+    return vec3(r * cos(theta), r * sin(theta), 0.0);
+}
+
+// --- Next-Event Estimation ---
+// Samples one light for the surface whose bounce p describes and returns its MIS-weighted contribution,
+// to be multiplied by the throughput and p.attenuation
+vec3 sampleLight(HitPayload p, inout uint seed) {
+    float u0 = rnd(seed);
+    float u1 = rnd(seed);
+    LightTriangle light = lightList.lights[pickLight(u0, u1)];
+    vec3 lightPoint = pointOnLight(light, vec2(rnd(seed), rnd(seed)));
+
+    vec3 toLight = lightPoint - p.nextRayOrigin;
+    float dist = length(toLight);
+    vec3 dir = toLight / dist;
+    if (dot(dir, p.hitNormal) <= 0.0) {
+        return vec3(0.0); // Behind the surface, where its lobe never goes
+    }
+    float lightCosine = abs(dot(lightNormal(light), dir));
+    float scatterPdf = lobePdf(p.lobe, p.hitNormal, p.lobeAxis, p.lobeExponent, dir);
+    if (lightCosine < 1e-6 || scatterPdf <= 0.0) {
+        return vec3(0.0);
+    }
+    float pdfLight = light.position1.w * dist * dist / (light.position0.w * lightCosine);
+    if (!isVisible(p.nextRayOrigin, lightPoint, 0.001)) {
+        return vec3(0.0);
+    }
+    // f * cos / pdfLight = attenuation * scatterPdf / pdfLight
+    return light.emission.rgb * scatterPdf / pdfLight * misWeight(pdfLight, scatterPdf);
+}
+
+// --- ReSTIR Direct Lighting ---
+// Direct light of a primary hit from the pixel's final reservoir, with its one visibility ray; to be
+// multiplied by the albedo. Replaces both light sampling and emitter hits of the first bounce.
+vec3 restirDirectLight(ivec2 pixel, RestirSurface s) {
+    Reservoir r = reservoirs.r[reservoirIndex(RESERVOIR_FINAL, pixel)];
+    if (r.W <= 0.0) {
+        return vec3(0.0);
+    }
+    vec3 lightPoint;
+    vec3 radiance = restirRadiance(s, r.lightIndex, unpackUnorm2x16(r.lightUv), lightPoint);
+    if (!isVisible(s.position + s.normal * 0.001, lightPoint, 0.001)) {
+        return vec3(0.0);
+    }
+    return radiance * r.W;
+}
+
+// scatterPdf of a bounce whose direct light came from the reservoir: emitters it hits add nothing
+const float RESERVOIR_LIT = -1.0;
+
+// Traces one shading ray (tMin 0.001, tMax 1000, opaque) and shades its hit or miss into p.
+// Defined by the including shader.
+void traceShadingRay(vec3 origin, vec3 direction, inout HitPayload p);
+
+// Shades the rasterized first hit of texelCoord, seen from cameraPos, like traceShadingRay would have
+// shaded a primary ray through the pixel center. The material is rebuilt from the G-buffer packing
+// (gbuffer.frag); materialType was already unpacked by the caller.
+void shadeGBufferHit(ivec2 texelCoord, vec3 cameraPos, vec4 albedoSample, vec4 propertiesSample, int materialType, inout HitPayload p) {
+    vec3 hitPos = texelFetch(gbuffer_position, texelCoord, 0).xyz;
+    vec4 normalRough = texelFetch(gbuffer_normal, texelCoord, 0);
+
+    MaterialData mat;
+    mat.baseColor = vec4(albedoSample.rgb, 1.0);
+    mat.emissiveColor = vec4(0.0);
+    mat.roughness = normalRough.a;
+    mat.metallic = propertiesSample.r;
+    mat.ior = propertiesSample.g * 2.0 + 1.0; // Packed as (ior - 1) / 2
+    mat.type = materialType;
+
+    vec3 toHit = hitPos - cameraPos;
+    float hitT = length(toHit);
+    scatterSurface(mat, materialType, hitPos, normalize(normalRough.xyz), toHit / hitT, hitT, p);
+}
+
+// Renders pixel pixelCoords of a size.x * size.y launch into outputImage
+void renderPixel(uvec2 pixelCoords, uvec2 size) {
+    // --- Early Out for Diffuse Materials (Optimization) ---
+    // Check G-Buffer to see if this pixel needs raytracing
+    ivec2 texelCoord = ivec2(pixelCoords.x, int(size.y) - int(pixelCoords.y) - 1);
+    vec4 albedoSample = texelFetch(gbuffer_albedo, texelCoord, 0);
+    vec4 propertiesSample = texelFetch(gbuffer_properties, texelCoord, 0);
+    
+    // Unpack material type
+    float packedType = propertiesSample.b;
+    int materialType = int(packedType * 2.0 + 0.5); // 0=Diffuse, 1=Metal, 2=Dielectric
+    bool isDielectric = (albedoSample.a < 0.5);
+    bool isMetal = (materialType == 1);
+    materialType = isDielectric ? 2 : materialType; // The alpha flag is exact, the packed type is not
+    
+    // Skip raytracing for pure diffuse materials (floor, walls, etc)
+    if (!isDielectric && !isMetal) {
+        // Write black/zero to output - compositing shader will use raster only
+        ivec2 storeCoords = ivec2(pixelCoords.x, int(size.y) - int(pixelCoords.y) - 1);
+        imageStore(outputImage, storeCoords, vec4(0.0, 0.0, 0.0, 1.0));
+        return;
+    }
+
+    ivec2 storeCoords = ivec2(pixelCoords.x, int(size.y) - int(pixelCoords.y) - 1);
+    // At reduced resolution a pixel is traced every blockPixelCount() frames, so it has fewer frames of its own
+    uint ownFrames = rtParams.accumulatedFrames / blockPixelCount();
+
+    // --- Adaptive Sampling ---
+    // The budget pass hands out samples by estimated noise; a pixel whose average is still valid may get
+    // none this frame, one that starts over always traces at least one
+    int sampleCount = SAMPLES_PER_PIXEL;
+    if (rtParams.maxSamples > 0u) {
+        uint budget = imageLoad(sampleBudgetImage, storeCoords).r;
+        sampleCount = budget == 0u ? SAMPLES_PER_PIXEL : int(min(budget - 1u, rtParams.maxSamples));
+        if (ownFrames == 0u) {
+            sampleCount = max(sampleCount, 1);
+        }
+    }
+    if (sampleCount == 0) {
+        imageStore(outputImage, storeCoords, vec4(imageLoad(accumulationImage, storeCoords).rgb, 1.0));
+        return;
+    }
+
+    // The reservoir is shaded once and shared by all samples, its primary hit is the same G-buffer texel
+    bool reservoirLit = false;
+    vec3 reservoirDirect = vec3(0.0);
+    if (HYBRID_PRIMARY && rtParams.restir != 0u) {
+        RestirSurface surface;
+        reservoirLit = loadRestirSurface(texelCoord, surface);
+        if (reservoirLit) {
+            reservoirDirect = restirDirectLight(texelCoord, surface);
+        }
+    }
+
+    HitPayload p;
+    
+    // --- Multi-Sample Anti-Aliasing ---
+    vec3 accumulatedColor = vec3(0.0);
+    float luminanceSum = 0.0;   // Per-sample statistics for the adaptive sampling budget
+    float luminanceSqSum = 0.0;
+    
+    for (int smp = 0; smp < sampleCount; smp++) {
+
+        uint seed = pcg_hash(pixelCoords.y * size.x + pixelCoords.x +  cam.frameNumber * 7919u + uint(smp) * 104729u);
+        
+        // --- Camera Ray with Jitter (Anti-Aliasing) ---
+        vec2 jitter = vec2(rnd(seed), rnd(seed)) - 0.5;
+        vec2 pixelCenter = vec2(pixelCoords) + 0.5 + jitter;
+        vec2 inUV = pixelCenter / vec2(size);
+        
+        // Convert to clip space (-1 to 1) with correct Y direction
+        vec2 clipCoords = inUV * 2.0 - 1.0;
+        clipCoords.y = -clipCoords.y; // Correct for Vulkan's coordinate system
+        
+        // Create ray from camera
+        vec4 target = cam.inverseProjection * vec4(clipCoords.x, clipCoords.y, 1.0, 1.0);
+        vec3 rayDirection = normalize((cam.inverseView * vec4(normalize(target.xyz), 0.0)).xyz);
+        vec3 rayOrigin = vec3(cam.inverseView[3]); // Camera position
+        
+        vec3 throughput = vec3(1.0);
+        vec3 sampleColor = vec3(0.0);
+        float scatterPdf = 0.0; // Pdf of the lobe rayDirection was sampled from, 0 = specular (no MIS)
+        
+        // --- Path Tracing Loop ---
+        for (int depth = 0; depth < MAX_DEPTH; depth++) {
+            // Reset payload for this trace
+            p.done = 1;
+            p.hitColor = vec3(0.0);
+            p.attenuation = vec3(0.0);
+            p.seed = seed;
+            p.lobe = LOBE_SPECULAR; // Misses don't set it
+            
+            // Trace the ray; in hybrid mode rasterization already found the first hit
+            if (HYBRID_PRIMARY && depth == 0) {
+                shadeGBufferHit(texelCoord, rayOrigin, albedoSample, propertiesSample, materialType, p);
+            } else {
+                traceShadingRay(rayOrigin, rayDirection, p);
+            }
+            
+            // Update seed from payload
+            seed = p.seed;
+            
+            // Accumulate emitted light. A light the previous bounce also sampled directly only gets
+            // its MIS share here, the rest came from sampleLight (or all of it from the reservoir)
+            vec3 emitted = p.hitColor;
+            if (scatterPdf == RESERVOIR_LIT) {
+                emitted = vec3(0.0);
+            } else if (p.lobe == LOBE_EMITTER && scatterPdf > 0.0) {
+                float pdfLight = lightSolidAnglePdf(luminance(emitted), p.hitT, abs(dot(p.hitNormal, rayDirection)));
+                emitted *= misWeight(scatterPdf, pdfLight);
+            }
+            sampleColor += throughput * emitted;
+
+            // --- Next-Event Estimation ---
+            // Diffuse and rough surfaces sample a light directly (also when their own bounce was absorbed)
+            scatterPdf = 0.0;
+            if (reservoirLit && depth == 0) {
+                sampleColor += throughput * p.attenuation * reservoirDirect;
+                scatterPdf = RESERVOIR_LIT;
+            } else if (rtParams.sampleLights != 0u && (p.lobe == LOBE_DIFFUSE || p.lobe == LOBE_GLOSSY)) {
+                sampleColor += throughput * p.attenuation * sampleLight(p, seed);
+                scatterPdf = lobePdf(p.lobe, p.hitNormal, p.lobeAxis, p.lobeExponent, p.nextRayDir);
+            }
+            
+            // Stop if ray terminated or throughput is negligible
+            if (p.done == 1 || 
+                max(throughput.r, max(throughput.g, throughput.b)) < 0.001) {
+                break;
+            }
+            
+            // Russian Roulette after 8 bounces
+            if (depth > 8) {
+                float survival = max(throughput.r, max(throughput.g, throughput.b));
+                if (rnd(seed) > survival) {
+                    break;
+                }
+                throughput /= survival; // Compensate for survival
+            }
+            
+            // Apply attenuation and continue
+            throughput *= p.attenuation;
+            
+            // Setup next bounce
+            rayOrigin = p.nextRayOrigin;
+            rayDirection = p.nextRayDir;
+        }
+        
+        accumulatedColor += sampleColor;
+        float sampleLuminance = luminance(sampleColor);
+        luminanceSum += sampleLuminance;
+        luminanceSqSum += sampleLuminance * sampleLuminance;
+    }
+    
+    // Average the samples
+    float samples = float(sampleCount);
+    vec3 finalColor = accumulatedColor / samples;
+
+    // --- Sample Statistics ---
+    // Only needed to plan the adaptive budget; a sliding window so the estimate follows the view
+    if (rtParams.maxSamples > 0u) {
+        vec4 statistics = imageLoad(statisticsImage, storeCoords);
+        float total = statistics.b + samples;
+        vec2 moments = (statistics.rg * statistics.b + vec2(luminanceSum, luminanceSqSum)) / total;
+        imageStore(statisticsImage, storeCoords, vec4(moments, min(total, STATISTICS_WINDOW), 0.0));
+    }
+
+    // --- Progressive Accumulation ---
+    // Running average of all samples since the last reset; the sample count is kept in alpha, since
+    // adaptive sampling gives each frame a different number of samples
+    float accumulatedSamples = samples;
+    if (ownFrames > 0u) {
+        vec4 previous = imageLoad(accumulationImage, storeCoords);
+        accumulatedSamples += previous.a;
+        finalColor = (previous.rgb * previous.a + accumulatedColor) / accumulatedSamples;
+    }
+    imageStore(accumulationImage, storeCoords, vec4(finalColor, accumulatedSamples));
+
+    // --- Store Results ---
+    imageStore(outputImage, storeCoords, vec4(finalColor, 1.0));
+}
+
+// Entry point of both backends: renders the image pixel of launch cell launchId. At full resolution that
+// is the cell itself, at reduced resolution one pixel of its block (raytrace_upsample.comp fills the rest).
+void traceLaunchPixel(uvec2 launchId) {
+    ivec2 size = imageSize(outputImage);
+    ivec2 imagePixel = tracedPixelInBlock(ivec2(launchId));
+    if (any(greaterThanEqual(imagePixel, size))) {
+        return; // Partial block at an odd extent
+    }
+    // renderPixel counts rows bottom-up and stores at (x, h - y - 1)
+    renderPixel(uvec2(imagePixel.x, size.y - 1 - imagePixel.y), uvec2(size));
+}
+
+// Entry point of both backends for the compacted dispatch: renders entry index of pixelList
+void traceListedPixel(uint index) {
+    if (index >= pixelList.count) {
+        return; // The last row of the list is partial
+    }
+    uint packedPixel = pixelList.pixels[index];
+    ivec2 imagePixel = ivec2(packedPixel & 0xFFFFu, packedPixel >> 16);
+    ivec2 size = imageSize(outputImage);
+    renderPixel(uvec2(imagePixel.x, size.y - 1 - imagePixel.y), uvec2(size));
+}
+
+#endif // RTPATH_GLSL
@@ -0,0 +1,137 @@
+// rtrestir.glsl - Reservoirs of the ReSTIR direct lighting at the primary hit
+// raytrace_restir.comp fills one reservoir per pixel each frame: pass 0 resamples candidates from the
+// light list and merges last frame's reservoir at the reprojected position, pass 1 merges the reservoirs
+// of neighbouring pixels on a similar surface. The trace (rtpath.glsl) then shades the selected light
+// sample with a single visibility ray, so the cost per pixel doesn't grow with the number of lights.
+// Reservoirs only exist for hybrid primary hits on rough metal, the only primary surfaces of the RT pass
+// whose lobe light sampling applies to (glass and mirrors are specular, diffuse pixels are rasterized).
+// Requires raypayload.glsl, rtshading.glsl, rtcommon.glsl and rtlights.glsl included first.
+
+#ifndef RTRESTIR_GLSL
+#define RTRESTIR_GLSL
+
+// --- Reservoirs ---
+// Two sets of one reservoir per image pixel. Must match RESERVOIR_SIZE in raytracermanager.cpp
+struct Reservoir {
+    uint lightIndex;    // Selected light sample: a triangle of lightList
+    uint lightUv;       // and its point, packUnorm2x16 of the pointOnLight numbers
+    float W;            // Unbiased contribution weight of the sample, 0 = none
+    float M;            // Candidates the reservoir represents, 0 = empty
+    uint surfaceNormal; // packSnorm4x8 normal of the surface it was built for
+    float surfaceDepth; // Clip w of that surface in its frame's camera
+};
+layout(set = 1, binding = 16, std430) buffer ReservoirBuffer {
+    Reservoir r[];
+} reservoirs;
+const uint RESERVOIR_TEMPORAL = 0u; // Candidates and temporal reuse, written by pass 0
+const uint RESERVOIR_FINAL = 1u;    // After spatial reuse, read by the trace and by next frame's pass 0
+
+const float RESTIR_NORMAL_TOLERANCE = 0.9; // Minimum normal dot product for reuse
+const float RESTIR_DEPTH_TOLERANCE = 0.1;  // Maximum depth difference for reuse, relative
+
+uint reservoirIndex(uint set, ivec2 pixel) {
+    ivec2 size = imageSize(outputImage);
+    return set * uint(size.x * size.y) + uint(pixel.y * size.x + pixel.x);
+}
+
+// --- Primary Hit ---
+struct RestirSurface {
+    vec3 position;
+    vec3 normal;
+    vec3 albedo;
+    vec3 lobeAxis;      // Mirror direction of the camera ray
+    float lobeExponent; // Phong exponent of the glossy lobe
+    float depth;        // Clip w in this frame's camera
+};
+
+// The G-buffer hit of pixel, as shadeGBufferHit shades it. False unless it is a rough metal.
+bool loadRestirSurface(ivec2 pixel, out RestirSurface s) {
+    vec4 normalRough = texelFetch(gbuffer_normal, pixel, 0);
+    s.position = texelFetch(gbuffer_position, pixel, 0).xyz;
+    s.normal = normalize(normalRough.xyz);
+    s.albedo = texelFetch(gbuffer_albedo, pixel, 0).rgb;
+    s.lobeAxis = reflect(normalize(s.position - vec3(cam.inverseView[3])), s.normal);
+    s.lobeExponent = phongExponent(normalRough.a);
+    s.depth = (cam.projection * cam.view * vec4(s.position, 1.0)).w;
+    return rtMaterialClass(pixel) == 1 && normalRough.a > 0.0; // scatterSurface's LOBE_GLOSSY condition
+}
+
+// Light from a light sample, times the surface's f * cos divided by its albedo (rtlights.glsl: both
+// lobes have f * cos = albedo * pdf), per area of the light. Zero behind the surface.
+vec3 restirRadiance(RestirSurface s, uint lightIndex, vec2 uv, out vec3 lightPoint) {
+    LightTriangle light = lightList.lights[lightIndex];
+    lightPoint = pointOnLight(light, uv);
+    vec3 toLight = lightPoint - s.position;
+    float dist2 = max(dot(toLight, toLight), 1e-8);
+    vec3 dir = toLight * inversesqrt(dist2);
+    if (dot(dir, s.normal) <= 0.0) {
+        return vec3(0.0);
+    }
+    float lightCosine = abs(dot(lightNormal(light), dir));
+    return light.emission.rgb * lobePdf(LOBE_GLOSSY, s.normal, s.lobeAxis, s.lobeExponent, dir) * lightCosine / dist2;
+}
+
+// Target function of the resampling: the unshadowed contribution, as luminance
+float restirTarget(RestirSurface s, uint lightIndex, vec2 uv) {
+    vec3 lightPoint;
+    return luminance(s.albedo * restirRadiance(s, lightIndex, uv, lightPoint));
+}
+
+// True if a reservoir built for another pixel (or frame) describes a surface like s. depth is s seen
+// from the camera the reservoir was built with.
+bool restirSimilar(RestirSurface s, Reservoir other, float depth) {
+    if (other.M <= 0.0) {
+        return false;
+    }
+    vec3 otherNormal = normalize(unpackSnorm4x8(other.surfaceNormal).xyz);
+    return dot(s.normal, otherNormal) > RESTIR_NORMAL_TOLERANCE &&
+           abs(other.surfaceDepth - depth) < RESTIR_DEPTH_TOLERANCE * depth;
+}
+
+// --- Streaming Resampling ---
+// A reservoir being filled: keeps one sample, replaced by each new one with probability weight / weightSum
+struct ReservoirState {
+    uint lightIndex;
+    vec2 uv;
+    float targetPdf; // Target of the kept sample at the surface being filled
+    float weightSum;
+    float M;
+};
+
+ReservoirState emptyReservoirState() {
+    return ReservoirState(0u, vec2(0.0), 0.0, 0.0, 0.0);
+}
+
+void reservoirAdd(inout ReservoirState r, uint lightIndex, vec2 uv, float weight, float targetPdf, float M, float u) {
+    r.weightSum += weight;
+    r.M += M;
+    if (u * r.weightSum < weight) {
+        r.lightIndex = lightIndex;
+        r.uv = uv;
+        r.targetPdf = targetPdf;
+    }
+}
+
+// Resamples another reservoir's sample at s, as if its M candidates had been taken here
+void reservoirMerge(inout ReservoirState r, Reservoir other, float M, RestirSurface s, float u) {
+    vec2 uv = unpackUnorm2x16(other.lightUv);
+    float targetPdf = restirTarget(s, other.lightIndex, uv);
+    reservoirAdd(r, other.lightIndex, uv, targetPdf * other.W * M, targetPdf, M, u);
+}
+
+Reservoir reservoirFinish(ReservoirState r, RestirSurface s) {
+    Reservoir result;
+    result.lightIndex = r.lightIndex;
+    result.lightUv = packUnorm2x16(r.uv);
+    result.W = r.targetPdf > 0.0 ? r.weightSum / (r.M * r.targetPdf) : 0.0;
+    result.M = r.M;
+    result.surfaceNormal = packSnorm4x8(vec4(s.normal, 0.0));
+    result.surfaceDepth = s.depth;
+    return result;
+}
+
+Reservoir emptyReservoir() {
+    return Reservoir(0u, 0u, 0.0, 0.0, 0u, 0.0);
+}
+
+#endif // RTRESTIR_GLSL
@@ -0,0 +1,272 @@
+// rtshading.glsl - Surface shading of a shading ray hit (diffuse, metal, dielectric)
+// Shared by the closest hit shader and the ray query compute backend, so both produce the same paths.
+// Requires GL_EXT_scalar_block_layout and GL_EXT_nonuniform_qualifier, and raypayload.glsl included first.
+
+#ifndef RTSHADING_GLSL
+#define RTSHADING_GLSL
+
+// --- Bindings ---
+// NOTE: Must match MaterialData in kinesis.cpp exactly (vec4s)
+struct MaterialData {
+   vec4 baseColor;
+   vec4 emissiveColor;
+   float roughness;
+   float metallic;
+   float ior;
+   int type;
+};
+struct Vertex { vec3 position; vec3 color; vec3 normal; vec2 texCoord; int _pad; };
+
+// Bindless heap (set 2), binding 0 holds every storage buffer; each declaration below views the
+// same array as a different buffer type. Indices are relative to the mesh's vertexOffset.
+layout(set = 2, binding = 0, scalar) readonly buffer VertexHeap { Vertex v[]; } vertexHeap[];
+layout(set = 2, binding = 0, scalar) readonly buffer IndexHeap { uint i[]; } indexHeap[];
+layout(set = 2, binding = 0, scalar) readonly buffer MaterialHeap { MaterialData m[]; } materialHeap[];
+
+// Per-instance heap handles and mesh range, indexed by gl_InstanceCustomIndexEXT
+struct InstanceData {
+    uint vertexBuffer;
+    uint indexBuffer;
+    uint vertexOffset;
+    uint firstIndex;
+    uint indexCount;
+    uint materialBuffer;
+    uint materialIndex;
+    uint _pad;
+};
+layout(set = 1, binding = 9, scalar) readonly buffer InstanceBuffer { InstanceData d[]; } instances;
+
+// --- Random Float Generator [0, 1) ---
+// Not the raygen generator (rtpath.glsl): bounce sampling has always used this LCG
+float hitRnd(inout uint prev) {
+  prev = (prev * 1664525u + 1013904223u);
+  return float(prev & 0x00FFFFFF) / float(0x01000000);
+}
+
+// --- Helper: Sample Cosine Weighted Hemisphere (Diffuse) ---
+vec3 sampleHemisphere(vec3 normal, inout uint seed) {
+    // Sample random angles
+    float r1 = hitRnd(seed);
+    float r2 = hitRnd(seed);
+    
+    // Cosine-weighted hemisphere sampling
+    float theta = 2.0 * 3.14159265359 * r1;  // Azimuth
+    float phi = acos(sqrt(r2));              // Polar angle (cosine weighted)
+    
+    float x = sin(phi) * cos(theta);
+    float y = sin(phi) * sin(theta);
+    float z = cos(phi);
+    
+    // Create local coordinate system from normal
+    vec3 u = normalize(cross(abs(normal.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0), normal));
+    vec3 v = cross(normal, u);
+    
+    // Transform to world space
+    return normalize(x * u + y * v + z * normal);
+}
+
+// --- Helper: Glossy lobe of rough metals ---
+// Normalized Phong lobe around the mirror direction; roughness 1 spreads it over the whole hemisphere.
+// Unlike a random perturbation its pdf is known, so light sampling can be weighed against it (MIS).
+float phongExponent(float roughness) {
+    return max(2.0 / max(roughness * roughness, 1e-4) - 2.0, 0.0);
+}
+
+vec3 samplePhongLobe(vec3 axis, float exponent, inout uint seed) {
+    float r1 = hitRnd(seed);
+    float r2 = hitRnd(seed);
+
+    float cosAlpha = pow(r2, 1.0 / (exponent + 1.0));
+    float sinAlpha = sqrt(max(1.0 - cosAlpha * cosAlpha, 0.0));
+    float phi = 2.0 * 3.14159265359 * r1;
+
+    vec3 u = normalize(cross(abs(axis.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0), axis));
+    vec3 v = cross(axis, u);
+    return normalize(sinAlpha * cos(phi) * u + sinAlpha * sin(phi) * v + cosAlpha * axis);
+}
+
+// --- Helper: Schlick Fresnel ---
+float schlick(float cosine, float ref_idx) {
+    float r0 = (1.0 - ref_idx) / (1.0 + ref_idx);
+    r0 = r0 * r0;
+    return r0 + (1.0 - r0) * pow((1.0 - cosine), 5.0);
+}
+
+// --- Helper: Refract using Snell's law ---
+bool refractRay(vec3 v, vec3 n, float ni_over_nt, out vec3 refracted) {
+    vec3 uv = normalize(v);
+    float dt = dot(uv, n);
+    float discriminant = 1.0 - ni_over_nt * ni_over_nt * (1.0 - dt * dt);
+    
+    if (discriminant > 0.0) {
+        refracted = ni_over_nt * (uv - n * dt) - n * sqrt(discriminant);
+        return true;
+    } else {
+        return false; // Total Internal Reflection
+    }
+}
+
+// Scatters a ray (direction rayDir, hitT long) at hitPos with material mat of model materialType, and
+// writes the next bounce (or the end of the path) into p. Used for traced hits (shadeSurface) as well
+// as for the rasterized first hit of hybrid rendering (rtpath.glsl).
+void scatterSurface(MaterialData mat, int materialType, vec3 hitPos, vec3 worldNormal, vec3 rayDir, float hitT, inout HitPayload p);
+
+// Shades the hit of a ray against triangle primitiveID of instance instanceID (its gl_InstanceCustomIndexEXT)
+// at barycentrics attribs, and writes the next bounce (or the end of the path) into p.
+// materialType selects the material model; -1 uses the type stored in the material.
+void shadeSurface(uint instanceID, uint primitiveID, vec2 attribs, mat4x3 objectToWorld,
+                  vec3 rayOrigin, vec3 rayDirection, float hitT, int materialType, inout HitPayload p) {
+    // --- Geometry Fetch ---
+    // Requires VK_BUFFER_USAGE_STORAGE_BUFFER_BIT in C++ creation!
+    // Handles differ between instances in the same wave, hence nonuniformEXT
+    InstanceData inst = instances.d[instanceID];
+    uint i0 = indexHeap[nonuniformEXT(inst.indexBuffer)].i[inst.firstIndex + 3 * primitiveID + 0] + inst.vertexOffset;
+    uint i1 = indexHeap[nonuniformEXT(inst.indexBuffer)].i[inst.firstIndex + 3 * primitiveID + 1] + inst.vertexOffset;
+    uint i2 = indexHeap[nonuniformEXT(inst.indexBuffer)].i[inst.firstIndex + 3 * primitiveID + 2] + inst.vertexOffset;
+
+    vec3 n0 = vertexHeap[nonuniformEXT(inst.vertexBuffer)].v[i0].normal;
+    vec3 n1 = vertexHeap[nonuniformEXT(inst.vertexBuffer)].v[i1].normal;
+    vec3 n2 = vertexHeap[nonuniformEXT(inst.vertexBuffer)].v[i2].normal;
+
+    // Interpolate normal
+    vec3 bary = vec3(1.0 - attribs.x - attribs.y, attribs.x, attribs.y);
+    vec3 localNormal = normalize(n0 * bary.x + n1 * bary.y + n2 * bary.z);
+    vec3 worldNormal = normalize(mat3(objectToWorld) * localNormal);
+
+    vec3 hitPos = rayOrigin + rayDirection * hitT;
+    vec3 rayDir = normalize(rayDirection);
+    
+    // --- Material Fetch ---
+    MaterialData mat = materialHeap[nonuniformEXT(inst.materialBuffer)].m[inst.materialIndex];
+    if (materialType < 0) {
+        materialType = mat.type;
+    }
+
+    scatterSurface(mat, materialType, hitPos, worldNormal, rayDir, hitT, p);
+}
+
+void scatterSurface(MaterialData mat, int materialType, vec3 hitPos, vec3 worldNormal, vec3 rayDir, float hitT, inout HitPayload p) {
+    uint seed = p.seed; // Local copy of seed
+
+    // Where and how the bounce was sampled, for light sampling in the path loop
+    p.hitNormal = worldNormal;
+    p.hitT = hitT;
+    p.lobe = LOBE_SPECULAR;
+    p.lobeAxis = worldNormal;
+    p.lobeExponent = 0.0;
+
+    // --- Material Logic ---
+    // TYPE 0: DIFFUSE
+    if (materialType == 0) {
+        // Sample a random direction in the hemisphere around the normal
+        vec3 diffuseDir = sampleHemisphere(worldNormal, seed);
+        
+        // Return material properties for next bounce
+        p.hitColor = vec3(0.0);  // No direct emission
+        p.attenuation = mat.baseColor.rgb;  // Use actual material albedo color
+        p.nextRayOrigin = hitPos + worldNormal * 0.001;
+        p.nextRayDir = diffuseDir;
+        p.done = 0; // Continue tracing
+        p.lobe = LOBE_DIFFUSE;
+    }
+    // TYPE 1: METAL
+else if (materialType == 1) {
+    // Perfect reflection: r = v - 2(v·n)n
+    vec3 reflected = reflect(rayDir, worldNormal);
+    
+    // --- ROUGHNESS: Sample the glossy lobe around the reflection direction ---
+    if (mat.roughness > 0.0) {
+        p.lobe = LOBE_GLOSSY;
+        p.lobeAxis = reflected;
+        p.lobeExponent = phongExponent(mat.roughness);
+        reflected = samplePhongLobe(reflected, p.lobeExponent, seed);
+    }
+    
+    // Apply metal color tint (albedo)
+    vec3 metalColor = mat.baseColor.rgb;
+    
+    // Only scatter if the reflected ray points away from the surface
+    if (dot(reflected, worldNormal) > 0.0) {
+        p.hitColor = vec3(0.0);
+        p.attenuation = metalColor; // Tint reflection with metal color!
+        p.nextRayOrigin = hitPos + worldNormal * 0.001;
+        p.nextRayDir = reflected;
+        p.done = 0; // Continue tracing
+    } else {
+        // Ray scattered into the surface - absorb it. Light sampling at this hit still counts,
+        // so the tint and origin are kept for it; the path loop stops before applying them.
+        p.hitColor = vec3(0.0);
+        p.attenuation = metalColor;
+        p.nextRayOrigin = hitPos + worldNormal * 0.001;
+        p.done = 1; // Stop tracing
+    }
+}
+    // TYPE 2: GLASS / DIELECTRIC
+else if (materialType == 2) {
+        vec3 outwardNormal;
+        float ni_over_nt;
+        vec3 attenuation = vec3(1.0); // Default no absorption
+
+        // Check if we are hitting front (entering) or back (exiting)
+        if (dot(rayDir, worldNormal) > 0.0) {
+            // EXITING the glass
+            outwardNormal = -worldNormal;
+            ni_over_nt = mat.ior; // Glass -> Air (assuming air is 1.0)
+            
+            // --- FIX: BEER'S LAW (Absorption) ---
+            // Light has traveled distance `gl_HitTEXT` inside the material.
+            // Absorb light based on distance and material color.
+            // Darker baseColor = higher density/absorbance.
+            vec3 absorbance = -log(mat.baseColor.rgb + vec3(0.0001)); // Prevent log(0)
+            attenuation = exp(-absorbance * hitT); 
+        } else {
+            // ENTERING the glass
+            outwardNormal = worldNormal;
+            ni_over_nt = 1.0 / mat.ior; // Air -> Glass
+        }
+
+        vec3 refractedDir;
+        float reflectProb;
+        
+        // --- FIX: CHECK FOR TOTAL INTERNAL REFLECTION ---
+        // Attempt to calculate refraction direction
+        bool canRefract = refractRay(rayDir, outwardNormal, ni_over_nt, refractedDir);
+
+        if (canRefract) {
+            // Calculate Schlick probability only if refraction is possible
+            float cosine = dot(-rayDir, outwardNormal);
+            reflectProb = schlick(cosine, 1.0 / mat.ior);
+        } else {
+            // Total Internal Reflection: Must reflect 100%
+            reflectProb = 1.0;
+        }
+
+        // Stochastic Refraction/Reflection
+        if (hitRnd(seed) < reflectProb) {
+            // Reflection
+            vec3 reflected = reflect(rayDir, outwardNormal);
+            p.nextRayDir = reflected;
+            p.attenuation = attenuation; // Carry any absorption from inside
+        } else {
+            // Refraction
+            p.nextRayDir = refractedDir;
+            p.attenuation = attenuation; // Carry any absorption
+        }
+
+        p.hitColor = vec3(0.0);
+        p.nextRayOrigin = hitPos + p.nextRayDir * 0.001;
+        p.done = 0;
+    }
+    // TYPE 3: LIGHT / EMISSIVE
+    else if (materialType == 3) {
+        // Emitters end the path; the path loop weighs this against light sampling (MIS)
+        p.hitColor = mat.emissiveColor.rgb;
+        p.attenuation = vec3(0.0);
+        p.done = 1;
+        p.lobe = LOBE_EMITTER;
+    }
+
+    p.seed = seed; // Update payload seed
+}
+
+#endif // RTSHADING_GLSL
@@ -0,0 +1,209 @@
+// kinesis/bindlessheap.cpp
+#include "bindlessheap.h"
+#include "deletionqueue.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Kinesis::BindlessHeap
+{
+    namespace
+    {
+        constexpr uint32_t TYPE_COUNT = 3;
+        constexpr std::array<VkDescriptorType, TYPE_COUNT> descriptorTypes = {
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+            VK_DESCRIPTOR_TYPE_SAMPLER};
+        // Requested sizes, clamped to the device's update-after-bind limits in initialize()
+        constexpr std::array<uint32_t, TYPE_COUNT> requestedCapacities = {4096, 4096, 64};
+
+        // Per-array slot allocator: fresh slots come from nextSlot, released ones from the free list
+        struct SlotAllocator
+        {
+            uint32_t capacity = 0;
+            uint32_t nextSlot = 0;
+            uint32_t used = 0;
+            std::vector<Handle> freeSlots;
+        };
+
+        std::array<SlotAllocator, TYPE_COUNT> allocators{};
+        VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+
+        Handle allocateSlot(Type type)
+        {
+            SlotAllocator &slots = allocators[static_cast<uint32_t>(type)];
+            Handle handle = INVALID_HANDLE;
+            if (!slots.freeSlots.empty())
+            {
+                handle = slots.freeSlots.back();
+                slots.freeSlots.pop_back();
+            }
+            else if (slots.nextSlot < slots.capacity)
+            {
+                handle = slots.nextSlot++;
+            }
+            else
+            {
+                throw std::runtime_error("BindlessHeap: descriptor array " + std::to_string(static_cast<uint32_t>(type)) + " is full!");
+            }
+            slots.used++;
+            return handle;
+        }
+
+        void writeSlot(Type type, Handle handle, const VkDescriptorBufferInfo *bufferInfo, const VkDescriptorImageInfo *imageInfo)
+        {
+            VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+            write.dstSet = set;
+            write.dstBinding = static_cast<uint32_t>(type);
+            write.dstArrayElement = handle;
+            write.descriptorCount = 1;
+            write.descriptorType = descriptorTypes[static_cast<uint32_t>(type)];
+            write.pBufferInfo = bufferInfo;
+            write.pImageInfo = imageInfo;
+            vkUpdateDescriptorSets(g_Device, 1, &write, 0, nullptr);
+        }
+    }
+
+    void initialize()
+    {
+        if (g_Device == VK_NULL_HANDLE || g_PhysicalDevice == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("Device not created before BindlessHeap::initialize!");
+        }
+
+        // Clamp the array sizes to what the device allows for update-after-bind sets
+        VkPhysicalDeviceVulkan12Properties props12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+        VkPhysicalDeviceProperties2 props2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+        props2.pNext = &props12;
+        vkGetPhysicalDeviceProperties2(g_PhysicalDevice, &props2);
+        std::array<uint32_t, TYPE_COUNT> limits = {
+            std::min(props12.maxDescriptorSetUpdateAfterBindStorageBuffers, props12.maxPerStageDescriptorUpdateAfterBindStorageBuffers),
+            std::min(props12.maxDescriptorSetUpdateAfterBindSampledImages, props12.maxPerStageDescriptorUpdateAfterBindSampledImages),
+            std::min(props12.maxDescriptorSetUpdateAfterBindSamplers, props12.maxPerStageDescriptorUpdateAfterBindSamplers)};
+
+        std::array<VkDescriptorSetLayoutBinding, TYPE_COUNT> bindings{};
+        std::array<VkDescriptorBindingFlags, TYPE_COUNT> bindingFlags{};
+        std::array<VkDescriptorPoolSize, TYPE_COUNT> poolSizes{};
+        for (uint32_t i = 0; i < TYPE_COUNT; ++i)
+        {
+            allocators[i] = {};
+            allocators[i].capacity = std::min(requestedCapacities[i], limits[i]);
+            bindings[i] = {i, descriptorTypes[i], allocators[i].capacity, VK_SHADER_STAGE_ALL, nullptr};
+            // Partially bound: unused slots may hold nothing (or a destroyed resource).
+            // Update-after-bind / unused-while-pending: slots can be (re)written while the set is in use.
+            bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                              VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                              VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+            poolSizes[i] = {descriptorTypes[i], allocators[i].capacity};
+        }
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+        flagsInfo.bindingCount = TYPE_COUNT;
+        flagsInfo.pBindingFlags = bindingFlags.data();
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = TYPE_COUNT;
+        layoutInfo.pBindings = bindings.data();
+        if (vkCreateDescriptorSetLayout(g_Device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create bindless heap descriptor set layout!");
+        }
+
+        // Own pool: update-after-bind sets have separate limits and this one set is never freed
+        VkDescriptorPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = 1;
+        poolInfo.poolSizeCount = TYPE_COUNT;
+        poolInfo.pPoolSizes = poolSizes.data();
+        if (vkCreateDescriptorPool(g_Device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create bindless heap descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+        allocInfo.descriptorPool = pool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+        if (vkAllocateDescriptorSets(g_Device, &allocInfo, &set) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate bindless heap descriptor set!");
+        }
+
+        std::cout << "Bindless heap created: " << allocators[0].capacity << " storage buffers, "
+                  << allocators[1].capacity << " sampled images, " << allocators[2].capacity << " samplers." << std::endl;
+    }
+
+    Handle registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        Handle handle = allocateSlot(Type::StorageBuffer);
+        VkDescriptorBufferInfo info{buffer, offset, range};
+        writeSlot(Type::StorageBuffer, handle, &info, nullptr);
+        return handle;
+    }
+
+    Handle registerSampledImage(VkImageView view, VkImageLayout imageLayout)
+    {
+        Handle handle = allocateSlot(Type::SampledImage);
+        VkDescriptorImageInfo info{VK_NULL_HANDLE, view, imageLayout};
+        writeSlot(Type::SampledImage, handle, nullptr, &info);
+        return handle;
+    }
+
+    Handle registerSampler(VkSampler sampler)
+    {
+        Handle handle = allocateSlot(Type::Sampler);
+        VkDescriptorImageInfo info{sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED};
+        writeSlot(Type::Sampler, handle, nullptr, &info);
+        return handle;
+    }
+
+    void release(Type type, Handle handle)
+    {
+        if (handle == INVALID_HANDLE)
+            return;
+        // Frames already recorded may still index this slot, only reuse it once they retired
+        DeletionQueue::retire([type, handle]()
+                              {
+            SlotAllocator &slots = allocators[static_cast<uint32_t>(type)];
+            slots.freeSlots.push_back(handle);
+            slots.used--; });
+    }
+
+    VkDescriptorSetLayout getLayout() { return layout; }
+    VkDescriptorSet getSet() { return set; }
+
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout pipelineLayout, uint32_t setIndex)
+    {
+        vkCmdBindDescriptorSets(commandBuffer, bindPoint, pipelineLayout, setIndex, 1, &set, 0, nullptr);
+    }
+
+    uint32_t getUsedCount(Type type) { return allocators[static_cast<uint32_t>(type)].used; }
+    uint32_t getCapacity(Type type) { return allocators[static_cast<uint32_t>(type)].capacity; }
+
+    void cleanup()
+    {
+        if (g_Device == VK_NULL_HANDLE)
+            return;
+        // The set is freed with its pool
+        if (pool != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorPool(g_Device, pool, nullptr);
+            pool = VK_NULL_HANDLE;
+        }
+        if (layout != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorSetLayout(g_Device, layout, nullptr);
+            layout = VK_NULL_HANDLE;
+        }
+        set = VK_NULL_HANDLE;
+        allocators = {};
+    }
+}
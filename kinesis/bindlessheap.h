@@ -0,0 +1,73 @@
+#ifndef BINDLESSHEAP_H
+#define BINDLESSHEAP_H
+
+#include "kinesis.h"
+
+namespace Kinesis::BindlessHeap
+{
+    /**
+     * @brief Index of a descriptor inside one of the heap's arrays. Shaders receive handles
+     * per instance (push constants, instance table) and index the matching array with them.
+     */
+    using Handle = uint32_t;
+    constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+    /**
+     * @brief The heap's descriptor arrays. The value is also the binding number in the heap set.
+     */
+    enum class Type : uint32_t
+    {
+        StorageBuffer = 0, // layout(set = HEAP, binding = 0) buffer ... [];
+        SampledImage = 1,  // layout(set = HEAP, binding = 1) uniform texture2D ...[];
+        Sampler = 2,       // layout(set = HEAP, binding = 2) uniform sampler ...[];
+    };
+
+    /**
+     * @brief Creates the heap's layout, pool and its single descriptor set.
+     * Every binding is partially bound and update-after-bind, so new slots can be written
+     * while frames using the set are still in flight. Capacities are clamped to the device limits.
+     */
+    void initialize();
+
+    /**
+     * @brief Writes a storage buffer into a free slot.
+     * @return The slot's handle. Throws if the array is full.
+     */
+    Handle registerStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+
+    /**
+     * @brief Writes a sampled image into a free slot.
+     */
+    Handle registerSampledImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    /**
+     * @brief Writes a sampler into a free slot.
+     */
+    Handle registerSampler(VkSampler sampler);
+
+    /**
+     * @brief Returns a slot to its free list once the frames in flight that may still
+     * read it have retired (goes through DeletionQueue). The descriptor itself is left as is,
+     * partially bound descriptors that are never accessed don't need to stay valid.
+     */
+    void release(Type type, Handle handle);
+
+    VkDescriptorSetLayout getLayout();
+    VkDescriptorSet getSet();
+
+    /**
+     * @brief Binds the heap set at setIndex of the given pipeline layout.
+     */
+    void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex);
+
+    uint32_t getUsedCount(Type type); // Slots currently handed out
+    uint32_t getCapacity(Type type);
+
+    /**
+     * @brief Destroys the pool and layout. The device must be idle and the DeletionQueue flushed after
+     * the last release, so no slot comes back to a heap that is gone.
+     */
+    void cleanup();
+}
+
+#endif // BINDLESSHEAP_H
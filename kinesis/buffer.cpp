@@ -49,6 +49,7 @@ Buffer::~Buffer() {
            buffer = VK_NULL_HANDLE; // Nullify handle after destruction
        }
        if (memory != VK_NULL_HANDLE) {
+           Kinesis::MemoryBudget::untrack(memory);
            vkFreeMemory(device, memory, nullptr);
            memory = VK_NULL_HANDLE; // Nullify handle after destruction
        }
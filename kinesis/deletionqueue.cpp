@@ -0,0 +1,128 @@
+// kinesis/deletionqueue.cpp
+#include "deletionqueue.h"
+#include "memorybudget.h"
+#include "swapchain.h"
+
+#include <cstring>
+#include <vector>
+
+namespace Kinesis::DeletionQueue
+{
+    namespace
+    {
+        struct PendingDeletion
+        {
+            uint64_t frame; // Frame that may still reference the resource
+            DeleterFn fn;
+            alignas(std::max_align_t) unsigned char captures[MAX_DELETER_SIZE];
+        };
+
+        // Tags only ever increase, so the queue stays sorted by frame. Erased from the front, never
+        // shrunk, so once it has seen the usual number of retirements it stops allocating.
+        std::vector<PendingDeletion> pending;
+        uint64_t submittedFrames = 0;
+        uint64_t completedFrames = 0; // Frames below this tag are done
+
+        // Runs the first `count` entries and drops them. A deleter may retire more (which can
+        // reallocate pending), so each entry is copied out before it runs.
+        void runFront(size_t count)
+        {
+            for (size_t i = 0; i < count; ++i)
+            {
+                PendingDeletion entry = pending[i];
+                entry.fn(entry.captures);
+            }
+            pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(count));
+        }
+    }
+
+    void retireRaw(DeleterFn fn, const void *captures, size_t size)
+    {
+        // Whatever is being recorded right now (or next) may use the resource; previously
+        // submitted frames finish before it, so waiting on this frame's fence covers them too.
+        PendingDeletion entry{};
+        entry.frame = submittedFrames;
+        entry.fn = fn;
+        memcpy(entry.captures, captures, size);
+        pending.push_back(entry);
+    }
+
+    void retireBuffer(VkBuffer buffer, VkDeviceMemory memory)
+    {
+        if (buffer == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+            return;
+        retire([buffer, memory]()
+               {
+                   if (g_Device == VK_NULL_HANDLE)
+                       return;
+                   if (buffer != VK_NULL_HANDLE)
+                       vkDestroyBuffer(g_Device, buffer, nullptr);
+                   if (memory != VK_NULL_HANDLE)
+                   {
+                       MemoryBudget::untrack(memory);
+                       vkFreeMemory(g_Device, memory, nullptr); // Implicitly unmaps persistently mapped memory
+                   } });
+    }
+
+    void retireImage(VkImage image, VkImageView view, VkDeviceMemory memory)
+    {
+        if (image == VK_NULL_HANDLE && view == VK_NULL_HANDLE && memory == VK_NULL_HANDLE)
+            return;
+        retire([image, view, memory]()
+               {
+                   if (g_Device == VK_NULL_HANDLE)
+                       return;
+                   if (view != VK_NULL_HANDLE)
+                       vkDestroyImageView(g_Device, view, nullptr);
+                   if (image != VK_NULL_HANDLE)
+                       vkDestroyImage(g_Device, image, nullptr);
+                   if (memory != VK_NULL_HANDLE)
+                   {
+                       MemoryBudget::untrack(memory);
+                       vkFreeMemory(g_Device, memory, nullptr);
+                   } });
+    }
+
+    void collect()
+    {
+        // The fence just waited on belongs to the frame submitted MAX_FRAMES_IN_FLIGHT frames ago
+        const uint64_t framesInFlight = static_cast<uint64_t>(SwapChain::MAX_FRAMES_IN_FLIGHT);
+        if (submittedFrames < framesInFlight)
+            return;
+        const uint64_t completedFrame = submittedFrames - framesInFlight;
+        completedFrames = completedFrame + 1;
+        size_t count = 0;
+        while (count < pending.size() && pending[count].frame <= completedFrame)
+            count++;
+        // Anything retired by these deleters is tagged with a later frame and stays queued
+        runFront(count);
+    }
+
+    void advanceFrame()
+    {
+        submittedFrames++;
+    }
+
+    void flush()
+    {
+        // Deleters may retire further resources, keep going until nothing is left
+        while (!pending.empty())
+            runFront(pending.size());
+        completedFrames = submittedFrames;
+    }
+
+    size_t getPendingCount()
+    {
+        return pending.size();
+    }
+
+    uint64_t getFrameNumber()
+    {
+        return submittedFrames;
+    }
+
+    uint64_t getCompletedFrameCount()
+    {
+        return completedFrames;
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef DELETIONQUEUE_H
+#define DELETIONQUEUE_H
+
+#include "kinesis.h"
+#include <cstddef>
+#include <type_traits>
+
+namespace Kinesis::DeletionQueue
+{
+    // Captures of a retired deleter are stored inline in the queue, so retiring never allocates
+    constexpr size_t MAX_DELETER_SIZE = 48;
+    using DeleterFn = void (*)(void *captures);
+
+    /**
+     * @brief Type-erased part of retire(): queues fn together with a copy of the size bytes at captures.
+     */
+    void retireRaw(DeleterFn fn, const void *captures, size_t size);
+
+    /**
+     * @brief Queues a destroy callback for a resource that in-flight frames may still use.
+     * The callback is tagged with the frame currently being recorded (or about to be) and runs
+     * once that frame's fence has signaled, so no device-wide idle is needed to drop a resource.
+     * The handles must already be unreachable from anything recorded later.
+     * @param deleter Destroys/frees the resource. Runs on the main thread inside collect()/flush().
+     * Its captures are copied bytewise, so they must be trivially copyable (handles, ids, raw pointers).
+     */
+    template <typename Deleter>
+    void retire(const Deleter &deleter)
+    {
+        static_assert(sizeof(Deleter) <= MAX_DELETER_SIZE, "Deleter captures too much for the inline storage");
+        static_assert(alignof(Deleter) <= alignof(std::max_align_t), "Deleter is over-aligned");
+        static_assert(std::is_trivially_copyable_v<Deleter> && std::is_trivially_destructible_v<Deleter>,
+                      "Deleter must only capture trivially copyable values");
+        retireRaw([](void *captures)
+                  { (*static_cast<Deleter *>(captures))(); },
+                  &deleter, sizeof(Deleter));
+    }
+
+    /**
+     * @brief Convenience wrappers around retire() for the common buffer/image cases.
+     * Memory is untracked from MemoryBudget when it is actually freed, not when it is retired.
+     * Null handles are ignored.
+     */
+    void retireBuffer(VkBuffer buffer, VkDeviceMemory memory);
+    void retireImage(VkImage image, VkImageView view, VkDeviceMemory memory);
+
+    /**
+     * @brief Runs every deleter whose frame is known to be finished.
+     * Call right after the current frame slot's in-flight fence has been waited on (Renderer::beginFrame).
+     */
+    void collect();
+
+    /**
+     * @brief Marks the frame being recorded as submitted. Call once per vkQueueSubmit of a frame.
+     */
+    void advanceFrame();
+
+    /**
+     * @brief Runs every pending deleter immediately. Only valid after vkDeviceWaitIdle.
+     */
+    void flush();
+
+    /**
+     * @brief Number of resources waiting for their frame to retire.
+     */
+    size_t getPendingCount();
+
+    /**
+     * @brief Number of frames submitted so far; retired resources are tagged with this value.
+     */
+    uint64_t getFrameNumber();
+
+    /**
+     * @brief Every frame tagged with a number below this one is known to have finished on the GPU.
+     * Advanced by collect() and flush().
+     */
+    uint64_t getCompletedFrameCount();
+}
+
+#endif // DELETIONQUEUE_H
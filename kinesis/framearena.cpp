@@ -0,0 +1,124 @@
+// kinesis/framearena.cpp
+#include "framearena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+
+namespace Kinesis::FrameArena
+{
+    namespace
+    {
+        constexpr size_t INITIAL_CAPACITY = 256 * 1024;
+
+        std::unique_ptr<std::byte[]> block;
+        size_t capacity = 0;
+        size_t offset = 0;
+
+        // Blocks handed out after the main block ran out during this frame
+        std::vector<std::unique_ptr<std::byte[]>> overflowBlocks;
+        size_t overflowBytes = 0;
+        size_t highWaterMark = 0;
+
+        std::atomic<uint64_t> heapAllocations{0};
+        uint64_t allocationsAtLastReset = 0;
+        uint64_t allocationsLastFrame = 0;
+
+        size_t alignUp(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+    }
+
+    void *allocate(size_t size, size_t alignment)
+    {
+        if (!block)
+        {
+            capacity = INITIAL_CAPACITY;
+            block = std::make_unique<std::byte[]>(capacity);
+        }
+
+        size_t start = alignUp(offset, alignment);
+        if (start + size <= capacity)
+        {
+            offset = start + size;
+            return block.get() + start;
+        }
+
+        // Out of space: serve this one from its own block and remember to grow at the next reset
+        overflowBytes += size + alignment;
+        overflowBlocks.push_back(std::make_unique<std::byte[]>(size + alignment));
+        auto base = reinterpret_cast<uintptr_t>(overflowBlocks.back().get());
+        return reinterpret_cast<void *>(alignUp(base, alignment));
+    }
+
+    void reset()
+    {
+        size_t frameBytes = offset + overflowBytes;
+        highWaterMark = std::max(highWaterMark, frameBytes);
+        if (!overflowBlocks.empty())
+        {
+            // Grow so the next frame with the same workload fits into a single block
+            size_t newCapacity = std::max(capacity, INITIAL_CAPACITY);
+            while (newCapacity < frameBytes)
+                newCapacity *= 2;
+            overflowBlocks.clear();
+            block = std::make_unique<std::byte[]>(newCapacity);
+            capacity = newCapacity;
+        }
+        offset = 0;
+        overflowBytes = 0;
+
+        uint64_t count = heapAllocations.load(std::memory_order_relaxed);
+        allocationsLastFrame = count - allocationsAtLastReset;
+        allocationsAtLastReset = count;
+    }
+
+    size_t getUsedBytes() { return offset + overflowBytes; }
+    size_t getCapacity() { return capacity; }
+    size_t getHighWaterMark() { return highWaterMark; }
+
+    uint64_t getHeapAllocationCount() { return heapAllocations.load(std::memory_order_relaxed); }
+    uint64_t getHeapAllocationsLastFrame() { return allocationsLastFrame; }
+
+    // Used by the global operator new replacements below
+    void countHeapAllocation()
+    {
+        heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+// --- Global allocation instrumentation ---
+// Replacing the global operators counts every heap allocation made by the engine and its
+// libraries, which is what the "allocations per frame" readout in the GUI is based on.
+void *operator new(std::size_t size)
+{
+    Kinesis::FrameArena::countHeapAllocation();
+    if (void *ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    Kinesis::FrameArena::countHeapAllocation();
+    return std::malloc(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept
+{
+    return ::operator new(size, tag);
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { std::free(ptr); }
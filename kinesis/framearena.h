@@ -0,0 +1,75 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace Kinesis::FrameArena
+{
+    /**
+     * @brief Bump-allocates transient CPU memory that lives until the next reset().
+     * Nothing is freed individually; the whole arena is rewound once per frame.
+     * If a frame needs more than the current capacity, the overflow is served from extra
+     * heap blocks and the arena grows to fit on the next reset, so steady state does not allocate.
+     * @param size Number of bytes.
+     * @param alignment Power of two alignment.
+     */
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    template <typename T>
+    T *allocateArray(size_t count)
+    {
+        return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /**
+     * @brief Rewinds the arena. Called by Renderer::beginFrame; anything allocated during the
+     * previous frame is invalid afterwards.
+     */
+    void reset();
+
+    size_t getUsedBytes();
+    size_t getCapacity();
+    size_t getHighWaterMark(); // Most bytes used by a single frame so far
+
+    /**
+     * @brief Process-wide count of operator new calls (global allocation instrumentation).
+     */
+    uint64_t getHeapAllocationCount();
+
+    /**
+     * @brief Heap allocations made between the last two reset() calls, i.e. during the last full frame.
+     * Should read 0 once the scene and GUI have settled.
+     */
+    uint64_t getHeapAllocationsLastFrame();
+
+    /**
+     * @brief STL allocator adapter over the frame arena. deallocate() is a no-op, so containers
+     * using it must not outlive the frame. reserve() up front to avoid wasting arena space on growth.
+     */
+    template <typename T>
+    class Allocator
+    {
+    public:
+        using value_type = T;
+
+        Allocator() noexcept = default;
+        template <typename U>
+        Allocator(const Allocator<U> &) noexcept {}
+
+        T *allocate(size_t count) { return allocateArray<T>(count); }
+        void deallocate(T *, size_t) noexcept {}
+
+        template <typename U>
+        bool operator==(const Allocator<U> &) const noexcept { return true; }
+        template <typename U>
+        bool operator!=(const Allocator<U> &) const noexcept { return false; }
+    };
+
+    template <typename T>
+    using Vector = std::vector<T, Allocator<T>>;
+}
+
+#endif // FRAMEARENA_H
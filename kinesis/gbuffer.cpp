@@ -23,6 +23,7 @@ namespace Kinesis::GBuffer { // Use the inner namespace
 
     VkSampler sampler = VK_NULL_HANDLE;
     VkExtent2D extent = {0, 0}; // Initialize extent
+    uint32_t generation = 0;
 
     // Helper to create image attachments (no changes needed here, but ensure it uses g_Device correctly)
     void createImageAttachment(uint32_t width, uint32_t height, VkFormat format, VkImageUsageFlags usage, VkImage* image, VkDeviceMemory* memory, VkImageView* view) {
@@ -57,6 +58,7 @@ namespace Kinesis::GBuffer { // Use the inner namespace
              throw std::runtime_error("Failed to allocate G-Buffer image memory!");
          }
          vkBindImageMemory(g_Device, *image, *memory, 0);
+         MemoryBudget::track(*memory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, MemoryBudget::Category::GBuffer);
 
          VkImageViewCreateInfo viewInfo{};
          viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -86,7 +88,7 @@ namespace Kinesis::GBuffer { // Use the inner namespace
         std::array<VkAttachmentDescription, 5> attachments = {}; // Position, Normal, Albedo, Properties, Depth
 
         // Position (World Space) - Attachment 0
-        attachments[0].format = VK_FORMAT_R16G16B16A16_SFLOAT; // High precision for position
+        attachments[0].format = VK_FORMAT_R32G32B32A32_SFLOAT; // Full float: hybrid RT starts secondary rays from it
         attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
         attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE; // Need to store it
@@ -249,10 +251,11 @@ namespace Kinesis::GBuffer { // Use the inner namespace
         cleanup(); // Clean up previous resources if any
 
         extent = {width, height};
+        generation++; // Attachments below are new, cached descriptors must be rewritten
 
         // --- Create image attachments ---
-        // Position
-        createImageAttachment(width, height, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // Position (must match attachments[0] in createRenderPass)
+        createImageAttachment(width, height, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
                               &positionAttachment.image, &positionAttachment.memory, &positionAttachment.view);
         // Normal + Roughness
         createImageAttachment(width, height, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
@@ -298,7 +301,10 @@ namespace Kinesis::GBuffer { // Use the inner namespace
         auto destroyAttachment = [&](VkImageView& view, VkImage& image, VkDeviceMemory& memory) {
              if (view != VK_NULL_HANDLE) vkDestroyImageView(g_Device, view, nullptr);
              if (image != VK_NULL_HANDLE) vkDestroyImage(g_Device, image, nullptr);
-             if (memory != VK_NULL_HANDLE) vkFreeMemory(g_Device, memory, nullptr);
+             if (memory != VK_NULL_HANDLE) {
+                 MemoryBudget::untrack(memory);
+                 vkFreeMemory(g_Device, memory, nullptr);
+             }
              view = VK_NULL_HANDLE; image = VK_NULL_HANDLE; memory = VK_NULL_HANDLE;
         };
         destroyAttachment(positionAttachment.view, positionAttachment.image, positionAttachment.memory);
@@ -50,6 +50,7 @@ namespace Kinesis {
 
         extern VkSampler sampler;
         extern VkExtent2D extent;
+        extern uint32_t generation; // Bumped by setup(); descriptor sets sampling the attachments compare against it
 
         // Keep function declarations
         void setup(uint32_t width, uint32_t height, VkFormat depthFormat);
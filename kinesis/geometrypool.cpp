@@ -0,0 +1,501 @@
+// kinesis/geometrypool.cpp
+#include "geometrypool.h"
+#include "window.h" // For createBuffer
+#include "deletionqueue.h"
+#include "bindlessheap.h"
+#include "swapchain.h" // MAX_FRAMES_IN_FLIGHT
+#include "GUI.h"       // raytracing_available: which stages read the pool
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace Kinesis::GeometryPool
+{
+    namespace
+    {
+        struct Range
+        {
+            uint32_t offset;
+            uint32_t count;
+        };
+
+        // One shared, persistently mapped buffer plus a first-fit free list over its elements
+        struct Arena
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            uint32_t capacity = 0; // In elements
+            uint32_t used = 0;
+            VkDeviceSize stride = 0;
+            VkBufferUsageFlags usage = 0;
+            std::vector<Range> freeRanges;
+            BindlessHeap::Handle heapHandle = BindlessHeap::INVALID_HANDLE; // Storage buffer slot of `buffer`
+            uint32_t layoutEpoch = 0; // Incremented by compaction, which moves every range
+        };
+
+        Arena vertexArena{};
+        Arena indexArena{};
+        uint32_t generation = 0;
+        uint32_t rangeGeneration = 0;
+        // Every live Allocation, so compaction can move their ranges
+        std::vector<Allocation *> owners;
+
+        // Vertex writes waiting for recordPendingWrites; the data of all of them is packed into
+        // pendingVertices. Both are cleared, not freed, so steady deformation doesn't allocate.
+        struct PendingWrite
+        {
+            const Allocation *allocation; // Destination, read when recorded so compaction is followed
+            size_t dataOffset;            // Into pendingVertices
+        };
+        std::vector<PendingWrite> pendingWrites;
+        std::vector<Mesh::Vertex> pendingVertices;
+
+        // One host-visible upload buffer per frame slot, grown as needed. It keeps the slot's last
+        // copies until the slot records again, so a reallocated arena can repeat the ones still in flight.
+        struct StagingBuffer
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            void *mapped = nullptr;
+            VkDeviceSize size = 0;
+            std::vector<VkBufferCopy> regions; // Staging -> vertex arena, bytes
+            uint64_t frameNumber = 0;          // DeletionQueue frame that recorded them
+        };
+        std::array<StagingBuffer, SwapChain::MAX_FRAMES_IN_FLIGHT> stagingBuffers{};
+
+        // Where compaction moved a live vertex range, in vertices
+        struct RangeMove
+        {
+            uint32_t oldOffset;
+            uint32_t count;
+            uint32_t newOffset;
+        };
+
+        // The copies of frames in flight may not have reached the old vertex buffer yet when it is
+        // copied into a new one; apply them to the new one on the CPU, oldest frame first. Slots whose
+        // frame already finished are skipped: their copies are in the old buffer's contents. With moves
+        // (compaction, sorted by oldOffset) the regions are rebased onto the new layout, and those of
+        // released ranges are dropped.
+        void replayRecentWrites(const std::vector<RangeMove> *moves)
+        {
+            const uint64_t completedFrames = DeletionQueue::getCompletedFrameCount();
+            std::array<StagingBuffer *, SwapChain::MAX_FRAMES_IN_FLIGHT> slots{};
+            for (size_t i = 0; i < slots.size(); ++i)
+                slots[i] = &stagingBuffers[i];
+            std::sort(slots.begin(), slots.end(), [](const StagingBuffer *a, const StagingBuffer *b)
+                      { return a->frameNumber < b->frameNumber; });
+            for (StagingBuffer *staging : slots)
+            {
+                if (staging->frameNumber < completedFrames)
+                {
+                    staging->regions.clear(); // Retired, never needed again
+                    continue;
+                }
+                size_t kept = 0;
+                for (VkBufferCopy region : staging->regions)
+                {
+                    if (moves)
+                    {
+                        const uint32_t oldOffset = static_cast<uint32_t>(region.dstOffset / vertexArena.stride);
+                        auto move = std::upper_bound(moves->begin(), moves->end(), oldOffset,
+                                                     [](uint32_t value, const RangeMove &m)
+                                                     { return value < m.oldOffset; });
+                        if (move == moves->begin() || oldOffset >= (move - 1)->oldOffset + (move - 1)->count)
+                            continue; // The range was released
+                        --move;
+                        region.dstOffset = vertexArena.stride * (move->newOffset + (oldOffset - move->oldOffset));
+                    }
+                    memcpy(static_cast<char *>(vertexArena.mapped) + region.dstOffset,
+                           static_cast<const char *>(staging->mapped) + region.srcOffset, static_cast<size_t>(region.size));
+                    staging->regions[kept++] = region;
+                }
+                staging->regions.resize(kept);
+            }
+        }
+
+        constexpr uint32_t INITIAL_VERTEX_CAPACITY = 256 * 1024;
+        constexpr uint32_t INITIAL_INDEX_CAPACITY = 1024 * 1024;
+
+        void destroyArena(Arena &arena)
+        {
+            if (g_Device == VK_NULL_HANDLE)
+                return;
+            if (arena.mapped)
+            {
+                vkUnmapMemory(g_Device, arena.memory);
+                arena.mapped = nullptr;
+            }
+            if (arena.buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(g_Device, arena.buffer, nullptr);
+                arena.buffer = VK_NULL_HANDLE;
+            }
+            if (arena.memory != VK_NULL_HANDLE)
+            {
+                MemoryBudget::untrack(arena.memory);
+                vkFreeMemory(g_Device, arena.memory, nullptr);
+                arena.memory = VK_NULL_HANDLE;
+            }
+        }
+
+        // Swaps in a new mapped buffer of newCapacity elements, the caller fills it from the old one
+        void *replaceArenaBuffer(Arena &arena, uint32_t newCapacity)
+        {
+            VkBuffer newBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory newMemory = VK_NULL_HANDLE;
+            VkDeviceSize newSize = arena.stride * newCapacity;
+            Kinesis::Window::createBuffer(newSize, arena.usage,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          newBuffer, newMemory, MemoryBudget::Category::Geometry);
+            void *newMapped = nullptr;
+            vkMapMemory(g_Device, newMemory, 0, newSize, 0, &newMapped);
+
+            void *oldMapped = arena.mapped;
+            if (arena.buffer != VK_NULL_HANDLE)
+            {
+                // The old buffer stays mapped and alive until the frames drawing from it retire
+                DeletionQueue::retireBuffer(arena.buffer, arena.memory);
+                generation++;
+            }
+
+            arena.buffer = newBuffer;
+            arena.memory = newMemory;
+            arena.mapped = newMapped;
+            arena.capacity = newCapacity;
+
+            // New buffer, new heap slot: the old slot may still be read by frames in flight
+            BindlessHeap::release(BindlessHeap::Type::StorageBuffer, arena.heapHandle);
+            arena.heapHandle = BindlessHeap::registerStorageBuffer(newBuffer);
+            return oldMapped;
+        }
+
+        // (Re)creates the arena's buffer with at least newCapacity elements, keeping its contents
+        void growArena(Arena &arena, uint32_t newCapacity)
+        {
+            uint32_t oldCapacity = arena.capacity;
+            void *oldMapped = replaceArenaBuffer(arena, newCapacity);
+            if (oldMapped)
+            {
+                memcpy(arena.mapped, oldMapped, static_cast<size_t>(arena.stride * oldCapacity));
+                if (&arena == &vertexArena)
+                    replayRecentWrites(nullptr);
+            }
+
+            // The new tail is free; merge it with a trailing free range if there is one
+            if (!arena.freeRanges.empty() && arena.freeRanges.back().offset + arena.freeRanges.back().count == oldCapacity)
+                arena.freeRanges.back().count += newCapacity - oldCapacity;
+            else
+                arena.freeRanges.push_back({oldCapacity, newCapacity - oldCapacity});
+        }
+
+        uint32_t allocateRange(Arena &arena, uint32_t count, uint32_t initialCapacity)
+        {
+            auto fit = std::find_if(arena.freeRanges.begin(), arena.freeRanges.end(),
+                                    [count](const Range &r)
+                                    { return r.count >= count; });
+            if (fit == arena.freeRanges.end())
+            {
+                uint32_t newCapacity = std::max(initialCapacity, arena.capacity * 2);
+                while (newCapacity - arena.capacity < count)
+                    newCapacity *= 2;
+                growArena(arena, newCapacity);
+                fit = std::find_if(arena.freeRanges.begin(), arena.freeRanges.end(),
+                                   [count](const Range &r)
+                                   { return r.count >= count; });
+            }
+
+            uint32_t offset = fit->offset;
+            fit->offset += count;
+            fit->count -= count;
+            if (fit->count == 0)
+                arena.freeRanges.erase(fit);
+            arena.used += count;
+            return offset;
+        }
+
+        void releaseRange(Arena &arena, uint32_t offset, uint32_t count)
+        {
+            if (count == 0)
+                return;
+            // Keep the list sorted by offset and coalesce with neighbours
+            auto it = std::lower_bound(arena.freeRanges.begin(), arena.freeRanges.end(), offset,
+                                       [](const Range &r, uint32_t value)
+                                       { return r.offset < value; });
+            it = arena.freeRanges.insert(it, {offset, count});
+            if (it + 1 != arena.freeRanges.end() && it->offset + it->count == (it + 1)->offset)
+            {
+                it->count += (it + 1)->count;
+                arena.freeRanges.erase(it + 1);
+            }
+            if (it != arena.freeRanges.begin() && (it - 1)->offset + (it - 1)->count == it->offset)
+            {
+                (it - 1)->count += it->count;
+                arena.freeRanges.erase(it);
+            }
+            arena.used -= count;
+        }
+
+        // Moves every live range to the front of a buffer sized for them, if that saves at least half
+        bool compactArena(Arena &arena, uint32_t initialCapacity)
+        {
+            const bool vertices = &arena == &vertexArena;
+            uint32_t live = 0;
+            for (const Allocation *owner : owners)
+                live += vertices ? owner->vertexCount : owner->indexCount;
+            // Headroom, so the next few allocations don't grow it straight back
+            uint32_t newCapacity = std::max(initialCapacity, live + live / 4);
+            if (arena.buffer == VK_NULL_HANDLE || newCapacity > arena.capacity / 2)
+                return false;
+
+            const char *oldMapped = static_cast<const char *>(replaceArenaBuffer(arena, newCapacity));
+            std::vector<RangeMove> moves;
+            moves.reserve(vertices ? owners.size() : 0);
+            uint32_t next = 0;
+            for (Allocation *owner : owners)
+            {
+                uint32_t &offset = vertices ? owner->vertexOffset : owner->firstIndex;
+                uint32_t count = vertices ? owner->vertexCount : owner->indexCount;
+                memcpy(static_cast<char *>(arena.mapped) + arena.stride * next, oldMapped + arena.stride * offset,
+                       static_cast<size_t>(arena.stride * count));
+                if (vertices)
+                    moves.push_back({offset, count, next});
+                offset = next;
+                next += count;
+            }
+            if (vertices)
+            {
+                std::sort(moves.begin(), moves.end(), [](const RangeMove &a, const RangeMove &b)
+                          { return a.oldOffset < b.oldOffset; });
+                replayRecentWrites(&moves);
+            }
+
+            // Ranges still waiting in the DeletionQueue were not copied, their release is now a no-op
+            arena.freeRanges.clear();
+            arena.freeRanges.push_back({next, newCapacity - next});
+            arena.used = next;
+            arena.layoutEpoch++;
+            return true;
+        }
+
+        void initArenas()
+        {
+            if (vertexArena.stride != 0)
+                return;
+            const VkBufferUsageFlags common = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            vertexArena.stride = sizeof(Mesh::Vertex);
+            vertexArena.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | common; // Dst of recordPendingWrites
+            indexArena.stride = sizeof(uint32_t);
+            indexArena.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | common;
+        }
+    }
+
+    void allocate(Allocation &allocation, const std::vector<Mesh::Vertex> &vertices, const std::vector<uint32_t> &indices)
+    {
+        allocation = {};
+        if (vertices.empty())
+            return;
+        if (g_Device == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("Logical device not created before GeometryPool::allocate!");
+        }
+        initArenas();
+
+        std::vector<uint32_t> generatedIndices;
+        const std::vector<uint32_t> *meshIndices = &indices;
+        if (indices.empty())
+        {
+            generatedIndices.resize(vertices.size());
+            for (uint32_t i = 0; i < generatedIndices.size(); ++i)
+                generatedIndices[i] = i;
+            meshIndices = &generatedIndices;
+        }
+
+        allocation.vertexCount = static_cast<uint32_t>(vertices.size());
+        allocation.indexCount = static_cast<uint32_t>(meshIndices->size());
+        allocation.vertexOffset = allocateRange(vertexArena, allocation.vertexCount, INITIAL_VERTEX_CAPACITY);
+        allocation.firstIndex = allocateRange(indexArena, allocation.indexCount, INITIAL_INDEX_CAPACITY);
+
+        rangeGeneration++;
+        memcpy(static_cast<char *>(vertexArena.mapped) + vertexArena.stride * allocation.vertexOffset,
+               vertices.data(), sizeof(Mesh::Vertex) * vertices.size());
+        memcpy(static_cast<char *>(indexArena.mapped) + indexArena.stride * allocation.firstIndex,
+               meshIndices->data(), sizeof(uint32_t) * meshIndices->size());
+        owners.push_back(&allocation);
+    }
+
+    void writeVertices(const Allocation &allocation, const std::vector<Mesh::Vertex> &vertices)
+    {
+        if (!allocation.valid())
+            return;
+        if (vertices.size() != allocation.vertexCount)
+        {
+            throw std::runtime_error("GeometryPool::writeVertices: vertex count does not match the allocated range!");
+        }
+        // Already queued this frame: overwrite that data, so every range is copied once
+        for (const PendingWrite &write : pendingWrites)
+        {
+            if (write.allocation == &allocation)
+            {
+                std::copy(vertices.begin(), vertices.end(), pendingVertices.begin() + write.dataOffset);
+                return;
+            }
+        }
+        pendingWrites.push_back({&allocation, pendingVertices.size()});
+        pendingVertices.insert(pendingVertices.end(), vertices.begin(), vertices.end());
+    }
+
+    void recordPendingWrites(VkCommandBuffer commandBuffer, int frameIndex)
+    {
+        if (pendingWrites.empty())
+            return;
+
+        StagingBuffer &staging = stagingBuffers[frameIndex];
+        const VkDeviceSize bytes = sizeof(Mesh::Vertex) * static_cast<VkDeviceSize>(pendingVertices.size());
+        if (staging.size < bytes)
+        {
+            // The slot's previous copies finished (its fence was waited on), nothing replays them
+            const VkDeviceSize newSize = std::max(bytes, staging.size * 2);
+            if (staging.buffer != VK_NULL_HANDLE)
+            {
+                vkUnmapMemory(g_Device, staging.memory);
+                DeletionQueue::retireBuffer(staging.buffer, staging.memory);
+            }
+            staging = {};
+            Kinesis::Window::createBuffer(newSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                          staging.buffer, staging.memory, MemoryBudget::Category::Staging);
+            staging.size = newSize;
+            vkMapMemory(g_Device, staging.memory, 0, staging.size, 0, &staging.mapped);
+        }
+        memcpy(staging.mapped, pendingVertices.data(), static_cast<size_t>(bytes));
+
+        staging.regions.clear();
+        staging.frameNumber = DeletionQueue::getFrameNumber();
+        for (const PendingWrite &write : pendingWrites)
+        {
+            staging.regions.push_back({sizeof(Mesh::Vertex) * static_cast<VkDeviceSize>(write.dataOffset),
+                                       vertexArena.stride * write.allocation->vertexOffset,
+                                       sizeof(Mesh::Vertex) * static_cast<VkDeviceSize>(write.allocation->vertexCount)});
+        }
+
+        // Everything that reads the pool: draws, AS builds/refits and the RT shaders (either backend)
+        VkPipelineStageFlags readers = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        if (GUI::raytracing_available)
+            readers |= VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR;
+
+        // WAR: earlier frames still in flight may read the ranges being overwritten (execution only)
+        vkCmdPipelineBarrier(commandBuffer, readers, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+        vkCmdCopyBuffer(commandBuffer, staging.buffer, vertexArena.buffer, static_cast<uint32_t>(staging.regions.size()), staging.regions.data());
+
+        VkMemoryBarrier copied{};
+        copied.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        copied.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        copied.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_SHADER_READ_BIT; // AS build inputs count as shader reads
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readers, 0, 1, &copied, 0, nullptr, 0, nullptr);
+
+        pendingWrites.clear();
+        pendingVertices.clear();
+    }
+
+    void release(Allocation &allocation)
+    {
+        if (!allocation.valid())
+            return;
+        owners.erase(std::remove(owners.begin(), owners.end(), &allocation), owners.end());
+        // A write still queued for the range must not land in whatever reuses it
+        for (size_t i = 0; i < pendingWrites.size(); ++i)
+        {
+            if (pendingWrites[i].allocation == &allocation)
+            {
+                pendingWrites.erase(pendingWrites.begin() + static_cast<std::ptrdiff_t>(i));
+                break;
+            }
+        }
+
+        // Frames in flight may still draw from (or build against) the range, so it only goes back
+        // to the free lists once they are done; otherwise a new mesh could overwrite it
+        const Allocation retired = allocation;
+        const uint32_t vertexEpoch = vertexArena.layoutEpoch;
+        const uint32_t indexEpoch = indexArena.layoutEpoch;
+        allocation = {};
+        rangeGeneration++;
+        DeletionQueue::retire([retired, vertexEpoch, indexEpoch]()
+                              {
+                                  // A compaction since then already left the range out
+                                  if (vertexArena.layoutEpoch == vertexEpoch)
+                                      releaseRange(vertexArena, retired.vertexOffset, retired.vertexCount);
+                                  if (indexArena.layoutEpoch == indexEpoch)
+                                      releaseRange(indexArena, retired.firstIndex, retired.indexCount); });
+    }
+
+    bool compact()
+    {
+        if (g_Device == VK_NULL_HANDLE)
+            return false;
+        bool vertexMoved = compactArena(vertexArena, INITIAL_VERTEX_CAPACITY);
+        bool indexMoved = compactArena(indexArena, INITIAL_INDEX_CAPACITY);
+        if (vertexMoved || indexMoved)
+        {
+            rangeGeneration++;
+            std::cout << "GeometryPool: compacted to " << vertexArena.capacity << " vertices / "
+                      << indexArena.capacity << " indices." << std::endl;
+        }
+        return vertexMoved || indexMoved;
+    }
+
+    void bind(VkCommandBuffer commandBuffer)
+    {
+        if (vertexArena.buffer == VK_NULL_HANDLE || indexArena.buffer == VK_NULL_HANDLE)
+            return;
+        VkBuffer buffers[] = {vertexArena.buffer};
+        VkDeviceSize offsets[] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indexArena.buffer, 0, VK_INDEX_TYPE_UINT32);
+    }
+
+    VkBuffer getVertexBuffer() { return vertexArena.buffer; }
+    VkBuffer getIndexBuffer() { return indexArena.buffer; }
+    uint32_t getVertexBufferHandle() { return vertexArena.heapHandle; }
+    uint32_t getIndexBufferHandle() { return indexArena.heapHandle; }
+    uint32_t getGeneration() { return generation; }
+    uint32_t getRangeGeneration() { return rangeGeneration; }
+    uint32_t getUsedVertices() { return vertexArena.used; }
+    uint32_t getUsedIndices() { return indexArena.used; }
+    uint32_t getVertexCapacity() { return vertexArena.capacity; }
+    uint32_t getIndexCapacity() { return indexArena.capacity; }
+
+    void cleanup()
+    {
+        if (vertexArena.used != 0 || indexArena.used != 0)
+        {
+            std::cerr << "Warning: GeometryPool cleaned up with " << vertexArena.used << " vertices / "
+                      << indexArena.used << " indices still allocated." << std::endl;
+        }
+        BindlessHeap::release(BindlessHeap::Type::StorageBuffer, vertexArena.heapHandle);
+        BindlessHeap::release(BindlessHeap::Type::StorageBuffer, indexArena.heapHandle);
+        destroyArena(vertexArena);
+        destroyArena(indexArena);
+        vertexArena = {};
+        indexArena = {};
+        owners.clear();
+        for (StagingBuffer &staging : stagingBuffers)
+        {
+            if (staging.buffer != VK_NULL_HANDLE)
+            {
+                vkUnmapMemory(g_Device, staging.memory);
+                vkDestroyBuffer(g_Device, staging.buffer, nullptr);
+                MemoryBudget::untrack(staging.memory);
+                vkFreeMemory(g_Device, staging.memory, nullptr);
+            }
+            staging = {};
+        }
+        pendingWrites.clear();
+        pendingVertices.clear();
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+#include "kinesis.h"
+#include "mesh/vertex.h"
+#include <vector>
+
+namespace Kinesis::GeometryPool
+{
+    /**
+     * @brief A mesh's range inside the shared vertex/index buffers.
+     * Indices are stored relative to vertexOffset, so draws pass vertexOffset as the
+     * vkCmdDrawIndexed vertex offset and shaders add it after fetching an index.
+     */
+    struct Allocation
+    {
+        uint32_t vertexOffset = 0; // In vertices
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0; // In indices
+        uint32_t indexCount = 0;
+
+        bool valid() const { return vertexCount > 0 && indexCount > 0; }
+    };
+
+    /**
+     * @brief Copies a mesh into the shared buffers, growing them if needed.
+     * Meshes without indices get a trivial 0..n-1 index list so every draw is indexed.
+     * The pool keeps a pointer to allocation and updates it when compact() moves the range,
+     * so it must stay at the same address until release().
+     * @param allocation Receives the range. Left invalid (all zero) if the mesh is empty.
+     * @param vertices Vertex data to upload.
+     * @param indices Index data (relative to the mesh's first vertex), may be empty.
+     */
+    void allocate(Allocation &allocation, const std::vector<Mesh::Vertex> &vertices, const std::vector<uint32_t> &indices);
+
+    /**
+     * @brief Queues new vertices for an existing range (same vertex count). Frames in flight may still
+     * draw from or refit with the range, so nothing is written right away: recordPendingWrites copies
+     * the data in the next frame's command buffer. A range written twice before that keeps the last data.
+     * @param allocation The Allocation passed to allocate(); the write follows it if compact() moves it.
+     */
+    void writeVertices(const Allocation &allocation, const std::vector<Mesh::Vertex> &vertices);
+
+    /**
+     * @brief Records the queued vertex writes into commandBuffer: the data goes through this frame
+     * slot's staging buffer and is copied after the earlier frames' reads of the pool, before this
+     * frame's draws, AS builds/refits and shaders. Call right after beginFrame (the slot's fence was
+     * waited on, so its staging buffer is free), before anything that reads the geometry.
+     */
+    void recordPendingWrites(VkCommandBuffer commandBuffer, int frameIndex);
+
+    /**
+     * @brief Gives a range back to the pool and drops a write still queued for it. allocation is reset
+     * right away, but the range only becomes reusable once the frames in flight that may still read it
+     * have retired (DeletionQueue).
+     */
+    void release(Allocation &allocation);
+
+    /**
+     * @brief Packs the live ranges to the front of new, smaller buffers when at most half of the
+     * capacity is in use, so released ranges give their memory back. The old buffers are retired
+     * through the DeletionQueue; frames in flight keep drawing from them with the old offsets.
+     * Ranges released but not yet reusable are dropped. Must be called outside of command buffer recording.
+     * @return true if the buffers were reallocated.
+     */
+    bool compact();
+
+    /**
+     * @brief Binds the shared vertex buffer (binding 0) and index buffer (uint32).
+     */
+    void bind(VkCommandBuffer commandBuffer);
+
+    VkBuffer getVertexBuffer();
+    VkBuffer getIndexBuffer();
+
+    /**
+     * @brief BindlessHeap storage buffer handles of the shared buffers (INVALID_HANDLE before the
+     * first allocation). They change whenever the buffers are reallocated, together with getGeneration().
+     */
+    uint32_t getVertexBufferHandle();
+    uint32_t getIndexBufferHandle();
+
+    /**
+     * @brief Incremented whenever the shared buffers are reallocated (growth or compaction). Anything
+     * that caches the buffer handles, device addresses or mesh offsets should refresh when this changes.
+     */
+    uint32_t getGeneration();
+
+    /**
+     * @brief Incremented on every allocate/release/compaction, i.e. whenever some mesh's range may have changed.
+     */
+    uint32_t getRangeGeneration();
+
+    /**
+     * @brief Number of vertices/indices currently handed out, and the buffer capacities.
+     */
+    uint32_t getUsedVertices();
+    uint32_t getUsedIndices();
+    uint32_t getVertexCapacity();
+    uint32_t getIndexCapacity();
+
+    /**
+     * @brief Destroys the shared buffers and releases their BindlessHeap slots. All Models must have
+     * released their ranges and the DeletionQueue must have been flushed. Flush it again before
+     * BindlessHeap::cleanup.
+     */
+    void cleanup();
+}
+
+#endif // GEOMETRYPOOL_H
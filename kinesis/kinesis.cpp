@@ -8,6 +8,9 @@
 #include "buffer.h"                     // Include the new Buffer helper
 #include "gbuffer.h"                    // Include for GBuffer access
 #include "raytracer/raytracermanager.h" // Include for RayTracerManager access
+#include "raytracer/asbuildscheduler.h"
+#include "raytracer/accumulation.h"
+#include "raytracer/denoiser.h"
 #include "mesh/material.h"              // Include for Kinesis::Mesh::Material
 
 struct CameraBufferObject
@@ -16,6 +19,8 @@ struct CameraBufferObject
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 inverseProjection; // Optional: For reconstructing world pos from depth
     alignas(16) glm::mat4 inverseView;       // Optional: For world space calculations
+    uint32_t frameNumber;                    // Frames submitted so far, seeds the RT sampling of each frame
+    float time;                              // Seconds since startup
     // Add other global uniforms like camera position if needed
 };
 
@@ -43,6 +48,12 @@ struct CompositePushConstant
 #include "rendersystem.h" // Include RenderSystem header
 #include "camera.h"
 #include "keyboard_controller.h"
+#include "residency.h"
+#include "geometrypool.h"
+#include "deletionqueue.h"
+#include "uniformring.h"
+#include "bindlessheap.h"
+#include "pipelinecache.h"
 
 #include <iostream>  // For std::cerr
 #include <stdexcept> // For std::exception
@@ -51,6 +62,7 @@ struct CompositePushConstant
 #include <cassert>   // For assert
 #include <chrono>
 #include <array> // For std::array
+#include <future> // Pipelines compile on worker threads at startup
 
 using namespace Kinesis;
 
@@ -76,13 +88,13 @@ namespace Kinesis
     std::vector<GameObject> gameObjects = std::vector<GameObject>();
 
     // --- Additions for Global Descriptor Set ---
-    std::vector<std::unique_ptr<Buffer>> uboBuffers;
     VkDescriptorSetLayout globalSetLayout = VK_NULL_HANDLE;
-    std::vector<VkDescriptorSet> globalDescriptorSets;
+    VkDescriptorSet globalDescriptorSet = VK_NULL_HANDLE; // Dynamic UBO into UniformRing
     // --- End Additions ---
 
     // --- Add Global Variable for Material Buffer ---
     std::unique_ptr<Buffer> materialBuffer = nullptr;
+    uint32_t materialBufferHandle = UINT32_MAX;  // Slot of materialBuffer in the BindlessHeap
     std::vector<MaterialData> sceneMaterialData; // Host-side copy
     // --- End Addition ---
 
@@ -92,12 +104,26 @@ namespace Kinesis
     VkPipeline compositePipeline = VK_NULL_HANDLE;
     VkDescriptorSetLayout compositeSetLayout = VK_NULL_HANDLE;
     std::vector<VkDescriptorSet> compositeDescriptorSets;
+    VkDescriptorUpdateTemplate compositeUpdateTemplate = VK_NULL_HANDLE; // Writes all 5 samplers from one array
+    // What each frame slot's composite set was last written with; rewritten only when this changes
+    struct CompositeDescriptorState
+    {
+        bool written = false;
+        uint32_t gbufferGeneration = 0;
+        uint32_t rtOutputGeneration = 0;
+        bool sampleRtOutput = false; // Binding 4 is the RT output rather than the albedo fallback
+    };
+    std::vector<CompositeDescriptorState> compositeDescriptorStates;
     // --- End Additions ---
 
     auto currentTime = std::chrono::high_resolution_clock::now();
+    const auto startTime = currentTime;
 
     void initialize(int width, int height)
     {
+        // The G-Buffer pipeline (inside RenderSystem) compiles on a worker thread; declared outside
+        // the try so the failure path can still join it and free what it created.
+        std::future<RenderSystem *> renderSystemTask;
         try
         {
             Kinesis::Window::initialize(width, height); // Initializes Vulkan core, window, ImGui
@@ -108,30 +134,22 @@ namespace Kinesis
             assert(Kinesis::Renderer::SwapChain != nullptr && "Swapchain must be initialized before GBuffer setup!");
             VkFormat depthFormat = Kinesis::Renderer::SwapChain->findDepthFormat();
             Kinesis::GBuffer::setup(width, height, depthFormat); // Initialize GBuffer
+            Kinesis::BindlessHeap::initialize();                 // Before any model registers its geometry
             loadGameObjects();                                   // Loads models into gameObjects vector
 
-            // --- Create Global UBO Buffers & Descriptor Set Layout/Sets ---
-            // One UBO buffer per frame in flight
-            uboBuffers.resize(Kinesis::SwapChain::MAX_FRAMES_IN_FLIGHT);
-            for (int i = 0; i < uboBuffers.size(); ++i)
-            {
-                uboBuffers[i] = std::make_unique<Buffer>(
-                    sizeof(CameraBufferObject),                                                // Use the defined struct size
-                    1,                                                                         // Only one instance of the global UBO
-                    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,                                        // Usage is UBO
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT // Host visible/coherent for easy CPU updates
-                );
-                uboBuffers[i]->map(); // Map the buffer persistently
-            }
+            // --- Create Global Transient UBO Ring & Descriptor Set Layout/Set ---
+            // The camera UBO is pushed into the per-frame uniform ring every frame, the global set
+            // points at the ring as a dynamic UBO and each bind passes this frame's offset.
+            Kinesis::UniformRing::initialize();
 
             // Create Descriptor Set Layout (defines the structure of the set)
             VkDescriptorSetLayoutBinding uboLayoutBinding{};
             uboLayoutBinding.binding = 0;         // Corresponds to layout(set=0, binding=0) in shaders
             uboLayoutBinding.descriptorCount = 1; // One UBO
-            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             uboLayoutBinding.pImmutableSamplers = nullptr;
             // Make the UBO accessible to relevant shader stages
-            uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
+            uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT; // Compute: ray query backend
 
             VkDescriptorSetLayoutCreateInfo layoutInfo{};
             layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -143,35 +161,28 @@ namespace Kinesis
                 throw std::runtime_error("Failed to create global descriptor set layout!");
             }
 
-            // Allocate Descriptor Sets (one per frame in flight) from the global pool
-            globalDescriptorSets.resize(Kinesis::SwapChain::MAX_FRAMES_IN_FLIGHT);
-            std::vector<VkDescriptorSetLayout> layouts(Kinesis::SwapChain::MAX_FRAMES_IN_FLIGHT, globalSetLayout); // Need layout array for allocation
-            VkDescriptorSetAllocateInfo allocInfoSet{};                                                            // Renamed variable
+            // A single set is enough: the per-frame part is the dynamic offset, not the descriptor
+            VkDescriptorSetAllocateInfo allocInfoSet{};
             allocInfoSet.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
             allocInfoSet.descriptorPool = g_DescriptorPool; // Use the global pool created in window.cpp
-            allocInfoSet.descriptorSetCount = static_cast<uint32_t>(Kinesis::SwapChain::MAX_FRAMES_IN_FLIGHT);
-            allocInfoSet.pSetLayouts = layouts.data();
+            allocInfoSet.descriptorSetCount = 1;
+            allocInfoSet.pSetLayouts = &globalSetLayout;
 
-            if (vkAllocateDescriptorSets(g_Device, &allocInfoSet, globalDescriptorSets.data()) != VK_SUCCESS)
+            if (vkAllocateDescriptorSets(g_Device, &allocInfoSet, &globalDescriptorSet) != VK_SUCCESS)
             {
-                throw std::runtime_error("failed to allocate global descriptor sets!");
+                throw std::runtime_error("failed to allocate global descriptor set!");
             }
 
-            // Update Descriptor Sets to point them to the corresponding UBO buffers
-            for (int i = 0; i < globalDescriptorSets.size(); i++)
-            {
-                auto bufferInfo = uboBuffers[i]->descriptorInfo(); // Get VkDescriptorBufferInfo for the buffer
-                VkWriteDescriptorSet descriptorWrite{};
-                descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-                descriptorWrite.dstSet = globalDescriptorSets[i]; // Target the specific set for this frame index
-                descriptorWrite.dstBinding = 0;                   // Matches the layout binding
-                descriptorWrite.dstArrayElement = 0;
-                descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                descriptorWrite.descriptorCount = 1;
-                descriptorWrite.pBufferInfo = &bufferInfo; // Point to the buffer info
-
-                vkUpdateDescriptorSets(g_Device, 1, &descriptorWrite, 0, nullptr); // Update the set
-            }
+            VkDescriptorBufferInfo bufferInfo = Kinesis::UniformRing::descriptorInfo(sizeof(CameraBufferObject));
+            VkWriteDescriptorSet descriptorWrite{};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = globalDescriptorSet;
+            descriptorWrite.dstBinding = 0; // Matches the layout binding
+            descriptorWrite.dstArrayElement = 0;
+            descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            descriptorWrite.descriptorCount = 1;
+            descriptorWrite.pBufferInfo = &bufferInfo;
+            vkUpdateDescriptorSets(g_Device, 1, &descriptorWrite, 0, nullptr);
             // --- End Descriptor Set Setup ---
 
             // --- Create Material Buffer ---
@@ -248,6 +259,9 @@ namespace Kinesis
                 );
                 materialBuffer->map();
                 materialBuffer->writeToBuffer(sceneMaterialData.data());
+                Kinesis::Accumulation::reset(); // Any rewrite of the materials invalidates the accumulated RT image
+                // Raster and RT shaders both read materials through the bindless heap
+                materialBufferHandle = Kinesis::BindlessHeap::registerStorageBuffer(materialBuffer->getBuffer());
                 // materialBuffer->unmap(); // Not needed if coherent
                 // materialBuffer->flush(); // Needed if not coherent
 
@@ -267,16 +281,21 @@ namespace Kinesis
             }
             // --- End Material Buffer Creation ---
 
+            // --- Startup pipeline compiles run concurrently (all go through g_PipelineCache) ---
+            // G-Buffer pipeline on a worker, RT pipeline on a worker started by RayTracerManager::initialize,
+            // compositing pipeline on this thread. All layouts they depend on exist at this point.
+
+            // --- Create RenderSystem (for G-Buffer Pass) ---
+            renderSystemTask = std::async(std::launch::async, []()
+                                          { return new RenderSystem(); }); // Uses globalSetLayout
+
             // --- Initialize Ray Tracing (if available) ---
             if (Kinesis::GUI::raytracing_available)
             {
-                // Pass material buffer info to RT manager if needed for descriptors immediately
+                // Builds the acceleration structures here while its pipeline compiles in the background
                 Kinesis::RayTracerManager::initialize({static_cast<uint32_t>(width), static_cast<uint32_t>(height)});
             }
 
-            // --- Create RenderSystem (for G-Buffer Pass) ---
-            mainRenderSystem = new RenderSystem(); // Uses globalSetLayout
-
             // ===================================
             // --- Create Compositing Pipeline ---
             // ===================================
@@ -304,6 +323,24 @@ namespace Kinesis
                     throw std::runtime_error("Failed to create compositing descriptor set layout!");
                 }
 
+                // The composite set is always rewritten as a whole, so use an update template over a
+                // plain array of the 5 image infos (bindings 0-4, in order)
+                std::array<VkDescriptorUpdateTemplateEntry, 5> compositeTemplateEntries{};
+                for (uint32_t i = 0; i < compositeTemplateEntries.size(); ++i)
+                {
+                    compositeTemplateEntries[i] = {i, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, i * sizeof(VkDescriptorImageInfo), 0};
+                }
+                VkDescriptorUpdateTemplateCreateInfo compositeTemplateInfo{};
+                compositeTemplateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+                compositeTemplateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(compositeTemplateEntries.size());
+                compositeTemplateInfo.pDescriptorUpdateEntries = compositeTemplateEntries.data();
+                compositeTemplateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+                compositeTemplateInfo.descriptorSetLayout = compositeSetLayout;
+                if (vkCreateDescriptorUpdateTemplate(g_Device, &compositeTemplateInfo, nullptr, &compositeUpdateTemplate) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to create compositing descriptor update template!");
+                }
+
                 // --- 2. Create Compositing Pipeline Layout ---
                 // <<< MODIFIED: Add Push Constant Range >>>
                 VkPushConstantRange compositePushConstantRange{};
@@ -394,7 +431,7 @@ namespace Kinesis
                 compositePipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
                 compositePipelineInfo.basePipelineIndex = -1;
 
-                if (vkCreateGraphicsPipelines(g_Device, VK_NULL_HANDLE, 1, &compositePipelineInfo, nullptr, &compositePipeline) != VK_SUCCESS)
+                if (vkCreateGraphicsPipelines(g_Device, g_PipelineCache, 1, &compositePipelineInfo, nullptr, &compositePipeline) != VK_SUCCESS)
                 {
                     vkDestroyShaderModule(g_Device, compositeVertModule, nullptr);
                     vkDestroyShaderModule(g_Device, compositeFragModule, nullptr);
@@ -409,6 +446,7 @@ namespace Kinesis
 
                 // --- 4. Allocate Compositing Descriptor Sets ---
                 compositeDescriptorSets.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+                compositeDescriptorStates.assign(SwapChain::MAX_FRAMES_IN_FLIGHT, CompositeDescriptorState{});
                 std::vector<VkDescriptorSetLayout> compositeLayouts(SwapChain::MAX_FRAMES_IN_FLIGHT, compositeSetLayout); // Renamed var
                 VkDescriptorSetAllocateInfo compositeAllocInfo{};                                                         // Renamed var
                 compositeAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -426,15 +464,37 @@ namespace Kinesis
                 }
                 std::cout << "Compositing Pipeline Initialized." << std::endl;
             } // End Compositing Pipeline Scope
+
+            // --- Join the worker-thread pipeline compiles ---
+            mainRenderSystem = renderSystemTask.get(); // Rethrows if the G-Buffer pipeline failed
+            if (Kinesis::GUI::raytracing_available)
+                Kinesis::RayTracerManager::waitForPipeline(); // Also creates the SBT
+
+            // Persist the cache now as well, so a crash later in the session still keeps a warm start
+            Kinesis::PipelineCache::save();
         }
         catch (const std::exception &e)
         {
             std::cerr << "Kinesis Initialization Failed: " << e.what() << std::endl;
+            // --- Join the G-Buffer pipeline worker so its resources can be released below ---
+            if (renderSystemTask.valid())
+            {
+                try
+                {
+                    mainRenderSystem = renderSystemTask.get();
+                }
+                catch (const std::exception &)
+                {
+                    // Already reported by the RenderSystem constructor
+                }
+            }
             // --- Perform partial cleanup for compositing resources if they were created ---
             if (compositePipeline != VK_NULL_HANDLE)
                 vkDestroyPipeline(g_Device, compositePipeline, nullptr);
             if (compositePipelineLayout != VK_NULL_HANDLE)
                 vkDestroyPipelineLayout(g_Device, compositePipelineLayout, nullptr);
+            if (compositeUpdateTemplate != VK_NULL_HANDLE)
+                vkDestroyDescriptorUpdateTemplate(g_Device, compositeUpdateTemplate, nullptr);
             if (compositeSetLayout != VK_NULL_HANDLE)
                 vkDestroyDescriptorSetLayout(g_Device, compositeSetLayout, nullptr);
             // --- Add Material Buffer Cleanup ---
@@ -450,9 +510,16 @@ namespace Kinesis
                 vkDestroyDescriptorSetLayout(g_Device, globalSetLayout, nullptr);
                 globalSetLayout = VK_NULL_HANDLE;
             }
-            uboBuffers.clear();
+            Kinesis::UniformRing::cleanup();
             materialBuffer.reset();
             gameObjects.clear();
+            if (g_Device != VK_NULL_HANDLE)
+                vkDeviceWaitIdle(g_Device);
+            Kinesis::DeletionQueue::flush(); // Hands the models' retired ranges back to the pool
+            Kinesis::GeometryPool::cleanup(); // Models have released their ranges
+            Kinesis::DeletionQueue::flush(); // Returns the pool's heap slots
+            Kinesis::BindlessHeap::cleanup();
+            materialBufferHandle = UINT32_MAX;
             Kinesis::GBuffer::cleanup(); // Cleanup GBuffer
             if (Kinesis::GUI::raytracing_available)
                 Kinesis::RayTracerManager::cleanup(); // Cleanup RT
@@ -474,10 +541,14 @@ namespace Kinesis
                 vkDestroyPipeline(g_Device, compositePipeline, nullptr);
             if (compositePipelineLayout != VK_NULL_HANDLE)
                 vkDestroyPipelineLayout(g_Device, compositePipelineLayout, nullptr);
+            if (compositeUpdateTemplate != VK_NULL_HANDLE)
+                vkDestroyDescriptorUpdateTemplate(g_Device, compositeUpdateTemplate, nullptr);
+            compositeUpdateTemplate = VK_NULL_HANDLE;
             if (compositeSetLayout != VK_NULL_HANDLE)
                 vkDestroyDescriptorSetLayout(g_Device, compositeSetLayout, nullptr);
             // Descriptor sets freed with pool
             compositeDescriptorSets.clear();
+            compositeDescriptorStates.clear();
             // --- End Compositing Cleanup ---
             if (Kinesis::GUI::raytracing_available)
                 Kinesis::RayTracerManager::cleanup();
@@ -488,8 +559,14 @@ namespace Kinesis
                 vkDestroyDescriptorSetLayout(g_Device, globalSetLayout, nullptr);
             // Cleanup Material Buffer
             materialBuffer.reset();
-            uboBuffers.clear();
+            Kinesis::UniformRing::cleanup();
+            Kinesis::Residency::cleanup();
             gameObjects.clear();
+            Kinesis::DeletionQueue::flush(); // Device is idle; hands the models' retired ranges back to the pool
+            Kinesis::GeometryPool::cleanup(); // Models have released their ranges
+            Kinesis::DeletionQueue::flush(); // Returns the pool's heap slots
+            Kinesis::BindlessHeap::cleanup();
+            materialBufferHandle = UINT32_MAX;
             Kinesis::Window::cleanup();
             return false;
         }
@@ -506,19 +583,37 @@ namespace Kinesis
             float aspect = Kinesis::Renderer::getAspectRatio();
             mainCamera.setPerspectiveProjection(glm::radians(50.f), aspect, 0.1f, 1000.f); // Increased far plane
 
+            // Refresh memory budget, restore newly visible models / evict stale ones if over budget.
+            // Restored models only queue their BLAS builds, ASBuildScheduler records them within the frame.
+            Kinesis::Residency::update(mainCamera);
+
             try
             {
                 if (auto commandBuffer = Kinesis::Renderer::beginFrame())
                 {
                     int frameIndex = Kinesis::Renderer::currentFrameIndex;
 
-                    // --- Update Camera UBO ---
+                    // --- Update Camera UBO (transient, lives in this frame's ring region) ---
                     CameraBufferObject ubo{};
                     ubo.projection = mainCamera.getProjection();
                     ubo.view = mainCamera.getView();
                     ubo.inverseProjection = glm::inverse(ubo.projection);
                     ubo.inverseView = glm::inverse(ubo.view);
-                    uboBuffers[frameIndex]->writeToBuffer(&ubo, sizeof(ubo));
+                    ubo.frameNumber = static_cast<uint32_t>(Kinesis::DeletionQueue::getFrameNumber());
+                    ubo.time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+                    uint32_t cameraUboOffset = Kinesis::UniformRing::push(ubo).offset;
+
+                    // Deformed meshes' new vertices, before anything in this frame reads the geometry
+                    Kinesis::GeometryPool::recordPendingWrites(commandBuffer, frameIndex);
+
+                    // Queued BLAS builds (within the AS build budget), deformed meshes and moved objects:
+                    // build/refit their BLAS, patch their TLAS instances, then refit the TLAS, all in this frame's command buffer
+                    if (Kinesis::GUI::raytracing_available && Kinesis::GUI::enable_raytracing_pass)
+                    {
+                        Kinesis::ASBuildScheduler::update(commandBuffer, frameIndex, mainCamera);
+                        Kinesis::RayTracerManager::refitDynamicBlas(commandBuffer);
+                        Kinesis::RayTracerManager::updateTlas(commandBuffer, frameIndex);
+                    }
 
                     // =========================
                     // Pass 1: G-Buffer Pass
@@ -554,7 +649,7 @@ namespace Kinesis
 
                         if (mainRenderSystem)
                         {
-                            mainRenderSystem->renderGameObjects(commandBuffer, mainCamera, globalDescriptorSets[frameIndex]);
+                            mainRenderSystem->renderGameObjects(commandBuffer, mainCamera, globalDescriptorSet, cameraUboOffset);
                         }
                         vkCmdEndRenderPass(commandBuffer);
                     }
@@ -563,8 +658,12 @@ namespace Kinesis
                     // Pass 2: Ray Tracing Pass (Conditional)
                     // =========================
                     bool raytracing_active = Kinesis::GUI::raytracing_available && Kinesis::GUI::enable_raytracing_pass; // Check both flags
+                    // Once the accumulated image has converged the pass is skipped, rtOutput keeps the result
+                    bool tracing = raytracing_active &&
+                                   Kinesis::Accumulation::begin(Kinesis::DeletionQueue::getFrameNumber(), ubo.view, ubo.projection, Kinesis::GBuffer::extent,
+                                                                Kinesis::GUI::samples_per_pixel, Kinesis::GUI::max_ray_depth);
 
-                    if (raytracing_active)
+                    if (tracing)
                     {
                         // Barrier to transition RT output image layout before tracing
                         VkImageMemoryBarrier rtOutputBarrier{};
@@ -578,15 +677,32 @@ namespace Kinesis
                         rtOutputBarrier.image = Kinesis::RayTracerManager::rtOutput.image;
                         rtOutputBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
 
+                        // The accumulation image stays in General: the last frame's trace must finish writing it first
+                        VkImageMemoryBarrier accumulationBarrier{};
+                        accumulationBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                        accumulationBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                        accumulationBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+                        accumulationBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+                        accumulationBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+                        accumulationBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        accumulationBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                        accumulationBarrier.image = Kinesis::RayTracerManager::rtAccumulation.image;
+                        accumulationBarrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+                        std::array<VkImageMemoryBarrier, 2> traceBarriers = {rtOutputBarrier, accumulationBarrier};
                         vkCmdPipelineBarrier(commandBuffer,
-                                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // Src Stage
-                                             VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR,                                 // Dst Stage
-                                             0, 0, nullptr, 0, nullptr, 1, &rtOutputBarrier);
-
-                        Kinesis::RayTracerManager::allocateAndUpdateRtDescriptorSet(Kinesis::RayTracerManager::tlas.structure, VK_NULL_HANDLE, 0);
-                        Kinesis::RayTracerManager::bind(commandBuffer, globalDescriptorSets[frameIndex]);
-                        Kinesis::RayTracerManager::traceRays(commandBuffer, Kinesis::GBuffer::extent.width, Kinesis::GBuffer::extent.height, 
-                                                                     Kinesis::GUI::samples_per_pixel, Kinesis::GUI::max_ray_depth);
+                                             VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, // Src Stage
+                                             VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, // Dst Stage (either trace backend)
+                                             0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(traceBarriers.size()), traceBarriers.data());
+
+                        Kinesis::RayTracerManager::allocateAndUpdateRtDescriptorSet(Kinesis::RayTracerManager::tlas.structure, frameIndex);
+                        Kinesis::RayTracerManager::bind(commandBuffer, globalDescriptorSet, cameraUboOffset);
+                        Kinesis::RayTracerManager::traceRays(commandBuffer, frameIndex, Kinesis::GBuffer::extent.width, Kinesis::GBuffer::extent.height,
+                                                                     Kinesis::GUI::samples_per_pixel, Kinesis::GUI::max_ray_depth, Kinesis::GUI::hybrid_primary_rays,
+                                                                     ubo.projection * ubo.view);
+
+                        // Denoise rtOutput in place (it stays in General until the compositing barrier below)
+                        Kinesis::Denoiser::record(commandBuffer, frameIndex, ubo.projection * ubo.view, glm::vec3(ubo.inverseView[3]));
                     }
 
                     // =========================
@@ -594,8 +710,9 @@ namespace Kinesis
                     // =========================
                     {
                         // --- Barrier: Wait for RT Writes (if active) or GBuffer writes, before Compositing Shader Reads ---
+                        // Skipped (converged) frames left rtOutput in Shader Read Only last time it was traced
                         VkImageMemoryBarrier rtOutputToSampleBarrier{};
-                        if (raytracing_active)
+                        if (tracing)
                         {
                             rtOutputToSampleBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
                             rtOutputToSampleBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
@@ -609,47 +726,42 @@ namespace Kinesis
                         }
 
                         vkCmdPipelineBarrier(commandBuffer,
-                                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | (raytracing_active ? VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR : 0),
+                                             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | (tracing ? VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0),
                                              VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
                                              0, 0, nullptr, 0, nullptr,
-                                             raytracing_active ? 1 : 0,
-                                             raytracing_active ? &rtOutputToSampleBarrier : nullptr);
-
-                        // --- Update Compositing Descriptor Set ---
-                        VkDescriptorImageInfo posInfo{GBuffer::sampler, GBuffer::positionAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                        VkDescriptorImageInfo normInfo{GBuffer::sampler, GBuffer::normalAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                        VkDescriptorImageInfo albInfo{GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                        VkDescriptorImageInfo propInfo{GBuffer::sampler, GBuffer::propertiesAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                        VkDescriptorImageInfo rtInfo{};
-
-                        if (raytracing_active)
-                        {
-                            if (RayTracerManager::rtOutput.view == VK_NULL_HANDLE)
-                            {
-                                std::cerr << "Warning: Raytracing active but rtOutput.view is null. Using fallback." << std::endl;
-                                if (GBuffer::albedoAttachment.view == VK_NULL_HANDLE)
-                                    throw std::runtime_error("Fallback G-Buffer view (albedo) is also null!");
-                                rtInfo = {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                            }
-                            else
-                            {
-                                rtInfo = {GBuffer::sampler, RayTracerManager::rtOutput.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                            }
-                        }
-                        else
+                                             tracing ? 1 : 0,
+                                             tracing ? &rtOutputToSampleBarrier : nullptr);
+
+                        // --- Update Compositing Descriptor Set (only when its inputs changed) ---
+                        bool sampleRtOutput = raytracing_active && RayTracerManager::rtOutput.view != VK_NULL_HANDLE;
+                        if (raytracing_active && !sampleRtOutput)
+                            std::cerr << "Warning: Raytracing active but rtOutput.view is null. Using fallback." << std::endl;
+
+                        CompositeDescriptorState &compositeState = compositeDescriptorStates[frameIndex];
+                        if (!compositeState.written ||
+                            compositeState.gbufferGeneration != GBuffer::generation ||
+                            compositeState.sampleRtOutput != sampleRtOutput ||
+                            (sampleRtOutput && compositeState.rtOutputGeneration != RayTracerManager::rtOutput.generation))
                         {
                             if (GBuffer::albedoAttachment.view == VK_NULL_HANDLE)
                                 throw std::runtime_error("Fallback G-Buffer view (albedo) is null!");
-                            rtInfo = {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-                        }
 
-                        std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
-                        descriptorWrites[0] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, compositeDescriptorSets[frameIndex], 0, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &posInfo, nullptr, nullptr};
-                        descriptorWrites[1] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, compositeDescriptorSets[frameIndex], 1, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &normInfo, nullptr, nullptr};
-                        descriptorWrites[2] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, compositeDescriptorSets[frameIndex], 2, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &albInfo, nullptr, nullptr};
-                        descriptorWrites[3] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, compositeDescriptorSets[frameIndex], 3, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &propInfo, nullptr, nullptr};
-                        descriptorWrites[4] = {VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr, compositeDescriptorSets[frameIndex], 4, 0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &rtInfo, nullptr, nullptr};
-                        vkUpdateDescriptorSets(g_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+                            // Bindings 0-4: position, normal, albedo, properties, RT output (or albedo fallback)
+                            std::array<VkDescriptorImageInfo, 5> compositeInfos{{
+                                {GBuffer::sampler, GBuffer::positionAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                                {GBuffer::sampler, GBuffer::normalAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                                {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                                {GBuffer::sampler, GBuffer::propertiesAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                                {GBuffer::sampler, sampleRtOutput ? RayTracerManager::rtOutput.view : GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
+                            }};
+                            // Safe: this slot's fence was waited on in beginFrame, so the GPU no longer reads the set
+                            vkUpdateDescriptorSetWithTemplate(g_Device, compositeDescriptorSets[frameIndex], compositeUpdateTemplate, compositeInfos.data());
+
+                            compositeState.written = true;
+                            compositeState.gbufferGeneration = GBuffer::generation;
+                            compositeState.rtOutputGeneration = RayTracerManager::rtOutput.generation;
+                            compositeState.sampleRtOutput = sampleRtOutput;
+                        }
 
                         // --- Begin Swapchain Render Pass ---
                         Renderer::beginSwapChainRenderPass(commandBuffer);
@@ -48,6 +48,7 @@ namespace Kinesis
     extern std::vector<GameObject> gameObjects;
     class Buffer;
     extern std::unique_ptr<Buffer> materialBuffer;
+    extern uint32_t materialBufferHandle; // BindlessHeap storage buffer handle of materialBuffer
 
     extern VkDescriptorSetLayout globalSetLayout;
 
@@ -0,0 +1,184 @@
+// kinesis/memorybudget.cpp
+#include "memorybudget.h"
+
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace Kinesis::MemoryBudget
+{
+    bool budgetExtensionEnabled = false;
+    float budgetThreshold = 0.9f;
+    int budgetOverrideMB = 0;
+
+    namespace
+    {
+        struct Allocation
+        {
+            VkDeviceSize size;
+            uint32_t heapIndex;
+            Category category;
+        };
+
+        constexpr size_t CATEGORY_COUNT = static_cast<size_t>(Category::Count);
+
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        std::unordered_map<VkDeviceMemory, Allocation> allocations;
+        std::array<VkDeviceSize, CATEGORY_COUNT> categoryUsage{};
+        std::array<uint32_t, CATEGORY_COUNT> categoryCounts{};
+        std::vector<VkDeviceSize> trackedPerHeap;
+        std::vector<HeapInfo> heaps;
+
+        // Without VK_EXT_memory_budget we have no idea what else lives on the heap,
+        // so only plan on using part of it.
+        constexpr float FALLBACK_HEAP_FRACTION = 0.8f;
+        constexpr VkDeviceSize MB = 1024ull * 1024ull;
+    }
+
+    void initialize()
+    {
+        if (g_PhysicalDevice == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("Physical device not selected before MemoryBudget::initialize!");
+        }
+        vkGetPhysicalDeviceMemoryProperties(g_PhysicalDevice, &memoryProperties);
+        trackedPerHeap.assign(memoryProperties.memoryHeapCount, 0);
+        heaps.assign(memoryProperties.memoryHeapCount, HeapInfo{});
+        update();
+
+        std::cout << "Memory budget tracking initialized ("
+                  << (budgetExtensionEnabled ? "VK_EXT_memory_budget" : "heap size estimate")
+                  << ", " << memoryProperties.memoryHeapCount << " heaps)." << std::endl;
+    }
+
+    void update()
+    {
+        if (g_PhysicalDevice == VK_NULL_HANDLE || heaps.empty())
+            return;
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        if (budgetExtensionEnabled)
+        {
+            VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+            memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            memoryProperties2.pNext = &budgetProperties;
+            vkGetPhysicalDeviceMemoryProperties2(g_PhysicalDevice, &memoryProperties2);
+        }
+
+        for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+        {
+            HeapInfo &heap = heaps[i];
+            heap.size = memoryProperties.memoryHeaps[i].size;
+            heap.deviceLocal = (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+            heap.tracked = trackedPerHeap[i];
+            if (budgetExtensionEnabled)
+            {
+                heap.budget = budgetProperties.heapBudget[i];
+                heap.usage = budgetProperties.heapUsage[i];
+            }
+            else
+            {
+                heap.budget = static_cast<VkDeviceSize>(heap.size * FALLBACK_HEAP_FRACTION);
+                heap.usage = heap.tracked;
+            }
+        }
+    }
+
+    void track(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, Category category)
+    {
+        if (memory == VK_NULL_HANDLE)
+            return;
+        uint32_t heapIndex = memoryTypeIndex < memoryProperties.memoryTypeCount
+                                 ? memoryProperties.memoryTypes[memoryTypeIndex].heapIndex
+                                 : 0;
+        allocations[memory] = {size, heapIndex, category};
+        categoryUsage[static_cast<size_t>(category)] += size;
+        categoryCounts[static_cast<size_t>(category)]++;
+        if (heapIndex < trackedPerHeap.size())
+            trackedPerHeap[heapIndex] += size;
+    }
+
+    void untrack(VkDeviceMemory memory)
+    {
+        auto it = allocations.find(memory);
+        if (it == allocations.end())
+            return;
+        const Allocation &alloc = it->second;
+        categoryUsage[static_cast<size_t>(alloc.category)] -= alloc.size;
+        categoryCounts[static_cast<size_t>(alloc.category)]--;
+        if (alloc.heapIndex < trackedPerHeap.size())
+            trackedPerHeap[alloc.heapIndex] -= alloc.size;
+        allocations.erase(it);
+    }
+
+    VkDeviceSize getUsage(Category category)
+    {
+        return categoryUsage[static_cast<size_t>(category)];
+    }
+
+    uint32_t getAllocationCount(Category category)
+    {
+        return categoryCounts[static_cast<size_t>(category)];
+    }
+
+    VkDeviceSize getTotalTracked()
+    {
+        VkDeviceSize total = 0;
+        for (VkDeviceSize usage : categoryUsage)
+            total += usage;
+        return total;
+    }
+
+    const std::vector<HeapInfo> &getHeaps()
+    {
+        return heaps;
+    }
+
+    VkDeviceSize getOverBudgetBytes()
+    {
+        // A manual override compares everything we allocated against a single fake budget
+        if (budgetOverrideMB > 0)
+        {
+            VkDeviceSize limit = static_cast<VkDeviceSize>(budgetOverrideMB * MB * budgetThreshold);
+            VkDeviceSize total = getTotalTracked();
+            return total > limit ? total - limit : 0;
+        }
+
+        VkDeviceSize worst = 0;
+        for (const HeapInfo &heap : heaps)
+        {
+            VkDeviceSize limit = static_cast<VkDeviceSize>(heap.budget * budgetThreshold);
+            if (heap.usage > limit && heap.usage - limit > worst)
+                worst = heap.usage - limit;
+        }
+        return worst;
+    }
+
+    bool isOverBudget()
+    {
+        return getOverBudgetBytes() > 0;
+    }
+
+    const char *categoryName(Category category)
+    {
+        switch (category)
+        {
+        case Category::Geometry:
+            return "Geometry";
+        case Category::AccelerationStructure:
+            return "Acceleration Structures";
+        case Category::GBuffer:
+            return "G-Buffer";
+        case Category::RTOutput:
+            return "RT Output";
+        case Category::Staging:
+            return "Staging / Scratch";
+        case Category::Other:
+            return "Other";
+        default:
+            return "Unknown";
+        }
+    }
+}
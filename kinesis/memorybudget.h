@@ -0,0 +1,101 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include "kinesis.h" // For Vulkan types
+#include <vector>
+
+namespace Kinesis::MemoryBudget
+{
+    /**
+     * @brief Buckets used to attribute device memory allocations to engine subsystems.
+     */
+    enum class Category
+    {
+        Geometry = 0,          // Vertex/index buffers owned by Models
+        AccelerationStructure, // BLAS/TLAS storage and TLAS instance buffers
+        GBuffer,               // G-Buffer attachments
+        RTOutput,              // Ray tracing output image(s)
+        Staging,               // Transient upload buffers and AS build scratch
+        Other,                 // UBOs, SBT, material SSBO, ...
+        Count
+    };
+
+    /**
+     * @brief Per-heap snapshot. budget/usage come from VK_EXT_memory_budget when it is enabled,
+     * otherwise budget is a fraction of the heap size and usage is what we tracked ourselves.
+     */
+    struct HeapInfo
+    {
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;   // Process-wide usage reported by the driver (or tracked fallback)
+        VkDeviceSize tracked = 0; // Bytes allocated through MemoryBudget::track on this heap
+        bool deviceLocal = false;
+    };
+
+    extern bool budgetExtensionEnabled; // Set by Window::SetupVulkan when VK_EXT_memory_budget is enabled
+    extern float budgetThreshold;       // Fraction of a heap's budget we allow before reporting over-budget
+    extern int budgetOverrideMB;        // >0 replaces every heap budget (handy for testing eviction on large GPUs)
+
+    /**
+     * @brief Caches the physical device memory layout. Call once after the logical device is created.
+     */
+    void initialize();
+
+    /**
+     * @brief Refreshes the per-heap budget/usage numbers. Cheap enough to call once per frame.
+     */
+    void update();
+
+    /**
+     * @brief Records a device memory allocation under the given category.
+     * @param memory The allocation handle (used as key by untrack).
+     * @param size Allocation size in bytes (the VkMemoryAllocateInfo size, not the requested resource size).
+     * @param memoryTypeIndex Memory type the allocation was made from, used to resolve its heap.
+     * @param category Subsystem the allocation belongs to.
+     */
+    void track(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryTypeIndex, Category category);
+
+    /**
+     * @brief Forgets an allocation previously passed to track. Unknown handles are ignored,
+     * so this is safe to call right before any vkFreeMemory.
+     */
+    void untrack(VkDeviceMemory memory);
+
+    /**
+     * @brief Returns the number of bytes currently tracked for a category.
+     */
+    VkDeviceSize getUsage(Category category);
+
+    /**
+     * @brief Returns the number of live allocations tracked for a category.
+     */
+    uint32_t getAllocationCount(Category category);
+
+    /**
+     * @brief Returns the sum of all tracked allocations.
+     */
+    VkDeviceSize getTotalTracked();
+
+    /**
+     * @brief Returns the heap snapshot from the last update().
+     */
+    const std::vector<HeapInfo> &getHeaps();
+
+    /**
+     * @brief True when any heap's usage exceeds budgetThreshold * budget.
+     */
+    bool isOverBudget();
+
+    /**
+     * @brief Bytes that must be released to bring every heap back under budgetThreshold * budget.
+     */
+    VkDeviceSize getOverBudgetBytes();
+
+    /**
+     * @brief Human-readable name for a category (used by the GUI).
+     */
+    const char *categoryName(Category category);
+}
+
+#endif // MEMORYBUDGET_H
@@ -4,122 +4,37 @@
 #include "model.h"
 #include "mesh/mesh.h"
 #include "window.h" // Include for Kinesis::Window::createBuffer
+#include "raytracer/asbuildscheduler.h"
 #include <iostream>
 
 namespace Kinesis
 {
 
-    void Model::createVertexBuffers(const std::vector<Mesh::Vertex> &vertices)
+    void Model::uploadGeometry()
     {
-        vertexCount = static_cast<uint32_t>(vertices.size());
-        // Allow vertexCount to be 0 if the mesh load failed or was empty
-        if (vertexCount == 0)
-        {
-            vertexBuffer = VK_NULL_HANDLE;
-            vertexBufferMemory = VK_NULL_HANDLE;
-            // std::cerr << "Warning: Creating vertex buffer with 0 vertices." << std::endl; // Optional warning
-            return;
-        }
-        // assert(vertexCount >= 3 && "Vertex count must be at least 3!" ); // Removing assert, allow models with <3 vertices initially
-        VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-
-        // Use the helper from window.cpp
-        Kinesis::Window::createBuffer(
-            bufferSize,
-            // CRITICAL FIX: Add VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
-            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | 
-            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | 
-            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | 
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            vertexBuffer,
-            vertexBufferMemory
-        );
-
-        void *data;
-        // Check if buffer creation was successful before mapping
-        if (vertexBuffer != VK_NULL_HANDLE && vertexBufferMemory != VK_NULL_HANDLE)
-        {
-            vkMapMemory(g_Device, vertexBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-            vkUnmapMemory(g_Device, vertexBufferMemory);
-        }
-        else if (vertexCount > 0)
-        {
-            // Throw error only if vertices existed but buffer creation failed
-            throw std::runtime_error("Failed to create vertex buffer even though vertex data exists!");
-        }
+        // Allow empty meshes; they simply get no range and are never drawn
+        GeometryPool::allocate(geometry, mesh.getVertices(), mesh.getIndices());
     }
 
-    void Model::createIndexBuffers(const std::vector<uint32_t> &indices)
+    void Model::releaseGeometry()
     {
-        indexCount = static_cast<uint32_t>(indices.size());
-        hasIndexBuffer = indexCount > 0;
-        if (!hasIndexBuffer)
-        {
-            indexBuffer = VK_NULL_HANDLE;
-            indexBufferMemory = VK_NULL_HANDLE;
-            return;
-        }
-        VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-
-        // Use the helper from window.cpp
-        Kinesis::Window::createBuffer(
-            bufferSize,
-            VK_BUFFER_USAGE_INDEX_BUFFER_BIT | 
-            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | 
-            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | 
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            indexBuffer,
-            indexBufferMemory
-        );
-
-        void *data;
-        // Check if buffer creation was successful before mapping
-        if (indexBuffer != VK_NULL_HANDLE && indexBufferMemory != VK_NULL_HANDLE)
-        {
-            vkMapMemory(g_Device, indexBufferMemory, 0, bufferSize, 0, &data);
-            memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-            vkUnmapMemory(g_Device, indexBufferMemory);
-        }
-        else
-        {
-            throw std::runtime_error("Failed to create index buffer even though index data exists!");
-        }
+        GeometryPool::release(geometry);
     }
 
     void Model::bind(VkCommandBuffer commandBuffer)
     {
-        if (vertexBuffer != VK_NULL_HANDLE)
-        { // Only bind if buffer exists
-            VkBuffer buffers[] = {vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
-        }
-        if (hasIndexBuffer && indexBuffer != VK_NULL_HANDLE)
-        { // Only bind if index buffer exists
-            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-        }
+        GeometryPool::bind(commandBuffer);
     }
 
     void Model::draw(VkCommandBuffer commandBuffer)
     {
-        // Only draw if vertex buffer exists
-        if (vertexBuffer == VK_NULL_HANDLE || vertexCount == 0)
+        // Only draw if the model currently has a range in the pool
+        if (!geometry.valid())
         {
             return;
         }
-
-        if (hasIndexBuffer && indexBuffer != VK_NULL_HANDLE)
-        { // Check index buffer handle too
-            vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-        }
-        else if (!hasIndexBuffer)
-        { // Only draw non-indexed if no index buffer was intended
-            vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
-        }
-        // If hasIndexBuffer is true but indexBuffer is VK_NULL_HANDLE, it indicates an error state - don't draw.
+        // Indices are mesh-relative, vertexOffset rebases them into the shared vertex buffer
+        vkCmdDrawIndexed(commandBuffer, geometry.indexCount, 1, geometry.firstIndex, static_cast<int32_t>(geometry.vertexOffset), 0);
     }
 
     Model::Model(const Builder &builder)
@@ -128,9 +43,9 @@ namespace Kinesis
         mesh.setVertices(builder.vertices);
         mesh.setIndices(builder.indices);
 
-        // Create GPU buffers from the builder data
-        createVertexBuffers(builder.vertices);
-        createIndexBuffers(builder.indices);
+        // Copy the builder data into the shared geometry buffers
+        uploadGeometry();
+        computeBounds();
     }
 
     // Constructor loading from file
@@ -142,52 +57,83 @@ namespace Kinesis
         { // Use the single-argument Load
             // Handle error: Maybe throw an exception or set model to an error state
             std::cerr << "Error loading mesh: " << fullPath << std::endl;
-            // Ensure buffers are null if loading fails
-            vertexBuffer = VK_NULL_HANDLE;
-            vertexBufferMemory = VK_NULL_HANDLE;
-            indexBuffer = VK_NULL_HANDLE;
-            indexBufferMemory = VK_NULL_HANDLE;
-            vertexCount = 0;
-            indexCount = 0;
-            hasIndexBuffer = false;
+            // Ensure no pool range is held if loading fails
+            geometry = {};
             // Optionally re-throw or return an error indicator
             throw std::runtime_error("Failed to load model: " + fullPath);
         }
-        // Use the correct accessor from the simplified mesh
-        createVertexBuffers(mesh.getVertices());
-        createIndexBuffers(mesh.getIndices()); // Create index buffers using loaded indices
+        // Copy the loaded vertices/indices into the shared geometry buffers
+        uploadGeometry();
+        computeBounds();
     }
 
-    Model::~Model()
+    void Model::computeBounds()
     {
-        // Check device handle validity from kinesis.h
-        if (g_Device != VK_NULL_HANDLE)
+        const auto &vertices = mesh.getVertices();
+        if (vertices.empty())
         {
-            if (vertexBuffer != VK_NULL_HANDLE)
-            {
-                vkDestroyBuffer(g_Device, vertexBuffer, nullptr);
-            }
-            if (vertexBufferMemory != VK_NULL_HANDLE)
-            {
-                vkFreeMemory(g_Device, vertexBufferMemory, nullptr);
-            }
-            if (hasIndexBuffer)
-            {
-                if (indexBuffer != VK_NULL_HANDLE)
-                {
-                    vkDestroyBuffer(g_Device, indexBuffer, nullptr);
-                }
-                if (indexBufferMemory != VK_NULL_HANDLE)
-                {
-                    vkFreeMemory(g_Device, indexBufferMemory, nullptr);
-                }
-            }
+            boundsCenter = glm::vec3(0.f);
+            boundsRadius = 0.f;
+            return;
         }
-        // Nullify handles after destruction (good practice)
-        vertexBuffer = VK_NULL_HANDLE;
-        vertexBufferMemory = VK_NULL_HANDLE;
-        indexBuffer = VK_NULL_HANDLE;
-        indexBufferMemory = VK_NULL_HANDLE;
+        // Center of the AABB + farthest vertex; not minimal, but good enough for culling
+        glm::vec3 minP = vertices[0].position;
+        glm::vec3 maxP = vertices[0].position;
+        for (const auto &v : vertices)
+        {
+            minP = glm::min(minP, v.position);
+            maxP = glm::max(maxP, v.position);
+        }
+        boundsCenter = (minP + maxP) * 0.5f;
+        boundsRadius = 0.f;
+        for (const auto &v : vertices)
+        {
+            boundsRadius = glm::max(boundsRadius, glm::length(v.position - boundsCenter));
+        }
+    }
+
+    void Model::updateVertices(const std::vector<Mesh::Vertex> &vertices)
+    {
+        if (vertices.size() != mesh.getVertices().size())
+        {
+            throw std::runtime_error("Model::updateVertices: vertex count must stay the same!");
+        }
+        mesh.setVertices(vertices);
+        // An evicted model picks the new data up when it is restored
+        if (resident)
+            GeometryPool::writeVertices(geometry, vertices);
+        computeBounds();
+        vertexGeneration++;
+    }
+
+    VkDeviceSize Model::getGeometrySize() const
+    {
+        // Meshes without indices get a generated index list in the pool
+        VkDeviceSize indexCount = mesh.hasIndices() ? mesh.numIndices() : mesh.numVertices();
+        return sizeof(Mesh::Vertex) * static_cast<VkDeviceSize>(mesh.numVertices()) +
+               sizeof(uint32_t) * indexCount;
+    }
+
+    void Model::evictBuffers()
+    {
+        if (!resident)
+            return;
+        releaseGeometry();
+        resident = false;
+    }
+
+    void Model::restoreBuffers()
+    {
+        if (resident)
+            return;
+        uploadGeometry();
+        resident = true;
+    }
+
+    Model::~Model()
+    {
+        ASBuildScheduler::cancel(this); // A queued build would point at a destroyed model
+        releaseGeometry();
     }
 
-} // namespace Kinesis
\ No newline at end of file
+} // namespace Kinesis
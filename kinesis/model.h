@@ -5,6 +5,7 @@
 #include "window.h"
 #include "mesh/mesh.h"
 #include "mesh/vertex.h"
+#include "geometrypool.h"
 
 #define GLM_FORCE_RADIANS           // Ensure GLM uses radians
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan depth range is [0, 1]
@@ -17,16 +18,16 @@ namespace Kinesis
         // --- Module Variables ---
     private:
         Mesh::Mesh mesh;
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
-        uint32_t vertexCount;
-        bool hasIndexBuffer = false;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
-        uint32_t indexCount;
-
-        void createVertexBuffers(const std::vector<Mesh::Vertex> &vertices);
-        void createIndexBuffers(const std::vector<uint32_t> &indices);
+        GeometryPool::Allocation geometry{}; // Range inside the shared vertex/index buffers
+        bool resident = true;
+        bool dynamic = false;         // Deforming geometry: refittable BLAS (see setDynamic)
+        uint32_t vertexGeneration = 0; // Bumped by updateVertices
+        glm::vec3 boundsCenter{0.f};
+        float boundsRadius = 0.f;
+
+        void uploadGeometry();
+        void releaseGeometry();
+        void computeBounds();
  
     public:
 
@@ -40,42 +41,99 @@ namespace Kinesis
         Mesh::Mesh* getMesh() { return &mesh; }
 
         /**
-         * @brief returns the vertex buffer
+         * @brief returns the shared vertex/index buffer holding this model's geometry,
+         * or VK_NULL_HANDLE while the model is evicted
+         */
+        VkBuffer getVertexBuffer() { return geometry.valid() ? GeometryPool::getVertexBuffer() : VK_NULL_HANDLE; }
+        VkBuffer getIndexBuffer() { return geometry.valid() ? GeometryPool::getIndexBuffer() : VK_NULL_HANDLE; }
+
+        /**
+         * @brief Offsets of this model's range inside the shared buffers (see GeometryPool::Allocation)
+         */
+        uint32_t getVertexOffset() const { return geometry.vertexOffset; }
+        uint32_t getVertexCount() const { return geometry.vertexCount; }
+        uint32_t getFirstIndex() const { return geometry.firstIndex; }
+        uint32_t getIndexCount() const { return geometry.indexCount; }
+
+        /**
+         * @brief Object-space bounding sphere of the mesh, used for visibility tests.
+         */
+        const glm::vec3 &getBoundsCenter() const { return boundsCenter; }
+        float getBoundsRadius() const { return boundsRadius; }
+
+        /**
+         * @brief Returns true while the vertex/index buffers are allocated on the GPU.
+         */
+        bool isResident() const { return resident; }
+
+        /**
+         * @brief Marks the model as deforming. Its BLAS is then built with ALLOW_UPDATE | PREFER_FAST_BUILD
+         * and refit every frame its vertices changed (RayTracerManager::refitDynamicBlas), instead of
+         * being rebuilt. Takes effect the next time the model's BLAS is built, so set it before create_blas
+         * (or call RayTracerManager::build_blas(model) afterwards).
          */
-        VkBuffer getVertexBuffer() { return vertexBuffer; }
-        VkBuffer getIndexBuffer() { return indexBuffer; }
+        void setDynamic(bool isDynamic) { dynamic = isDynamic; }
+        bool isDynamic() const { return dynamic; }
 
         /**
-         * @brief Binds the vertex buffer to the specified command buffer for drawing.
-         * @param commandBuffer The command buffer to bind the vertex buffer to.
+         * @brief Replaces the vertex data (same vertex count, same topology) in the CPU mesh and, when
+         * resident, queues it for the geometry pool (GeometryPool::writeVertices), then refreshes the
+         * bounds and bumps getVertexGeneration().
+         */
+        void updateVertices(const std::vector<Mesh::Vertex> &vertices);
+        uint32_t getVertexGeneration() const { return vertexGeneration; }
+
+        /**
+         * @brief Size in bytes of the GPU geometry buffers this model occupies when resident.
+         */
+        VkDeviceSize getGeometrySize() const;
+
+        /**
+         * @brief Returns the model's range to the geometry pool while keeping the CPU-side mesh data.
+         * The range is only reused once the frames in flight that may still read it have finished.
+         */
+        void evictBuffers();
+
+        /**
+         * @brief Re-uploads the CPU-side mesh data into the geometry pool after an eviction.
+         */
+        void restoreBuffers();
+
+        /**
+         * @brief Binds the shared geometry buffers. Every model lives in the same buffers,
+         * so this only needs to happen once per pass (see GeometryPool::bind).
+         * @param commandBuffer The command buffer to bind the buffers to.
          */
         void bind(VkCommandBuffer commandBuffer);
 
         /**
-         * @brief Records a draw command into the specified command buffer using the bound vertex buffer.
+         * @brief Records an indexed draw of this model's range using firstIndex/vertexOffset.
+         * Assumes the shared geometry buffers are bound.
          * @param commandBuffer The command buffer to record the draw command into.
          */
         void draw(VkCommandBuffer commandBuffer);
 
         /**
-         * @brief Initializes the model by creating the vertex buffer with the given data.
-         * (Currently just calls createVertexBuffers).
+         * @brief Initializes the model by uploading the given data into the geometry pool.
          * @param vertices The vertex data to initialize the model with.
          */
         Model(const Builder& builder);
 
         /**
-         * @brief Initializes the model from an .obj file.
-         * (Currently just calls createVertexBuffers).
+         * @brief Initializes the model from an .obj file and uploads it into the geometry pool.
          * @param path The folder containing the file.
          * @param input_file The name of the .obj file.
          */
         Model(const std::string &path, const std::string &input_file);
 
         /**
-         * @brief Cleans up Vulkan resources (vertex buffer and memory) used by the model.
+         * @brief Returns the model's range to the geometry pool.
          */
         ~Model();
+
+        // The pool keeps a pointer to `geometry`, so a model can't be copied
+        Model(const Model &) = delete;
+        Model &operator=(const Model &) = delete;
     };
 
 }
@@ -0,0 +1,186 @@
+// kinesis/pipelinecache.cpp
+#include "pipelinecache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace Kinesis::PipelineCache
+{
+    namespace
+    {
+        // Bump when the file layout changes; old files are then ignored (different name and header)
+        constexpr uint32_t FILE_VERSION = 1;
+        constexpr uint32_t FILE_MAGIC = 0x3143504B; // "KPC1"
+
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t fileVersion;
+            uint32_t vendorID;
+            uint32_t deviceID;
+            uint32_t driverVersion;
+            uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+            uint32_t reserved; // Keeps dataSize 8-byte aligned without implicit padding (header is memcmp'd)
+            uint64_t dataSize;
+        };
+        static_assert(sizeof(FileHeader) == 48, "FileHeader must not contain padding");
+
+        VkPhysicalDeviceProperties deviceProperties{};
+        std::string path;
+        size_t loadedBytes = 0;
+
+        FileHeader makeHeader(uint64_t dataSize)
+        {
+            FileHeader header{};
+            header.magic = FILE_MAGIC;
+            header.fileVersion = FILE_VERSION;
+            header.vendorID = deviceProperties.vendorID;
+            header.deviceID = deviceProperties.deviceID;
+            header.driverVersion = deviceProperties.driverVersion;
+            memcpy(header.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+            header.dataSize = dataSize;
+            return header;
+        }
+
+        std::string makePath()
+        {
+            std::ostringstream name;
+            name << "pipeline_cache_v" << FILE_VERSION << "_" << std::hex << std::setfill('0')
+                 << std::setw(4) << deviceProperties.vendorID << "_" << std::setw(4) << deviceProperties.deviceID << "_"
+                 << std::setw(8) << deviceProperties.driverVersion << "_";
+            for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+                name << std::setw(2) << static_cast<uint32_t>(deviceProperties.pipelineCacheUUID[i]);
+            name << ".bin";
+            return name.str();
+        }
+
+        // Reads the cache data from disk, empty if the file is missing or was written for another device/driver
+        std::vector<char> readCacheFile()
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+                return {};
+            size_t fileSize = static_cast<size_t>(file.tellg());
+            if (fileSize < sizeof(FileHeader))
+                return {};
+            file.seekg(0);
+
+            FileHeader header{};
+            file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader));
+            FileHeader expected = makeHeader(header.dataSize);
+            if (memcmp(&header, &expected, sizeof(FileHeader)) != 0 || header.dataSize != fileSize - sizeof(FileHeader))
+            {
+                std::cout << "Pipeline cache file " << path << " does not match this device/driver, ignoring it." << std::endl;
+                return {};
+            }
+
+            std::vector<char> data(static_cast<size_t>(header.dataSize));
+            file.read(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!file)
+                return {};
+
+            // The driver validates its own header too, but a truncated/foreign blob is cheap to reject here
+            VkPipelineCacheHeaderVersionOne vkHeader{};
+            if (data.size() < sizeof(vkHeader))
+                return {};
+            memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+            if (vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+                vkHeader.vendorID != deviceProperties.vendorID || vkHeader.deviceID != deviceProperties.deviceID ||
+                memcmp(vkHeader.pipelineCacheUUID, deviceProperties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+                return {};
+            return data;
+        }
+    }
+
+    void load()
+    {
+        if (g_Device == VK_NULL_HANDLE || g_PhysicalDevice == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("Device not created before PipelineCache::load!");
+        }
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &deviceProperties);
+        path = makePath();
+
+        std::vector<char> data = readCacheFile();
+        loadedBytes = data.size();
+
+        VkPipelineCacheCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize = data.size();
+        createInfo.pInitialData = data.empty() ? nullptr : data.data();
+        // Not externally synchronized: pipelines are compiled on several threads at startup
+        if (vkCreatePipelineCache(g_Device, &createInfo, nullptr, &g_PipelineCache) != VK_SUCCESS)
+        {
+            // A rejected blob is not fatal, start cold
+            std::cerr << "Warning: Pipeline cache data rejected, starting with an empty cache." << std::endl;
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            loadedBytes = 0;
+            if (vkCreatePipelineCache(g_Device, &createInfo, nullptr, &g_PipelineCache) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create pipeline cache!");
+            }
+        }
+        std::cout << "Pipeline cache " << path << (loadedBytes ? " loaded (" + std::to_string(loadedBytes) + " bytes)." : " not found, cold start.") << std::endl;
+    }
+
+    void save()
+    {
+        if (g_Device == VK_NULL_HANDLE || g_PipelineCache == VK_NULL_HANDLE || path.empty())
+            return;
+
+        size_t dataSize = 0;
+        if (vkGetPipelineCacheData(g_Device, g_PipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0)
+            return;
+        std::vector<char> data(dataSize);
+        if (vkGetPipelineCacheData(g_Device, g_PipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+        {
+            std::cerr << "Warning: Failed to read pipeline cache data." << std::endl;
+            return;
+        }
+
+        // Write to a temporary file first so a crash mid-write never leaves a truncated cache behind
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                std::cerr << "Warning: Could not open " << tempPath << " for writing." << std::endl;
+                return;
+            }
+            FileHeader header = makeHeader(dataSize);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+            file.write(data.data(), static_cast<std::streamsize>(dataSize));
+            if (!file)
+            {
+                std::cerr << "Warning: Failed to write " << tempPath << "." << std::endl;
+                return;
+            }
+        }
+        std::remove(path.c_str()); // rename() does not replace existing files on every platform
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "Warning: Could not move " << tempPath << " to " << path << "." << std::endl;
+            return;
+        }
+        std::cout << "Pipeline cache saved to " << path << " (" << dataSize << " bytes)." << std::endl;
+    }
+
+    void cleanup()
+    {
+        if (g_Device != VK_NULL_HANDLE && g_PipelineCache != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineCache(g_Device, g_PipelineCache, nullptr);
+        }
+        g_PipelineCache = VK_NULL_HANDLE;
+    }
+
+    const std::string &getPath() { return path; }
+    size_t getLoadedBytes() { return loadedBytes; }
+}
@@ -0,0 +1,37 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include "kinesis.h"
+#include <string>
+
+namespace Kinesis::PipelineCache
+{
+    /**
+     * @brief Creates g_PipelineCache, seeded from disk when a matching cache file exists.
+     * The file name is keyed by vendor/device ID, driver version and pipelineCacheUUID, and the
+     * file carries its own header that is validated again on load, so a driver update or a
+     * different GPU simply starts with an empty cache instead of feeding the driver foreign data.
+     * Called by Window::SetupVulkan right after the device is created.
+     */
+    void load();
+
+    /**
+     * @brief Writes g_PipelineCache to disk (through a temporary file, then renamed into place).
+     * Safe to call more than once; failures are logged, never thrown.
+     */
+    void save();
+
+    /**
+     * @brief Destroys g_PipelineCache. Call before the device is destroyed.
+     */
+    void cleanup();
+
+    /**
+     * @brief The cache file used for the current device. Empty before load().
+     */
+    const std::string &getPath();
+
+    size_t getLoadedBytes(); // Size of the cache data found on disk at startup (0 = cold start)
+}
+
+#endif // PIPELINECACHE_H
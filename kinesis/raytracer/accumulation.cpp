@@ -0,0 +1,65 @@
+// kinesis/raytracer/accumulation.cpp
+#include "raytracer/accumulation.h"
+
+#include <cstring>
+
+namespace Kinesis::Accumulation
+{
+    bool enabled = true;
+    int maxFrames = 1024;
+
+    namespace
+    {
+        // Everything the image depends on that begin() can compare by itself
+        struct ViewState
+        {
+            glm::mat4 view{0.f};
+            glm::mat4 projection{0.f};
+            VkExtent2D extent{0, 0};
+            int samplesPerPixel = 0;
+            int maxDepth = 0;
+            bool enabled = false;
+        };
+
+        ViewState last{};
+        uint64_t lastFrameNumber = UINT64_MAX;
+        uint32_t frameCount = 0;
+        uint64_t resetCount = 0;
+    }
+
+    void reset()
+    {
+        if (frameCount > 0)
+            resetCount++;
+        frameCount = 0;
+    }
+
+    bool begin(uint64_t frameNumber, const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D extent,
+               int samplesPerPixel, int maxDepth)
+    {
+        ViewState current{view, projection, extent, samplesPerPixel, maxDepth, enabled};
+        // Compared bitwise: any camera movement, however small, invalidates the average
+        const bool changed = memcmp(&current.view, &last.view, sizeof(glm::mat4)) != 0 ||
+                             memcmp(&current.projection, &last.projection, sizeof(glm::mat4)) != 0 ||
+                             current.extent.width != last.extent.width || current.extent.height != last.extent.height ||
+                             current.samplesPerPixel != last.samplesPerPixel || current.maxDepth != last.maxDepth ||
+                             current.enabled != last.enabled;
+        // A gap means the pass was off for a while, the scene may have changed without anyone noticing
+        if (changed || frameNumber != lastFrameNumber + 1)
+            reset();
+        last = current;
+        lastFrameNumber = frameNumber;
+        return !isConverged();
+    }
+
+    uint32_t recordFrame()
+    {
+        if (!enabled)
+            return 0;
+        return frameCount++;
+    }
+
+    uint32_t getFrameCount() { return frameCount; }
+    bool isConverged() { return enabled && maxFrames > 0 && frameCount >= static_cast<uint32_t>(maxFrames); }
+    uint64_t getResetCount() { return resetCount; }
+}
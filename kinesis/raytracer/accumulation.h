@@ -0,0 +1,37 @@
+#ifndef ACCUMULATION_H
+#define ACCUMULATION_H
+
+#include "kinesis.h"
+
+namespace Kinesis::Accumulation
+{
+    extern bool enabled; // Average the RT output over frames while nothing changes
+    extern int maxFrames; // Frames averaged before the image counts as converged and tracing pauses
+
+    /**
+     * @brief Starts the accumulation over. Called for changes begin() cannot see itself: moved or deformed
+     * geometry (RayTracerManager::updateTlas), a different pipeline variant, material edits.
+     */
+    void reset();
+
+    /**
+     * @brief Per-frame tick of the RT pass, call before recording it. Starts over if the camera, the render
+     * extent or the RT settings changed, or if the pass did not run last frame.
+     * @return False once maxFrames are averaged: the image has converged and the pass can be skipped,
+     * the RT output keeps its contents.
+     */
+    bool begin(uint64_t frameNumber, const glm::mat4 &view, const glm::mat4 &projection, VkExtent2D extent,
+               int samplesPerPixel, int maxDepth);
+
+    /**
+     * @brief Counts the frame being traced. Call when the trace is recorded, after anything that may reset().
+     * @return Frames already averaged into the accumulation image (0 = overwrite it, always 0 when disabled).
+     */
+    uint32_t recordFrame();
+
+    uint32_t getFrameCount(); // Frames in the current average
+    bool isConverged();
+    uint64_t getResetCount();
+}
+
+#endif // ACCUMULATION_H
@@ -0,0 +1,183 @@
+// kinesis/raytracer/asbuildscheduler.cpp
+#include "raytracer/asbuildscheduler.h"
+#include "raytracer/raytracermanager.h"
+#include "gameobject.h"
+#include "swapchain.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace Kinesis::ASBuildScheduler
+{
+    float budgetMs = 1.0f;
+    float lastFrameGpuMs = 0.f;
+    uint32_t buildsLastFrame = 0;
+    float estimatedNsPerTriangle = 5.0f; // Conservative start, replaced by measurements after the first builds
+
+    namespace
+    {
+        // Weight of a new measurement in the running per-triangle estimate
+        constexpr float ESTIMATE_BLEND = 0.25f;
+
+        struct Candidate
+        {
+            Model *model = nullptr;
+            float coverage = 0.f; // Squared projected size of the closest instance (radius / distance)^2
+            float distance = 0.f;
+        };
+
+        std::vector<Model *> queue;
+        std::vector<Candidate> candidates; // Reused every frame so scheduling doesn't allocate
+        std::vector<Model *> selected;      // Likewise, the models whose builds are recorded this frame
+
+        // Two timestamps (before/after the builds) per frame slot; a slot is only read back if it was written
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        bool timestampsSupported = true;
+        float timestampPeriodNs = 1.f;
+        std::array<uint32_t, SwapChain::MAX_FRAMES_IN_FLIGHT> slotTriangles{}; // Triangles built while the slot was measured
+
+        void createQueryPool()
+        {
+            VkPhysicalDeviceProperties properties{};
+            vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+            if (!properties.limits.timestampComputeAndGraphics)
+            {
+                // Without timestamps the initial estimate is used as is
+                std::cerr << "Warning: Timestamp queries not supported, AS build budget uses a fixed estimate." << std::endl;
+                timestampsSupported = false;
+                return;
+            }
+            timestampPeriodNs = properties.limits.timestampPeriod;
+
+            VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryInfo.queryCount = 2 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(g_Device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create AS build timestamp query pool!");
+            }
+        }
+
+        // The fence wait in beginFrame guarantees this slot's last submission finished, so this never blocks
+        void readBackTimings(int frameIndex)
+        {
+            if (queryPool == VK_NULL_HANDLE || slotTriangles[frameIndex] == 0)
+                return;
+
+            std::array<uint64_t, 2> timestamps{};
+            VkResult result = vkGetQueryPoolResults(g_Device, queryPool, 2 * frameIndex, 2,
+                                                    sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                                    VK_QUERY_RESULT_64_BIT);
+            const uint32_t triangles = slotTriangles[frameIndex];
+            slotTriangles[frameIndex] = 0;
+            if (result != VK_SUCCESS || timestamps[1] < timestamps[0])
+                return;
+
+            const float elapsedNs = static_cast<float>(timestamps[1] - timestamps[0]) * timestampPeriodNs;
+            lastFrameGpuMs = elapsedNs * 1e-6f;
+            const float measured = elapsedNs / static_cast<float>(triangles);
+            estimatedNsPerTriangle += (measured - estimatedNsPerTriangle) * ESTIMATE_BLEND;
+        }
+
+        // Priority of a queued model: its instance that covers the most of the screen, approximated by
+        // the squared ratio of bounding radius to distance. Closer objects win ties.
+        bool rateCandidate(Model *model, const glm::vec3 &cameraPosition, Candidate &candidate)
+        {
+            candidate = {model, -1.f, std::numeric_limits<float>::max()};
+            for (const auto &obj : gameObjects)
+            {
+                if (obj.model.get() != model)
+                    continue;
+                glm::vec3 center = glm::vec3(obj.transform.mat4() * glm::vec4(model->getBoundsCenter(), 1.f));
+                float maxScale = glm::max(glm::abs(obj.transform.scale.x), glm::max(glm::abs(obj.transform.scale.y), glm::abs(obj.transform.scale.z)));
+                float radius = model->getBoundsRadius() * maxScale;
+                float distance = glm::length(center - cameraPosition);
+                // Inside the bounding sphere the object fills the screen
+                float coverage = distance > radius ? (radius * radius) / (distance * distance) : 1.f;
+                if (coverage > candidate.coverage || (coverage == candidate.coverage && distance < candidate.distance))
+                {
+                    candidate.coverage = coverage;
+                    candidate.distance = distance;
+                }
+            }
+            return candidate.coverage >= 0.f; // No instance uses the model anymore
+        }
+    }
+
+    void enqueue(Model *model)
+    {
+        if (model && std::find(queue.begin(), queue.end(), model) == queue.end())
+            queue.push_back(model);
+    }
+
+    void cancel(const Model *model)
+    {
+        queue.erase(std::remove(queue.begin(), queue.end(), model), queue.end());
+    }
+
+    void update(VkCommandBuffer commandBuffer, int frameIndex, const Camera &camera)
+    {
+        buildsLastFrame = 0;
+        if (queryPool == VK_NULL_HANDLE && timestampsSupported && !queue.empty())
+            createQueryPool();
+        readBackTimings(frameIndex);
+        if (queue.empty())
+            return;
+
+        // Rate what is still worth building; evicted or unused models leave the queue
+        const glm::vec3 cameraPosition = glm::vec3(glm::inverse(camera.getView())[3]);
+        candidates.clear();
+        for (Model *model : queue)
+        {
+            Candidate candidate;
+            if (model->isResident() && model->getIndexCount() >= 3 && rateCandidate(model, cameraPosition, candidate))
+                candidates.push_back(candidate);
+        }
+        queue.clear();
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+                  { return a.coverage != b.coverage ? a.coverage > b.coverage : a.distance < b.distance; });
+
+        // Highest priority first, until the estimated cost would overrun the budget. At least one build is
+        // recorded every frame so the queue always drains, even if a single model exceeds the budget.
+        selected.clear();
+        float estimatedMs = 0.f;
+        size_t next = 0;
+        for (; next < candidates.size(); ++next)
+        {
+            const float costMs = static_cast<float>(candidates[next].model->getIndexCount() / 3) * estimatedNsPerTriangle * 1e-6f;
+            if (!selected.empty() && estimatedMs + costMs > budgetMs)
+                break;
+            selected.push_back(candidates[next].model);
+            estimatedMs += costMs;
+        }
+        for (size_t i = next; i < candidates.size(); ++i)
+            queue.push_back(candidates[i].model); // Kept in priority order, re-rated next frame anyway
+
+        // The timestamps go around the build command itself (see recordBlasBuilds); the vertex copies and
+        // barriers recorded ahead of it in this command buffer are not part of the measurement
+        if (queryPool != VK_NULL_HANDLE)
+            vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameIndex, 2);
+        const uint32_t triangles = RayTracerManager::recordBlasBuilds(commandBuffer, selected, queryPool, 2 * frameIndex);
+        if (queryPool != VK_NULL_HANDLE)
+            slotTriangles[frameIndex] = triangles; // 0 if nothing was built, then no timestamps were written
+        buildsLastFrame = static_cast<uint32_t>(selected.size());
+    }
+
+    size_t getPendingCount() { return queue.size(); }
+
+    void cleanup()
+    {
+        queue.clear();
+        candidates.clear();
+        selected.clear();
+        slotTriangles.fill(0);
+        if (g_Device != VK_NULL_HANDLE && queryPool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(g_Device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+        timestampsSupported = true;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef ASBUILDSCHEDULER_H
+#define ASBUILDSCHEDULER_H
+
+#include "kinesis.h"
+#include "camera.h"
+
+namespace Kinesis::ASBuildScheduler
+{
+    extern float budgetMs;             // GPU time per frame that queued BLAS builds may take
+    extern float lastFrameGpuMs;       // Measured GPU time of the builds recorded in the last measured frame
+    extern uint32_t buildsLastFrame;   // BLAS builds recorded in the last frame
+    extern float estimatedNsPerTriangle; // Running estimate the budget is spent with, refined from the measurements
+
+    /**
+     * @brief Queues a BLAS build for a model instead of building it right away. Queuing a model that is
+     * already queued is a no-op. Until its build runs, the model's instances are left out of the TLAS.
+     */
+    void enqueue(Model *model);
+
+    /**
+     * @brief Per-frame tick. Reads back the GPU time the builds of this frame slot took last time, orders the
+     * queue by priority (estimated screen coverage of the model's closest instance, then distance to the
+     * camera) and records as many builds into the frame's command buffer as the estimated cost fits in
+     * budgetMs, at least one per frame. The build command is bracketed by timestamp queries.
+     * Call after beginFrame, before RayTracerManager::updateTlas, outside a render pass.
+     */
+    void update(VkCommandBuffer commandBuffer, int frameIndex, const Camera &camera);
+
+    /**
+     * @brief Forgets a queued model (e.g. when it is evicted before its build ran). Model's destructor
+     * calls this, so the queue never holds a destroyed model.
+     */
+    void cancel(const Model *model);
+
+    size_t getPendingCount();
+
+    /**
+     * @brief Drops the queue and destroys the timestamp query pool. The device must be idle.
+     */
+    void cleanup();
+}
+
+#endif // ASBUILDSCHEDULER_H
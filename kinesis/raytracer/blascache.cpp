@@ -0,0 +1,187 @@
+// kinesis/raytracer/blascache.cpp
+#include "raytracer/blascache.h"
+#include "model.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace Kinesis::BlasCache
+{
+    bool enabled = true;
+
+    namespace
+    {
+        // Bump when the file layout changes; old files then fail the header check and are rebuilt
+        constexpr uint32_t FILE_VERSION = 1;
+        constexpr uint32_t FILE_MAGIC = 0x3153414B; // "KAS1"
+
+        // Serialized AS data starts with the driver UUID and the compatibility UUID, followed by the
+        // serialized size, the deserialized size and the number of instance handles (one uint64 each)
+        constexpr size_t SERIALIZED_HEADER_SIZE = 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t);
+
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t fileVersion;
+            uint32_t vendorID;
+            uint32_t deviceID;
+            uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+            uint64_t geometryHash;
+            uint32_t buildFlags;
+            uint32_t reserved; // Keeps dataSize 8-byte aligned without implicit padding (header is memcmp'd)
+            uint64_t dataSize;
+        };
+        static_assert(sizeof(FileHeader) == 56, "FileHeader must not contain padding");
+
+        const std::string directory = "blas_cache";
+        Stats stats{};
+        VkPhysicalDeviceProperties deviceProperties{};
+        bool devicePropertiesQueried = false;
+
+        const VkPhysicalDeviceProperties &getDeviceProperties()
+        {
+            if (!devicePropertiesQueried)
+            {
+                vkGetPhysicalDeviceProperties(g_PhysicalDevice, &deviceProperties);
+                devicePropertiesQueried = true;
+            }
+            return deviceProperties;
+        }
+
+        FileHeader makeHeader(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags, uint64_t dataSize)
+        {
+            FileHeader header{};
+            header.magic = FILE_MAGIC;
+            header.fileVersion = FILE_VERSION;
+            header.vendorID = getDeviceProperties().vendorID;
+            header.deviceID = getDeviceProperties().deviceID;
+            memcpy(header.pipelineCacheUUID, getDeviceProperties().pipelineCacheUUID, VK_UUID_SIZE);
+            header.geometryHash = geometryHash;
+            header.buildFlags = static_cast<uint32_t>(flags);
+            header.dataSize = dataSize;
+            return header;
+        }
+
+        // One file per device/driver (vendor/device ID and pipelineCacheUUID), geometry and build flags, so
+        // another GPU or driver writes its own files instead of replacing these. The driver still checks the
+        // data itself (vkGetDeviceAccelerationStructureCompatibilityKHR).
+        std::string makePath(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags)
+        {
+            const VkPhysicalDeviceProperties &properties = getDeviceProperties();
+            std::ostringstream name;
+            name << directory << "/blas_v" << FILE_VERSION << "_" << std::hex << std::setfill('0')
+                 << std::setw(4) << properties.vendorID << "_" << std::setw(4) << properties.deviceID << "_";
+            for (uint32_t i = 0; i < VK_UUID_SIZE; ++i)
+                name << std::setw(2) << static_cast<uint32_t>(properties.pipelineCacheUUID[i]);
+            name << "_" << std::setw(16) << geometryHash << "_" << std::setw(4) << static_cast<uint32_t>(flags) << ".bin";
+            return name.str();
+        }
+
+        // FNV-1a, stable across runs and platforms (std::hash is neither)
+        void hashBytes(uint64_t &hash, const void *data, size_t size)
+        {
+            const auto *bytes = static_cast<const uint8_t *>(data);
+            for (size_t i = 0; i < size; ++i)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001B3ull;
+            }
+        }
+    }
+
+    uint64_t hashGeometry(Model *model)
+    {
+        uint64_t hash = 0xCBF29CE484222325ull;
+        const uint32_t counts[2] = {model->getVertexCount(), model->getIndexCount()};
+        hashBytes(hash, counts, sizeof(counts));
+        // Only positions feed the build; colors/normals/UVs may change without invalidating the BLAS
+        for (const auto &vertex : model->getMesh()->getVertices())
+            hashBytes(hash, &vertex.position, sizeof(vertex.position));
+        const auto &indices = model->getMesh()->getIndices();
+        if (!indices.empty())
+            hashBytes(hash, indices.data(), indices.size() * sizeof(uint32_t));
+        return hash;
+    }
+
+    bool read(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags, std::vector<char> &data)
+    {
+        data.clear();
+        std::ifstream file(makePath(geometryHash, flags), std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+        size_t fileSize = static_cast<size_t>(file.tellg());
+        if (fileSize < sizeof(FileHeader) + SERIALIZED_HEADER_SIZE)
+            return false;
+        file.seekg(0);
+
+        FileHeader header{};
+        file.read(reinterpret_cast<char *>(&header), sizeof(FileHeader));
+        FileHeader expected = makeHeader(geometryHash, flags, header.dataSize);
+        if (memcmp(&header, &expected, sizeof(FileHeader)) != 0 || header.dataSize != fileSize - sizeof(FileHeader))
+            return false;
+
+        data.resize(static_cast<size_t>(header.dataSize));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file)
+        {
+            data.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void write(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags, const char *data, size_t size)
+    {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if (error)
+        {
+            std::cerr << "Warning: Could not create " << directory << ": " << error.message() << std::endl;
+            return;
+        }
+
+        // Write to a temporary file first so a crash mid-write never leaves a truncated file behind
+        const std::string path = makePath(geometryHash, flags);
+        const std::string tempPath = path + ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open())
+            {
+                std::cerr << "Warning: Could not open " << tempPath << " for writing." << std::endl;
+                return;
+            }
+            FileHeader header = makeHeader(geometryHash, flags, size);
+            file.write(reinterpret_cast<const char *>(&header), sizeof(FileHeader));
+            file.write(data, static_cast<std::streamsize>(size));
+            if (!file)
+            {
+                std::cerr << "Warning: Failed to write " << tempPath << "." << std::endl;
+                return;
+            }
+        }
+        std::remove(path.c_str()); // rename() does not replace existing files on every platform
+        if (std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::cerr << "Warning: Could not move " << tempPath << " to " << path << "." << std::endl;
+            return;
+        }
+        stats.bytesWritten += size;
+        stats.stored++;
+    }
+
+    void countLoaded(size_t bytes)
+    {
+        stats.loaded++;
+        stats.bytesRead += bytes;
+    }
+
+    void countIncompatible() { stats.incompatible++; }
+
+    const std::string &getDirectory() { return directory; }
+    Stats getStats() { return stats; }
+}
@@ -0,0 +1,48 @@
+#ifndef BLASCACHE_H
+#define BLASCACHE_H
+
+#include "kinesis.h"
+#include <string>
+#include <vector>
+
+namespace Kinesis::BlasCache
+{
+    struct Stats
+    {
+        uint32_t loaded = 0;       // BLAS deserialized from the cache this run
+        uint32_t stored = 0;       // BLAS serialized into the cache this run
+        uint32_t incompatible = 0; // Cache files the driver rejected despite a matching device/UUID, rebuilt and overwritten
+        uint64_t bytesRead = 0;
+        uint64_t bytesWritten = 0;
+    };
+
+    extern bool enabled; // Load/store static BLAS from/to the on-disk cache (applies to later builds)
+
+    /**
+     * @brief Hash of everything a BLAS build reads from a model: vertex positions, indices and their counts.
+     */
+    uint64_t hashGeometry(Model *model);
+
+    /**
+     * @brief Reads the serialized BLAS stored for a geometry hash and set of build flags on this device
+     * (files are keyed by vendor/device ID and pipelineCacheUUID).
+     * Only the cache's own header is validated here; whether the driver can deserialize the data
+     * (vkGetDeviceAccelerationStructureCompatibilityKHR) is up to the caller.
+     * @return False if there is no (valid) file, data is then left empty.
+     */
+    bool read(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags, std::vector<char> &data);
+
+    /**
+     * @brief Writes a serialized BLAS (the output of vkCmdCopyAccelerationStructureToMemoryKHR) to the cache,
+     * through a temporary file renamed into place. Failures are logged, never thrown.
+     */
+    void write(uint64_t geometryHash, VkBuildAccelerationStructureFlagsKHR flags, const char *data, size_t size);
+
+    void countLoaded(size_t bytes); // Called once data returned by read() was deserialized
+    void countIncompatible();       // Called when the driver rejected data returned by read()
+
+    const std::string &getDirectory();
+    Stats getStats();
+}
+
+#endif // BLASCACHE_H
@@ -0,0 +1,407 @@
+// kinesis/raytracer/denoiser.cpp
+#include "raytracer/denoiser.h"
+#include "raytracer/raytracermanager.h"
+#include "gbuffer.h"
+#include "swapchain.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace Kinesis::Denoiser
+{
+    bool enabled = true;
+    int atrousIterations = 4;
+    float temporalAlpha = 0.1f;
+    float phiColor = 4.0f;
+    float lastFrameGpuMs = 0.f;
+
+    namespace
+    {
+        constexpr uint32_t GROUP_SIZE = 8;      // local_size_x/y of both denoiser shaders
+        constexpr uint32_t OUTPUT_TARGET = 2;   // Push constant target: write rtOutput instead of a filter image
+
+        // Must match DenoiseParameters in denoise.glsl (128 bytes, the guaranteed push constant size)
+        struct DenoisePushConstants
+        {
+            glm::mat4 prevViewProjection;
+            glm::vec4 cameraPosition;
+            glm::vec4 prevCameraPosition; // w = 1 if the history is usable
+            glm::ivec2 size;
+            uint32_t current; // History slot written this frame, the other one is read
+            int32_t stepSize; // A-trous tap distance in pixels
+            uint32_t source;  // Filter image read (0/1)
+            uint32_t target;  // Filter image written (0/1) or OUTPUT_TARGET
+            float temporalAlpha;
+            float phiColor;
+        };
+        static_assert(sizeof(DenoisePushConstants) == 128, "DenoisePushConstants must match the shader block");
+
+        // Everything written into a denoiser descriptor set, laid out for the update template
+        struct DenoiseDescriptorData
+        {
+            VkDescriptorImageInfo output;            // 0
+            VkDescriptorImageInfo gbuffer[4];        // 1-4
+            VkDescriptorImageInfo historyColor[2];   // 5-6
+            VkDescriptorImageInfo historyMoments[2]; // 7-8
+            VkDescriptorImageInfo historyGeometry[2];// 9-10
+            VkDescriptorImageInfo filter[2];         // 11-12
+        };
+        constexpr uint32_t BINDING_COUNT = 13;
+
+        // What a frame slot's set was last written with (see RtDescriptorState in raytracermanager.cpp)
+        struct DescriptorState
+        {
+            bool written = false;
+            uint32_t outputGeneration = 0;
+            uint32_t gbufferGeneration = 0;
+            uint32_t imageGeneration = 0;
+        };
+
+        VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+        VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        VkDescriptorUpdateTemplate updateTemplate = VK_NULL_HANDLE;
+        VkPipeline temporalPipeline = VK_NULL_HANDLE;
+        VkPipeline atrousPipeline = VK_NULL_HANDLE;
+        std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> descriptorSets{};
+        std::array<DescriptorState, SwapChain::MAX_FRAMES_IN_FLIGHT> descriptorStates{};
+
+        // History ping-pongs between two slots, the filter between two images
+        std::array<RayTracerManager::RTOutput, 2> historyColor{};    // rgb: integrated color, a: history length
+        std::array<RayTracerManager::RTOutput, 2> historyMoments{};  // r: luminance, g: squared luminance
+        std::array<RayTracerManager::RTOutput, 2> historyGeometry{}; // xyz: normal, w: distance to the camera (0 = none)
+        std::array<RayTracerManager::RTOutput, 2> filter{};          // rgb: color, a: luminance variance
+        VkExtent2D imageExtent{0, 0};
+        uint32_t imageGeneration = 0;
+
+        uint32_t currentSlot = 0;
+        bool historyValid = false;
+        glm::mat4 prevViewProjection{1.f};
+        glm::vec3 prevCameraPosition{0.f};
+
+        // Two timestamps around the passes per frame slot, read back when the slot is reused
+        VkQueryPool queryPool = VK_NULL_HANDLE;
+        bool timestampsSupported = true;
+        float timestampPeriodNs = 1.f;
+        std::array<bool, SwapChain::MAX_FRAMES_IN_FLIGHT> slotMeasured{};
+
+        void createQueryPool()
+        {
+            VkPhysicalDeviceProperties properties{};
+            vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+            if (!properties.limits.timestampComputeAndGraphics)
+            {
+                timestampsSupported = false;
+                return;
+            }
+            timestampPeriodNs = properties.limits.timestampPeriod;
+
+            VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryInfo.queryCount = 2 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(g_Device, &queryInfo, nullptr, &queryPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create denoiser timestamp query pool!");
+            }
+        }
+
+        // The fence wait in beginFrame guarantees this slot's last submission finished, so this never blocks
+        void readBackTimings(int frameIndex)
+        {
+            if (queryPool == VK_NULL_HANDLE || !slotMeasured[frameIndex])
+                return;
+            slotMeasured[frameIndex] = false;
+
+            std::array<uint64_t, 2> timestamps{};
+            VkResult result = vkGetQueryPoolResults(g_Device, queryPool, 2 * frameIndex, 2,
+                                                    sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                                    VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS || timestamps[1] < timestamps[0])
+                return;
+            lastFrameGpuMs = static_cast<float>(timestamps[1] - timestamps[0]) * timestampPeriodNs * 1e-6f;
+        }
+
+        void createLayouts()
+        {
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            bindings.push_back({0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}); // rtOutput
+            for (uint32_t i = 1; i <= 4; ++i)
+                bindings.push_back({i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}); // G-buffer
+            for (uint32_t i = 5; i < BINDING_COUNT; ++i)
+                bindings.push_back({i, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr}); // History, filter
+
+            VkDescriptorSetLayoutCreateInfo layoutInfo{};
+            layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+            layoutInfo.pBindings = bindings.data();
+            if (vkCreateDescriptorSetLayout(g_Device, &layoutInfo, nullptr, &setLayout) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create denoiser descriptor set layout!");
+            }
+
+            // Bindings are consecutive VkDescriptorImageInfos in DenoiseDescriptorData
+            std::vector<VkDescriptorUpdateTemplateEntry> entries;
+            for (uint32_t i = 0; i < BINDING_COUNT; ++i)
+            {
+                const VkDescriptorType type = (i >= 1 && i <= 4) ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                entries.push_back({i, 0, 1, type, i * sizeof(VkDescriptorImageInfo), 0});
+            }
+            VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+            templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+            templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+            templateInfo.pDescriptorUpdateEntries = entries.data();
+            templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+            templateInfo.descriptorSetLayout = setLayout;
+            if (vkCreateDescriptorUpdateTemplate(g_Device, &templateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create denoiser descriptor update template!");
+            }
+
+            VkPushConstantRange pushConstantRange{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DenoisePushConstants)};
+            VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+            pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            pipelineLayoutInfo.setLayoutCount = 1;
+            pipelineLayoutInfo.pSetLayouts = &setLayout;
+            pipelineLayoutInfo.pushConstantRangeCount = 1;
+            pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+            if (vkCreatePipelineLayout(g_Device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create denoiser pipeline layout!");
+            }
+        }
+
+        VkPipeline createComputePipeline(const std::string &shaderPath)
+        {
+            VkShaderModule module = RayTracerManager::createShaderModule(shaderPath);
+
+            VkComputePipelineCreateInfo pipelineInfo{};
+            pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            pipelineInfo.stage.module = module;
+            pipelineInfo.stage.pName = "main";
+            pipelineInfo.layout = pipelineLayout;
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            VkResult result = vkCreateComputePipelines(g_Device, g_PipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+            vkDestroyShaderModule(g_Device, module, nullptr);
+            if (result != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create denoiser pipeline (" + shaderPath + ")!");
+            }
+            return pipeline;
+        }
+
+        void createPipelines()
+        {
+#ifdef __APPLE__
+            const std::string temporalShaderPath = "../../../../../../kinesis/assets/shaders/bin/denoise_temporal.comp.spv";
+            const std::string atrousShaderPath = "../../../../../../kinesis/assets/shaders/bin/denoise_atrous.comp.spv";
+#else
+            const std::string temporalShaderPath = "../../../kinesis/assets/shaders/bin/denoise_temporal.comp.spv";
+            const std::string atrousShaderPath = "../../../kinesis/assets/shaders/bin/denoise_atrous.comp.spv";
+#endif
+            createLayouts();
+            temporalPipeline = createComputePipeline(temporalShaderPath);
+            atrousPipeline = createComputePipeline(atrousShaderPath);
+            std::cout << "Denoiser pipelines created." << std::endl;
+        }
+
+        void updateDescriptorSet(int frameIndex)
+        {
+            VkDescriptorSet &set = descriptorSets[frameIndex];
+            if (set == VK_NULL_HANDLE)
+            {
+                VkDescriptorSetAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                allocInfo.descriptorPool = g_DescriptorPool;
+                allocInfo.descriptorSetCount = 1;
+                allocInfo.pSetLayouts = &setLayout;
+                if (vkAllocateDescriptorSets(g_Device, &allocInfo, &set) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to allocate denoiser descriptor set!");
+                }
+            }
+
+            DescriptorState current{true, RayTracerManager::rtOutput.generation, GBuffer::generation, imageGeneration};
+            DescriptorState &last = descriptorStates[frameIndex];
+            if (last.written && last.outputGeneration == current.outputGeneration &&
+                last.gbufferGeneration == current.gbufferGeneration && last.imageGeneration == current.imageGeneration)
+                return; // Nothing changed since this slot was last written
+
+            auto storage = [](const RayTracerManager::RTOutput &image)
+            {
+                return VkDescriptorImageInfo{VK_NULL_HANDLE, image.view, VK_IMAGE_LAYOUT_GENERAL};
+            };
+            DenoiseDescriptorData data{};
+            data.output = storage(RayTracerManager::rtOutput);
+            data.gbuffer[0] = {GBuffer::sampler, GBuffer::positionAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            data.gbuffer[1] = {GBuffer::sampler, GBuffer::normalAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            data.gbuffer[2] = {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            data.gbuffer[3] = {GBuffer::sampler, GBuffer::propertiesAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+            for (uint32_t i = 0; i < 2; ++i)
+            {
+                data.historyColor[i] = storage(historyColor[i]);
+                data.historyMoments[i] = storage(historyMoments[i]);
+                data.historyGeometry[i] = storage(historyGeometry[i]);
+                data.filter[i] = storage(filter[i]);
+            }
+            vkUpdateDescriptorSetWithTemplate(g_Device, set, updateTemplate, &data);
+            last = current;
+        }
+
+        // Shader writes of one pass become visible to the next (all images stay in General layout)
+        void computeBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStages)
+        {
+            VkMemoryBarrier barrier{};
+            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+    }
+
+    void createImages(VkExtent2D extent)
+    {
+        if (temporalPipeline == VK_NULL_HANDLE)
+            createPipelines();
+        destroyImages();
+
+        // Half floats are enough for filtered color, moments and the normal/distance used to validate history
+        const VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            RayTracerManager::createRtImage(historyColor[i], extent, format, VK_IMAGE_USAGE_STORAGE_BIT, "denoiser history color");
+            RayTracerManager::createRtImage(historyMoments[i], extent, format, VK_IMAGE_USAGE_STORAGE_BIT, "denoiser history moments");
+            RayTracerManager::createRtImage(historyGeometry[i], extent, format, VK_IMAGE_USAGE_STORAGE_BIT, "denoiser history geometry");
+            RayTracerManager::createRtImage(filter[i], extent, format, VK_IMAGE_USAGE_STORAGE_BIT, "denoiser filter");
+        }
+        imageExtent = extent;
+        imageGeneration++;
+        historyValid = false; // New images hold no history
+    }
+
+    void destroyImages()
+    {
+        if (g_Device == VK_NULL_HANDLE)
+            return;
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            for (RayTracerManager::RTOutput *image : {&historyColor[i], &historyMoments[i], &historyGeometry[i], &filter[i]})
+            {
+                if (image->image != VK_NULL_HANDLE)
+                    RayTracerManager::destroyRtImage(*image);
+            }
+        }
+        imageExtent = {0, 0};
+        historyValid = false;
+    }
+
+    void record(VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition)
+    {
+        if (!enabled || temporalPipeline == VK_NULL_HANDLE || filter[0].view == VK_NULL_HANDLE ||
+            imageExtent.width != GBuffer::extent.width || imageExtent.height != GBuffer::extent.height)
+        {
+            historyValid = false; // Frames pass without updating it
+            return;
+        }
+
+        if (queryPool == VK_NULL_HANDLE && timestampsSupported)
+            createQueryPool();
+        readBackTimings(frameIndex);
+        updateDescriptorSet(frameIndex);
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, queryPool, 2 * frameIndex, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frameIndex);
+        }
+
+        // rtOutput was written by either trace backend; the history and filter images by last frame's passes
+        computeBarrier(commandBuffer, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+        DenoisePushConstants pushConstants{};
+        pushConstants.prevViewProjection = prevViewProjection;
+        pushConstants.cameraPosition = glm::vec4(cameraPosition, 1.f);
+        pushConstants.prevCameraPosition = glm::vec4(prevCameraPosition, historyValid ? 1.f : 0.f);
+        pushConstants.size = glm::ivec2(imageExtent.width, imageExtent.height);
+        pushConstants.current = currentSlot;
+        pushConstants.temporalAlpha = temporalAlpha;
+        pushConstants.phiColor = phiColor;
+
+        const uint32_t groupsX = (imageExtent.width + GROUP_SIZE - 1) / GROUP_SIZE;
+        const uint32_t groupsY = (imageExtent.height + GROUP_SIZE - 1) / GROUP_SIZE;
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[frameIndex], 0, nullptr);
+
+        // Temporal pass: history -> filter image 0. It reads rtOutput around each pixel, so at least one
+        // a-trous pass is needed to write the result back
+        const int iterations = std::max(atrousIterations, 1);
+        pushConstants.target = 0;
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, temporalPipeline);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DenoisePushConstants), &pushConstants);
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+        // A-trous passes ping-pong between the filter images, the last one writes rtOutput
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, atrousPipeline);
+        uint32_t source = 0;
+        for (int i = 0; i < iterations; ++i)
+        {
+            computeBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            pushConstants.stepSize = 1 << i;
+            pushConstants.source = source;
+            pushConstants.target = (i == iterations - 1) ? OUTPUT_TARGET : 1 - source;
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DenoisePushConstants), &pushConstants);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+            source = 1 - source;
+        }
+
+        if (queryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 2 * frameIndex + 1);
+            slotMeasured[frameIndex] = true;
+        }
+
+        prevViewProjection = viewProjection;
+        prevCameraPosition = cameraPosition;
+        historyValid = true;
+        currentSlot = 1 - currentSlot;
+    }
+
+    void resetHistory() { historyValid = false; }
+
+    void cleanup()
+    {
+        if (g_Device == VK_NULL_HANDLE)
+            return;
+        destroyImages();
+        for (VkPipeline *pipeline : {&temporalPipeline, &atrousPipeline})
+        {
+            if (*pipeline != VK_NULL_HANDLE)
+                vkDestroyPipeline(g_Device, *pipeline, nullptr);
+            *pipeline = VK_NULL_HANDLE;
+        }
+        if (pipelineLayout != VK_NULL_HANDLE)
+            vkDestroyPipelineLayout(g_Device, pipelineLayout, nullptr);
+        pipelineLayout = VK_NULL_HANDLE;
+        if (updateTemplate != VK_NULL_HANDLE)
+            vkDestroyDescriptorUpdateTemplate(g_Device, updateTemplate, nullptr);
+        updateTemplate = VK_NULL_HANDLE;
+        if (setLayout != VK_NULL_HANDLE)
+            vkDestroyDescriptorSetLayout(g_Device, setLayout, nullptr);
+        setLayout = VK_NULL_HANDLE;
+        // Descriptor sets are freed with g_DescriptorPool
+        descriptorSets.fill(VK_NULL_HANDLE);
+        descriptorStates.fill(DescriptorState{});
+        if (queryPool != VK_NULL_HANDLE)
+            vkDestroyQueryPool(g_Device, queryPool, nullptr);
+        queryPool = VK_NULL_HANDLE;
+        timestampsSupported = true;
+        slotMeasured.fill(false);
+        lastFrameGpuMs = 0.f;
+        currentSlot = 0;
+    }
+}
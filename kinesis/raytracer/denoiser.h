@@ -0,0 +1,47 @@
+#ifndef DENOISER_H
+#define DENOISER_H
+
+#include "kinesis.h"
+
+namespace Kinesis::Denoiser
+{
+    extern bool enabled;         // Denoise rtOutput between the RT pass and compositing
+    extern int atrousIterations; // Wavelet passes (at least 1), each doubles the tap distance (1, 2, 4, ... pixels)
+    extern float temporalAlpha;  // Minimum weight of the new frame in the temporal average
+    extern float phiColor;       // Luminance edge-stopping, in standard deviations of the estimated variance
+    extern float lastFrameGpuMs; // Measured GPU time of the denoiser passes
+
+    /**
+     * @brief Creates the history and filter images for an extent (and the compute pipelines on first use).
+     * Called by RayTracerManager::createRtOutputImage, the denoiser works on rtOutput in place.
+     */
+    void createImages(VkExtent2D extent);
+
+    /**
+     * @brief Retires the images (frames in flight may still use them); the history starts over.
+     */
+    void destroyImages();
+
+    /**
+     * @brief Records the denoiser after traceRays, before rtOutput is transitioned for compositing.
+     * Temporal pass: reprojects last frame's history with the G-buffer position, rejects it where the
+     * geometry doesn't match, clamps it to the current neighbourhood and integrates color and luminance
+     * moments (variance). Then atrousIterations edge-aware a-trous passes guided by normal, position,
+     * albedo and luminance variance; the last one writes rtOutput.
+     * Only pixels the RT pass shades (metal, dielectric) are filtered.
+     * @param viewProjection This frame's camera, kept to reproject the next frame.
+     */
+    void record(VkCommandBuffer commandBuffer, int frameIndex, const glm::mat4 &viewProjection, const glm::vec3 &cameraPosition);
+
+    /**
+     * @brief Drops the history, e.g. after a camera cut.
+     */
+    void resetHistory();
+
+    /**
+     * @brief Destroys pipelines, layouts and images. The device must be idle.
+     */
+    void cleanup();
+}
+
+#endif // DENOISER_H
@@ -0,0 +1,231 @@
+// kinesis/raytracer/lightlist.cpp
+#include "raytracer/lightlist.h"
+#include "raytracer/accumulation.h"
+#include "gameobject.h"
+#include "mesh/mesh.h"
+#include "mesh/material.h"
+#include "mesh/vertex.h"
+#include "buffer.h"
+#include "deletionqueue.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace Kinesis::LightList
+{
+    bool enabled = true;
+
+    namespace
+    {
+        // Must match LightTriangle in rtpath.glsl (std430, 80 bytes)
+        struct GpuLight
+        {
+            glm::vec4 position0;   // xyz, w = area
+            glm::vec4 position1;   // xyz, w = selection probability (power / total power)
+            glm::vec4 position2;   // xyz, w = alias table: probability of keeping this entry
+            glm::vec4 emission;    // rgb
+            uint32_t alias;        // Entry taken otherwise
+            uint32_t _pad[3];
+        };
+        static_assert(sizeof(GpuLight) == 80, "GpuLight must match the shader struct");
+
+        // Must match the header of LightListBuffer in rtpath.glsl
+        struct GpuHeader
+        {
+            uint32_t count;
+            float totalPower;
+            uint32_t _pad[2];
+        };
+        static_assert(sizeof(GpuHeader) == 16, "GpuHeader must match the shader block");
+
+        // What the list was last built from, one entry per emissive object
+        struct LightSource
+        {
+            size_t objectIndex;
+            glm::mat4 transform;
+            uint32_t vertexGeneration;
+            bool operator==(const LightSource &o) const
+            {
+                return objectIndex == o.objectIndex && transform == o.transform && vertexGeneration == o.vertexGeneration;
+            }
+        };
+
+        std::unique_ptr<Buffer> lightBuffer = nullptr;
+        std::vector<LightSource> builtFrom;
+        std::vector<LightSource> sources; // Scratch for update(), cleared rather than freed since it runs every frame
+        uint32_t generation = 0;
+        uint32_t lightCount = 0;
+        float totalPower = 0.f;
+
+        float luminance(const glm::vec3 &c)
+        {
+            return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f)); // Same weights as the shaders
+        }
+
+        // Material the RT pass shades a triangle with. Meshes carry no per-primitive material ids, so like the
+        // material buffer built in kinesis.cpp this is the mesh's first material; nullptr when it has none
+        const Mesh::Material *triangleMaterial(const Mesh::Mesh &mesh, size_t /*triangle*/)
+        {
+            const auto &materials = mesh.getMaterials();
+            return materials.empty() ? nullptr : materials[0];
+        }
+
+        bool isLight(const Mesh::Material *material)
+        {
+            return material && material->getType() == Mesh::MaterialType::LIGHT;
+        }
+
+        bool isEmissive(GameObject &go)
+        {
+            if (!go.model || !go.model->isResident())
+                return false; // Evicted objects aren't in the TLAS either, their light would come from nowhere
+            const Mesh::Mesh *mesh = go.model->getMesh();
+            for (const Mesh::Material *material : mesh->getMaterials())
+            {
+                if (isLight(material))
+                    return true; // Which triangles actually emit is decided per triangle in update()
+            }
+            return false;
+        }
+
+        // Vose's alias method: entry i is kept with probability position2.w, otherwise alias is taken,
+        // which together selects every entry in proportion to its power
+        void buildAliasTable(std::vector<GpuLight> &lights, const std::vector<float> &power, float total)
+        {
+            const size_t n = lights.size();
+            std::vector<float> scaled(n);
+            std::vector<uint32_t> small, large;
+            for (size_t i = 0; i < n; ++i)
+            {
+                scaled[i] = power[i] * static_cast<float>(n) / total;
+                (scaled[i] < 1.f ? small : large).push_back(static_cast<uint32_t>(i));
+            }
+            while (!small.empty() && !large.empty())
+            {
+                uint32_t s = small.back();
+                small.pop_back();
+                uint32_t l = large.back();
+                large.pop_back();
+                lights[s].position2.w = scaled[s];
+                lights[s].alias = l;
+                scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+                (scaled[l] < 1.f ? small : large).push_back(l);
+            }
+            // Leftovers are 1 up to rounding
+            for (uint32_t i : small)
+            {
+                lights[i].position2.w = 1.f;
+                lights[i].alias = i;
+            }
+            for (uint32_t i : large)
+            {
+                lights[i].position2.w = 1.f;
+                lights[i].alias = i;
+            }
+        }
+    }
+
+    void update()
+    {
+        sources.clear();
+        for (size_t i = 0; i < gameObjects.size(); ++i)
+        {
+            if (isEmissive(gameObjects[i]))
+                sources.push_back({i, gameObjects[i].transform.mat4(), gameObjects[i].model->getVertexGeneration()});
+        }
+        if (lightBuffer && sources == builtFrom)
+            return;
+
+        // --- World space triangles ---
+        std::vector<GpuLight> lights;
+        std::vector<float> power;
+        totalPower = 0.f;
+        for (const LightSource &source : sources)
+        {
+            const Mesh::Mesh *mesh = gameObjects[source.objectIndex].model->getMesh();
+            const auto &vertices = mesh->getVertices();
+            const auto &indices = mesh->getIndices();
+            // Non-indexed meshes get a sequential index list in the pool, so the BLAS sees consecutive vertex triples
+            const size_t triangleCount = (mesh->hasIndices() ? indices.size() : vertices.size()) / 3;
+            auto vertexOf = [&](size_t corner)
+            { return mesh->hasIndices() ? static_cast<size_t>(indices[corner]) : corner; };
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                const Mesh::Material *material = triangleMaterial(*mesh, t);
+                if (!isLight(material))
+                    continue;
+                const glm::vec3 emission = material->getEmittedColor();
+
+                glm::vec3 p0 = glm::vec3(source.transform * glm::vec4(vertices[vertexOf(3 * t + 0)].position, 1.f));
+                glm::vec3 p1 = glm::vec3(source.transform * glm::vec4(vertices[vertexOf(3 * t + 1)].position, 1.f));
+                glm::vec3 p2 = glm::vec3(source.transform * glm::vec4(vertices[vertexOf(3 * t + 2)].position, 1.f));
+                float area = 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0));
+                float trianglePower = luminance(emission) * area;
+                if (!(trianglePower > 0.f))
+                    continue; // Degenerate or black, never picked anyway
+
+                GpuLight light{};
+                light.position0 = glm::vec4(p0, area);
+                light.position1 = glm::vec4(p1, 0.f);
+                light.position2 = glm::vec4(p2, 1.f);
+                light.emission = glm::vec4(emission, 0.f);
+                light.alias = static_cast<uint32_t>(lights.size());
+                lights.push_back(light);
+                power.push_back(trianglePower);
+                totalPower += trianglePower;
+            }
+        }
+        for (size_t i = 0; i < lights.size(); ++i)
+            lights[i].position1.w = power[i] / totalPower;
+        if (!lights.empty())
+            buildAliasTable(lights, power, totalPower);
+        lightCount = static_cast<uint32_t>(lights.size());
+
+        // --- Upload into a new buffer, frames in flight keep reading the old one ---
+        if (lightBuffer)
+        {
+            Buffer *retired = lightBuffer.release();
+            DeletionQueue::retire([retired]()
+                                  { delete retired; });
+        }
+        const VkDeviceSize size = sizeof(GpuHeader) + sizeof(GpuLight) * std::max<size_t>(lights.size(), 1);
+        lightBuffer = std::make_unique<Buffer>(
+            size, 1,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        lightBuffer->map();
+        auto *mapped = static_cast<uint8_t *>(lightBuffer->getMappedMemory());
+        memset(mapped, 0, static_cast<size_t>(size));
+        GpuHeader header{lightCount, totalPower, {0, 0}};
+        memcpy(mapped, &header, sizeof(header));
+        if (!lights.empty())
+            memcpy(mapped + sizeof(GpuHeader), lights.data(), sizeof(GpuLight) * lights.size());
+
+        builtFrom.swap(sources); // Both keep their capacity for the next frames
+        ++generation;
+        Accumulation::reset(); // Lights moved, appeared or went away
+        std::cout << "Light list rebuilt: " << lightCount << " emissive triangles from " << builtFrom.size()
+                  << " objects, total power " << totalPower << std::endl;
+    }
+
+    VkDescriptorBufferInfo descriptorInfo()
+    {
+        return lightBuffer ? lightBuffer->descriptorInfo() : VkDescriptorBufferInfo{VK_NULL_HANDLE, 0, VK_WHOLE_SIZE};
+    }
+
+    uint32_t getGeneration() { return generation; }
+    uint32_t getLightCount() { return lightCount; }
+    float getTotalPower() { return totalPower; }
+
+    void cleanup()
+    {
+        lightBuffer.reset();
+        builtFrom.clear();
+        lightCount = 0;
+        totalPower = 0.f;
+        ++generation;
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LIGHTLIST_H
+#define LIGHTLIST_H
+
+#include "kinesis.h"
+
+namespace Kinesis::LightList
+{
+    extern bool enabled; // Next-event estimation: sample a light at every diffuse and rough bounce of the RT pass
+
+    /**
+     * @brief Rebuilds the list when an emissive object was added, removed, moved, deformed or evicted since
+     * the last call. Every triangle whose material is Mesh::MaterialType::LIGHT becomes a world space
+     * light (indexed or not); a power-weighted alias table (emitted luminance x area) picks them in O(1) on the GPU.
+     * The buffer is replaced, not rewritten, since frames in flight may still read the old one.
+     * Called by RayTracerManager::allocateAndUpdateRtDescriptorSet before it writes the descriptor set.
+     */
+    void update();
+
+    /**
+     * @brief The current list for the RT descriptor set (binding 15, LightListBuffer in rtpath.glsl).
+     * Valid after update(), also when the scene has no lights (count 0).
+     */
+    VkDescriptorBufferInfo descriptorInfo();
+
+    uint32_t getGeneration(); // Bumped whenever the buffer is replaced
+    uint32_t getLightCount(); // Emissive triangles in the list
+    float getTotalPower();    // Sum of emitted luminance x area over the list
+
+    /**
+     * @brief Destroys the buffer. The device must be idle.
+     */
+    void cleanup();
+}
+
+#endif // LIGHTLIST_H
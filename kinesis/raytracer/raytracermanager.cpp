@@ -3,21 +3,37 @@
 #include <stdexcept>
 #include <vector>
 #include <array>
+#include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <cstddef> // offsetof
+#include <cstring>
 #include <fstream>
 #include <filesystem>
+#include <future>
+#include <chrono>
+#include <unordered_map>
 
 #include "kinesis.h" // Include kinesis.h for globals like g_Device, g_Allocator etc.
 #include "RayTracerManager.h"
 #include "GUI.h"
 #include "mesh/mesh.h"   // Needed for geometry info
+#include "mesh/material.h" // Material model selects the hit group
 #include "mesh/vertex.h" // Include Vertex definition
 #include "gameobject.h"  // Needed for gameObjects global
 #include "window.h"      // For createBuffer, findMemoryType, etc.
 #include "pipeline.h"    // For readFile
 #include "buffer.h"
 #include "gbuffer.h" // For GBuffer data access in descriptor update
+#include "geometrypool.h" // Shared vertex/index buffers
+#include "deletionqueue.h" // Deferred destruction of AS/buffers still used by frames in flight
+#include "swapchain.h"    // MAX_FRAMES_IN_FLIGHT
+#include "bindlessheap.h" // Set 2: geometry and material buffers
+#include "raytracer/asbuildscheduler.h" // Queued BLAS builds, dropped on cleanup
+#include "raytracer/blascache.h"       // Serialized BLAS on disk
+#include "raytracer/lightlist.h"       // Emissive triangles for next-event estimation
+#include "raytracer/accumulation.h"    // Progressive accumulation of the RT output
+#include "raytracer/denoiser.h"        // Owns images sized like rtOutput
 
 // --- Function Pointers for KHR Extensions ---
 // Declare function pointers using a prefix (e.g., pfn) to avoid name conflicts
@@ -30,11 +46,16 @@ PFN_vkDestroyAccelerationStructureKHR pfnDestroyAccelerationStructureKHR = nullp
 PFN_vkGetAccelerationStructureBuildSizesKHR pfnGetAccelerationStructureBuildSizesKHR = nullptr;
 PFN_vkGetAccelerationStructureDeviceAddressKHR pfnGetAccelerationStructureDeviceAddressKHR = nullptr;
 PFN_vkCmdTraceRaysKHR pfnCmdTraceRaysKHR = nullptr;
+PFN_vkCmdTraceRaysIndirectKHR pfnCmdTraceRaysIndirectKHR = nullptr; // Optional (rayTracingPipelineTraceRaysIndirect)
 PFN_vkGetRayTracingShaderGroupHandlesKHR pfnGetRayTracingShaderGroupHandlesKHR = nullptr;
 PFN_vkCreateRayTracingPipelinesKHR pfnCreateRayTracingPipelinesKHR = nullptr;
 // Add others if needed (e.g., copy/query functions)
 PFN_vkCmdWriteAccelerationStructuresPropertiesKHR pfnCmdWriteAccelerationStructuresPropertiesKHR = nullptr;
 PFN_vkCopyAccelerationStructureKHR pfnCopyAccelerationStructureKHR = nullptr;
+PFN_vkCmdCopyAccelerationStructureKHR pfnCmdCopyAccelerationStructureKHR = nullptr;
+PFN_vkCmdCopyAccelerationStructureToMemoryKHR pfnCmdCopyAccelerationStructureToMemoryKHR = nullptr;
+PFN_vkCmdCopyMemoryToAccelerationStructureKHR pfnCmdCopyMemoryToAccelerationStructureKHR = nullptr;
+PFN_vkGetDeviceAccelerationStructureCompatibilityKHR pfnGetDeviceAccelerationStructureCompatibilityKHR = nullptr;
 
 namespace Kinesis::RayTracerManager
 {
@@ -42,10 +63,14 @@ namespace Kinesis::RayTracerManager
     // --- Define static/global variables declared extern in the header ---
     VkDescriptorSetLayout rtDescriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout rtPipelineLayout = VK_NULL_HANDLE;
-    VkDescriptorSet rtDescriptorSet = VK_NULL_HANDLE; // Will be allocated per frame or updated
+    VkDescriptorSet rtDescriptorSet = VK_NULL_HANDLE; // The current frame slot's set (see rtDescriptorSets)
+    uint32_t tlasGeneration = 0;
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR rt_pipeline_properties{};
     VkPhysicalDeviceAccelerationStructureFeaturesKHR as_features{};
-    std::vector<AccelerationStructure> blas;
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR as_properties{};
+    bool compactBlas = true;
+    VkDeviceSize blasCompactionSavedBytes = 0;
+    std::unordered_map<const Model *, AccelerationStructure> blas;
     AccelerationStructure tlas{};
     VkBuffer instances_buffer = VK_NULL_HANDLE;
     VkDeviceMemory instances_buffer_memory = VK_NULL_HANDLE;
@@ -56,10 +81,184 @@ namespace Kinesis::RayTracerManager
     ShaderBindingTableEntry chitSBT{};
     ShaderBindingTableEntry callableSBT{};
     RTOutput rtOutput = {}; // Default initialize
+    RTOutput rtAccumulation = {};
+    // Adaptive sampling images, created and destroyed with rtOutput
+    RTOutput rtStatistics{};   // Per-pixel luminance moments of recent samples
+    RTOutput rtSampleBudget{}; // Samples per pixel for the next frame (+1, 0 = none yet)
+    // Compacted dispatch pixel list, sized for every pixel of rtOutput.
+    // Header of RtPixelList in rtcommon.glsl; the entries (one uint per pixel) follow it
+    constexpr VkDeviceSize PIXEL_LIST_TRACE_ARGS_OFFSET = 0;     // VkTraceRaysIndirectCommandKHR
+    constexpr VkDeviceSize PIXEL_LIST_DISPATCH_ARGS_OFFSET = 12; // VkDispatchIndirectCommand
+    constexpr VkDeviceSize PIXEL_LIST_COUNT_OFFSET = 24;
+    constexpr VkDeviceSize PIXEL_LIST_HEADER_SIZE = 32;
+    struct PixelListBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceAddress address = 0; // For vkCmdTraceRaysIndirectKHR
+        VkDeviceSize size = 0;
+    } rtPixelList;
+    // ReSTIR reservoirs, two per pixel of rtOutput
+    constexpr VkDeviceSize RESERVOIR_SIZE = 24; // Reservoir in rtrestir.glsl
+    struct ReservoirBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+    } rtReservoirs;
+    bool restirHistoryValid = false; // Cleared when rtReservoirs is recreated
+
+    // createRayTracingPipeline() running on a worker thread, joined by waitForPipeline()
+    std::future<void> pipelineTask;
+
+    // Upper bound for the scratch memory one batch of BLAS builds may use at once
+    constexpr VkDeviceSize BLAS_SCRATCH_BUDGET = 64ull * 1024 * 1024;
+
+    // Stages that read the TLAS and write the RT output: the ray tracing pipeline and the ray query (compute) backend
+    constexpr VkPipelineStageFlags TRACE_STAGES = VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    // Shaders that run the per-pixel loop (rtpath.glsl) and read its push constants
+    constexpr VkShaderStageFlags TRACE_PUSH_STAGES = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT;
 
     // Command pool for builds (can be specific to RTManager or shared)
     VkCommandPool buildCommandPool = VK_NULL_HANDLE; // Needs definition
 
+    // Per-object bindless handles and ranges, indexed by gl_InstanceCustomIndexEXT (binding 9).
+    // The buffer handles index the BindlessHeap's storage buffer array (set 2).
+    struct InstanceData
+    {
+        uint32_t vertexBuffer;   // Heap handle of the vertex buffer
+        uint32_t indexBuffer;    // Heap handle of the index buffer
+        uint32_t vertexOffset;   // Range inside those buffers
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t materialBuffer; // Heap handle of the material buffer
+        uint32_t materialIndex;  // Element in it
+        uint32_t _pad;
+    };
+    std::unique_ptr<Buffer> instanceDataBuffer = nullptr;
+
+    // --- Per-frame TLAS updates (see updateTlas) ---
+    int tlasRebuildInterval = 120;
+    uint32_t tlasUpdatedInstancesLastFrame = 0;
+    uint64_t tlasUpdateCount = 0;
+    uint64_t tlasRebuildCount = 0;
+    // Object index of every TLAS instance, in instance buffer order, and the records last uploaded for them
+    std::vector<uint32_t> tlasInstanceObjects;
+    std::vector<VkAccelerationStructureInstanceKHR> tlasInstanceRecords;
+    ScratchBuffer tlasScratch{}; // Persistent, large enough for a full build and for an update
+    bool tlasAllowsUpdate = false;
+    uint32_t tlasUpdatesSinceRebuild = 0;
+    // Host-visible staging for changed instance records, one per frame slot (sized for MAX_SCENE_OBJECTS)
+    std::array<std::unique_ptr<Buffer>, SwapChain::MAX_FRAMES_IN_FLIGHT> instanceStaging{};
+    std::vector<VkBufferCopy> instanceCopies; // Reused every frame so updates don't allocate
+    uint32_t tlasInstanceCapacity = 0;        // Instances the TLAS, its instance buffer and scratch were sized for
+    bool tlasInstancesDirty = false;          // Set by markTlasInstancesDirty; updateTlas then rebuilds the instance list
+
+    // --- Dynamic BLAS refits (see refitDynamicBlas) ---
+    int blasRefitLimit = 60;
+    float blasRebuildBoundsGrowth = 1.5f;
+    uint32_t blasRefitsLastFrame = 0;
+    uint32_t blasRebuildsLastFrame = 0;
+    struct DynamicBlasState
+    {
+        uint32_t vertexGeneration = 0; // Model::getVertexGeneration() the BLAS was last built/refit from
+        uint32_t refitCount = 0;       // Refits since the last full build
+        float builtRadius = 0.f;       // Bounds radius at the last full build
+        VkDeviceSize buildScratchSize = 0;
+        VkDeviceSize updateScratchSize = 0;
+        uint32_t primitiveCount = 0;
+    };
+    std::unordered_map<const Model *, DynamicBlasState> dynamicBlasStates;
+    ScratchBuffer refitScratch{}; // Grows to the summed scratch of every dynamic BLAS
+    VkDeviceSize refitScratchSize = 0;
+    bool blasContentChanged = false; // Set by refitDynamicBlas, makes updateTlas refit the TLAS too
+    // Reused every frame so refits don't allocate
+    std::vector<VkAccelerationStructureGeometryKHR> refitGeometries;
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> refitInfos;
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> refitRanges;
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> refitRangePtrs;
+
+    // --- In-frame BLAS builds (see recordBlasBuilds, driven by ASBuildScheduler) ---
+    ScratchBuffer scheduledScratch{}; // Grows to the summed scratch of the largest set of builds recorded in one frame
+    VkDeviceSize scheduledScratchSize = 0;
+
+    // Everything a BLAS build command needs; it has to stay alive until the command is recorded
+    struct PendingBuild
+    {
+        Model *model = nullptr;
+        VkAccelerationStructureGeometryKHR geometry{};
+        VkAccelerationStructureBuildGeometryInfoKHR buildInfo{};
+        VkAccelerationStructureBuildRangeInfoKHR rangeInfo{};
+        VkDeviceSize scratchSize = 0;
+        bool compactable = false; // Built with ALLOW_COMPACTION
+        AccelerationStructure blasEntry{};
+    };
+
+    // Reused every frame so scheduled builds don't allocate (see recordBlasBuilds)
+    std::vector<PendingBuild> scheduledBuilds;
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> scheduledInfos;
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> scheduledRangePtrs;
+
+    VkTransformMatrixKHR toTransformMatrix(const glm::mat4 &modelMatrix)
+    {
+        // Vulkan expects row-major 3x4, glm is column-major, so transpose and keep the first three rows
+        VkTransformMatrixKHR transform;
+        glm::mat4 transposed = glm::transpose(modelMatrix);
+        memcpy(&transform, &transposed, sizeof(VkTransformMatrixKHR));
+        return transform;
+    }
+
+    // What the instance table was last written from
+    struct InstanceTableState
+    {
+        uint32_t rangeGeneration = UINT32_MAX; // GeometryPool::getRangeGeneration()
+        size_t objectCount = 0;
+        uint32_t vertexBuffer = BindlessHeap::INVALID_HANDLE;
+        uint32_t indexBuffer = BindlessHeap::INVALID_HANDLE;
+        uint32_t materialBuffer = BindlessHeap::INVALID_HANDLE;
+    };
+    InstanceTableState instanceTableState{};
+
+    // Everything written into the RT descriptor set, laid out for rtUpdateTemplate
+    struct RtDescriptorData
+    {
+        VkAccelerationStructureKHR tlas;        // 0
+        VkDescriptorImageInfo output;           // 1
+        VkDescriptorImageInfo gbuffer[4];       // 3-6
+        VkDescriptorBufferInfo instances;       // 9
+        VkDescriptorImageInfo accumulation;     // 10
+        VkDescriptorImageInfo statistics;       // 11
+        VkDescriptorImageInfo sampleBudget;     // 12
+        VkDescriptorBufferInfo budgetTotals;    // 13
+        VkDescriptorBufferInfo pixelList;       // 14
+        VkDescriptorBufferInfo lights;          // 15
+        VkDescriptorBufferInfo reservoirs;      // 16
+    };
+
+    // What a frame slot's set was last written with. Generations instead of raw handles, since a
+    // destroyed handle value can be handed out again for a new resource.
+    struct RtDescriptorState
+    {
+        bool written = false;
+        VkAccelerationStructureKHR tlas = VK_NULL_HANDLE;
+        uint32_t tlasGeneration = 0;
+        uint32_t outputGeneration = 0;
+        uint32_t gbufferGeneration = 0;
+        uint32_t lightGeneration = 0;
+
+        bool operator==(const RtDescriptorState &o) const
+        {
+            return written == o.written && tlas == o.tlas && tlasGeneration == o.tlasGeneration &&
+                   outputGeneration == o.outputGeneration && gbufferGeneration == o.gbufferGeneration &&
+                   lightGeneration == o.lightGeneration;
+        }
+    };
+
+    // One set per frame in flight: a slot's set is only rewritten after its fence was waited on
+    std::array<VkDescriptorSet, SwapChain::MAX_FRAMES_IN_FLIGHT> rtDescriptorSets{};
+    std::array<RtDescriptorState, SwapChain::MAX_FRAMES_IN_FLIGHT> rtDescriptorStates{};
+    VkDescriptorUpdateTemplate rtUpdateTemplate = VK_NULL_HANDLE;
+
     // --- Helper Functions ---
     uint64_t getBufferDeviceAddress(VkBuffer buffer)
     {
@@ -96,7 +295,7 @@ namespace Kinesis::RayTracerManager
 
         // Use the global buffer creation helper
         Kinesis::Window::createBuffer(size, bufferInfo.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                      scratchBuffer.buffer, scratchBuffer.memory);
+                                      scratchBuffer.buffer, scratchBuffer.memory, MemoryBudget::Category::Staging);
         // Get address using the loaded function pointer (via helper)
         scratchBuffer.address = getBufferDeviceAddress(scratchBuffer.buffer);
         return scratchBuffer;
@@ -113,6 +312,7 @@ namespace Kinesis::RayTracerManager
         }
         if (scratch_buffer.memory != VK_NULL_HANDLE)
         {
+            MemoryBudget::untrack(scratch_buffer.memory);
             vkFreeMemory(g_Device, scratch_buffer.memory, nullptr);
             scratch_buffer.memory = VK_NULL_HANDLE;
         }
@@ -124,28 +324,32 @@ namespace Kinesis::RayTracerManager
         if (g_Device == VK_NULL_HANDLE)
             return; // Avoid calls if device is null
 
-        // Use the loaded function pointer (with pfn prefix)
-        if (!pfnDestroyAccelerationStructureKHR)
-        {
-            std::cerr << "Warning: vkDestroyAccelerationStructureKHR function pointer not loaded. Cannot destroy Acceleration Structure." << std::endl;
-        }
-        else if (acceleration_structure.structure != VK_NULL_HANDLE)
+        // Frames in flight may still trace against this AS (directly or through a TLAS),
+        // so the handles are retired and destroyed once those frames have finished.
+        VkAccelerationStructureKHR structure = acceleration_structure.structure;
+        if (structure != VK_NULL_HANDLE)
         {
-            pfnDestroyAccelerationStructureKHR(g_Device, acceleration_structure.structure, nullptr);
-            acceleration_structure.structure = VK_NULL_HANDLE;
+            if (!pfnDestroyAccelerationStructureKHR)
+            {
+                // Use the loaded function pointer (with pfn prefix)
+                std::cerr << "Warning: vkDestroyAccelerationStructureKHR function pointer not loaded. Cannot destroy Acceleration Structure." << std::endl;
+            }
+            else
+            {
+                DeletionQueue::retire([structure]()
+                                      {
+                                          if (g_Device != VK_NULL_HANDLE)
+                                              pfnDestroyAccelerationStructureKHR(g_Device, structure, nullptr); });
+            }
         }
+        // Retired after the AS so it is destroyed before its backing buffer
+        DeletionQueue::retireBuffer(acceleration_structure.buffer, acceleration_structure.memory);
 
-        if (acceleration_structure.buffer != VK_NULL_HANDLE)
-        {
-            vkDestroyBuffer(g_Device, acceleration_structure.buffer, nullptr);
-            acceleration_structure.buffer = VK_NULL_HANDLE;
-        }
-        if (acceleration_structure.memory != VK_NULL_HANDLE)
-        {
-            vkFreeMemory(g_Device, acceleration_structure.memory, nullptr);
-            acceleration_structure.memory = VK_NULL_HANDLE;
-        }
+        acceleration_structure.structure = VK_NULL_HANDLE;
+        acceleration_structure.buffer = VK_NULL_HANDLE;
+        acceleration_structure.memory = VK_NULL_HANDLE;
         acceleration_structure.address = 0;
+        acceleration_structure.size = 0;
     }
 
     VkShaderModule createShaderModule(const std::string &filePath)
@@ -181,65 +385,65 @@ namespace Kinesis::RayTracerManager
         return shaderModule;
     }
 
-    void createRtOutputImage(VkExtent2D extent)
+    void createRtImage(RTOutput &target, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const char *name)
     {
-        destroyRtOutputImage(); // Clean up existing if any
-
-        rtOutput.format = VK_FORMAT_R16G16B16A16_SFLOAT; // Use HDR format
+        target.format = format;
 
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
-        imageInfo.format = rtOutput.format;
+        imageInfo.format = target.format;
         imageInfo.extent = {extent.width, extent.height, 1};
         imageInfo.mipLevels = 1;
         imageInfo.arrayLayers = 1;
         imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        // Needs to be Storage image for RGen shader and Sampled for composition pass
-        imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT; // Add Transfer Src if needed for blitting/copying
+        imageInfo.usage = usage;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-        if (vkCreateImage(g_Device, &imageInfo, nullptr, &rtOutput.image) != VK_SUCCESS)
+        if (vkCreateImage(g_Device, &imageInfo, nullptr, &target.image) != VK_SUCCESS)
         {
-            throw std::runtime_error("Failed to create RT output image!");
+            throw std::runtime_error(std::string("Failed to create ") + name + " image!");
         }
 
         VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(g_Device, rtOutput.image, &memRequirements);
+        vkGetImageMemoryRequirements(g_Device, target.image, &memRequirements);
 
         VkMemoryAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
         allocInfo.allocationSize = memRequirements.size;
         allocInfo.memoryTypeIndex = Kinesis::Window::findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-        if (vkAllocateMemory(g_Device, &allocInfo, nullptr, &rtOutput.memory) != VK_SUCCESS)
+        if (vkAllocateMemory(g_Device, &allocInfo, nullptr, &target.memory) != VK_SUCCESS)
         {
-            vkDestroyImage(g_Device, rtOutput.image, nullptr); // Cleanup
-            rtOutput.image = VK_NULL_HANDLE;
-            throw std::runtime_error("Failed to allocate RT output image memory!");
+            vkDestroyImage(g_Device, target.image, nullptr); // Cleanup
+            target.image = VK_NULL_HANDLE;
+            throw std::runtime_error(std::string("Failed to allocate ") + name + " image memory!");
         }
-        vkBindImageMemory(g_Device, rtOutput.image, rtOutput.memory, 0);
+        vkBindImageMemory(g_Device, target.image, target.memory, 0);
+        MemoryBudget::track(target.memory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, MemoryBudget::Category::RTOutput);
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        viewInfo.image = rtOutput.image;
+        viewInfo.image = target.image;
         viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-        viewInfo.format = rtOutput.format;
+        viewInfo.format = target.format;
         viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         viewInfo.subresourceRange.baseMipLevel = 0;
         viewInfo.subresourceRange.levelCount = 1;
         viewInfo.subresourceRange.baseArrayLayer = 0;
         viewInfo.subresourceRange.layerCount = 1;
 
-        if (vkCreateImageView(g_Device, &viewInfo, nullptr, &rtOutput.view) != VK_SUCCESS)
+        if (vkCreateImageView(g_Device, &viewInfo, nullptr, &target.view) != VK_SUCCESS)
         {
-            vkDestroyImage(g_Device, rtOutput.image, nullptr); // Cleanup
-            vkFreeMemory(g_Device, rtOutput.memory, nullptr);  // Cleanup
-            rtOutput.image = VK_NULL_HANDLE;
-            rtOutput.memory = VK_NULL_HANDLE;
-            throw std::runtime_error("Failed to create RT output image view!");
+            vkDestroyImage(g_Device, target.image, nullptr); // Cleanup
+            MemoryBudget::untrack(target.memory);
+            vkFreeMemory(g_Device, target.memory, nullptr);  // Cleanup
+            target.image = VK_NULL_HANDLE;
+            target.memory = VK_NULL_HANDLE;
+            throw std::runtime_error(std::string("Failed to create ") + name + " image view!");
         }
+        target.generation++;
 
         // Transition image layout to General for storage image usage
         VkCommandBuffer cmdBuf = beginSingleTimeCommands();
@@ -249,47 +453,92 @@ namespace Kinesis::RayTracerManager
         barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL; // Layout for storage image access
         barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
         barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = rtOutput.image;
+        barrier.image = target.image;
         barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         barrier.subresourceRange.baseMipLevel = 0;
         barrier.subresourceRange.levelCount = 1;
         barrier.subresourceRange.baseArrayLayer = 0;
         barrier.subresourceRange.layerCount = 1;
         barrier.srcAccessMask = 0;                          // No need to wait for previous writes
-        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT; // Prepare for shader writes
+        barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT; // Prepare for shader writes (or the clear)
 
         vkCmdPipelineBarrier(
             cmdBuf,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,            // Source stage
-            VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, // Destination stage
+            TRACE_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, // Destination stage (shaders, or the clear below)
             0,
             0, nullptr,
             0, nullptr,
             1, &barrier);
+
+        // Images that are read before anything wrote them (e.g. the sample statistics) start at zero
+        if (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+        {
+            VkClearColorValue zero{};
+            vkCmdClearColorImage(cmdBuf, target.image, VK_IMAGE_LAYOUT_GENERAL, &zero, 1, &barrier.subresourceRange);
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, TRACE_STAGES, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
         endSingleTimeCommands(cmdBuf);
 
-        std::cout << "RT Output Image created and transitioned to General layout." << std::endl;
+        std::cout << "RT " << name << " image created and transitioned to General layout." << std::endl;
+    }
+
+    void createRtOutputImage(VkExtent2D extent)
+    {
+        destroyRtOutputImage(); // Clean up existing if any
+
+        // Needs to be Storage image for RGen shader and Sampled for composition pass
+        createRtImage(rtOutput, extent, VK_FORMAT_R16G16B16A16_SFLOAT, // Use HDR format
+                      VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, "output");
+        // Running average across frames, full float so late frames (weight 1/n) still register.
+        // Only the RT pass touches it, so it stays in General layout.
+        createRtImage(rtAccumulation, extent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT, "accumulation");
+        // Adaptive sampling reads both before anything wrote them, so they are cleared (transfer dst)
+        createRtImage(rtStatistics, extent, VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, "sample statistics");
+        createRtImage(rtSampleBudget, extent, VK_FORMAT_R32_UINT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, "sample budget");
+
+        // Room for every pixel; the header holds the count and the indirect arguments
+        rtPixelList.size = PIXEL_LIST_HEADER_SIZE + sizeof(uint32_t) * VkDeviceSize(extent.width) * extent.height;
+        Kinesis::Window::createBuffer(rtPixelList.size,
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, rtPixelList.buffer, rtPixelList.memory, MemoryBudget::Category::RTOutput);
+        rtPixelList.address = getBufferDeviceAddress(rtPixelList.buffer);
+        // Two reservoirs per pixel (temporal and final set); nothing in them is valid yet
+        rtReservoirs.size = 2 * RESERVOIR_SIZE * VkDeviceSize(extent.width) * extent.height;
+        Kinesis::Window::createBuffer(rtReservoirs.size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, rtReservoirs.buffer, rtReservoirs.memory, MemoryBudget::Category::RTOutput);
+        restirHistoryValid = false;
+        Accumulation::reset();
+        Denoiser::createImages(extent); // Denoises rtOutput in place, same size
     }
 
     void destroyRtOutputImage()
     {
         if (g_Device == VK_NULL_HANDLE)
             return; // Avoid calls if device is null
-        if (rtOutput.view != VK_NULL_HANDLE)
-        {
-            vkDestroyImageView(g_Device, rtOutput.view, nullptr);
-            rtOutput.view = VK_NULL_HANDLE;
-        }
-        if (rtOutput.image != VK_NULL_HANDLE)
-        {
-            vkDestroyImage(g_Device, rtOutput.image, nullptr);
-            rtOutput.image = VK_NULL_HANDLE;
-        }
-        if (rtOutput.memory != VK_NULL_HANDLE)
-        {
-            vkFreeMemory(g_Device, rtOutput.memory, nullptr);
-            rtOutput.memory = VK_NULL_HANDLE;
-        }
+        // The composite pass of frames in flight may still sample the old image
+        destroyRtImage(rtOutput);
+        destroyRtImage(rtAccumulation);
+        destroyRtImage(rtStatistics);
+        destroyRtImage(rtSampleBudget);
+        if (rtPixelList.buffer != VK_NULL_HANDLE)
+            DeletionQueue::retireBuffer(rtPixelList.buffer, rtPixelList.memory);
+        rtPixelList = {};
+        if (rtReservoirs.buffer != VK_NULL_HANDLE)
+            DeletionQueue::retireBuffer(rtReservoirs.buffer, rtReservoirs.memory);
+        rtReservoirs = {};
+        Denoiser::destroyImages();
+    }
+
+    void destroyRtImage(RTOutput &target)
+    {
+        DeletionQueue::retireImage(target.image, target.view, target.memory);
+        target.view = VK_NULL_HANDLE;
+        target.image = VK_NULL_HANDLE;
+        target.memory = VK_NULL_HANDLE;
     }
 
     //temp, may need to move
@@ -302,182 +551,379 @@ namespace Kinesis::RayTracerManager
             rtDescriptorSetLayout = VK_NULL_HANDLE;
         }
 
+        // Materials and geometry (formerly bindings 2, 7 and 8) live in the bindless heap (set 2),
+        // so this layout no longer depends on the scene. Binding numbers are kept stable.
         std::vector<VkDescriptorSetLayoutBinding> bindings;
-        uint32_t currentBinding = 0;
+        // The ray query backend (raytrace_query.comp) does raygen and closest hit work in one compute shader
+        const VkShaderStageFlags rgenStages = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT;
+        const VkShaderStageFlags hitStages = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_COMPUTE_BIT;
 
         // Binding 0: TLAS
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, nullptr});
+        bindings.push_back({0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 1, rgenStages | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR, nullptr});
         
         // Binding 1: Output Image
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr});
-
-        // Binding 2: Material Buffer (SSBO)
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, nullptr});
+        bindings.push_back({1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, rgenStages, nullptr});
 
         // Binding 3-6: G-Buffer Samplers
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr}); // Pos
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr}); // Norm
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr}); // Alb
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr}); // Prop
-
-        // <<< CHANGED: Bindings 7 & 8 are now Arrays >>>
-        // Binding 7: Vertex Buffers (Array)
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_SCENE_OBJECTS, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, nullptr});
-        
-        // Binding 8: Index Buffers (Array)
-        bindings.push_back({currentBinding++, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, MAX_SCENE_OBJECTS, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR, nullptr});
+        bindings.push_back({3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, rgenStages, nullptr}); // Pos
+        bindings.push_back({4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, rgenStages, nullptr}); // Norm
+        bindings.push_back({5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, rgenStages, nullptr}); // Alb
+        bindings.push_back({6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, rgenStages, nullptr}); // Prop
+
+        // Binding 9: Per-instance heap handles and mesh ranges
+        bindings.push_back({9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, hitStages, nullptr});
 
-        // Use Binding Flags to allow "Partially Bound" descriptors (so we don't crash if we have fewer than 1000 objects)
-        std::vector<VkDescriptorBindingFlags> bindingFlags(bindings.size(), 0);
-        // Apply PARTIALLY_BOUND to the arrays (last two bindings)
-        bindingFlags[bindings.size() - 2] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT; // Vertices
-        bindingFlags[bindings.size() - 1] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT; // Indices
+        // Binding 10: Accumulation image (running average across frames)
+        bindings.push_back({10, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, rgenStages, nullptr});
 
-        VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
-        bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
-        bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
-        bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+        // Binding 11-13: Adaptive sampling statistics, per-pixel budget and the budget pass totals
+        bindings.push_back({11, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, rgenStages, nullptr});
+        bindings.push_back({12, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, rgenStages, nullptr});
+        bindings.push_back({13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr});
+
+        // Binding 14: Compacted list of the pixels that need rays
+        bindings.push_back({14, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, rgenStages, nullptr});
+
+        // Binding 15: Emissive triangles and their alias table (LightList)
+        bindings.push_back({15, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, rgenStages, nullptr});
+
+        // Binding 16: ReSTIR reservoirs, temporal and final set
+        bindings.push_back({16, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, rgenStages, nullptr});
 
         VkDescriptorSetLayoutCreateInfo layoutInfo{};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        layoutInfo.pNext = &bindingFlagsInfo; // Link the flags
         layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
         layoutInfo.pBindings = bindings.data();
 
         if (vkCreateDescriptorSetLayout(g_Device, &layoutInfo, nullptr, &rtDescriptorSetLayout) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create Ray Tracing descriptor set layout!");
         }
-        std::cout << "RT Descriptor Set Layout created with Bindless support." << std::endl;
+        std::cout << "RT Descriptor Set Layout created." << std::endl;
+
+        // All bindings are always rewritten together, so describe them once as an update template
+        if (rtUpdateTemplate != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorUpdateTemplate(g_Device, rtUpdateTemplate, nullptr);
+            rtUpdateTemplate = VK_NULL_HANDLE;
+        }
+        std::vector<VkDescriptorUpdateTemplateEntry> entries;
+        auto entry = [&](uint32_t binding, VkDescriptorType type, size_t offset)
+        {
+            entries.push_back({binding, 0, 1, type, offset, 0});
+        };
+        entry(0, VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, offsetof(RtDescriptorData, tlas));
+        entry(1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, offsetof(RtDescriptorData, output));
+        for (uint32_t i = 0; i < 4; ++i)
+            entry(3 + i, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offsetof(RtDescriptorData, gbuffer) + i * sizeof(VkDescriptorImageInfo));
+        entry(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(RtDescriptorData, instances));
+        entry(10, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, offsetof(RtDescriptorData, accumulation));
+        entry(11, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, offsetof(RtDescriptorData, statistics));
+        entry(12, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, offsetof(RtDescriptorData, sampleBudget));
+        entry(13, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(RtDescriptorData, budgetTotals));
+        entry(14, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(RtDescriptorData, pixelList));
+        entry(15, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(RtDescriptorData, lights));
+        entry(16, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, offsetof(RtDescriptorData, reservoirs));
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo{};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+        templateInfo.pDescriptorUpdateEntries = entries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = rtDescriptorSetLayout;
+        if (vkCreateDescriptorUpdateTemplate(g_Device, &templateInfo, nullptr, &rtUpdateTemplate) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create Ray Tracing descriptor update template!");
+        }
     }
 
-    void createRayTracingPipeline()
+    // --- Pipeline variants ---
+    // Shader groups: 0 = RGen, 1 = Miss, 2 = Occlusion Miss, then one hit group per material model.
+    // The hit shader is specialized per group (MATERIAL_TYPE), TLAS instances select theirs with
+    // instanceShaderBindingTableRecordOffset (see hitGroupOffset).
+    constexpr uint32_t FIRST_HIT_GROUP = 3;
+    constexpr uint32_t HIT_GROUP_COUNT = 4;       // Mesh::MaterialType: DIFFUSE, METAL, DIELECTRIC, LIGHT
+    constexpr size_t MAX_CACHED_PIPELINE_VARIANTS = 4; // Inactive variants kept besides the active one
+
+    // Settings compiled into the raygen shader as specialization constants
+    struct PipelineVariantKey
     {
-        assert(g_Device != VK_NULL_HANDLE && "Device must be valid");
-        // Check if the required function pointer is loaded (with pfn prefix)
-        if (!pfnCreateRayTracingPipelinesKHR)
+        int samplesPerPixel = 0;
+        int maxDepth = 0;
+        VkBool32 hybridPrimary = VK_FALSE; // Start paths at the G-buffer instead of tracing primary rays
+        bool operator==(const PipelineVariantKey &other) const
         {
-            throw std::runtime_error("vkCreateRayTracingPipelinesKHR function pointer not loaded!");
+            return samplesPerPixel == other.samplesPerPixel && maxDepth == other.maxDepth && hybridPrimary == other.hybridPrimary;
         }
+    };
 
-        // --- Create Pipeline Layout ---
-        if (rtPipelineLayout != VK_NULL_HANDLE)
+    // A compiled pipeline with its own SBT (group handles are only valid for the pipeline they came from),
+    // and the ray query compute pipeline specialized the same way
+    struct PipelineVariant
+    {
+        PipelineVariantKey key{};
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkPipeline queryPipeline = VK_NULL_HANDLE; // Null without VK_KHR_ray_query
+        ShaderBindingTableEntry rgen{};
+        ShaderBindingTableEntry miss{};
+        ShaderBindingTableEntry hit{};
+        uint64_t lastUsedFrame = 0; // DeletionQueue frame number when it stopped being the active variant
+    };
+
+    // rtPipeline, rtQueryPipeline, rgenSBT, missSBT and chitSBT are the active variant; the others wait here
+    VkPipeline rtQueryPipeline = VK_NULL_HANDLE;
+    PipelineVariantKey activeVariantKey{};
+    std::vector<PipelineVariant> cachedVariants;
+    std::vector<PipelineVariantKey> failedVariants; // Never retried
+    std::future<PipelineVariant> variantTask;       // Variant compiling on a worker thread (SBT still missing)
+    PipelineVariantKey variantTaskKey{};
+    uint32_t pipelineVariantSwitches = 0;
+
+    // --- Ray query backend ---
+    constexpr uint32_t RAY_QUERY_GROUP_SIZE = 8; // local_size_x/y of raytrace_query.comp
+
+    // Matches RtPushConstants in rtpath.glsl
+    struct TracePushConstants
+    {
+        uint32_t launchWidth;       // Ray query backend only, the pipeline has gl_LaunchSizeEXT
+        uint32_t launchHeight;
+        uint32_t accumulatedFrames; // Frames already averaged into rtAccumulation, 0 = overwrite it
+        uint32_t pattern;           // SubpixelPattern
+        uint32_t blockWidth;        // Image pixels per traced pixel (1x1 at full resolution)
+        uint32_t blockHeight;
+        uint32_t budgetSamples;     // Average samples per traced pixel with adaptive sampling
+        uint32_t maxSamples;        // Per-pixel cap with adaptive sampling, 0 = off
+        uint32_t compacted;         // 1 = trace over rtPixelList
+        uint32_t sampleLights;      // 1 = next-event estimation with the LightList
+        uint32_t restir;            // 1 = primary hits are lit from rtReservoirs
+        uint32_t restirCandidates;  // Light samples per pixel of the first ReSTIR pass
+        uint32_t restirHistory;     // 1 = last frame's final reservoirs may be reused
+        uint32_t padding[2];        // The matrix is 16-byte aligned
+        glm::mat4 prevViewProjection; // Camera of last frame's reservoirs
+    };
+    static_assert(sizeof(TracePushConstants) == 128, "TracePushConstants must match RtPushConstants in rtcommon.glsl");
+    bool useRayQuery = false;
+    float pipelineTraceMs = 0.f;
+    float rayQueryTraceMs = 0.f;
+
+    // --- Reduced resolution ---
+    TraceResolution traceResolution = TraceResolution::Full;
+    SubpixelPattern subpixelPattern = SubpixelPattern::Checkerboard;
+    VkPipeline rtUpsamplePipeline = VK_NULL_HANDLE; // raytrace_upsample.comp, same layout as the trace
+    TraceResolution lastTraceResolution = TraceResolution::Full;
+    SubpixelPattern lastSubpixelPattern = SubpixelPattern::Checkerboard;
+
+    // --- Adaptive sampling ---
+    bool adaptiveSampling = false;
+    int adaptiveMaxSamples = 16;
+    std::array<VkPipeline, 2> rtBudgetPipelines{}; // raytrace_budget.comp: sum, then allocate
+    std::unique_ptr<Buffer> sampleBudgetTotals = nullptr; // Sums of the first budget pass
+
+    VkPipeline createRtComputePipeline(VkShaderModule module, const VkSpecializationInfo *specialization, const char *name)
+    {
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = specialization;
+        pipelineInfo.layout = rtPipelineLayout;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        if (vkCreateComputePipelines(g_Device, g_PipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
         {
-            vkDestroyPipelineLayout(g_Device, rtPipelineLayout, nullptr);
-            rtPipelineLayout = VK_NULL_HANDLE;
+            throw std::runtime_error(std::string("Failed to create RT ") + name + " pipeline!");
         }
-        assert(rtDescriptorSetLayout != VK_NULL_HANDLE && "RT Descriptor Set Layout must be created first");
-        // Use global set layout (Set 0) and RT set layout (Set 1)
-        assert(Kinesis::globalSetLayout != VK_NULL_HANDLE && "Global set layout must exist");
-        std::vector<VkDescriptorSetLayout> setLayouts = {Kinesis::globalSetLayout, rtDescriptorSetLayout};
+        return pipeline;
+    }
 
-        // Push constant range for ray tracing parameters
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.stageFlags = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-        pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(int) * 2; // samplesPerPixel and maxDepth
+    // --- Compacted dispatch ---
+    bool compactDispatch = true;
+    std::array<VkPipeline, 2> rtCompactPipelines{}; // raytrace_compact.comp: classify, then write the arguments
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size()); // Now using two sets
-        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
-        pipelineLayoutInfo.pushConstantRangeCount = 1;
-        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    // --- ReSTIR direct lighting ---
+    bool restirEnabled = false;
+    int restirCandidates = 16;
+    std::array<VkPipeline, 2> rtRestirPipelines{}; // raytrace_restir.comp: candidates + temporal, then spatial
+    // Last frame's final reservoirs can be reused if the passes ran then, for the same lights (and restirHistoryValid)
+    uint64_t restirLastFrame = 0;
+    uint32_t restirLightGeneration = 0;
+    glm::mat4 restirPrevViewProjection{1.0f};
 
-        if (vkCreatePipelineLayout(g_Device, &pipelineLayoutInfo, nullptr, &rtPipelineLayout) != VK_SUCCESS)
+    void destroyRtComputePipelines()
+    {
+        for (VkPipeline *pipeline : {&rtUpsamplePipeline, &rtBudgetPipelines[0], &rtBudgetPipelines[1], &rtCompactPipelines[0], &rtCompactPipelines[1],
+                                     &rtRestirPipelines[0], &rtRestirPipelines[1]})
         {
-            throw std::runtime_error("Failed to create ray tracing pipeline layout!");
+            if (*pipeline != VK_NULL_HANDLE)
+                vkDestroyPipeline(g_Device, *pipeline, nullptr);
+            *pipeline = VK_NULL_HANDLE;
         }
-        std::cout << "RT Pipeline Layout created." << std::endl;
-        // --- Pipeline Layout Created ---
+    }
 
-        std::cout << "Creating Ray Tracing Pipeline..." << std::endl;
+    // Image pixels covered by one traced pixel
+    VkExtent2D getTraceBlockSize(TraceResolution resolution)
+    {
+        switch (resolution)
+        {
+        case TraceResolution::Half:
+            return {2, 1};
+        case TraceResolution::Quarter:
+            return {2, 2};
+        default:
+            return {1, 1};
+        }
+    }
+
+    // Loaded once and kept until cleanup, so variants can be compiled at any time
+    struct RtShaderModules
+    {
+        VkShaderModule rgen = VK_NULL_HANDLE;
+        VkShaderModule miss = VK_NULL_HANDLE;
+        VkShaderModule occlusionMiss = VK_NULL_HANDLE;
+        VkShaderModule chit = VK_NULL_HANDLE;
+        VkShaderModule query = VK_NULL_HANDLE; // Ray query backend, only loaded with VK_KHR_ray_query
+        VkShaderModule upsample = VK_NULL_HANDLE; // Reduced resolution reconstruction
+        VkShaderModule budget = VK_NULL_HANDLE;   // Adaptive sampling budget
+        VkShaderModule compact = VK_NULL_HANDLE;  // Compacted dispatch pixel list
+        VkShaderModule restir = VK_NULL_HANDLE;   // ReSTIR reservoir passes
+    } rtShaderModules;
+
+    void destroyRtShaderModules()
+    {
+        for (VkShaderModule *module : {&rtShaderModules.rgen, &rtShaderModules.miss, &rtShaderModules.occlusionMiss, &rtShaderModules.chit, &rtShaderModules.query, &rtShaderModules.upsample, &rtShaderModules.budget, &rtShaderModules.compact,
+                                        &rtShaderModules.restir})
+        {
+            if (*module != VK_NULL_HANDLE)
+                vkDestroyShaderModule(g_Device, *module, nullptr);
+            *module = VK_NULL_HANDLE;
+        }
+    }
 
+    void loadRtShaderModules()
+    {
 // Adjust shader paths based on execution directory if needed
 #if __APPLE__
         const std::string rgenShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace.rgen.spv";
         const std::string missShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace.rmiss.spv";
+        const std::string occlusionMissShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_occlusion.rmiss.spv";
         const std::string chitShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace.rchit.spv";
+        const std::string queryShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_query.comp.spv";
+        const std::string upsampleShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_upsample.comp.spv";
+        const std::string budgetShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_budget.comp.spv";
+        const std::string compactShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_compact.comp.spv";
+        const std::string restirShaderPath = "../../../../../../kinesis/assets/shaders/bin/raytrace_restir.comp.spv";
 #else
         const std::string rgenShaderPath = "../../../kinesis/assets/shaders/bin/raytrace.rgen.spv";
         const std::string missShaderPath = "../../../kinesis/assets/shaders/bin/raytrace.rmiss.spv";
+        const std::string occlusionMissShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_occlusion.rmiss.spv";
         const std::string chitShaderPath = "../../../kinesis/assets/shaders/bin/raytrace.rchit.spv";
+        const std::string queryShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_query.comp.spv";
+        const std::string upsampleShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_upsample.comp.spv";
+        const std::string budgetShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_budget.comp.spv";
+        const std::string compactShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_compact.comp.spv";
+        const std::string restirShaderPath = "../../../kinesis/assets/shaders/bin/raytrace_restir.comp.spv";
 #endif
-
-        VkShaderModule rgenModule = VK_NULL_HANDLE;
-        VkShaderModule missModule = VK_NULL_HANDLE;
-        VkShaderModule chitModule = VK_NULL_HANDLE;
-
+        destroyRtShaderModules();
         try
         {
-            rgenModule = createShaderModule(rgenShaderPath);
-            missModule = createShaderModule(missShaderPath);
-            chitModule = createShaderModule(chitShaderPath);
+            rtShaderModules.rgen = createShaderModule(rgenShaderPath);
+            rtShaderModules.miss = createShaderModule(missShaderPath);
+            rtShaderModules.occlusionMiss = createShaderModule(occlusionMissShaderPath);
+            rtShaderModules.chit = createShaderModule(chitShaderPath);
+            rtShaderModules.upsample = createShaderModule(upsampleShaderPath);
+            rtShaderModules.budget = createShaderModule(budgetShaderPath);
+            rtShaderModules.compact = createShaderModule(compactShaderPath);
+            rtShaderModules.restir = createShaderModule(restirShaderPath);
+            if (Kinesis::GUI::rayquery_available)
+                rtShaderModules.query = createShaderModule(queryShaderPath);
         }
         catch (const std::exception &e)
         {
-            if (rgenModule)
-                vkDestroyShaderModule(g_Device, rgenModule, nullptr);
-            if (missModule)
-                vkDestroyShaderModule(g_Device, missModule, nullptr);
-            // Potential missing cleanup for chitModule if it failed after others succeeded
-            if (chitModule)
-                vkDestroyShaderModule(g_Device, chitModule, nullptr);
+            destroyRtShaderModules();
             std::cerr << "Failed to load ray tracing shaders: " << e.what() << std::endl;
             throw;
         }
+    }
+
+    // Identical for every variant; only the specialization constants differ
+    std::vector<VkRayTracingShaderGroupCreateInfoKHR> makeShaderGroups()
+    {
+        std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
+        auto generalGroup = [&](uint32_t stage)
+        {
+            VkRayTracingShaderGroupCreateInfoKHR group{};
+            group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+            group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
+            group.generalShader = stage; // Index in the variant's `stages`
+            group.closestHitShader = VK_SHADER_UNUSED_KHR;
+            group.anyHitShader = VK_SHADER_UNUSED_KHR;
+            group.intersectionShader = VK_SHADER_UNUSED_KHR;
+            groups.push_back(group);
+        };
+        generalGroup(0); // RGen Group (Index 0)
+        generalGroup(1); // Miss Group (Index 1)
+        generalGroup(2); // Occlusion Miss Group (Index 2) - must directly follow the miss group, shaders select it with missIndex 1
+        // Hit Groups (Index 3..) - triangle geometry, one per material model
+        for (uint32_t i = 0; i < HIT_GROUP_COUNT; ++i)
+        {
+            VkRayTracingShaderGroupCreateInfoKHR chitGroup{};
+            chitGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+            chitGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
+            chitGroup.generalShader = VK_SHADER_UNUSED_KHR;
+            chitGroup.closestHitShader = FIRST_HIT_GROUP + i;   // Stages are laid out like the groups
+            chitGroup.anyHitShader = VK_SHADER_UNUSED_KHR;       // Add AnyHit shader index if used
+            chitGroup.intersectionShader = VK_SHADER_UNUSED_KHR; // Use for procedural geometry
+            groups.push_back(chitGroup);
+        }
+        return groups;
+    }
+
+    // Compiles one variant of the RT pipeline (and of the ray query pipeline, if loaded); the SBT is created
+    // separately. Only reads state that is fixed after createRayTracingPipeline (layout, shader modules,
+    // shader_groups), so it may run on a worker thread.
+    PipelineVariant compilePipelineVariant(PipelineVariantKey key)
+    {
+        // RGen: constant_id 0 = SAMPLES_PER_PIXEL, 1 = MAX_DEPTH, 2 = HYBRID_PRIMARY
+        const std::array<VkSpecializationMapEntry, 3> rgenEntries = {{
+            {0, offsetof(PipelineVariantKey, samplesPerPixel), sizeof(int)},
+            {1, offsetof(PipelineVariantKey, maxDepth), sizeof(int)},
+            {2, offsetof(PipelineVariantKey, hybridPrimary), sizeof(VkBool32)},
+        }};
+        VkSpecializationInfo rgenSpecialization{};
+        rgenSpecialization.mapEntryCount = static_cast<uint32_t>(rgenEntries.size());
+        rgenSpecialization.pMapEntries = rgenEntries.data();
+        rgenSpecialization.dataSize = sizeof(PipelineVariantKey);
+        rgenSpecialization.pData = &key;
+
+        // CHit: constant_id 0 = MATERIAL_TYPE, one specialization per hit group
+        const VkSpecializationMapEntry materialEntry{0, 0, sizeof(int)};
+        std::array<int, HIT_GROUP_COUNT> materialTypes{};
+        std::array<VkSpecializationInfo, HIT_GROUP_COUNT> chitSpecializations{};
+        for (uint32_t i = 0; i < HIT_GROUP_COUNT; ++i)
+        {
+            materialTypes[i] = static_cast<int>(i);
+            chitSpecializations[i].mapEntryCount = 1;
+            chitSpecializations[i].pMapEntries = &materialEntry;
+            chitSpecializations[i].dataSize = sizeof(int);
+            chitSpecializations[i].pData = &materialTypes[i];
+        }
 
         std::vector<VkPipelineShaderStageCreateInfo> stages;
-        // RGen Stage
-        VkPipelineShaderStageCreateInfo rgenStageInfo{};
-        rgenStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        rgenStageInfo.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-        rgenStageInfo.module = rgenModule;
-        rgenStageInfo.pName = "main";
-        stages.push_back(rgenStageInfo);
-        // Miss Stage
-        VkPipelineShaderStageCreateInfo missStageInfo{};
-        missStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        missStageInfo.stage = VK_SHADER_STAGE_MISS_BIT_KHR;
-        missStageInfo.module = missModule;
-        missStageInfo.pName = "main";
-        stages.push_back(missStageInfo);
-        // CHit Stage
-        VkPipelineShaderStageCreateInfo chitStageInfo{};
-        chitStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        chitStageInfo.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-        chitStageInfo.module = chitModule;
-        chitStageInfo.pName = "main";
-        stages.push_back(chitStageInfo);
-
-        // Shader Groups
-        shader_groups.clear();
-        // RGen Group (Index 0)
-        VkRayTracingShaderGroupCreateInfoKHR rgenGroup{};
-        rgenGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        rgenGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-        rgenGroup.generalShader = 0; // Index of RGen stage in `stages`
-        rgenGroup.closestHitShader = VK_SHADER_UNUSED_KHR;
-        rgenGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
-        rgenGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_groups.push_back(rgenGroup);
-        // Miss Group (Index 1)
-        VkRayTracingShaderGroupCreateInfoKHR missGroup{};
-        missGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        missGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-        missGroup.generalShader = 1; // Index of Miss stage in `stages`
-        missGroup.closestHitShader = VK_SHADER_UNUSED_KHR;
-        missGroup.anyHitShader = VK_SHADER_UNUSED_KHR;
-        missGroup.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_groups.push_back(missGroup);
-        // CHit Group (Index 2) - Triangle geometry uses this group
-        VkRayTracingShaderGroupCreateInfoKHR chitGroup{};
-        chitGroup.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        chitGroup.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
-        chitGroup.generalShader = VK_SHADER_UNUSED_KHR;
-        chitGroup.closestHitShader = 2;                      // Index of CHit stage in `stages`
-        chitGroup.anyHitShader = VK_SHADER_UNUSED_KHR;       // Add AnyHit shader index if used
-        chitGroup.intersectionShader = VK_SHADER_UNUSED_KHR; // Use for procedural geometry
-        shader_groups.push_back(chitGroup);
+        auto addStage = [&](VkShaderStageFlagBits stage, VkShaderModule module, const VkSpecializationInfo *specialization)
+        {
+            VkPipelineShaderStageCreateInfo stageInfo{};
+            stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            stageInfo.stage = stage;
+            stageInfo.module = module;
+            stageInfo.pName = "main";
+            stageInfo.pSpecializationInfo = specialization;
+            stages.push_back(stageInfo);
+        };
+        addStage(VK_SHADER_STAGE_RAYGEN_BIT_KHR, rtShaderModules.rgen, &rgenSpecialization);  // Stage 0
+        addStage(VK_SHADER_STAGE_MISS_BIT_KHR, rtShaderModules.miss, nullptr);                // Stage 1
+        addStage(VK_SHADER_STAGE_MISS_BIT_KHR, rtShaderModules.occlusionMiss, nullptr);       // Stage 2 - visibility queries (occlusion.glsl)
+        for (uint32_t i = 0; i < HIT_GROUP_COUNT; ++i)
+            addStage(VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR, rtShaderModules.chit, &chitSpecializations[i]); // Stages 3..
 
         // Pipeline Create Info
         VkRayTracingPipelineCreateInfoKHR pipelineInfo{};
@@ -488,8 +934,79 @@ namespace Kinesis::RayTracerManager
         pipelineInfo.pGroups = shader_groups.data();
         pipelineInfo.maxPipelineRayRecursionDepth = 10; // Max recursion depth (e.g., 1 for primary rays only)
         pipelineInfo.layout = rtPipelineLayout;        // Use the RT pipeline layout created above
-        // pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // For pipeline derivatives
-        // pipelineInfo.basePipelineIndex = -1;
+
+        PipelineVariant variant{};
+        variant.key = key;
+        if (pfnCreateRayTracingPipelinesKHR(g_Device, VK_NULL_HANDLE, g_PipelineCache, 1, &pipelineInfo, nullptr, &variant.pipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create ray tracing pipeline!");
+        }
+
+        // Ray query backend: raygen's specialization constants have the same ids in the compute shader
+        if (rtShaderModules.query != VK_NULL_HANDLE)
+        {
+            VkComputePipelineCreateInfo computeInfo{};
+            computeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            computeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            computeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            computeInfo.stage.module = rtShaderModules.query;
+            computeInfo.stage.pName = "main";
+            computeInfo.stage.pSpecializationInfo = &rgenSpecialization;
+            computeInfo.layout = rtPipelineLayout;
+            if (vkCreateComputePipelines(g_Device, g_PipelineCache, 1, &computeInfo, nullptr, &variant.queryPipeline) != VK_SUCCESS)
+            {
+                vkDestroyPipeline(g_Device, variant.pipeline, nullptr);
+                throw std::runtime_error("Failed to create ray query compute pipeline!");
+            }
+        }
+        return variant;
+    }
+
+    void createRayTracingPipeline()
+    {
+        assert(g_Device != VK_NULL_HANDLE && "Device must be valid");
+        // Check if the required function pointer is loaded (with pfn prefix)
+        if (!pfnCreateRayTracingPipelinesKHR)
+        {
+            throw std::runtime_error("vkCreateRayTracingPipelinesKHR function pointer not loaded!");
+        }
+
+        // --- Create Pipeline Layout ---
+        if (rtPipelineLayout != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineLayout(g_Device, rtPipelineLayout, nullptr);
+            rtPipelineLayout = VK_NULL_HANDLE;
+        }
+        assert(rtDescriptorSetLayout != VK_NULL_HANDLE && "RT Descriptor Set Layout must be created first");
+        // Use global set layout (Set 0), RT set layout (Set 1) and the bindless heap (Set 2)
+        assert(Kinesis::globalSetLayout != VK_NULL_HANDLE && "Global set layout must exist");
+        assert(BindlessHeap::getLayout() != VK_NULL_HANDLE && "Bindless heap must be initialized");
+        std::vector<VkDescriptorSetLayout> setLayouts = {Kinesis::globalSetLayout, rtDescriptorSetLayout, BindlessHeap::getLayout()};
+
+        // samplesPerPixel and maxDepth are specialization constants of each variant. Push constants carry
+        // what changes per frame: the accumulation count and the launch size of the ray query backend.
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = TRACE_PUSH_STAGES;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(TracePushConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size()); // Now using three sets
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+        if (vkCreatePipelineLayout(g_Device, &pipelineLayoutInfo, nullptr, &rtPipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create ray tracing pipeline layout!");
+        }
+        std::cout << "RT Pipeline Layout created." << std::endl;
+        // --- Pipeline Layout Created ---
+
+        std::cout << "Creating Ray Tracing Pipeline..." << std::endl;
+        loadRtShaderModules();
+        shader_groups = makeShaderGroups();
 
         if (rtPipeline != VK_NULL_HANDLE)
         {
@@ -497,27 +1014,58 @@ namespace Kinesis::RayTracerManager
             rtPipeline = VK_NULL_HANDLE;
         }
 
-        if (pfnCreateRayTracingPipelinesKHR(g_Device, VK_NULL_HANDLE, g_PipelineCache, 1, &pipelineInfo, nullptr, &rtPipeline) != VK_SUCCESS)
+        if (rtQueryPipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(g_Device, rtQueryPipeline, nullptr);
+            rtQueryPipeline = VK_NULL_HANDLE;
+        }
+
+        destroyRtComputePipelines();
+
+        try
+        {
+            PipelineVariant variant = compilePipelineVariant(activeVariantKey);
+            rtPipeline = variant.pipeline;
+            rtQueryPipeline = variant.queryPipeline;
+
+            // The upsampler, budget, compaction and ReSTIR passes have no variant specialization, one set serves every variant
+            rtUpsamplePipeline = createRtComputePipeline(rtShaderModules.upsample, nullptr, "upsample");
+            for (int32_t pass = 0; pass < 2; ++pass)
+            {
+                VkSpecializationMapEntry passEntry{0, 0, sizeof(int32_t)};
+                VkSpecializationInfo passSpecialization{1, &passEntry, sizeof(int32_t), &pass};
+                rtBudgetPipelines[pass] = createRtComputePipeline(rtShaderModules.budget, &passSpecialization, "sample budget");
+                rtCompactPipelines[pass] = createRtComputePipeline(rtShaderModules.compact, &passSpecialization, "compaction");
+                rtRestirPipelines[pass] = createRtComputePipeline(rtShaderModules.restir, &passSpecialization, "ReSTIR");
+            }
+        }
+        catch (const std::exception &)
         {
-            // Cleanup modules and layout on failure
-            vkDestroyShaderModule(g_Device, rgenModule, nullptr);
-            vkDestroyShaderModule(g_Device, missModule, nullptr);
-            vkDestroyShaderModule(g_Device, chitModule, nullptr);
+            // Cleanup what the variant already created, then modules and layout
+            if (rtPipeline != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(g_Device, rtPipeline, nullptr);
+                rtPipeline = VK_NULL_HANDLE;
+            }
+            if (rtQueryPipeline != VK_NULL_HANDLE)
+            {
+                vkDestroyPipeline(g_Device, rtQueryPipeline, nullptr);
+                rtQueryPipeline = VK_NULL_HANDLE;
+            }
+            destroyRtComputePipelines();
+            destroyRtShaderModules();
             vkDestroyPipelineLayout(g_Device, rtPipelineLayout, nullptr); // Clean up layout on failure
             rtPipelineLayout = VK_NULL_HANDLE;
-            throw std::runtime_error("Failed to create ray tracing pipeline!");
+            throw;
         }
 
-        // Cleanup shader modules - they are no longer needed after pipeline creation
-        vkDestroyShaderModule(g_Device, rgenModule, nullptr);
-        vkDestroyShaderModule(g_Device, missModule, nullptr);
-        vkDestroyShaderModule(g_Device, chitModule, nullptr);
-
-        std::cout << "Ray Tracing Pipeline created successfully." << std::endl;
+        std::cout << "Ray Tracing Pipeline created successfully (" << activeVariantKey.samplesPerPixel << " spp, depth "
+                  << activeVariantKey.maxDepth << ")." << std::endl;
     }
 
     // Helper to Create and Upload SBT Entry
-    void createSBTEntry(ShaderBindingTableEntry &sbtEntry, uint32_t groupIndex, uint32_t handleSize, uint32_t groupHandleAlignment, const uint8_t *shaderHandleStorage)
+    // Holds groupCount records (consecutive shader groups starting at groupIndex), one stride apart
+    void createSBTEntry(ShaderBindingTableEntry &sbtEntry, uint32_t groupIndex, uint32_t groupCount, uint32_t handleSize, uint32_t groupHandleAlignment, const uint8_t *shaderHandleStorage)
     {
         // SBT entries need specific usage flags and alignment
         const VkBufferUsageFlags sbtBufferUsageFlags =
@@ -527,6 +1075,7 @@ namespace Kinesis::RayTracerManager
 
         // The size of one entry in the SBT must be aligned to shaderGroupHandleAlignment
         const VkDeviceSize sbtEntrySizeAligned = Kinesis::Buffer::getAlignment(handleSize, groupHandleAlignment);
+        const VkDeviceSize sbtTableSize = sbtEntrySizeAligned * groupCount;
 
         // Destroy old buffer/memory if it exists
         if (sbtEntry.buffer != VK_NULL_HANDLE)
@@ -536,13 +1085,14 @@ namespace Kinesis::RayTracerManager
         }
         if (sbtEntry.memory != VK_NULL_HANDLE)
         {
+            MemoryBudget::untrack(sbtEntry.memory);
             vkFreeMemory(g_Device, sbtEntry.memory, nullptr);
             sbtEntry.memory = VK_NULL_HANDLE;
         }
 
         // Create Buffer using the helper function
         Kinesis::Window::createBuffer(
-            sbtEntrySizeAligned, // Use aligned size
+            sbtTableSize, // Aligned size of every record
             sbtBufferUsageFlags,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, // Use device local memory for performance
             sbtEntry.buffer,
@@ -552,17 +1102,22 @@ namespace Kinesis::RayTracerManager
         VkBuffer stagingBuffer;
         VkDeviceMemory stagingMemory;
         Kinesis::Window::createBuffer(
-            handleSize, // Size of one raw handle
+            sbtTableSize, // Records laid out exactly as in the SBT buffer
             VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
             stagingBuffer,
-            stagingMemory);
+            stagingMemory,
+            MemoryBudget::Category::Staging);
 
         // Map staging buffer and copy the specific handle data
         void *mappedData;
-        vkMapMemory(g_Device, stagingMemory, 0, handleSize, 0, &mappedData);
-        // Copy the handle for the specified groupIndex from the retrieved storage
-        memcpy(mappedData, shaderHandleStorage + groupIndex * handleSize, handleSize);
+        vkMapMemory(g_Device, stagingMemory, 0, sbtTableSize, 0, &mappedData);
+        // Copy the handles for groupIndex.. from the retrieved storage, each at the start of its aligned record
+        for (uint32_t i = 0; i < groupCount; ++i)
+        {
+            memcpy(static_cast<uint8_t *>(mappedData) + i * sbtEntrySizeAligned,
+                   shaderHandleStorage + (groupIndex + i) * handleSize, handleSize);
+        }
         vkUnmapMemory(g_Device, stagingMemory);
 
         // Copy from staging buffer to the start of the SBT buffer
@@ -570,24 +1125,25 @@ namespace Kinesis::RayTracerManager
         VkBufferCopy copyRegion{};
         copyRegion.srcOffset = 0;
         copyRegion.dstOffset = 0;     // Copy to the beginning of the SBT entry buffer
-        copyRegion.size = handleSize; // Copy only the raw handle size
+        copyRegion.size = sbtTableSize; // All records, including their alignment padding
         vkCmdCopyBuffer(cmdBuf, stagingBuffer, sbtEntry.buffer, 1, &copyRegion);
         endSingleTimeCommands(cmdBuf);
 
         // Cleanup staging buffer
         vkDestroyBuffer(g_Device, stagingBuffer, nullptr);
+        MemoryBudget::untrack(stagingMemory);
         vkFreeMemory(g_Device, stagingMemory, nullptr);
 
         // Set up address region for vkCmdTraceRaysKHR
         // Get address using the loaded function pointer (via helper)
         sbtEntry.addressRegion.deviceAddress = getBufferDeviceAddress(sbtEntry.buffer);
         sbtEntry.addressRegion.stride = sbtEntrySizeAligned; // Stride must be the aligned size
-        sbtEntry.addressRegion.size = sbtEntrySizeAligned;   // Size must be the aligned size
+        sbtEntry.addressRegion.size = sbtTableSize;          // Stride times the number of records
     }
 
-    void createShaderBindingTable()
+    // Builds the SBT of one pipeline variant
+    void createShaderBindingTable(VkPipeline pipeline, ShaderBindingTableEntry &rgen, ShaderBindingTableEntry &miss, ShaderBindingTableEntry &hit)
     {
-        assert(rtPipeline != VK_NULL_HANDLE && "Ray tracing pipeline must be created before SBT");
         // Check if the required function pointer is loaded (with pfn prefix)
         if (!pfnGetRayTracingShaderGroupHandlesKHR)
         {
@@ -595,8 +1151,6 @@ namespace Kinesis::RayTracerManager
         }
         assert(!shader_groups.empty() && "Shader groups must be created before SBT");
 
-        std::cout << "Creating Shader Binding Table..." << std::endl;
-
         const uint32_t handleSize = rt_pipeline_properties.shaderGroupHandleSize;
         const uint32_t handleAlignment = rt_pipeline_properties.shaderGroupHandleAlignment; // Renamed for clarity
         const uint32_t groupCount = static_cast<uint32_t>(shader_groups.size());
@@ -606,17 +1160,27 @@ namespace Kinesis::RayTracerManager
         std::vector<uint8_t> shaderHandleStorage(dataSize);
 
         // Call function via loaded pointer (with pfn prefix)
-        if (pfnGetRayTracingShaderGroupHandlesKHR(g_Device, rtPipeline, 0, groupCount, dataSize, shaderHandleStorage.data()) != VK_SUCCESS)
+        if (pfnGetRayTracingShaderGroupHandlesKHR(g_Device, pipeline, 0, groupCount, dataSize, shaderHandleStorage.data()) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to get ray tracing shader group handles!");
         }
 
         // --- Create SBT entries ---
-        // Assuming Group Indices: 0=RGen, 1=Miss, 2=CHit
+        // Group Indices: 0=RGen, 1=Miss, 2=Occlusion Miss, 3..=one CHit group per material model
+        // The miss table holds both miss records: traceRayEXT's missIndex 0 shades, 1 answers visibility queries.
+        // The hit table holds one record per material model, instances pick theirs with their SBT record offset.
         // Use handleAlignment for alignment parameter
-        createSBTEntry(rgenSBT, 0, handleSize, handleAlignment, shaderHandleStorage.data());
-        createSBTEntry(missSBT, 1, handleSize, handleAlignment, shaderHandleStorage.data());
-        createSBTEntry(chitSBT, 2, handleSize, handleAlignment, shaderHandleStorage.data());
+        createSBTEntry(rgen, 0, 1, handleSize, handleAlignment, shaderHandleStorage.data());
+        createSBTEntry(miss, 1, 2, handleSize, handleAlignment, shaderHandleStorage.data());
+        createSBTEntry(hit, FIRST_HIT_GROUP, HIT_GROUP_COUNT, handleSize, handleAlignment, shaderHandleStorage.data());
+    }
+
+    void createShaderBindingTable()
+    {
+        assert(rtPipeline != VK_NULL_HANDLE && "Ray tracing pipeline must be created before SBT");
+        std::cout << "Creating Shader Binding Table..." << std::endl;
+
+        createShaderBindingTable(rtPipeline, rgenSBT, missSBT, chitSBT);
         // Create other entries (ahitSBT, callableSBT) if needed, adjusting indices
         callableSBT.addressRegion.deviceAddress = 0; // Or address of a dummy buffer if needed
         callableSBT.addressRegion.stride = 0;        // Stride is 0 if no entries
@@ -627,6 +1191,179 @@ namespace Kinesis::RayTracerManager
         std::cout << "  - CHit Address: " << chitSBT.addressRegion.deviceAddress << ", Stride: " << chitSBT.addressRegion.stride << ", Size: " << chitSBT.addressRegion.size << std::endl;
     }
 
+    void destroySBTEntry(ShaderBindingTableEntry &entry)
+    {
+        if (entry.buffer != VK_NULL_HANDLE)
+            vkDestroyBuffer(g_Device, entry.buffer, nullptr);
+        if (entry.memory != VK_NULL_HANDLE)
+        {
+            MemoryBudget::untrack(entry.memory);
+            vkFreeMemory(g_Device, entry.memory, nullptr);
+        }
+        entry = {}; // Reset struct
+    }
+
+    // Drops the least recently used inactive variants beyond MAX_CACHED_PIPELINE_VARIANTS.
+    // Frames in flight may still trace with them, so they go through the DeletionQueue.
+    void trimPipelineVariants()
+    {
+        while (cachedVariants.size() > MAX_CACHED_PIPELINE_VARIANTS)
+        {
+            auto oldest = std::min_element(cachedVariants.begin(), cachedVariants.end(), [](const PipelineVariant &a, const PipelineVariant &b)
+                                           { return a.lastUsedFrame < b.lastUsedFrame; });
+            VkPipeline pipeline = oldest->pipeline;
+            VkPipeline queryPipeline = oldest->queryPipeline;
+            DeletionQueue::retire([pipeline, queryPipeline]()
+                                  {
+                vkDestroyPipeline(g_Device, pipeline, nullptr);
+                if (queryPipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(g_Device, queryPipeline, nullptr); });
+            DeletionQueue::retireBuffer(oldest->rgen.buffer, oldest->rgen.memory);
+            DeletionQueue::retireBuffer(oldest->miss.buffer, oldest->miss.memory);
+            DeletionQueue::retireBuffer(oldest->hit.buffer, oldest->hit.memory);
+            cachedVariants.erase(oldest);
+        }
+    }
+
+    // Makes the variant for `key` active if it is compiled. Otherwise its compile is started on a worker
+    // thread (one at a time) and the active variant keeps tracing until it is ready, so changing a
+    // setting never stalls a frame on pipeline compilation.
+    void usePipelineVariant(const PipelineVariantKey &key)
+    {
+        // Collect a finished background compile into the cache
+        if (variantTask.valid() && variantTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        {
+            PipelineVariant variant{};
+            variant.key = variantTaskKey;
+            try
+            {
+                variant = variantTask.get();
+                createShaderBindingTable(variant.pipeline, variant.rgen, variant.miss, variant.hit);
+                variant.lastUsedFrame = DeletionQueue::getFrameNumber();
+                cachedVariants.push_back(variant);
+                std::cout << "RT pipeline variant compiled (" << variant.key.samplesPerPixel << " spp, depth " << variant.key.maxDepth << ")." << std::endl;
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Warning: RT pipeline variant (" << variant.key.samplesPerPixel << " spp, depth " << variant.key.maxDepth
+                          << ") failed: " << e.what() << std::endl;
+                // Never recorded, no need to retire
+                if (variant.pipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(g_Device, variant.pipeline, nullptr);
+                if (variant.queryPipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(g_Device, variant.queryPipeline, nullptr);
+                destroySBTEntry(variant.rgen);
+                destroySBTEntry(variant.miss);
+                destroySBTEntry(variant.hit);
+                failedVariants.push_back(variant.key);
+            }
+        }
+
+        if (key == activeVariantKey)
+            return;
+
+        auto cached = std::find_if(cachedVariants.begin(), cachedVariants.end(), [&](const PipelineVariant &variant)
+                                   { return variant.key == key; });
+        if (cached != cachedVariants.end())
+        {
+            // Swap: the requested variant becomes active, the active one is cached
+            PipelineVariant previous{activeVariantKey, rtPipeline, rtQueryPipeline, rgenSBT, missSBT, chitSBT, DeletionQueue::getFrameNumber()};
+            activeVariantKey = cached->key;
+            rtPipeline = cached->pipeline;
+            rtQueryPipeline = cached->queryPipeline;
+            rgenSBT = cached->rgen;
+            missSBT = cached->miss;
+            chitSBT = cached->hit;
+            *cached = previous;
+            pipelineVariantSwitches++;
+            Accumulation::reset(); // Frames so far were traced with the previous settings
+            trimPipelineVariants();
+            return;
+        }
+
+        if (!variantTask.valid() && std::find(failedVariants.begin(), failedVariants.end(), key) == failedVariants.end())
+        {
+            variantTaskKey = key;
+            variantTask = std::async(std::launch::async, compilePipelineVariant, key);
+        }
+    }
+
+    size_t getPipelineVariantCount() { return cachedVariants.size() + (rtPipeline != VK_NULL_HANDLE ? 1 : 0); }
+    bool isCompilingPipelineVariant() { return variantTask.valid(); }
+
+    // --- Trace Backend Timings ---
+    // Two timestamps around the trace per frame slot, so both backends can be compared on the same scene.
+    // Each slot remembers which backend it measured; results are read when the slot comes around again.
+    namespace
+    {
+        enum class TraceBackend : uint8_t
+        {
+            None,
+            Pipeline,
+            RayQuery
+        };
+
+        // Weight of a new measurement in the displayed averages
+        constexpr float TRACE_TIME_BLEND = 0.1f;
+
+        VkQueryPool traceQueryPool = VK_NULL_HANDLE;
+        bool traceTimestampsSupported = true;
+        float traceTimestampPeriodNs = 1.f;
+        std::array<TraceBackend, SwapChain::MAX_FRAMES_IN_FLIGHT> traceSlotBackends{};
+
+        void createTraceQueryPool()
+        {
+            VkPhysicalDeviceProperties properties{};
+            vkGetPhysicalDeviceProperties(g_PhysicalDevice, &properties);
+            if (!properties.limits.timestampComputeAndGraphics)
+            {
+                std::cerr << "Warning: Timestamp queries not supported, trace times are not measured." << std::endl;
+                traceTimestampsSupported = false;
+                return;
+            }
+            traceTimestampPeriodNs = properties.limits.timestampPeriod;
+
+            VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+            queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+            queryInfo.queryCount = 2 * SwapChain::MAX_FRAMES_IN_FLIGHT;
+            if (vkCreateQueryPool(g_Device, &queryInfo, nullptr, &traceQueryPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create trace timestamp query pool!");
+            }
+        }
+
+        // The fence wait in beginFrame guarantees this slot's last submission finished, so this never blocks
+        void readBackTraceTime(int frameIndex)
+        {
+            const TraceBackend backend = traceSlotBackends[frameIndex];
+            traceSlotBackends[frameIndex] = TraceBackend::None;
+            if (traceQueryPool == VK_NULL_HANDLE || backend == TraceBackend::None)
+                return;
+
+            std::array<uint64_t, 2> timestamps{};
+            VkResult result = vkGetQueryPoolResults(g_Device, traceQueryPool, 2 * frameIndex, 2,
+                                                    sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+                                                    VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS || timestamps[1] < timestamps[0])
+                return;
+
+            const float elapsedMs = static_cast<float>(timestamps[1] - timestamps[0]) * traceTimestampPeriodNs * 1e-6f;
+            float &average = backend == TraceBackend::RayQuery ? rayQueryTraceMs : pipelineTraceMs;
+            average = average == 0.f ? elapsedMs : average + (elapsedMs - average) * TRACE_TIME_BLEND;
+        }
+
+        void destroyTraceTimestamps()
+        {
+            if (traceQueryPool != VK_NULL_HANDLE)
+                vkDestroyQueryPool(g_Device, traceQueryPool, nullptr);
+            traceQueryPool = VK_NULL_HANDLE;
+            traceTimestampsSupported = true;
+            traceSlotBackends.fill(TraceBackend::None);
+            pipelineTraceMs = 0.f;
+            rayQueryTraceMs = 0.f;
+        }
+    }
+
     // --- initialize ---
     void initialize(VkExtent2D extent)
     {
@@ -648,10 +1385,16 @@ namespace Kinesis::RayTracerManager
         pfnGetAccelerationStructureBuildSizesKHR = (PFN_vkGetAccelerationStructureBuildSizesKHR)vkGetDeviceProcAddr(g_Device, "vkGetAccelerationStructureBuildSizesKHR");
         pfnGetAccelerationStructureDeviceAddressKHR = (PFN_vkGetAccelerationStructureDeviceAddressKHR)vkGetDeviceProcAddr(g_Device, "vkGetAccelerationStructureDeviceAddressKHR");
         pfnCmdTraceRaysKHR = (PFN_vkCmdTraceRaysKHR)vkGetDeviceProcAddr(g_Device, "vkCmdTraceRaysKHR");
+        if (Kinesis::GUI::traceindirect_available)
+            pfnCmdTraceRaysIndirectKHR = (PFN_vkCmdTraceRaysIndirectKHR)vkGetDeviceProcAddr(g_Device, "vkCmdTraceRaysIndirectKHR");
         pfnGetRayTracingShaderGroupHandlesKHR = (PFN_vkGetRayTracingShaderGroupHandlesKHR)vkGetDeviceProcAddr(g_Device, "vkGetRayTracingShaderGroupHandlesKHR");
         pfnCreateRayTracingPipelinesKHR = (PFN_vkCreateRayTracingPipelinesKHR)vkGetDeviceProcAddr(g_Device, "vkCreateRayTracingPipelinesKHR");
         pfnCmdWriteAccelerationStructuresPropertiesKHR = (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR)vkGetDeviceProcAddr(g_Device, "vkCmdWriteAccelerationStructuresPropertiesKHR");
         pfnCopyAccelerationStructureKHR = (PFN_vkCopyAccelerationStructureKHR)vkGetDeviceProcAddr(g_Device, "vkCopyAccelerationStructureKHR");
+        pfnCmdCopyAccelerationStructureKHR = (PFN_vkCmdCopyAccelerationStructureKHR)vkGetDeviceProcAddr(g_Device, "vkCmdCopyAccelerationStructureKHR");
+        pfnCmdCopyAccelerationStructureToMemoryKHR = (PFN_vkCmdCopyAccelerationStructureToMemoryKHR)vkGetDeviceProcAddr(g_Device, "vkCmdCopyAccelerationStructureToMemoryKHR");
+        pfnCmdCopyMemoryToAccelerationStructureKHR = (PFN_vkCmdCopyMemoryToAccelerationStructureKHR)vkGetDeviceProcAddr(g_Device, "vkCmdCopyMemoryToAccelerationStructureKHR");
+        pfnGetDeviceAccelerationStructureCompatibilityKHR = (PFN_vkGetDeviceAccelerationStructureCompatibilityKHR)vkGetDeviceProcAddr(g_Device, "vkGetDeviceAccelerationStructureCompatibilityKHR");
         // pfnBuildAccelerationStructuresKHR = (PFN_vkBuildAccelerationStructuresKHR)vkGetDeviceProcAddr(g_Device, "vkBuildAccelerationStructuresKHR"); // If needed
 
         // Check if essential pointers were loaded (using renamed variables)
@@ -684,6 +1427,8 @@ namespace Kinesis::RayTracerManager
         // Get RT Properties & Features
         // Ensure these are queried using VkPhysicalDeviceProperties2 after selecting physical device
         rt_pipeline_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+        as_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+        rt_pipeline_properties.pNext = &as_properties; // Scratch alignment for batched AS builds
         as_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
         VkPhysicalDeviceProperties2 deviceProps2{};
         deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
@@ -711,29 +1456,51 @@ namespace Kinesis::RayTracerManager
             // 1. Create Layouts (Global layout created in kinesis.cpp)
             createRtDescriptorSetLayout(); // Creates rtDescriptorSetLayout (Set 1)
 
-            // 2. Create Output Image
+            // 2. Start compiling the RT Pipeline (Requires layouts). This dominates startup time, so it runs
+            // on a worker thread while the acceleration structures are built and the caller creates its
+            // own pipelines; waitForPipeline() joins it and builds the SBT.
+            // The first variant is specialized for the current GUI settings, so the first frames don't wait for another
+            activeVariantKey = {Kinesis::GUI::samples_per_pixel, Kinesis::GUI::max_ray_depth, Kinesis::GUI::hybrid_primary_rays ? VK_TRUE : VK_FALSE};
+            pipelineTask = std::async(std::launch::async, createRayTracingPipeline); // Creates rtPipeline and rtPipelineLayout
+
+            // 3. Create Output Image
             createRtOutputImage(extent); // Creates rtOutput
 
-            // 3. Build Acceleration Structures
+            // 4. Build Acceleration Structures
             create_blas();     // Creates blas vector
             create_tlas(true); // Creates tlas, allows updates
 
-            // 4. Create RT Pipeline (Requires layouts)
-            createRayTracingPipeline(); // Creates rtPipeline and rtPipelineLayout
-
-            // 5. Create Shader Binding Table (Requires pipeline)
-            createShaderBindingTable(); // Creates SBT entries (rgenSBT, missSBT, chitSBT)
-
             // 6. Initial Descriptor Set Allocation/Update (will be done per-frame in run loop)
             // allocateAndUpdateRtDescriptorSet is called later with frame-specific data
         }
         catch (const std::exception &e)
         {
             std::cerr << "Ray Tracing Manager Initialization failed: " << e.what() << std::endl;
-            cleanup(); // Attempt cleanup on failure
+            cleanup(); // Attempt cleanup on failure (joins the pipeline task first)
             throw;
         }
-        std::cout << "Ray Tracing Manager Initialized Successfully." << std::endl;
+        std::cout << "Ray Tracing Manager Initialized, pipeline compiling in the background." << std::endl;
+    }
+
+    // --- waitForPipeline ---
+    void waitForPipeline()
+    {
+        if (!pipelineTask.valid())
+            return; // Already joined
+        try
+        {
+            pipelineTask.get(); // Rethrows anything createRayTracingPipeline threw
+
+            // 5. Create Shader Binding Table (Requires pipeline)
+            createShaderBindingTable(); // Creates SBT entries (rgenSBT, missSBT, chitSBT)
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Ray Tracing Pipeline creation failed: " << e.what() << std::endl;
+            cleanup();
+            throw;
+        }
+        std::cout << "Ray Tracing Manager Initialized Successfully." << std::endl;
     }
 
     // --- cleanup ---
@@ -744,20 +1511,46 @@ namespace Kinesis::RayTracerManager
             return;
 
         std::cout << "Cleaning up Ray Tracing Manager..." << std::endl;
+        // A pipeline still compiling on the worker thread must finish before its layouts go away
+        if (pipelineTask.valid())
+        {
+            pipelineTask.wait();
+            pipelineTask = std::future<void>(); // Drop any stored error along with the task
+        }
+        // Same for a pipeline variant still compiling
+        if (variantTask.valid())
+        {
+            try
+            {
+                PipelineVariant variant = variantTask.get();
+                vkDestroyPipeline(g_Device, variant.pipeline, nullptr);
+                if (variant.queryPipeline != VK_NULL_HANDLE)
+                    vkDestroyPipeline(g_Device, variant.queryPipeline, nullptr);
+            }
+            catch (const std::exception &)
+            {
+                // Nothing was created
+            }
+        }
         // Ensure all GPU operations are finished before destroying resources
         vkDeviceWaitIdle(g_Device);
 
+        // Destroy inactive pipeline variants along with their SBTs
+        for (auto &variant : cachedVariants)
+        {
+            vkDestroyPipeline(g_Device, variant.pipeline, nullptr);
+            if (variant.queryPipeline != VK_NULL_HANDLE)
+                vkDestroyPipeline(g_Device, variant.queryPipeline, nullptr);
+            destroySBTEntry(variant.rgen);
+            destroySBTEntry(variant.miss);
+            destroySBTEntry(variant.hit);
+        }
+        cachedVariants.clear();
+        failedVariants.clear();
+        pipelineVariantSwitches = 0;
+        destroyRtShaderModules();
+
         // Destroy SBT Buffers
-        auto destroySBTEntry = [&](ShaderBindingTableEntry &entry)
-        {
-            if (g_Device == VK_NULL_HANDLE)
-                return; // Check again inside lambda
-            if (entry.buffer != VK_NULL_HANDLE)
-                vkDestroyBuffer(g_Device, entry.buffer, nullptr);
-            if (entry.memory != VK_NULL_HANDLE)
-                vkFreeMemory(g_Device, entry.memory, nullptr);
-            entry = {}; // Reset struct
-        };
         destroySBTEntry(rgenSBT);
         destroySBTEntry(missSBT);
         destroySBTEntry(chitSBT);
@@ -771,6 +1564,13 @@ namespace Kinesis::RayTracerManager
             rtPipeline = VK_NULL_HANDLE;
             std::cout << "  - RT Pipeline destroyed." << std::endl;
         }
+        if (rtQueryPipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(g_Device, rtQueryPipeline, nullptr);
+            rtQueryPipeline = VK_NULL_HANDLE;
+        }
+        destroyRtComputePipelines();
+        destroyTraceTimestamps();
 
         // Destroy Layouts
         // Global layout (Set 0) is cleaned up in kinesis.cpp
@@ -786,7 +1586,12 @@ namespace Kinesis::RayTracerManager
             rtDescriptorSetLayout = VK_NULL_HANDLE;
             std::cout << "  - RT Descriptor Set Layout destroyed." << std::endl;
         }
-        // Descriptor set (rtDescriptorSet) is freed when the pool (g_DescriptorPool) is destroyed
+        if (rtUpdateTemplate != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorUpdateTemplate(g_Device, rtUpdateTemplate, nullptr);
+            rtUpdateTemplate = VK_NULL_HANDLE;
+        }
+        // Descriptor sets (rtDescriptorSets) are freed when the pool (g_DescriptorPool) is destroyed
 
         // Destroy Acceleration Structures
         // Use the helper which now calls the function pointer (pfn prefix)
@@ -801,7 +1606,10 @@ namespace Kinesis::RayTracerManager
             if (tlas.buffer != VK_NULL_HANDLE)
                 vkDestroyBuffer(g_Device, tlas.buffer, nullptr);
             if (tlas.memory != VK_NULL_HANDLE)
+            {
+                MemoryBudget::untrack(tlas.memory);
                 vkFreeMemory(g_Device, tlas.memory, nullptr);
+            }
             tlas = {}; // Reset struct
         }
 
@@ -812,14 +1620,15 @@ namespace Kinesis::RayTracerManager
         }
         if (instances_buffer_memory != VK_NULL_HANDLE)
         {
+            MemoryBudget::untrack(instances_buffer_memory);
             vkFreeMemory(g_Device, instances_buffer_memory, nullptr);
             instances_buffer_memory = VK_NULL_HANDLE;
             std::cout << "  - Instance Buffer destroyed." << std::endl;
         }
 
-        for (auto &b : blas)
+        for (auto &entry : blas)
         {
-            delete_acceleration_structure(b); // Use helper
+            delete_acceleration_structure(entry.second); // Use helper
         }
         blas.clear();
         std::cout << "  - BLASes destroyed." << std::endl;
@@ -836,158 +1645,161 @@ namespace Kinesis::RayTracerManager
             std::cout << "  - Build Command Pool destroyed." << std::endl;
         }
 
-        rtDescriptorSet = VK_NULL_HANDLE; // Reset the handle (memory freed with pool)
+        instanceDataBuffer.reset();
+        sampleBudgetTotals.reset();
+        LightList::cleanup();
+        instanceTableState = {};
+        for (auto &staging : instanceStaging)
+            staging.reset();
+        delete_scratch_buffer(tlasScratch);
+        delete_scratch_buffer(refitScratch);
+        refitScratchSize = 0;
+        delete_scratch_buffer(scheduledScratch);
+        scheduledScratchSize = 0;
+        scheduledBuilds.clear();
+        ASBuildScheduler::cleanup();
+        Denoiser::cleanup();
+        dynamicBlasStates.clear();
+        tlasInstanceObjects.clear();
+        tlasInstanceRecords.clear();
+        tlasAllowsUpdate = false;
+        tlasInstanceCapacity = 0;
+        tlasInstancesDirty = false;
+
+        // The device is idle, so everything retired above can go right away
+        DeletionQueue::flush();
+
+        rtDescriptorSet = VK_NULL_HANDLE; // Reset the handles (memory freed with pool)
+        rtDescriptorSets.fill(VK_NULL_HANDLE);
+        rtDescriptorStates.fill(RtDescriptorState{});
         std::cout << "Ray Tracing Manager Cleanup Finished." << std::endl;
     }
 
+    // Rewrites the per-instance table when some mesh's pool range or a heap handle changed.
+    // The table is shared by all frame slots; only resident objects' entries are written, and
+    // evicted ones keep their stale values since in-flight frames may still trace them.
+    void updateInstanceTable()
+    {
+        if (!instanceDataBuffer)
+        {
+            instanceDataBuffer = std::make_unique<Buffer>(
+                sizeof(InstanceData),
+                MAX_SCENE_OBJECTS,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            instanceDataBuffer->map();
+            memset(instanceDataBuffer->getMappedMemory(), 0, static_cast<size_t>(instanceDataBuffer->getBufferSize()));
+        }
+
+        InstanceTableState current{};
+        current.rangeGeneration = GeometryPool::getRangeGeneration();
+        current.objectCount = Kinesis::gameObjects.size();
+        current.vertexBuffer = GeometryPool::getVertexBufferHandle();
+        current.indexBuffer = GeometryPool::getIndexBufferHandle();
+        current.materialBuffer = Kinesis::materialBufferHandle;
+        if (current.rangeGeneration == instanceTableState.rangeGeneration && current.objectCount == instanceTableState.objectCount &&
+            current.vertexBuffer == instanceTableState.vertexBuffer && current.indexBuffer == instanceTableState.indexBuffer &&
+            current.materialBuffer == instanceTableState.materialBuffer)
+            return;
+
+        auto *entries = static_cast<InstanceData *>(instanceDataBuffer->getMappedMemory());
+        for (size_t i = 0; i < Kinesis::gameObjects.size() && i < MAX_SCENE_OBJECTS; ++i)
+        {
+            const auto &go = Kinesis::gameObjects[i];
+            if (go.model && go.model->isResident())
+            {
+                entries[i] = {current.vertexBuffer, current.indexBuffer,
+                              go.model->getVertexOffset(), go.model->getFirstIndex(), go.model->getIndexCount(),
+                              current.materialBuffer, static_cast<uint32_t>(i), 0};
+            }
+        }
+        instanceTableState = current;
+    }
+
     // --- allocateAndUpdateRtDescriptorSet ---
-    // Updates the RT-specific descriptor set (Set 1)
-    void allocateAndUpdateRtDescriptorSet(VkAccelerationStructureKHR tlasHandle, VkBuffer /*camBuffer*/, VkDeviceSize /*camBufSize*/)
+    // Updates the RT-specific descriptor set (Set 1) of a frame slot, only when something it references changed
+    void allocateAndUpdateRtDescriptorSet(VkAccelerationStructureKHR tlasHandle, int frameIndex)
     {
         assert(rtDescriptorSetLayout != VK_NULL_HANDLE && "RT Descriptor Set Layout must be created first");
+        assert(rtUpdateTemplate != VK_NULL_HANDLE && "RT Descriptor Update Template must be created first");
         assert(g_DescriptorPool != VK_NULL_HANDLE && "Global Descriptor Pool is null");
         assert(rtOutput.view != VK_NULL_HANDLE && "RT Output Image View must be created first");
         // Assert for GBuffer resources
         assert(Kinesis::GBuffer::sampler != VK_NULL_HANDLE && "G-Buffer Sampler missing");
         assert(Kinesis::GBuffer::positionAttachment.view != VK_NULL_HANDLE && "G-Buffer Position View missing");
         // ... (assert other GBuffer views) ...
-        assert(Kinesis::materialBuffer != nullptr && Kinesis::materialBuffer->getBuffer() != VK_NULL_HANDLE && "Material Buffer is missing!"); // <<< NEW ASSERT >>>
+        assert(Kinesis::materialBufferHandle != BindlessHeap::INVALID_HANDLE && "Material Buffer is not registered in the bindless heap!");
         assert(tlasHandle != VK_NULL_HANDLE && "TLAS Handle missing");
+        assert(frameIndex >= 0 && frameIndex < SwapChain::MAX_FRAMES_IN_FLIGHT && "Frame index out of range");
 
-        if (rtDescriptorSet == VK_NULL_HANDLE) {
+        VkDescriptorSet &set = rtDescriptorSets[frameIndex];
+        if (set == VK_NULL_HANDLE) {
              VkDescriptorSetAllocateInfo allocInfo{};
              allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
              allocInfo.descriptorPool = g_DescriptorPool;
              allocInfo.descriptorSetCount = 1;
              allocInfo.pSetLayouts = &rtDescriptorSetLayout;
-             
-             // Variable descriptor count info might be needed if strictly required, 
-             // but often redundant if max is fixed in layout.
-             
-             if (vkAllocateDescriptorSets(g_Device, &allocInfo, &rtDescriptorSet) != VK_SUCCESS) {
+
+             if (vkAllocateDescriptorSets(g_Device, &allocInfo, &set) != VK_SUCCESS) {
                  throw std::runtime_error("Failed to allocate Ray Tracing descriptor set!");
              }
         }
+        rtDescriptorSet = set;
 
-        std::vector<VkWriteDescriptorSet> descriptorWrites;
-        
-        // --- Standard Bindings (0-6) ---
-        // 0: TLAS
-        VkWriteDescriptorSetAccelerationStructureKHR tlasWriteInfo{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET_ACCELERATION_STRUCTURE_KHR};
-        tlasWriteInfo.accelerationStructureCount = 1;
-        tlasWriteInfo.pAccelerationStructures = &tlasHandle;
-        
-        VkWriteDescriptorSet tlasWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-        tlasWrite.dstSet = rtDescriptorSet;
-        tlasWrite.dstBinding = 0;
-        tlasWrite.descriptorType = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
-        tlasWrite.descriptorCount = 1;
-        tlasWrite.pNext = &tlasWriteInfo;
-        descriptorWrites.push_back(tlasWrite);
-
-        // 1: Output Image
-        VkDescriptorImageInfo outputImageInfo{VK_NULL_HANDLE, rtOutput.view, VK_IMAGE_LAYOUT_GENERAL};
-        VkWriteDescriptorSet outWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-        outWrite.dstSet = rtDescriptorSet;
-        outWrite.dstBinding = 1;
-        outWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-        outWrite.descriptorCount = 1;
-        outWrite.pImageInfo = &outputImageInfo;
-        descriptorWrites.push_back(outWrite);
-
-        // 2: Material Buffer
-        VkDescriptorBufferInfo matBufInfo = Kinesis::materialBuffer->descriptorInfo();
-        VkWriteDescriptorSet matWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-        matWrite.dstSet = rtDescriptorSet;
-        matWrite.dstBinding = 2;
-        matWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        matWrite.descriptorCount = 1;
-        matWrite.pBufferInfo = &matBufInfo;
-        descriptorWrites.push_back(matWrite);
-
-        // 3-6: G-Buffer Samplers (Keep your existing GBuffer logic here, simplified for brevity)
-        std::vector<VkDescriptorImageInfo> gbufferInfos = {
-            {GBuffer::sampler, GBuffer::positionAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-            {GBuffer::sampler, GBuffer::normalAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-            {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL},
-            {GBuffer::sampler, GBuffer::propertiesAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL}
-        };
-        for(int i=0; i<4; ++i) {
-            VkWriteDescriptorSet gbWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-            gbWrite.dstSet = rtDescriptorSet;
-            gbWrite.dstBinding = 3 + i;
-            gbWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            gbWrite.descriptorCount = 1;
-            gbWrite.pImageInfo = &gbufferInfos[i];
-            descriptorWrites.push_back(gbWrite);
-        }
-
-        // --- Bindless Arrays (7 & 8) ---
-        // Collect buffers from all objects
-       // Resize vectors to match gameObjects size exactly
-std::vector<VkDescriptorBufferInfo> vertexBufferInfos(Kinesis::gameObjects.size());
-std::vector<VkDescriptorBufferInfo> indexBufferInfos(Kinesis::gameObjects.size());
-
-// Fallback buffer (e.g., floor) to prevent crashes on null slots
-auto fallbackVert = Kinesis::gameObjects[0].model->getVertexBuffer();
-
-for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
-    const auto& go = Kinesis::gameObjects[i];
-
-    if (go.model && go.model->getVertexBuffer() != VK_NULL_HANDLE) {
-        // Valid object: Bind its actual buffers
-        vertexBufferInfos[i] = {go.model->getVertexBuffer(), 0, VK_WHOLE_SIZE};
-
-        if (go.model->getIndexBuffer() != VK_NULL_HANDLE) {
-            indexBufferInfos[i] = {go.model->getIndexBuffer(), 0, VK_WHOLE_SIZE};
-        } else {
-            // Bind vertex buffer as dummy index buffer if missing
-            indexBufferInfos[i] = {go.model->getVertexBuffer(), 0, VK_WHOLE_SIZE};
-        }
-    } else {
-        // Empty/Light/Camera object: Bind fallback to keep indices aligned
-        vertexBufferInfos[i] = {fallbackVert, 0, VK_WHOLE_SIZE};
-        indexBufferInfos[i] = {fallbackVert, 0, VK_WHOLE_SIZE};
-    }
-}
-
-        if (!vertexBufferInfos.empty()) {
-            // 7: Vertex Buffers Array
-            VkWriteDescriptorSet vertArrayWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-            vertArrayWrite.dstSet = rtDescriptorSet;
-            vertArrayWrite.dstBinding = 7;
-            vertArrayWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            vertArrayWrite.descriptorCount = static_cast<uint32_t>(vertexBufferInfos.size());
-            vertArrayWrite.pBufferInfo = vertexBufferInfos.data();
-            descriptorWrites.push_back(vertArrayWrite);
-
-            // 8: Index Buffers Array
-            VkWriteDescriptorSet indexArrayWrite{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-            indexArrayWrite.dstSet = rtDescriptorSet;
-            indexArrayWrite.dstBinding = 8;
-            indexArrayWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-            indexArrayWrite.descriptorCount = static_cast<uint32_t>(indexBufferInfos.size());
-            indexArrayWrite.pBufferInfo = indexBufferInfos.data();
-            descriptorWrites.push_back(indexArrayWrite);
-        }
-
-        vkUpdateDescriptorSets(g_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+        updateInstanceTable();
+        LightList::update();
+        if (!sampleBudgetTotals)
+        {
+            sampleBudgetTotals = std::make_unique<Buffer>(
+                sizeof(uint32_t),
+                3, // weightSum, pixelCount, minimumSum (raytrace_budget.comp)
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+
+        RtDescriptorState current{};
+        current.written = true;
+        current.tlas = tlasHandle;
+        current.tlasGeneration = tlasGeneration;
+        current.outputGeneration = rtOutput.generation; // The other RT images are always recreated with it
+        current.gbufferGeneration = GBuffer::generation;
+        current.lightGeneration = LightList::getGeneration();
+        if (rtDescriptorStates[frameIndex] == current)
+            return; // Nothing changed since this slot was last written
+
+        RtDescriptorData data{};
+        data.tlas = tlasHandle;
+        data.output = {VK_NULL_HANDLE, rtOutput.view, VK_IMAGE_LAYOUT_GENERAL};
+        data.accumulation = {VK_NULL_HANDLE, rtAccumulation.view, VK_IMAGE_LAYOUT_GENERAL};
+        data.statistics = {VK_NULL_HANDLE, rtStatistics.view, VK_IMAGE_LAYOUT_GENERAL};
+        data.sampleBudget = {VK_NULL_HANDLE, rtSampleBudget.view, VK_IMAGE_LAYOUT_GENERAL};
+        data.budgetTotals = sampleBudgetTotals->descriptorInfo();
+        data.pixelList = {rtPixelList.buffer, 0, VK_WHOLE_SIZE};
+        data.lights = LightList::descriptorInfo();
+        data.reservoirs = {rtReservoirs.buffer, 0, VK_WHOLE_SIZE};
+        data.gbuffer[0] = {GBuffer::sampler, GBuffer::positionAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        data.gbuffer[1] = {GBuffer::sampler, GBuffer::normalAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        data.gbuffer[2] = {GBuffer::sampler, GBuffer::albedoAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        data.gbuffer[3] = {GBuffer::sampler, GBuffer::propertiesAttachment.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        // The hit shader finds its geometry and material through the instance table, indexed by
+        // the instance custom index (= object index); the buffers themselves are in the heap.
+        data.instances = instanceDataBuffer->descriptorInfo();
+
+        vkUpdateDescriptorSetWithTemplate(g_Device, set, rtUpdateTemplate, &data);
+        rtDescriptorStates[frameIndex] = current;
     }
 
     // --- bind ---
-    // Binds the RT pipeline and its descriptor sets
-    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalSet)
+    // Binds the RT descriptor sets. The pipeline variant is bound by traceRays, all variants share the layout.
+    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalSet, uint32_t globalOffset)
     { // Pass global set
         if (!Kinesis::GUI::raytracing_available || rtPipeline == VK_NULL_HANDLE || rtPipelineLayout == VK_NULL_HANDLE || rtDescriptorSet == VK_NULL_HANDLE || globalSet == VK_NULL_HANDLE)
         {
             std::cerr << "Warning: Attempting to bind uninitialized ray tracing resources or missing global set!" << std::endl;
             return;
         }
-        // Bind the RT pipeline
-        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, rtPipeline);
-
-        // Bind descriptor sets: Set 0 = global, Set 1 = RT specific
-        std::array<VkDescriptorSet, 2> descriptorSetsToBind = {globalSet, rtDescriptorSet};
+        // Bind descriptor sets: Set 0 = global, Set 1 = RT specific, Set 2 = bindless heap
+        std::array<VkDescriptorSet, 3> descriptorSetsToBind = {globalSet, rtDescriptorSet, BindlessHeap::getSet()};
         vkCmdBindDescriptorSets(
             commandBuffer,
             VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR,
@@ -995,11 +1807,19 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
             0,                                                  // First set index to bind
             static_cast<uint32_t>(descriptorSetsToBind.size()), // Number of sets to bind
             descriptorSetsToBind.data(),                        // Pointer to array of sets
-            0, nullptr);                                        // No dynamic offsets
+            1, &globalOffset);                                  // Camera UBO (set 0) lives in the uniform ring
+        // The ray query backend uses the same layout from the compute bind point
+        if (rtQueryPipeline != VK_NULL_HANDLE)
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtPipelineLayout, 0,
+                                    static_cast<uint32_t>(descriptorSetsToBind.size()), descriptorSetsToBind.data(),
+                                    1, &globalOffset);
+        }
     }
 
     // --- traceRays ---
-    void traceRays(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height, int samplesPerPixel, int maxDepth)
+    void traceRays(VkCommandBuffer commandBuffer, int frameIndex, uint32_t width, uint32_t height, int samplesPerPixel, int maxDepth, bool hybridPrimary,
+                   const glm::mat4 &viewProjection)
     {
         // Check if the required function pointer is loaded (with pfn prefix)
         if (!pfnCmdTraceRaysKHR)
@@ -1007,28 +1827,215 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
             std::cerr << "Error: vkCmdTraceRaysKHR function pointer not loaded! Cannot trace rays." << std::endl;
             return; // Or throw
         }
-        assert(rgenSBT.buffer != VK_NULL_HANDLE);
-        assert(missSBT.buffer != VK_NULL_HANDLE);
-        assert(chitSBT.buffer != VK_NULL_HANDLE);
 
-        // Push constants for ray tracing parameters
-        struct RayTracingPushConstants {
-            int samplesPerPixel;
-            int maxDepth;
-        } pushConstants;
-        pushConstants.samplesPerPixel = samplesPerPixel;
-        pushConstants.maxDepth = maxDepth;
+        // Ray tracing parameters are specialization constants: trace with the variant compiled for them,
+        // or with the active one while it compiles
+        usePipelineVariant({samplesPerPixel, maxDepth, hybridPrimary ? VK_TRUE : VK_FALSE});
 
-        vkCmdPushConstants(commandBuffer, rtPipelineLayout, VK_SHADER_STAGE_RAYGEN_BIT_KHR, 0, sizeof(RayTracingPushConstants), &pushConstants);
+        if (traceQueryPool == VK_NULL_HANDLE && traceTimestampsSupported)
+            createTraceQueryPool();
+        readBackTraceTime(frameIndex);
+        // Both timestamps wait for all prior work, so the measurement starts once the G-buffer is done
+        if (traceQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdResetQueryPool(commandBuffer, traceQueryPool, 2 * frameIndex, 2);
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, traceQueryPool, 2 * frameIndex);
+        }
 
-        // Call function via loaded pointer (with pfn prefix)
-        pfnCmdTraceRaysKHR(
-            commandBuffer,
-            &rgenSBT.addressRegion, // RayGen SBT entry info
-            &missSBT.addressRegion, // Miss SBT entry info
-            &chitSBT.addressRegion, // Hit Group SBT entry info
-            &callableSBT.addressRegion,                // Callable SBT entry info (if used)
-            width, height, 1);      // Dimensions of the ray dispatch
+        // At reduced resolution one pixel per block is traced (which one depends on the frame and pattern)
+        // and the upsampler fills in the rest; a different pattern invalidates the per-pixel averages
+        const TraceResolution resolution = rtUpsamplePipeline != VK_NULL_HANDLE ? traceResolution : TraceResolution::Full;
+        if (resolution != lastTraceResolution || subpixelPattern != lastSubpixelPattern)
+        {
+            Accumulation::reset();
+            lastTraceResolution = resolution;
+            lastSubpixelPattern = subpixelPattern;
+        }
+        const VkExtent2D block = getTraceBlockSize(resolution);
+        const uint32_t launchWidth = (width + block.width - 1) / block.width;
+        const uint32_t launchHeight = (height + block.height - 1) / block.height;
+
+        // Adaptive sampling: last frame's budget pass decided each pixel's samples
+        const bool adaptive = adaptiveSampling && rtBudgetPipelines[1] != VK_NULL_HANDLE;
+
+        // Compacted dispatch: the RT pipeline needs the indirect trace, the ray query backend an indirect dispatch
+        const bool rayQuery = useRayQuery && rtQueryPipeline != VK_NULL_HANDLE;
+        const bool compacted = compactDispatch && rtCompactPipelines[1] != VK_NULL_HANDLE && rtPixelList.buffer != VK_NULL_HANDLE &&
+                               (rayQuery || pfnCmdTraceRaysIndirectKHR != nullptr);
+
+        // ReSTIR: only the rasterized primary hit has a reservoir, and only with lights to sample. Last
+        // frame's reservoirs are reused if they were written by the previous frame for the same lights.
+        const bool sampleLights = LightList::enabled && LightList::getLightCount() > 0;
+        const bool restir = restirEnabled && hybridPrimary && sampleLights && rtRestirPipelines[1] != VK_NULL_HANDLE &&
+                            rtReservoirs.buffer != VK_NULL_HANDLE;
+        const uint64_t frameNumber = DeletionQueue::getFrameNumber();
+        const bool restirHistory = restir && restirHistoryValid && restirLastFrame + 1 == frameNumber &&
+                                   restirLightGeneration == LightList::getGeneration();
+
+        // Counted after usePipelineVariant, which starts the accumulation over when it switches variants.
+        // The budget averages the active variant's samples per pixel, so the ray count stays the same.
+        TracePushConstants pushConstants{launchWidth, launchHeight, Accumulation::recordFrame(),
+                                         static_cast<uint32_t>(subpixelPattern), block.width, block.height,
+                                         static_cast<uint32_t>(activeVariantKey.samplesPerPixel),
+                                         adaptive ? static_cast<uint32_t>(std::max(adaptiveMaxSamples, 1)) : 0u,
+                                         compacted ? 1u : 0u,
+                                         sampleLights ? 1u : 0u,
+                                         restir ? 1u : 0u,
+                                         static_cast<uint32_t>(std::clamp(restirCandidates, 1, 64)),
+                                         restirHistory ? 1u : 0u,
+                                         {0u, 0u},
+                                         restirPrevViewProjection};
+        vkCmdPushConstants(commandBuffer, rtPipelineLayout, TRACE_PUSH_STAGES, 0, sizeof(TracePushConstants), &pushConstants);
+
+        if (compacted)
+        {
+            // List the pixels of this frame that need rays (diffuse ones get their zero right away),
+            // then turn the list length into the trace's indirect arguments
+            VkMemoryBarrier beforeClear{};
+            beforeClear.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            beforeClear.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT; // Last frame's trace
+            beforeClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, TRACE_STAGES | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 1, &beforeClear, 0, nullptr, 0, nullptr);
+            vkCmdFillBuffer(commandBuffer, rtPixelList.buffer, PIXEL_LIST_COUNT_OFFSET, sizeof(uint32_t), 0);
+
+            VkMemoryBarrier toCompact{};
+            toCompact.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            toCompact.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            toCompact.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toCompact, 0, nullptr, 0, nullptr);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtCompactPipelines[0]);
+            vkCmdDispatch(commandBuffer, (launchWidth + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE,
+                          (launchHeight + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE, 1);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toCompact, 0, nullptr, 0, nullptr);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtCompactPipelines[1]);
+            vkCmdDispatch(commandBuffer, 1, 1, 1);
+        }
+
+        if (restir)
+        {
+            // Candidates and temporal reuse, then spatial reuse. Last frame's trace read the final set
+            // this frame's first pass reads back and the second pass overwrites.
+            VkMemoryBarrier toRestir{};
+            toRestir.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            toRestir.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            toRestir.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, TRACE_STAGES, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toRestir, 0, nullptr, 0, nullptr);
+            const uint32_t groupsX = (width + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE;
+            const uint32_t groupsY = (height + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtRestirPipelines[0]);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toRestir, 0, nullptr, 0, nullptr);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtRestirPipelines[1]);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+            restirHistoryValid = true;
+            restirLastFrame = frameNumber;
+            restirLightGeneration = LightList::getGeneration();
+            restirPrevViewProjection = viewProjection;
+        }
+
+        if (adaptive || compacted || restir)
+        {
+            // The budget (last frame), the pixel list and the reservoirs (just now) were written by compute shaders
+            VkMemoryBarrier computeToTrace{};
+            computeToTrace.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            computeToTrace.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            computeToTrace.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, TRACE_STAGES | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                 0, 1, &computeToTrace, 0, nullptr, 0, nullptr);
+        }
+
+        if (rayQuery)
+        {
+            // Same shading code and specialization as the pipeline; the launch size replaces gl_LaunchSizeEXT
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtQueryPipeline);
+            if (compacted)
+                vkCmdDispatchIndirect(commandBuffer, rtPixelList.buffer, PIXEL_LIST_DISPATCH_ARGS_OFFSET);
+            else
+                vkCmdDispatch(commandBuffer, (launchWidth + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE,
+                              (launchHeight + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE, 1);
+        }
+        else
+        {
+            assert(rgenSBT.buffer != VK_NULL_HANDLE);
+            assert(missSBT.buffer != VK_NULL_HANDLE);
+            assert(chitSBT.buffer != VK_NULL_HANDLE);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, rtPipeline);
+
+            if (compacted)
+            {
+                // One invocation per listed pixel, sized on the GPU
+                pfnCmdTraceRaysIndirectKHR(commandBuffer, &rgenSBT.addressRegion, &missSBT.addressRegion,
+                                           &chitSBT.addressRegion, &callableSBT.addressRegion,
+                                           rtPixelList.address + PIXEL_LIST_TRACE_ARGS_OFFSET);
+            }
+            else
+            {
+                // Call function via loaded pointer (with pfn prefix)
+                pfnCmdTraceRaysKHR(
+                    commandBuffer,
+                    &rgenSBT.addressRegion,     // RayGen SBT entry info
+                    &missSBT.addressRegion,     // Miss SBT entry info
+                    &chitSBT.addressRegion,     // Hit Group SBT entry info
+                    &callableSBT.addressRegion, // Callable SBT entry info (if used)
+                    launchWidth, launchHeight, 1); // Dimensions of the ray dispatch
+            }
+        }
+
+        if (resolution != TraceResolution::Full)
+        {
+            // Reconstruct the full resolution image from this frame's traced pixels (and older ones in
+            // rtAccumulation). Same layout, so the bound sets and push constants carry over.
+            VkMemoryBarrier traceToUpsample{};
+            traceToUpsample.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            traceToUpsample.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            traceToUpsample.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, TRACE_STAGES, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &traceToUpsample, 0, nullptr, 0, nullptr);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtUpsamplePipeline);
+            vkCmdDispatch(commandBuffer, (width + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE,
+                          (height + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE, 1);
+        }
+
+        if (adaptive)
+        {
+            // Plan next frame's samples from the statistics the trace just updated: sum the noise
+            // weights over the image, then hand out the budget in proportion
+            VkMemoryBarrier beforeClear{};
+            beforeClear.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            beforeClear.srcAccessMask = VK_ACCESS_SHADER_READ_BIT; // Last frame's allocation pass read the totals
+            beforeClear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 1, &beforeClear, 0, nullptr, 0, nullptr);
+            vkCmdFillBuffer(commandBuffer, sampleBudgetTotals->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+            VkMemoryBarrier toBudget{};
+            toBudget.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            toBudget.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+            toBudget.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            vkCmdPipelineBarrier(commandBuffer, TRACE_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toBudget, 0, nullptr, 0, nullptr);
+
+            const uint32_t groupsX = (width + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE;
+            const uint32_t groupsY = (height + RAY_QUERY_GROUP_SIZE - 1) / RAY_QUERY_GROUP_SIZE;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtBudgetPipelines[0]);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &toBudget, 0, nullptr, 0, nullptr);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, rtBudgetPipelines[1]);
+            vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+        }
+
+        if (traceQueryPool != VK_NULL_HANDLE)
+        {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, traceQueryPool, 2 * frameIndex + 1);
+            traceSlotBackends[frameIndex] = rayQuery ? TraceBackend::RayQuery : TraceBackend::Pipeline;
+        }
     }
 
     // --- Single Time Command Helpers ---
@@ -1104,89 +2111,221 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
         vkFreeCommandBuffers(g_Device, buildCommandPool, 1, &commandBuffer);
     }
 
-    // --- create_blas ---
-    void create_blas()
+    // --- compact_blas ---
+    // Copies freshly built BLAS (built with ALLOW_COMPACTION) into allocations of their compacted size,
+    // read from the query pool filled right after the build. Originals are retired through the DeletionQueue.
+    void compact_blas(const std::vector<Model *> &models, std::vector<AccelerationStructure> &structures, VkQueryPool queryPool)
     {
-        // Check required function pointers (with pfn prefix)
-        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
+        std::vector<VkDeviceSize> compactedSizes(structures.size(), 0);
+        if (vkGetQueryPoolResults(g_Device, queryPool, 0, static_cast<uint32_t>(structures.size()),
+                                  compactedSizes.size() * sizeof(VkDeviceSize), compactedSizes.data(), sizeof(VkDeviceSize),
+                                  VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS)
         {
-            throw std::runtime_error("Required BLAS build function pointers not loaded!");
+            std::cerr << "Warning: Failed to read BLAS compacted sizes, keeping uncompacted BLAS." << std::endl;
+            return;
         }
 
-        // Clean up existing BLAS first
-        for (auto &b : blas)
-            delete_acceleration_structure(b);
-        blas.clear();
-
-        // Resize blas vector to match gameObjects size, with null entries for objects without BLAS
-        blas.resize(Kinesis::gameObjects.size());
-        
-        for (size_t objectIndex = 0; objectIndex < Kinesis::gameObjects.size(); ++objectIndex)
+        std::vector<AccelerationStructure> compacted(structures.size());
+        VkCommandBuffer cmdBuf = VK_NULL_HANDLE;
+        for (size_t i = 0; i < structures.size(); ++i)
         {
-            const auto &gameObject = Kinesis::gameObjects[objectIndex];
-            
-            if (!gameObject.model || !gameObject.model->getMesh() || gameObject.model->getMesh()->numVertices() == 0)
+            if (compactedSizes[i] == 0 || compactedSizes[i] >= structures[i].size)
+                continue; // Nothing to gain (or the driver reported nothing)
+
+            AccelerationStructure &target = compacted[i];
+            try
             {
-                // No BLAS for this object - leave it as default-initialized (address = 0)
+                Kinesis::Window::createBuffer(compactedSizes[i],
+                                              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                              target.buffer, target.memory,
+                                              MemoryBudget::Category::AccelerationStructure);
+            }
+            catch (const std::exception &e)
+            {
+                // Keep the uncompacted one for this model
+                std::cerr << "Warning: " << e.what() << " Keeping an uncompacted BLAS." << std::endl;
+                target = {};
                 continue;
             }
+            target.size = compactedSizes[i];
 
-            // 1. Get Geometry Data Pointers/Addresses
-            VkBuffer vertexBuffer = gameObject.model->getVertexBuffer();
-            VkBuffer indexBuffer = gameObject.model->getIndexBuffer(); // Get index buffer
-            bool hasIndices = gameObject.model->getMesh()->hasIndices();
-
-            if (vertexBuffer == VK_NULL_HANDLE || (hasIndices && indexBuffer == VK_NULL_HANDLE))
+            VkAccelerationStructureCreateInfoKHR createInfo{};
+            createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+            createInfo.buffer = target.buffer;
+            createInfo.size = compactedSizes[i];
+            createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            if (pfnCreateAccelerationStructureKHR(g_Device, &createInfo, nullptr, &target.structure) != VK_SUCCESS)
             {
-                std::cerr << "Warning: Skipping BLAS creation for GameObject '" << gameObject.name << "' due to missing buffers." << std::endl;
+                // Keep the uncompacted one for this model
+                delete_acceleration_structure(target);
+                continue;
+            }
+            VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+            addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+            addressInfo.accelerationStructure = target.structure;
+            target.address = pfnGetAccelerationStructureDeviceAddressKHR(g_Device, &addressInfo);
+
+            if (cmdBuf == VK_NULL_HANDLE)
+                cmdBuf = beginSingleTimeCommands();
+            VkCopyAccelerationStructureInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR};
+            copyInfo.src = structures[i].structure;
+            copyInfo.dst = target.structure;
+            copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR;
+            pfnCmdCopyAccelerationStructureKHR(cmdBuf, &copyInfo);
+        }
+        if (cmdBuf == VK_NULL_HANDLE)
+            return; // Nothing was worth compacting
+
+        // Barrier: compacted copies must be complete before TLAS builds / shaders read them
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(cmdBuf); // One submit for every copy
+
+        VkDeviceSize totalBefore = 0;
+        VkDeviceSize totalAfter = 0;
+        for (size_t i = 0; i < structures.size(); ++i)
+        {
+            if (compacted[i].structure == VK_NULL_HANDLE)
                 continue;
+
+            const VkDeviceSize before = structures[i].size;
+            const VkDeviceSize after = compacted[i].size;
+            std::string name = "<unnamed>";
+            for (const auto &gameObject : Kinesis::gameObjects)
+            {
+                if (gameObject.model.get() == models[i])
+                {
+                    name = gameObject.name;
+                    break;
+                }
             }
+            std::cout << "  BLAS compaction '" << name << "': " << (before >> 10) << " KiB -> " << (after >> 10) << " KiB ("
+                      << (100 * (before - after) / before) << "% saved)." << std::endl;
+            totalBefore += before;
+            totalAfter += after;
+
+            delete_acceleration_structure(structures[i]); // Retired; nothing has referenced it yet
+            structures[i] = compacted[i];
+        }
+        blasCompactionSavedBytes += totalBefore - totalAfter;
+        std::cout << "BLAS compaction saved " << ((totalBefore - totalAfter) >> 10) << " KiB ("
+                  << (totalBefore >> 10) << " KiB -> " << (totalAfter >> 10) << " KiB)." << std::endl;
+    }
 
-            uint64_t vertexBufferAddress = getBufferDeviceAddress(vertexBuffer);                // Uses helper -> pointer
-            uint64_t indexBufferAddress = hasIndices ? getBufferDeviceAddress(indexBuffer) : 0; // Uses helper -> pointer
-            uint32_t vertexCount = gameObject.model->getMesh()->numVertices();
-            uint32_t indexCount = gameObject.model->getMesh()->numIndices();
-            // Calculate primitive count based on indices or vertices
-            uint32_t primitiveCount = hasIndices ? (indexCount / 3) : (vertexCount / 3);
+    // Triangle geometry of a model's range in the shared GeometryPool buffers
+    VkAccelerationStructureGeometryKHR makeBlasGeometry(const Model *model)
+    {
+        uint64_t vertexBufferAddress = getBufferDeviceAddress(GeometryPool::getVertexBuffer()) +
+                                       static_cast<uint64_t>(model->getVertexOffset()) * sizeof(Kinesis::Mesh::Vertex);
+        uint64_t indexBufferAddress = getBufferDeviceAddress(GeometryPool::getIndexBuffer()) +
+                                      static_cast<uint64_t>(model->getFirstIndex()) * sizeof(uint32_t);
+
+        VkAccelerationStructureGeometryKHR accelGeom{};
+        accelGeom.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+        accelGeom.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        accelGeom.flags = VK_GEOMETRY_OPAQUE_BIT_KHR; // Assume opaque for now, can be based on material later
+        accelGeom.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+        accelGeom.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; // Match Kinesis::Mesh::Vertex position
+        accelGeom.geometry.triangles.vertexData.deviceAddress = vertexBufferAddress;
+        accelGeom.geometry.triangles.vertexStride = sizeof(Kinesis::Mesh::Vertex); // Stride is the size of the vertex struct
+        accelGeom.geometry.triangles.maxVertex = model->getVertexCount() - 1;      // Highest vertex index used (indices are range-relative)
+        accelGeom.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+        accelGeom.geometry.triangles.indexData.deviceAddress = indexBufferAddress;
+        accelGeom.geometry.triangles.transformData = {}; // No transform for BLAS geometry itself
+        return accelGeom;
+    }
 
-            if (primitiveCount == 0)
+    // Dynamic BLAS are refit, so they trade trace speed for build speed and never get compacted
+    VkBuildAccelerationStructureFlagsKHR blasBuildFlags(const Model *model, bool compact)
+    {
+        if (model->isDynamic())
+            return VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_BUILD_BIT_KHR;
+        VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+        if (compact)
+            flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR;
+        return flags;
+    }
+
+    // Undoes prepareBlasBuilds when a later step throws before the builds were submitted: the new AS objects
+    // and buffers are retired and their models are left without a BLAS
+    void discardBlasBuilds(std::vector<PendingBuild> &builds)
+    {
+        for (auto &build : builds)
+        {
+            delete_acceleration_structure(build.blasEntry);
+            dynamicBlasStates.erase(build.model);
+        }
+        builds.clear();
+    }
+
+    // Steps 1-4 of a BLAS build, shared by build_blas and recordBlasBuilds: drops each model's old BLAS,
+    // queries the build sizes and creates the new (still empty) AS objects. Nothing is recorded yet.
+    // If creating one throws, everything created so far is discarded before the exception propagates.
+    void prepareBlasBuilds(const std::vector<Model *> &models, bool compact, std::vector<PendingBuild> &builds)
+    {
+        builds.clear();
+        builds.reserve(models.size()); // pGeometries point into builds, it must never reallocate
+
+        const VkBuffer vertexBuffer = GeometryPool::getVertexBuffer();
+        const VkBuffer indexBuffer = GeometryPool::getIndexBuffer();
+        const VkDeviceSize scratchAlignment = as_properties.minAccelerationStructureScratchOffsetAlignment;
+
+        for (Model *model : models)
+        {
+            if (!model || std::any_of(builds.begin(), builds.end(), [model](const PendingBuild &build)
+                                      { return build.model == model; }))
+                continue;
+
+            // Drop whatever was built for this model before
+            release_blas(model);
+
+            if (!model->getMesh() || model->getMesh()->numVertices() == 0)
             {
-                std::cerr << "Warning: Skipping BLAS creation for GameObject '" << gameObject.name << "' due to zero primitives." << std::endl;
+                // No BLAS for this model - instances using it are left out of the TLAS
                 continue;
             }
 
-            // 2. Define Acceleration Structure Geometry (Triangles)
-            VkAccelerationStructureGeometryKHR accelGeom{};
-            accelGeom.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-            accelGeom.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-            accelGeom.flags = VK_GEOMETRY_OPAQUE_BIT_KHR; // Assume opaque for now, can be based on material later
-            accelGeom.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-            accelGeom.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT; // Match Kinesis::Mesh::Vertex position
-            accelGeom.geometry.triangles.vertexData.deviceAddress = vertexBufferAddress;
-            accelGeom.geometry.triangles.vertexStride = sizeof(Kinesis::Mesh::Vertex); // Stride is the size of the vertex struct
-            accelGeom.geometry.triangles.maxVertex = vertexCount - 1;                  // Highest vertex index used
-
-            if (hasIndices)
+            // 1. Get Geometry Data Pointers/Addresses
+            // All meshes live in the shared GeometryPool buffers; point the build at this model's range.
+            if (!model->isResident() || vertexBuffer == VK_NULL_HANDLE || indexBuffer == VK_NULL_HANDLE)
             {
-                accelGeom.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32; // Assuming 32-bit indices
-                accelGeom.geometry.triangles.indexData.deviceAddress = indexBufferAddress;
+                std::cerr << "Warning: Skipping BLAS creation for a model due to missing buffers." << std::endl;
+                continue;
             }
-            else
+
+            // The pool generates indices for non-indexed meshes, so every mesh is indexed here
+            uint32_t primitiveCount = model->getIndexCount() / 3;
+
+            if (primitiveCount == 0)
             {
-                accelGeom.geometry.triangles.indexType = VK_INDEX_TYPE_NONE_KHR; // Not using indices
-                accelGeom.geometry.triangles.indexData.deviceAddress = 0;
+                std::cerr << "Warning: Skipping BLAS creation for a model with zero primitives." << std::endl;
+                continue;
             }
-            accelGeom.geometry.triangles.transformData = {}; // No transform for BLAS geometry itself
+
+            builds.emplace_back();
+            PendingBuild &build = builds.back();
+            build.model = model;
+            build.compactable = compact && !model->isDynamic();
+
+            // 2. Define Acceleration Structure Geometry (Triangles)
+            VkAccelerationStructureGeometryKHR &accelGeom = build.geometry;
+            accelGeom = makeBlasGeometry(model);
 
             // 3. Get Build Sizes
-            VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo{};
+            VkAccelerationStructureBuildGeometryInfoKHR &buildGeomInfo = build.buildInfo;
             buildGeomInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
             buildGeomInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-            // Prefer fast trace, allow updates if needed later (though BLAS updates are less common)
-            buildGeomInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+            buildGeomInfo.flags = blasBuildFlags(model, compact);
             buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR; // Build mode
             buildGeomInfo.geometryCount = 1;                                     // One geometry description per BLAS for simplicity
-            buildGeomInfo.pGeometries = &accelGeom;
+            buildGeomInfo.pGeometries = &accelGeom;                              // builds is reserved, so this never moves
 
             VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo{};
             buildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
@@ -1197,240 +2336,735 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
                 &buildGeomInfo,
                 &primitiveCount, // Number of triangles/primitives
                 &buildSizesInfo);
+            build.scratchSize = Kinesis::Buffer::getAlignment(buildSizesInfo.buildScratchSize, scratchAlignment);
+            if (model->isDynamic())
+            {
+                DynamicBlasState &state = dynamicBlasStates[model];
+                state = {};
+                state.vertexGeneration = model->getVertexGeneration();
+                state.builtRadius = model->getBoundsRadius();
+                state.buildScratchSize = build.scratchSize;
+                state.updateScratchSize = Kinesis::Buffer::getAlignment(buildSizesInfo.updateScratchSize, scratchAlignment);
+                state.primitiveCount = primitiveCount;
+            }
 
             // 4. Create BLAS Buffer and AS Object
-            AccelerationStructure blasEntry; // Create a new entry for this object
-            Kinesis::Window::createBuffer(buildSizesInfo.accelerationStructureSize,
+            AccelerationStructure &blasEntry = build.blasEntry;
+            try
+            {
+                Kinesis::Window::createBuffer(buildSizesInfo.accelerationStructureSize,
+                                              VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                              blasEntry.buffer, blasEntry.memory,
+                                              MemoryBudget::Category::AccelerationStructure);
+                blasEntry.size = buildSizesInfo.accelerationStructureSize;
+
+                VkAccelerationStructureCreateInfoKHR createInfo{};
+                createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+                createInfo.buffer = blasEntry.buffer;
+                createInfo.size = buildSizesInfo.accelerationStructureSize;
+                createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+                // Call function via loaded pointer (with pfn prefix)
+                if (pfnCreateAccelerationStructureKHR(g_Device, &createInfo, nullptr, &blasEntry.structure) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to create BLAS!");
+                }
+            }
+            catch (const std::exception &)
+            {
+                // Cleanup everything created so far, this build included; nothing has been recorded yet
+                discardBlasBuilds(builds);
+                throw;
+            }
+            // Get the device address *after* the AS is created and bound to the buffer implicitly
+            VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
+            addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+            addressInfo.accelerationStructure = blasEntry.structure;
+            blasEntry.address = pfnGetAccelerationStructureDeviceAddressKHR(g_Device, &addressInfo);
+
+            buildGeomInfo.dstAccelerationStructure = blasEntry.structure; // Target AS object
+
+            // Define build range info (describes the primitives to build)
+            build.rangeInfo.primitiveCount = primitiveCount;
+            build.rangeInfo.primitiveOffset = 0; // Offset into index/vertex buffer
+            build.rangeInfo.firstVertex = 0;     // Offset for non-indexed geometry
+            build.rangeInfo.transformOffset = 0; // Offset for transform data (usually 0 for BLAS)
+        }
+    }
+
+    // Serialized/deserialized AS data must sit at 256-byte aligned device addresses
+    constexpr VkDeviceSize AS_SERIALIZATION_ALIGNMENT = 256;
+
+    // --- loadCachedBlas ---
+    // Deserializes the BLAS of static models found in BlasCache (same geometry, same build flags, and data
+    // the driver reports as compatible), all copied in one submission. Returns the models that still need a build.
+    std::vector<Model *> loadCachedBlas(const std::vector<Model *> &models, bool compact)
+    {
+        if (!BlasCache::enabled || !pfnCmdCopyMemoryToAccelerationStructureKHR || !pfnGetDeviceAccelerationStructureCompatibilityKHR)
+            return models;
+
+        struct CachedBlas
+        {
+            Model *model = nullptr;
+            std::vector<char> data;
+            VkDeviceSize stagingOffset = 0;
+            AccelerationStructure blasEntry{};
+        };
+        std::vector<CachedBlas> cached;
+        std::vector<Model *> remaining;
+        VkDeviceSize stagingSize = 0;
+        for (Model *model : models)
+        {
+            // Dynamic BLAS are refit from changing vertices, there is nothing stable to cache
+            if (!model || model->isDynamic() || !model->isResident() || model->getIndexCount() < 3 ||
+                std::any_of(cached.begin(), cached.end(), [model](const CachedBlas &entry)
+                            { return entry.model == model; }))
+            {
+                remaining.push_back(model); // prepareBlasBuilds skips/dedupes these itself
+                continue;
+            }
+
+            CachedBlas entry;
+            entry.model = model;
+            if (!BlasCache::read(BlasCache::hashGeometry(model), blasBuildFlags(model, compact), entry.data))
+            {
+                remaining.push_back(model);
+                continue;
+            }
+
+            // The data starts with the driver and compatibility UUIDs the driver checks it against
+            VkAccelerationStructureVersionInfoKHR versionInfo{VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR};
+            versionInfo.pVersionData = reinterpret_cast<const uint8_t *>(entry.data.data());
+            VkAccelerationStructureCompatibilityKHR compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+            pfnGetDeviceAccelerationStructureCompatibilityKHR(g_Device, &versionInfo, &compatibility);
+            if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR)
+            {
+                BlasCache::countIncompatible(); // Rebuilt below and overwritten by storeBlasInCache
+                remaining.push_back(model);
+                continue;
+            }
+
+            entry.stagingOffset = Kinesis::Buffer::getAlignment(stagingSize, AS_SERIALIZATION_ALIGNMENT);
+            stagingSize = entry.stagingOffset + entry.data.size();
+            cached.push_back(std::move(entry));
+        }
+        if (cached.empty())
+            return remaining;
+
+        // All serialized blobs go through one host-visible buffer, padded so its start can be aligned
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        Kinesis::Window::createBuffer(stagingSize + AS_SERIALIZATION_ALIGNMENT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      stagingBuffer, stagingMemory, MemoryBudget::Category::Staging);
+        const uint64_t stagingAddress = getBufferDeviceAddress(stagingBuffer);
+        const uint64_t stagingBase = Kinesis::Buffer::getAlignment(stagingAddress, AS_SERIALIZATION_ALIGNMENT);
+        char *mapped;
+        vkMapMemory(g_Device, stagingMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&mapped));
+
+        // Create every AS first so a failure leaves nothing recorded
+        for (auto &entry : cached)
+        {
+            memcpy(mapped + (stagingBase - stagingAddress) + entry.stagingOffset, entry.data.data(), entry.data.size());
+
+            // Size of the deserialized AS, right after the two UUIDs and the serialized size
+            uint64_t structureSize = 0;
+            memcpy(&structureSize, entry.data.data() + 2 * VK_UUID_SIZE + sizeof(uint64_t), sizeof(uint64_t));
+
+            AccelerationStructure &blasEntry = entry.blasEntry;
+            Kinesis::Window::createBuffer(structureSize,
                                           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                          blasEntry.buffer, blasEntry.memory);
+                                          blasEntry.buffer, blasEntry.memory,
+                                          MemoryBudget::Category::AccelerationStructure);
+            blasEntry.size = structureSize;
 
             VkAccelerationStructureCreateInfoKHR createInfo{};
             createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
             createInfo.buffer = blasEntry.buffer;
-            createInfo.size = buildSizesInfo.accelerationStructureSize;
+            createInfo.size = structureSize;
             createInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-            // Call function via loaded pointer (with pfn prefix)
             if (pfnCreateAccelerationStructureKHR(g_Device, &createInfo, nullptr, &blasEntry.structure) != VK_SUCCESS)
             {
-                // Cleanup buffer/memory if AS creation fails
-                delete_acceleration_structure(blasEntry); // Use helper to clean up
-                throw std::runtime_error("Failed to create BLAS for GameObject '" + gameObject.name + "'!");
+                // Drop what was created so far and let everything be built instead
+                for (auto &other : cached)
+                    delete_acceleration_structure(other.blasEntry);
+                vkUnmapMemory(g_Device, stagingMemory);
+                vkDestroyBuffer(g_Device, stagingBuffer, nullptr);
+                MemoryBudget::untrack(stagingMemory);
+                vkFreeMemory(g_Device, stagingMemory, nullptr);
+                std::cerr << "Warning: Failed to create a BLAS for cached data, building all of them instead." << std::endl;
+                return models;
             }
-            // Get the device address *after* the AS is created and bound to the buffer implicitly
             VkAccelerationStructureDeviceAddressInfoKHR addressInfo{};
             addressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
             addressInfo.accelerationStructure = blasEntry.structure;
-            // Call function via loaded pointer (with pfn prefix)
             blasEntry.address = pfnGetAccelerationStructureDeviceAddressKHR(g_Device, &addressInfo);
+        }
 
-            // 5. Create Scratch Buffer
-            ScratchBuffer scratch = create_scratch_buffer(buildSizesInfo.buildScratchSize);
-
-            // 6. Build BLAS on GPU using a command buffer
-            VkCommandBuffer cmdBuf = beginSingleTimeCommands();
-
-            // Update buildGeomInfo for the build command
-            buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-            buildGeomInfo.dstAccelerationStructure = blasEntry.structure; // Target AS object
-            buildGeomInfo.scratchData.deviceAddress = scratch.address;    // Scratch buffer address
+        VkCommandBuffer cmdBuf = beginSingleTimeCommands();
+        for (const auto &entry : cached)
+        {
+            VkCopyMemoryToAccelerationStructureInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR};
+            copyInfo.src.deviceAddress = stagingBase + entry.stagingOffset;
+            copyInfo.dst = entry.blasEntry.structure;
+            copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+            pfnCmdCopyMemoryToAccelerationStructureKHR(cmdBuf, &copyInfo);
+        }
 
-            // Define build range info (describes the primitives to build)
-            VkAccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
-            buildRangeInfo.primitiveCount = primitiveCount;
-            buildRangeInfo.primitiveOffset = 0; // Offset into index/vertex buffer
-            buildRangeInfo.firstVertex = 0;     // Offset for non-indexed geometry
-            buildRangeInfo.transformOffset = 0; // Offset for transform data (usually 0 for BLAS)
-            const VkAccelerationStructureBuildRangeInfoKHR *pBuildRangeInfo = &buildRangeInfo;
+        // Barrier: the TLAS build and the shaders read the deserialized BLAS
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(cmdBuf); // One submit and wait for all of them
 
-            // Call function via loaded pointer (with pfn prefix)
-            pfnCmdBuildAccelerationStructuresKHR(cmdBuf, 1, &buildGeomInfo, &pBuildRangeInfo);
-
-            // Barrier: Ensure BLAS build completes before scratch buffer is destroyed/reused
-            // and before the BLAS is used in a TLAS build.
-            VkMemoryBarrier barrier{};
-            barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-            barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR; // Write finished
-            barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;  // Ready for read (TLAS build, shader access)
-            vkCmdPipelineBarrier(cmdBuf,
-                                 VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,                                                // Source stage
-                                 VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, // Dest stages
-                                 0,                                                                                                     // No dependency flags needed usually
-                                 1, &barrier,                                                                                           // Memory barrier
-                                 0, nullptr,                                                                                            // Buffer barriers
-                                 0, nullptr);                                                                                           // Image barriers
-
-            endSingleTimeCommands(cmdBuf); // Submit and wait for completion
-
-            // 7. Cleanup Scratch Buffer
-            delete_scratch_buffer(scratch);
+        vkUnmapMemory(g_Device, stagingMemory);
+        vkDestroyBuffer(g_Device, stagingBuffer, nullptr);
+        MemoryBudget::untrack(stagingMemory);
+        vkFreeMemory(g_Device, stagingMemory, nullptr);
 
-            // 8. Store BLAS at the correct index (matching gameObject index)
-            blas[objectIndex] = blasEntry;
-        }
-        
-        // Count how many BLAS were actually created
-        uint32_t blasCount = 0;
-        for (const auto& b : blas) {
-            if (b.address != 0) blasCount++;
+        for (auto &entry : cached)
+        {
+            release_blas(entry.model);
+            blas[entry.model] = entry.blasEntry;
+            BlasCache::countLoaded(entry.data.size());
         }
-        std::cout << "Created " << blasCount << " BLAS objects out of " << blas.size() << " game objects." << std::endl;
+        std::cout << "Loaded " << cached.size() << " BLAS from " << BlasCache::getDirectory() << " (" << (stagingSize >> 10)
+                  << " KiB), " << remaining.size() << " left to build." << std::endl;
+        return remaining;
     }
 
-    // --- create_tlas ---
-    void create_tlas(bool allow_update)
+    // --- storeBlasInCache ---
+    // Serializes freshly built static BLAS (after compaction, so the cache holds the compacted ones) and
+    // writes them to BlasCache. Costs two extra blocking submissions, but only when something was built,
+    // i.e. on the first run or after the geometry, build flags or driver changed.
+    void storeBlasInCache(const std::vector<PendingBuild> &builds)
     {
-        // Check required function pointers (with pfn prefix)
-        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
-        {
-            throw std::runtime_error("Required TLAS build function pointers not loaded!");
-        }
+        if (!BlasCache::enabled || !pfnCmdCopyAccelerationStructureToMemoryKHR || !pfnCmdWriteAccelerationStructuresPropertiesKHR)
+            return;
 
-        // Delete previous TLAS and instance buffer if they exist
-        if (tlas.structure != VK_NULL_HANDLE)
+        std::vector<const PendingBuild *> storable;
+        for (const auto &build : builds)
         {
-            delete_acceleration_structure(tlas); // Cleans up buffer/memory too using pointer
-            tlas = {};                           // Reset struct
+            if (!build.model->isDynamic())
+                storable.push_back(&build);
         }
-        if (instances_buffer != VK_NULL_HANDLE)
+        if (storable.empty())
+            return;
+        const uint32_t count = static_cast<uint32_t>(storable.size());
+
+        // 1. Ask the driver how large each serialized BLAS is
+        VkQueryPool sizeQueries = VK_NULL_HANDLE;
+        VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+        queryInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+        queryInfo.queryCount = count;
+        if (vkCreateQueryPool(g_Device, &queryInfo, nullptr, &sizeQueries) != VK_SUCCESS)
         {
-            vkDestroyBuffer(g_Device, instances_buffer, nullptr);
-            instances_buffer = VK_NULL_HANDLE;
+            std::cerr << "Warning: Failed to create BLAS serialization query pool, not caching BLAS." << std::endl;
+            return;
         }
-        if (instances_buffer_memory != VK_NULL_HANDLE)
+        std::vector<VkAccelerationStructureKHR> structures;
+        structures.reserve(count);
+        for (const PendingBuild *build : storable)
+            structures.push_back(build->blasEntry.structure);
+
+        VkCommandBuffer cmdBuf = beginSingleTimeCommands();
+        vkCmdResetQueryPool(cmdBuf, sizeQueries, 0, count);
+        pfnCmdWriteAccelerationStructuresPropertiesKHR(cmdBuf, count, structures.data(),
+                                                       VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, sizeQueries, 0);
+        endSingleTimeCommands(cmdBuf);
+
+        std::vector<VkDeviceSize> serializedSizes(count, 0);
+        VkResult result = vkGetQueryPoolResults(g_Device, sizeQueries, 0, count,
+                                                serializedSizes.size() * sizeof(VkDeviceSize), serializedSizes.data(), sizeof(VkDeviceSize),
+                                                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        vkDestroyQueryPool(g_Device, sizeQueries, nullptr);
+        if (result != VK_SUCCESS)
         {
-            vkFreeMemory(g_Device, instances_buffer_memory, nullptr);
-            instances_buffer_memory = VK_NULL_HANDLE;
+            std::cerr << "Warning: Failed to read BLAS serialization sizes, not caching BLAS." << std::endl;
+            return;
         }
 
-        // Create instance descriptions for each object that has a corresponding BLAS
-        std::vector<VkAccelerationStructureInstanceKHR> instances;
-        // Ensure blas vector size matches gameObjects or use a map
-        // Basic check: ensure we don't access blas out of bounds
-        if (blas.size() < Kinesis::gameObjects.size())
+        // 2. Serialize all of them into one host-visible buffer
+        std::vector<VkDeviceSize> offsets(count, 0);
+        VkDeviceSize totalSize = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            offsets[i] = Kinesis::Buffer::getAlignment(totalSize, AS_SERIALIZATION_ALIGNMENT);
+            totalSize = offsets[i] + serializedSizes[i];
+        }
+        VkBuffer readbackBuffer;
+        VkDeviceMemory readbackMemory;
+        Kinesis::Window::createBuffer(totalSize + AS_SERIALIZATION_ALIGNMENT, VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      readbackBuffer, readbackMemory, MemoryBudget::Category::Staging);
+        const uint64_t readbackAddress = getBufferDeviceAddress(readbackBuffer);
+        const uint64_t readbackBase = Kinesis::Buffer::getAlignment(readbackAddress, AS_SERIALIZATION_ALIGNMENT);
+
+        cmdBuf = beginSingleTimeCommands();
+        for (uint32_t i = 0; i < count; ++i)
         {
-            std::cerr << "Warning: Fewer BLAS (" << blas.size()
-                      << ") than game objects (" << Kinesis::gameObjects.size()
-                      << "). TLAS might be incomplete." << std::endl;
+            if (serializedSizes[i] == 0)
+                continue;
+            VkCopyAccelerationStructureToMemoryInfoKHR copyInfo{VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR};
+            copyInfo.src = structures[i];
+            copyInfo.dst.deviceAddress = readbackBase + offsets[i];
+            copyInfo.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+            pfnCmdCopyAccelerationStructureToMemoryKHR(cmdBuf, &copyInfo);
         }
+        // Barrier: the serialized data is read by the host after the fence wait
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        vkCmdPipelineBarrier(cmdBuf,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        endSingleTimeCommands(cmdBuf);
 
-        for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i)
+        // 3. Write one cache file per BLAS
+        char *mapped;
+        vkMapMemory(g_Device, readbackMemory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void **>(&mapped));
+        for (uint32_t i = 0; i < count; ++i)
         {
-            // Ensure object has model and a corresponding BLAS was created and exists at index i
-            if (i >= blas.size() || !gameObjects[i].model || blas[i].address == 0)
-            {
-                // Optionally log skipped object
-                // std::cout << "Skipping TLAS instance for object " << i << std::endl;
+            if (serializedSizes[i] == 0)
                 continue;
-            }
-
-            VkAccelerationStructureInstanceKHR instance{};
-            // Convert glm::mat4 to VkTransformMatrixKHR (row-major)
-            glm::mat4 modelMatrix = gameObjects[i].transform.mat4();
-            // Vulkan expects row-major, glm is column-major by default, so transpose
-            glm::mat4 transposed = glm::transpose(modelMatrix);
-            memcpy(&instance.transform, &transposed, sizeof(VkTransformMatrixKHR));
-
-            instance.instanceCustomIndex = static_cast<uint32_t>(i); // Use the actual object index for material lookup
-            instance.mask = 0xFF;                                 // Visibility mask (default: visible to all rays)
-            // Offset into the SBT hit group records.
-            // Simple case: All instances use the same hit group (index 2 from group creation), offset 0.
-            // Complex case: Different materials -> different hit groups -> different offsets.
-            instance.instanceShaderBindingTableRecordOffset = 0;
-            instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR; // Example: Disable backface culling for this instance
-            instance.accelerationStructureReference = blas[i].address;                  // Address of the BLAS for this instance
-            instances.push_back(instance);
+            const PendingBuild &build = *storable[i];
+            BlasCache::write(BlasCache::hashGeometry(build.model), build.buildInfo.flags,
+                             mapped + (readbackBase - readbackAddress) + offsets[i], static_cast<size_t>(serializedSizes[i]));
         }
+        vkUnmapMemory(g_Device, readbackMemory);
+        vkDestroyBuffer(g_Device, readbackBuffer, nullptr);
+        MemoryBudget::untrack(readbackMemory);
+        vkFreeMemory(g_Device, readbackMemory, nullptr);
 
-        if (instances.empty())
+        std::cout << "Serialized " << count << " BLAS into " << BlasCache::getDirectory() << " (" << (totalSize >> 10) << " KiB)." << std::endl;
+    }
+
+    // --- build_blas ---
+    // Builds (or rebuilds) the BLAS shared by every game object that uses each model. All builds are
+    // recorded into one command buffer and submitted once; scratch memory is a single buffer that the
+    // builds suballocate from, in batches bounded by BLAS_SCRATCH_BUDGET (see build_blas in the header).
+    void build_blas(const std::vector<Model *> &models)
+    {
+        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
         {
-            std::cerr << "Warning: No valid instances with corresponding BLAS found. Skipping TLAS build." << std::endl;
-            return; // Nothing to build
+            throw std::runtime_error("Required BLAS build function pointers not loaded!");
         }
 
-        // Create and upload instances buffer
-        VkDeviceSize instanceBufferSize = sizeof(VkAccelerationStructureInstanceKHR) * instances.size();
-        // Usage flags for instance buffer
-        const VkBufferUsageFlags instanceBufferUsage =
-            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
-            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT; // Need transfer destination
+        std::vector<PendingBuild> builds;
+        const bool compact = compactBlas && pfnCmdWriteAccelerationStructuresPropertiesKHR && pfnCmdCopyAccelerationStructureKHR;
+        const VkDeviceSize scratchAlignment = as_properties.minAccelerationStructureScratchOffsetAlignment;
+        // Static models cached from an earlier run are deserialized instead of built
+        prepareBlasBuilds(loadCachedBlas(models, compact), compact, builds);
 
-        // Use helper to create device-local buffer
-        Kinesis::Window::createBuffer(instanceBufferSize, instanceBufferUsage,
-                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                      instances_buffer, instances_buffer_memory);
+        if (builds.empty())
+            return;
 
-        // Upload instance data (using staging buffer for device-local memory)
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-        Kinesis::Window::createBuffer(instanceBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-        void *data;
-        vkMapMemory(g_Device, stagingMemory, 0, instanceBufferSize, 0, &data);
-        memcpy(data, instances.data(), instanceBufferSize);
-        vkUnmapMemory(g_Device, stagingMemory);
+        // 5. Split the builds into batches whose summed scratch fits the budget. Builds inside a batch
+        // run concurrently on disjoint scratch ranges; a barrier between batches lets the next one reuse them.
+        // A single build larger than the budget gets a batch (and a scratch buffer this large) of its own.
+        std::vector<size_t> batchStarts{0};
+        VkDeviceSize batchScratch = 0;
+        VkDeviceSize scratchSize = 0;
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            if (batchScratch > 0 && batchScratch + builds[i].scratchSize > BLAS_SCRATCH_BUDGET)
+            {
+                batchStarts.push_back(i);
+                batchScratch = 0;
+            }
+            batchScratch += builds[i].scratchSize;
+            scratchSize = std::max(scratchSize, batchScratch);
+        }
+        batchStarts.push_back(builds.size());
 
-        VkCommandBuffer cmdBufCopy = beginSingleTimeCommands();
-        VkBufferCopy copyRegion{};
-        copyRegion.size = instanceBufferSize;
-        vkCmdCopyBuffer(cmdBufCopy, stagingBuffer, instances_buffer, 1, &copyRegion);
-        // Barrier: Ensure copy finishes before TLAS build reads the instance buffer
-        VkBufferMemoryBarrier bufferBarrier = {};
-        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        bufferBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR; // Read by AS build
-        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        bufferBarrier.buffer = instances_buffer;
-        bufferBarrier.offset = 0;
-        bufferBarrier.size = instanceBufferSize;
-        vkCmdPipelineBarrier(cmdBufCopy,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT,                         // Source stage
-                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, // Destination stage
-                             0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+        // Compacted sizes are written by the same submission, right after the builds
+        std::vector<size_t> compactIndices;
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            if (builds[i].compactable)
+                compactIndices.push_back(i);
+        }
 
-        endSingleTimeCommands(cmdBufCopy); // Submits and waits
+        // Until the submission finished, a throw discards everything this call created
+        ScratchBuffer scratch{};
+        VkQueryPool compactionQueries = VK_NULL_HANDLE;
+        try
+        {
+            // Padded so the first range can be aligned even if the buffer's own address is not
+            scratch = create_scratch_buffer(scratchSize + scratchAlignment);
 
-        // Clean up staging buffer
-        vkDestroyBuffer(g_Device, stagingBuffer, nullptr);
-        vkFreeMemory(g_Device, stagingMemory, nullptr);
+            if (!compactIndices.empty())
+            {
+                VkQueryPoolCreateInfo queryInfo{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+                queryInfo.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR;
+                queryInfo.queryCount = static_cast<uint32_t>(compactIndices.size());
+                if (vkCreateQueryPool(g_Device, &queryInfo, nullptr, &compactionQueries) != VK_SUCCESS)
+                {
+                    std::cerr << "Warning: Failed to create BLAS compaction query pool, keeping uncompacted BLAS." << std::endl;
+                    compactionQueries = VK_NULL_HANDLE;
+                }
+            }
+
+            // 6. Record every batch into one command buffer
+            VkCommandBuffer cmdBuf = beginSingleTimeCommands();
+            if (compactionQueries != VK_NULL_HANDLE)
+                vkCmdResetQueryPool(cmdBuf, compactionQueries, 0, static_cast<uint32_t>(compactIndices.size()));
+            std::vector<VkAccelerationStructureBuildGeometryInfoKHR> buildInfos;
+            std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> rangeInfos;
+            for (size_t batch = 0; batch + 1 < batchStarts.size(); ++batch)
+            {
+                buildInfos.clear();
+                rangeInfos.clear();
+                uint64_t scratchAddress = Kinesis::Buffer::getAlignment(scratch.address, scratchAlignment);
+                for (size_t i = batchStarts[batch]; i < batchStarts[batch + 1]; ++i)
+                {
+                    builds[i].buildInfo.scratchData.deviceAddress = scratchAddress; // Suballocated scratch range
+                    scratchAddress += builds[i].scratchSize;
+                    buildInfos.push_back(builds[i].buildInfo);
+                    rangeInfos.push_back(&builds[i].rangeInfo);
+                }
+
+                // Call function via loaded pointer (with pfn prefix)
+                pfnCmdBuildAccelerationStructuresKHR(cmdBuf, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+
+                // Barrier: the next batch reuses the scratch, and the TLAS build / shaders read these BLAS
+                VkMemoryBarrier barrier{};
+                barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;                                           // Write finished
+                barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR; // Ready for read / scratch reuse
+                vkCmdPipelineBarrier(cmdBuf,
+                                     VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,                                                // Source stage
+                                     VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES, // Dest stages
+                                     0,
+                                     1, &barrier,
+                                     0, nullptr,
+                                     0, nullptr);
+            }
+            if (compactionQueries != VK_NULL_HANDLE)
+            {
+                // The barrier above made the builds visible to AS reads at the build stage, which is what this needs
+                std::vector<VkAccelerationStructureKHR> structures;
+                structures.reserve(compactIndices.size());
+                for (size_t i : compactIndices)
+                    structures.push_back(builds[i].blasEntry.structure);
+                pfnCmdWriteAccelerationStructuresPropertiesKHR(cmdBuf, static_cast<uint32_t>(structures.size()), structures.data(),
+                                                               VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactionQueries, 0);
+            }
+            endSingleTimeCommands(cmdBuf); // One submit and wait for all of them
+        }
+        catch (const std::exception &)
+        {
+            delete_scratch_buffer(scratch);
+            if (compactionQueries != VK_NULL_HANDLE)
+                vkDestroyQueryPool(g_Device, compactionQueries, nullptr);
+            discardBlasBuilds(builds);
+            throw;
+        }
+
+        // 7. Cleanup Scratch Buffer (the GPU is done with it)
+        delete_scratch_buffer(scratch);
+
+        // 8. Optionally shrink each BLAS to its compacted size
+        if (compactionQueries != VK_NULL_HANDLE)
+        {
+            std::vector<Model *> builtModels;
+            std::vector<AccelerationStructure> built;
+            builtModels.reserve(compactIndices.size());
+            built.reserve(compactIndices.size());
+            for (size_t i : compactIndices)
+            {
+                builtModels.push_back(builds[i].model);
+                built.push_back(builds[i].blasEntry);
+            }
+            compact_blas(builtModels, built, compactionQueries);
+            vkDestroyQueryPool(g_Device, compactionQueries, nullptr);
+            for (size_t j = 0; j < compactIndices.size(); ++j)
+                builds[compactIndices[j]].blasEntry = built[j];
+        }
+
+        // 9. Store each BLAS under its model; every instance of the model references this one address
+        for (auto &build : builds)
+            blas[build.model] = build.blasEntry;
+
+        // 10. Serialize the new static BLAS so the next run can load them instead
+        storeBlasInCache(builds);
+
+        if (builds.size() > 1)
+        {
+            std::cout << "Built " << builds.size() << " BLAS in " << (batchStarts.size() - 1) << " batch(es), "
+                      << (scratchSize >> 10) << " KiB shared scratch." << std::endl;
+        }
+    }
+
+    void build_blas(Model *model)
+    {
+        build_blas(std::vector<Model *>{model});
+    }
+
+    // --- recordBlasBuilds ---
+    // Same builds as build_blas, but recorded into the frame's command buffer instead of a blocking
+    // submission. The caller (ASBuildScheduler) keeps the amount per frame small, so they all run as one
+    // batch on a scratch buffer that only ever grows. Compaction is skipped: it needs the compacted size
+    // read back on the host, which would mean waiting for this frame.
+    uint32_t recordBlasBuilds(VkCommandBuffer commandBuffer, const std::vector<Model *> &models,
+                              VkQueryPool timestampPool, uint32_t firstTimestamp)
+    {
+        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
+        {
+            throw std::runtime_error("Required BLAS build function pointers not loaded!");
+        }
 
-        // Get address using loaded pointer (via helper)
-        uint64_t instanceBufferAddr = getBufferDeviceAddress(instances_buffer);
+        std::vector<PendingBuild> &builds = scheduledBuilds;
+        prepareBlasBuilds(models, false, builds);
+        if (builds.empty())
+            return 0;
 
-        // Define TLAS geometry (references the instances buffer)
+        const VkDeviceSize scratchAlignment = as_properties.minAccelerationStructureScratchOffsetAlignment;
+        VkDeviceSize scratchNeeded = 0;
+        for (const auto &build : builds)
+            scratchNeeded += build.scratchSize;
+        if (scratchNeeded > scheduledScratchSize)
+        {
+            DeletionQueue::retireBuffer(scheduledScratch.buffer, scheduledScratch.memory); // Frames in flight may still build with it
+            scheduledScratch = {};
+            scheduledScratchSize = 0;
+            try
+            {
+                scheduledScratch = create_scratch_buffer(scratchNeeded + scratchAlignment);
+            }
+            catch (const std::exception &)
+            {
+                discardBlasBuilds(builds);
+                throw;
+            }
+            scheduledScratchSize = scratchNeeded;
+        }
+
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR> &buildInfos = scheduledInfos;
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR *> &rangeInfos = scheduledRangePtrs;
+        buildInfos.clear();
+        rangeInfos.clear();
+        uint64_t scratchAddress = Kinesis::Buffer::getAlignment(scheduledScratch.address, scratchAlignment);
+        uint32_t primitiveCount = 0;
+        for (auto &build : builds)
+        {
+            build.buildInfo.scratchData.deviceAddress = scratchAddress; // Suballocated scratch range
+            scratchAddress += build.scratchSize;
+            buildInfos.push_back(build.buildInfo);
+            rangeInfos.push_back(&build.rangeInfo);
+            primitiveCount += build.rangeInfo.primitiveCount;
+        }
+
+        // Builds recorded by previous frames may still be writing the scratch
+        VkMemoryBarrier scratchBarrier{};
+        scratchBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        scratchBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        scratchBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             0, 1, &scratchBarrier, 0, nullptr, 0, nullptr);
+
+        // Bottom of pipe: the start is written once everything recorded before (pending vertex writes,
+        // the barrier above) has finished, so only the builds fall between the two timestamps
+        if (timestampPool != VK_NULL_HANDLE)
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstTimestamp);
+        pfnCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(buildInfos.size()), buildInfos.data(), rangeInfos.data());
+        if (timestampPool != VK_NULL_HANDLE)
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, firstTimestamp + 1);
+
+        // Barrier: the TLAS build later in this frame and the trace read these BLAS
+        VkMemoryBarrier buildBarrier{};
+        buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES,
+                             0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+
+        // Every later command in this frame sees the finished BLAS, so their instances can join the TLAS now
+        for (auto &build : builds)
+            blas[build.model] = build.blasEntry;
+        markTlasInstancesDirty();
+        return primitiveCount;
+    }
+
+    void markTlasInstancesDirty()
+    {
+        tlasInstancesDirty = true;
+    }
+
+    void release_blas(const Model *model)
+    {
+        dynamicBlasStates.erase(model);
+        auto it = blas.find(model);
+        if (it == blas.end())
+            return;
+        delete_acceleration_structure(it->second);
+        blas.erase(it);
+        markTlasInstancesDirty(); // Its instances must leave the TLAS before the BLAS is actually destroyed
+    }
+
+    const AccelerationStructure *getBlas(const Model *model)
+    {
+        auto it = blas.find(model);
+        return (it != blas.end() && it->second.address != 0) ? &it->second : nullptr;
+    }
+
+    // --- create_blas ---
+    void create_blas()
+    {
+        // Check required function pointers (with pfn prefix)
+        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
+        {
+            throw std::runtime_error("Required BLAS build function pointers not loaded!");
+        }
+
+        // Clean up existing BLAS first
+        for (auto &entry : blas)
+            delete_acceleration_structure(entry.second);
+        blas.clear();
+        dynamicBlasStates.clear();
+
+        // One BLAS per unique model; game objects sharing a model become instances of it in the TLAS.
+        // They are all built in a single submission.
+        std::vector<Model *> models;
+        for (const auto &gameObject : Kinesis::gameObjects)
+        {
+            Model *model = gameObject.model.get();
+            if (model && std::find(models.begin(), models.end(), model) == models.end())
+                models.push_back(model);
+        }
+        build_blas(models);
+
+        std::cout << "Created " << blas.size() << " BLAS objects for " << Kinesis::gameObjects.size() << " game objects." << std::endl;
+    }
+
+    // Hit record (relative to the hit SBT) of the material model an object is shaded with. Uses the
+    // mesh's first material, like the material buffer built in kinesis.cpp; no material means diffuse.
+    uint32_t hitGroupOffset(const GameObject &object)
+    {
+        const auto &materials = object.model->getMesh()->getMaterials();
+        if (materials.empty() || !materials[0])
+            return 0;
+        const uint32_t type = static_cast<uint32_t>(materials[0]->getType());
+        return type < HIT_GROUP_COUNT ? type : 0;
+    }
+
+    // One instance per game object whose model has a BLAS; objects sharing a model share its BLAS.
+    // Refills instances (cleared, not freed, so the per-frame path doesn't allocate) and tlasInstanceObjects
+    // with the object index of each record, in the same order.
+    void collectTlasInstances(std::vector<VkAccelerationStructureInstanceKHR> &instances)
+    {
+        instances.clear();
+        instances.reserve(Kinesis::gameObjects.size());
+        tlasInstanceObjects.clear();
+        for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i)
+        {
+            const AccelerationStructure *modelBlas = gameObjects[i].model ? getBlas(gameObjects[i].model.get()) : nullptr;
+            if (!modelBlas)
+                continue; // No geometry, the model is currently evicted, or its BLAS is still queued
+
+            VkAccelerationStructureInstanceKHR instance{};
+            instance.transform = toTransformMatrix(gameObjects[i].transform.mat4());
+
+            // The object index selects this instance's geometry range and material in the instance table
+            instance.instanceCustomIndex = static_cast<uint32_t>(i);
+            instance.mask = 0xFF;                                 // Visibility mask (default: visible to all rays)
+            // Offset into the SBT hit group records: the hit group specialized for the object's material model
+            instance.instanceShaderBindingTableRecordOffset = hitGroupOffset(gameObjects[i]);
+            instance.flags = VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR; // Example: Disable backface culling for this instance
+            instance.accelerationStructureReference = modelBlas->address;               // Shared BLAS of this instance's model
+            instances.push_back(instance);
+            tlasInstanceObjects.push_back(static_cast<uint32_t>(i));
+        }
+    }
+
+    // TLAS geometry reading the packed instance records in instances_buffer
+    VkAccelerationStructureGeometryKHR makeTlasGeometry()
+    {
         VkAccelerationStructureGeometryKHR tlasGeometry{};
         tlasGeometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
         tlasGeometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
         tlasGeometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR; // Usually opaque for TLAS
         tlasGeometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-        tlasGeometry.geometry.instances.arrayOfPointers = VK_FALSE;              // Data is a packed array
-        tlasGeometry.geometry.instances.data.deviceAddress = instanceBufferAddr; // Address of instance data on GPU
+        tlasGeometry.geometry.instances.arrayOfPointers = VK_FALSE;                                   // Data is a packed array
+        tlasGeometry.geometry.instances.data.deviceAddress = getBufferDeviceAddress(instances_buffer); // Address of instance data on GPU
+        return tlasGeometry;
+    }
 
-        // Get TLAS build sizes
-        VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo{};
-        buildGeomInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        buildGeomInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        buildGeomInfo.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    VkBuildAccelerationStructureFlagsKHR tlasBuildFlags(bool allow_update)
+    {
+        VkBuildAccelerationStructureFlagsKHR flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
         if (allow_update)
+            flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+        return flags;
+    }
+
+    // Retires the TLAS, its instance buffer and scratch; frames in flight keep using them
+    void retireTlasStorage()
+    {
+        if (tlas.structure != VK_NULL_HANDLE)
         {
-            buildGeomInfo.flags |= VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR;
+            delete_acceleration_structure(tlas); // Retires buffer/memory too
+            tlas = {};                           // Reset struct
         }
-        buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR; // Initial build
-        buildGeomInfo.geometryCount = 1;                                     // One geometry struct (pointing to instance buffer)
+        DeletionQueue::retireBuffer(instances_buffer, instances_buffer_memory);
+        instances_buffer = VK_NULL_HANDLE;
+        instances_buffer_memory = VK_NULL_HANDLE;
+        DeletionQueue::retireBuffer(tlasScratch.buffer, tlasScratch.memory);
+        tlasScratch = {};
+        tlasInstanceCapacity = 0;
+    }
+
+    // Creates an empty TLAS, its instance buffer and the persistent scratch, all sized for up to
+    // `capacity` instances so later builds with a different instance count can reuse them in place.
+    // Nothing is uploaded or built; the previous ones are retired.
+    void createTlasStorage(uint32_t capacity, bool allow_update)
+    {
+        retireTlasStorage();
+
+        // Usage flags for instance buffer
+        const VkBufferUsageFlags instanceBufferUsage =
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT; // Need transfer destination
+        Kinesis::Window::createBuffer(sizeof(VkAccelerationStructureInstanceKHR) * capacity, instanceBufferUsage,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                      instances_buffer, instances_buffer_memory,
+                                      MemoryBudget::Category::AccelerationStructure);
+
+        // Get TLAS build sizes for the full capacity; smaller builds into the same TLAS are valid
+        VkAccelerationStructureGeometryKHR tlasGeometry = makeTlasGeometry();
+        VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo{};
+        buildGeomInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeomInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        buildGeomInfo.flags = tlasBuildFlags(allow_update);
+        buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+        buildGeomInfo.geometryCount = 1; // One geometry struct (pointing to instance buffer)
         buildGeomInfo.pGeometries = &tlasGeometry;
 
-        uint32_t instanceCount = static_cast<uint32_t>(instances.size());
         VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo{};
         buildSizesInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
         // Call function via loaded pointer (with pfn prefix)
-        pfnGetAccelerationStructureBuildSizesKHR(g_Device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeomInfo, &instanceCount, &buildSizesInfo);
+        pfnGetAccelerationStructureBuildSizesKHR(g_Device, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeomInfo, &capacity, &buildSizesInfo);
 
         // Create TLAS buffer and object
         Kinesis::Window::createBuffer(buildSizesInfo.accelerationStructureSize,
                                       VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
                                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                      tlas.buffer, tlas.memory);
+                                      tlas.buffer, tlas.memory,
+                                      MemoryBudget::Category::AccelerationStructure);
+        tlas.size = buildSizesInfo.accelerationStructureSize;
 
         VkAccelerationStructureCreateInfoKHR createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
@@ -1448,17 +3082,109 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
         tlasAddressInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
         tlasAddressInfo.accelerationStructure = tlas.structure;
         tlas.address = pfnGetAccelerationStructureDeviceAddressKHR(g_Device, &tlasAddressInfo);
+        tlasGeneration++; // Descriptor sets referencing the old TLAS must be rewritten
+
+        // Scratch is kept for the per-frame updates/rebuilds in updateTlas, so size it for both
+        const VkDeviceSize scratchAlignment = as_properties.minAccelerationStructureScratchOffsetAlignment;
+        tlasScratch = create_scratch_buffer(std::max(buildSizesInfo.buildScratchSize, buildSizesInfo.updateScratchSize) + scratchAlignment);
 
-        // Create scratch buffer for TLAS build
-        ScratchBuffer scratch = create_scratch_buffer(buildSizesInfo.buildScratchSize);
+        tlasInstanceCapacity = capacity;
+        tlasAllowsUpdate = allow_update;
+        tlasUpdatesSinceRebuild = 0;
+    }
+
+    // Per-frame-slot staging for instance records, used by updateTlas
+    void ensureInstanceStaging()
+    {
+        if (instanceStaging[0])
+            return;
+        for (auto &staging : instanceStaging)
+        {
+            staging = std::make_unique<Buffer>(
+                sizeof(VkAccelerationStructureInstanceKHR),
+                MAX_SCENE_OBJECTS,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            staging->map();
+        }
+    }
+
+    // --- create_tlas ---
+    void create_tlas(bool allow_update)
+    {
+        // Check required function pointers (with pfn prefix)
+        if (!pfnGetAccelerationStructureBuildSizesKHR || !pfnCreateAccelerationStructureKHR || !pfnGetAccelerationStructureDeviceAddressKHR || !pfnCmdBuildAccelerationStructuresKHR || !pfnGetBufferDeviceAddressKHR)
+        {
+            throw std::runtime_error("Required TLAS build function pointers not loaded!");
+        }
+
+        // This rebuilds the instance list, nothing is left for updateTlas to pick up
+        tlasInstancesDirty = false;
+        std::vector<VkAccelerationStructureInstanceKHR> instances;
+        collectTlasInstances(instances);
+
+        if (instances.empty())
+        {
+            retireTlasStorage();
+            tlasInstanceRecords.clear();
+            std::cerr << "Warning: No valid instances with corresponding BLAS found. Skipping TLAS build." << std::endl;
+            return; // Nothing to build
+        }
+
+        // An updatable TLAS has room for MAX_SCENE_OBJECTS instances, so instances joining or leaving later
+        // (ASBuildScheduler, residency) are handled in the frame by updateTlas without recreating anything
+        uint32_t instanceCount = static_cast<uint32_t>(instances.size());
+        createTlasStorage(allow_update ? std::max(instanceCount, MAX_SCENE_OBJECTS) : instanceCount, allow_update);
+
+        // Upload instance data (using staging buffer for device-local memory)
+        VkDeviceSize instanceBufferSize = sizeof(VkAccelerationStructureInstanceKHR) * instances.size();
+        VkBuffer stagingBuffer;
+        VkDeviceMemory stagingMemory;
+        Kinesis::Window::createBuffer(instanceBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory, MemoryBudget::Category::Staging);
+        void *data;
+        vkMapMemory(g_Device, stagingMemory, 0, instanceBufferSize, 0, &data);
+        memcpy(data, instances.data(), instanceBufferSize);
+        vkUnmapMemory(g_Device, stagingMemory);
+
+        VkCommandBuffer cmdBufCopy = beginSingleTimeCommands();
+        VkBufferCopy copyRegion{};
+        copyRegion.size = instanceBufferSize;
+        vkCmdCopyBuffer(cmdBufCopy, stagingBuffer, instances_buffer, 1, &copyRegion);
+        // Barrier: Ensure copy finishes before TLAS build reads the instance buffer
+        VkBufferMemoryBarrier bufferBarrier = {};
+        bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        bufferBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR; // Read by AS build
+        bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        bufferBarrier.buffer = instances_buffer;
+        bufferBarrier.offset = 0;
+        bufferBarrier.size = instanceBufferSize;
+        vkCmdPipelineBarrier(cmdBufCopy,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,                         // Source stage
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR, // Destination stage
+                             0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+        endSingleTimeCommands(cmdBufCopy); // Submits and waits
+
+        // Clean up staging buffer
+        vkDestroyBuffer(g_Device, stagingBuffer, nullptr);
+        MemoryBudget::untrack(stagingMemory);
+        vkFreeMemory(g_Device, stagingMemory, nullptr);
 
         // Build TLAS on GPU
         VkCommandBuffer cmdBufBuild = beginSingleTimeCommands();
 
-        // Update buildGeomInfo for the build command
-        buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-        buildGeomInfo.dstAccelerationStructure = tlas.structure;   // Target TLAS object
-        buildGeomInfo.scratchData.deviceAddress = scratch.address; // Scratch buffer
+        VkAccelerationStructureGeometryKHR tlasGeometry = makeTlasGeometry();
+        VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo{};
+        buildGeomInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeomInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        buildGeomInfo.flags = tlasBuildFlags(allow_update);
+        buildGeomInfo.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR; // Initial build
+        buildGeomInfo.geometryCount = 1;
+        buildGeomInfo.pGeometries = &tlasGeometry;
+        buildGeomInfo.dstAccelerationStructure = tlas.structure; // Target TLAS object
+        buildGeomInfo.scratchData.deviceAddress = Kinesis::Buffer::getAlignment(tlasScratch.address, as_properties.minAccelerationStructureScratchOffsetAlignment);
 
         // Define build range info for the instances
         VkAccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
@@ -1478,15 +3204,266 @@ for (size_t i = 0; i < Kinesis::gameObjects.size(); ++i) {
         barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR; // Ready for shader read
         vkCmdPipelineBarrier(cmdBufBuild,
                              VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,                                                // Source: Build stage
-                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR, // Dest: Build (for scratch reuse) & RT Shader
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES, // Dest: Build (for scratch reuse) & RT Shader
                              0, 1, &barrier, 0, nullptr, 0, nullptr);
 
         endSingleTimeCommands(cmdBufBuild); // Submit and wait
 
-        // Cleanup scratch buffer
-        delete_scratch_buffer(scratch);
+        // Remember what was uploaded so updateTlas only patches instances that moved since
+        tlasInstanceRecords = std::move(instances);
+        instanceCopies.reserve(tlasInstanceRecords.size());
+        if (allow_update)
+            ensureInstanceStaging();
 
         std::cout << "TLAS created successfully with " << instanceCount << " instances." << std::endl;
     }
 
+    // --- refitDynamicBlas ---
+    // Refits (MODE_UPDATE, in place) the BLAS of every dynamic model whose vertices changed since its BLAS was
+    // last built or refit, all in one build call recorded into the frame's command buffer. A BLAS is rebuilt
+    // in place instead after blasRefitLimit refits, or once the bounds grew past blasRebuildBoundsGrowth,
+    // because refitting only stretches the original hierarchy and trace performance degrades with it.
+    void refitDynamicBlas(VkCommandBuffer commandBuffer)
+    {
+        blasRefitsLastFrame = 0;
+        blasRebuildsLastFrame = 0;
+        if (dynamicBlasStates.empty() || !pfnCmdBuildAccelerationStructuresKHR)
+            return;
+
+        const VkDeviceSize scratchAlignment = as_properties.minAccelerationStructureScratchOffsetAlignment;
+        refitGeometries.clear();
+        refitInfos.clear();
+        refitRanges.clear();
+        refitRangePtrs.clear();
+        refitGeometries.reserve(dynamicBlasStates.size()); // pGeometries below point into it
+        VkDeviceSize scratchNeeded = 0;
+
+        for (auto &entry : dynamicBlasStates)
+        {
+            const Model *model = entry.first;
+            DynamicBlasState &state = entry.second;
+            const AccelerationStructure *modelBlas = getBlas(model);
+            if (!modelBlas || !model->isResident() || model->getVertexGeneration() == state.vertexGeneration)
+                continue;
+
+            const bool rebuild = (blasRefitLimit > 0 && state.refitCount >= static_cast<uint32_t>(blasRefitLimit)) ||
+                                 model->getBoundsRadius() > state.builtRadius * blasRebuildBoundsGrowth;
+
+            refitGeometries.push_back(makeBlasGeometry(model)); // Pool may have grown, addresses are refreshed
+            VkAccelerationStructureBuildGeometryInfoKHR info{};
+            info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+            info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+            info.flags = blasBuildFlags(model, false); // Same flags as the original build
+            info.mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+            info.srcAccelerationStructure = rebuild ? VK_NULL_HANDLE : modelBlas->structure;
+            info.dstAccelerationStructure = modelBlas->structure; // Same size, same address: the TLAS keeps pointing at it
+            info.geometryCount = 1;
+            info.pGeometries = &refitGeometries.back();
+            info.scratchData.deviceAddress = scratchNeeded; // Offset for now, rebased onto refitScratch below
+            refitInfos.push_back(info);
+            scratchNeeded += rebuild ? state.buildScratchSize : state.updateScratchSize;
+
+            VkAccelerationStructureBuildRangeInfoKHR range{};
+            range.primitiveCount = state.primitiveCount;
+            refitRanges.push_back(range);
+
+            state.vertexGeneration = model->getVertexGeneration();
+            if (rebuild)
+            {
+                state.refitCount = 0;
+                state.builtRadius = model->getBoundsRadius();
+                blasRebuildsLastFrame++;
+            }
+            else
+            {
+                state.refitCount++;
+                blasRefitsLastFrame++;
+            }
+        }
+        if (refitInfos.empty())
+            return;
+
+        // One scratch region per build, suballocated from a buffer that only ever grows
+        if (scratchNeeded > refitScratchSize)
+        {
+            DeletionQueue::retireBuffer(refitScratch.buffer, refitScratch.memory); // Frames in flight may still refit with it
+            refitScratch = {};
+            refitScratchSize = 0;
+            refitScratch = create_scratch_buffer(scratchNeeded + scratchAlignment);
+            refitScratchSize = scratchNeeded;
+        }
+        const uint64_t scratchBase = Kinesis::Buffer::getAlignment(refitScratch.address, scratchAlignment);
+        for (size_t i = 0; i < refitInfos.size(); ++i)
+        {
+            refitInfos[i].scratchData.deviceAddress += scratchBase;
+            refitRangePtrs.push_back(&refitRanges[i]);
+        }
+
+        // Previous frames may still trace these BLAS (WAR), and their refits wrote both the BLAS being
+        // refit and refitScratch (RAW/WAW). The new vertex data was copied and made visible to AS
+        // builds by GeometryPool::recordPendingWrites.
+        VkMemoryBarrier refitBarrier{};
+        refitBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        refitBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        refitBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             TRACE_STAGES | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             0, 1, &refitBarrier, 0, nullptr, 0, nullptr);
+
+        pfnCmdBuildAccelerationStructuresKHR(commandBuffer, static_cast<uint32_t>(refitInfos.size()), refitInfos.data(), refitRangePtrs.data());
+
+        // Barrier: refit BLAS are read by the TLAS update that follows and by the trace
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR | TRACE_STAGES,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+        blasContentChanged = true;
+    }
+
+    // --- updateTlas ---
+    // Patches the instance records of objects whose transform changed and updates the TLAS in place,
+    // all recorded into the frame's command buffer. Every tlasRebuildInterval updates the TLAS is rebuilt
+    // (still in place, same instance count) since repeated refits degrade its quality. When the instance
+    // list itself changed (markTlasInstancesDirty) the whole list is uploaded and the TLAS rebuilt in place.
+    void updateTlas(VkCommandBuffer commandBuffer, int frameIndex)
+    {
+        tlasUpdatedInstancesLastFrame = 0;
+        const VkDeviceSize recordSize = sizeof(VkAccelerationStructureInstanceKHR);
+        bool instanceListChanged = false;
+
+        if (tlasInstancesDirty)
+        {
+            // BLAS were built, released or evicted since the last frame: instances join or leave the TLAS
+            tlasInstancesDirty = false;
+            instanceListChanged = true;
+            std::vector<VkAccelerationStructureInstanceKHR> &instances = tlasInstanceRecords; // Collected in place
+            collectTlasInstances(instances);
+            if (instances.size() > MAX_SCENE_OBJECTS)
+            {
+                std::cerr << "Warning: " << instances.size() << " TLAS instances, only the first " << MAX_SCENE_OBJECTS << " are traced." << std::endl;
+                instances.resize(MAX_SCENE_OBJECTS);
+                tlasInstanceObjects.resize(MAX_SCENE_OBJECTS);
+            }
+            // Room for MAX_SCENE_OBJECTS instances; only allocation happens here, the build is recorded below
+            if (tlas.structure == VK_NULL_HANDLE || !tlasAllowsUpdate || instances.size() > tlasInstanceCapacity)
+                createTlasStorage(MAX_SCENE_OBJECTS, true);
+            ensureInstanceStaging();
+
+            instanceCopies.clear();
+            if (!instances.empty())
+            {
+                memcpy(instanceStaging[frameIndex]->getMappedMemory(), instances.data(), instances.size() * recordSize);
+                instanceCopies.push_back({0, 0, instances.size() * recordSize});
+            }
+            tlasUpdatedInstancesLastFrame = static_cast<uint32_t>(instances.size());
+        }
+        else
+        {
+            if (tlas.structure == VK_NULL_HANDLE || !tlasAllowsUpdate || tlasInstanceObjects.empty() ||
+                tlasInstanceObjects.size() > MAX_SCENE_OBJECTS || !instanceStaging[frameIndex])
+                return;
+
+            // Dirty tracking: compare each instance's current transform with the record last uploaded for it.
+            // Changed records go to this frame slot's staging buffer, which beginFrame's fence wait made free.
+            auto *stagingRecords = static_cast<VkAccelerationStructureInstanceKHR *>(instanceStaging[frameIndex]->getMappedMemory());
+            instanceCopies.clear();
+            for (size_t i = 0; i < tlasInstanceObjects.size(); ++i)
+            {
+                const uint32_t objectIndex = tlasInstanceObjects[i];
+                if (objectIndex >= Kinesis::gameObjects.size())
+                    continue;
+                VkTransformMatrixKHR transform = toTransformMatrix(Kinesis::gameObjects[objectIndex].transform.mat4());
+                VkAccelerationStructureInstanceKHR &record = tlasInstanceRecords[i];
+                if (memcmp(&record.transform, &transform, sizeof(VkTransformMatrixKHR)) == 0)
+                    continue;
+
+                record.transform = transform;
+                stagingRecords[i] = record;
+                const VkDeviceSize offset = i * recordSize;
+                if (!instanceCopies.empty() && instanceCopies.back().srcOffset + instanceCopies.back().size == offset)
+                    instanceCopies.back().size += recordSize; // Neighbouring records share one copy region
+                else
+                    instanceCopies.push_back({offset, offset, recordSize});
+                tlasUpdatedInstancesLastFrame++;
+            }
+        }
+        // Refit BLAS (refitDynamicBlas) change the bounds the TLAS was built from, so it needs an update as well
+        const bool blasChanged = blasContentChanged;
+        blasContentChanged = false;
+        if (instanceCopies.empty() && !blasChanged && !instanceListChanged)
+            return; // Nothing moved, the TLAS is still valid
+        Accumulation::reset(); // Something moved, the accumulated image no longer matches the scene
+
+        // Previous frames may still trace this TLAS or build from the instance buffer; wait for them (WAR, execution only)
+        vkCmdPipelineBarrier(commandBuffer,
+                             TRACE_STAGES | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+        if (!instanceCopies.empty())
+        {
+            vkCmdCopyBuffer(commandBuffer, instanceStaging[frameIndex]->getBuffer(), instances_buffer,
+                            static_cast<uint32_t>(instanceCopies.size()), instanceCopies.data());
+
+            // Barrier: instance records must be written before the build reads them
+            VkMemoryBarrier copyBarrier{};
+            copyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+            copyBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            copyBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+            vkCmdPipelineBarrier(commandBuffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                                 0, 1, &copyBarrier, 0, nullptr, 0, nullptr);
+        }
+
+        // An update needs the same instance count as the last build, so a changed list is always a rebuild
+        const bool rebuild = instanceListChanged ||
+                             (tlasRebuildInterval > 0 && tlasUpdatesSinceRebuild >= static_cast<uint32_t>(tlasRebuildInterval));
+
+        VkAccelerationStructureGeometryKHR tlasGeometry = makeTlasGeometry();
+
+        // Flags must match the original build for an update to be valid
+        VkAccelerationStructureBuildGeometryInfoKHR buildGeomInfo{};
+        buildGeomInfo.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+        buildGeomInfo.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+        buildGeomInfo.flags = tlasBuildFlags(true);
+        buildGeomInfo.mode = rebuild ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR;
+        buildGeomInfo.srcAccelerationStructure = rebuild ? VK_NULL_HANDLE : tlas.structure; // Update in place
+        buildGeomInfo.dstAccelerationStructure = tlas.structure;
+        buildGeomInfo.geometryCount = 1;
+        buildGeomInfo.pGeometries = &tlasGeometry;
+        buildGeomInfo.scratchData.deviceAddress = Kinesis::Buffer::getAlignment(tlasScratch.address, as_properties.minAccelerationStructureScratchOffsetAlignment);
+
+        VkAccelerationStructureBuildRangeInfoKHR buildRangeInfo{};
+        buildRangeInfo.primitiveCount = static_cast<uint32_t>(tlasInstanceRecords.size()); // May be 0, an empty TLAS is valid
+        const VkAccelerationStructureBuildRangeInfoKHR *pBuildRangeInfo = &buildRangeInfo;
+        pfnCmdBuildAccelerationStructuresKHR(commandBuffer, 1, &buildGeomInfo, &pBuildRangeInfo);
+
+        // Barrier: the updated TLAS must be complete before this frame traces against it
+        VkMemoryBarrier buildBarrier{};
+        buildBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        buildBarrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+        buildBarrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+        vkCmdPipelineBarrier(commandBuffer,
+                             VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+                             TRACE_STAGES,
+                             0, 1, &buildBarrier, 0, nullptr, 0, nullptr);
+
+        if (rebuild)
+        {
+            tlasUpdatesSinceRebuild = 0;
+            tlasRebuildCount++;
+        }
+        else
+        {
+            tlasUpdatesSinceRebuild++;
+            tlasUpdateCount++;
+        }
+    }
+
 } // namespace Kinesis::RayTracerManager
\ No newline at end of file
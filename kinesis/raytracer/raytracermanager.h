@@ -4,6 +4,7 @@
 #include "kinesis.h" // Include necessary base headers
 #include <vector>
 #include <memory> // For std::unique_ptr
+#include <unordered_map>
 
 
 namespace Kinesis::RayTracerManager {
@@ -13,6 +14,7 @@ namespace Kinesis::RayTracerManager {
         uint64_t address = 0;
         VkBuffer buffer = VK_NULL_HANDLE;
         VkDeviceMemory memory = VK_NULL_HANDLE; // Add memory handle
+        VkDeviceSize size = 0; // accelerationStructureSize, used for memory accounting
     };
 
     struct ScratchBuffer {
@@ -33,16 +35,29 @@ namespace Kinesis::RayTracerManager {
         VkDeviceMemory memory = VK_NULL_HANDLE;
         VkImageView view = VK_NULL_HANDLE;
         VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT; // HDR format for reflections
+        uint32_t generation = 0; // Bumped whenever the image is recreated
     };
 
 
     // --- Existing Extern Declarations ---
     extern VkDescriptorSetLayout rtDescriptorSetLayout;
     extern VkPipelineLayout rtPipelineLayout; // RT specific pipeline layout
-    extern VkDescriptorSet rtDescriptorSet;
+    extern VkDescriptorSet rtDescriptorSet; // Set bound by bind(); the current frame slot's set
+    extern uint32_t tlasGeneration;         // Bumped whenever create_tlas replaces the TLAS
     extern VkPhysicalDeviceRayTracingPipelinePropertiesKHR rt_pipeline_properties; // Renamed from rtPipelineProperties
     extern VkPhysicalDeviceAccelerationStructureFeaturesKHR as_features;
-    extern std::vector<AccelerationStructure> blas;
+    extern VkPhysicalDeviceAccelerationStructurePropertiesKHR as_properties; // Queried in initialize()
+    extern bool compactBlas;                         // Compact BLAS after building them (applies to later builds)
+    extern VkDeviceSize blasCompactionSavedBytes;    // Total bytes saved by compaction so far
+    extern int tlasRebuildInterval;                  // Refits between full in-place TLAS rebuilds (0 = never rebuild)
+    extern uint32_t tlasUpdatedInstancesLastFrame;   // Instance records updateTlas patched in the last frame
+    extern uint64_t tlasUpdateCount;                 // In-place TLAS updates so far
+    extern uint64_t tlasRebuildCount;                // Periodic in-frame TLAS rebuilds so far
+    extern int blasRefitLimit;                       // Refits of a dynamic BLAS before it is rebuilt (0 = never)
+    extern float blasRebuildBoundsGrowth;            // Rebuild when the bounds radius grew by this factor since the last build
+    extern uint32_t blasRefitsLastFrame;
+    extern uint32_t blasRebuildsLastFrame;
+    extern std::unordered_map<const Model *, AccelerationStructure> blas; // One BLAS per model, shared by all its instances
 	extern AccelerationStructure tlas;
     // Remove vertex/index buffer externs if managed elsewhere (e.g., Model)
     // extern std::unique_ptr<VkBuffer> vertex_buffer;
@@ -52,25 +67,118 @@ namespace Kinesis::RayTracerManager {
     extern std::vector<VkRayTracingShaderGroupCreateInfoKHR> shader_groups;
 
     // --- NEW Extern Declarations for RT Pipeline and SBT ---
-    extern VkPipeline rtPipeline; // The ray tracing pipeline object
-    extern ShaderBindingTableEntry rgenSBT; // RayGen SBT entry
-    extern ShaderBindingTableEntry missSBT; // Miss SBT entry
-    extern ShaderBindingTableEntry chitSBT; // ClosestHit SBT entry
+    extern VkPipeline rtPipeline; // The active pipeline variant (see traceRays)
+    extern ShaderBindingTableEntry rgenSBT; // RayGen SBT entry of the active variant
+    extern ShaderBindingTableEntry missSBT; // Miss SBT: record 0 shading miss, record 1 occlusion miss (occlusion.glsl)
+    extern ShaderBindingTableEntry chitSBT; // Hit SBT: one record per Mesh::MaterialType, selected by the instance's SBT record offset
+    extern uint32_t pipelineVariantSwitches; // Times traceRays switched to another cached pipeline variant
+    extern VkPipeline rtQueryPipeline; // Ray query compute pipeline of the active variant, null without VK_KHR_ray_query
+    extern bool useRayQuery;           // Trace with rtQueryPipeline instead of rtPipeline (if available)
+    extern float pipelineTraceMs;      // Averaged GPU time of traceRays with the RT pipeline
+    extern float rayQueryTraceMs;      // Averaged GPU time of traceRays with the ray query backend
+
+    // Reduced resolution tracing: one pixel per 2x1 (Half) or 2x2 (Quarter) block is traced each frame
+    // and a joint bilateral upsample guided by G-buffer depth and normals fills the rest of rtOutput;
+    // traceRays' measured time includes the upsample
+    enum class TraceResolution { Full, Half, Quarter };
+    // Which pixel of a block: alternating between neighbouring blocks, or the same one moving every frame
+    enum class SubpixelPattern { Checkerboard, Rotating };
+    extern TraceResolution traceResolution;
+    extern SubpixelPattern subpixelPattern;
+    // Adaptive sampling: samples per pixel follow the estimated noise, averaging the variant's samplesPerPixel
+    // per traced pixel. Each pixel traces the budget last frame's budget pass gave it; a budget pass after
+    // the trace plans the next frame from per-pixel luminance statistics
+    extern bool adaptiveSampling;
+    extern int adaptiveMaxSamples; // Per-pixel cap
+    // Compacted dispatch: a compute pre-pass lists the pixels that need rays (metal, dielectric) and the trace
+    // runs indirectly over that list, so its cost follows their number instead of the screen area. Needs
+    // rayTracingPipelineTraceRaysIndirect for the RT pipeline; the ray query backend always can
+    extern bool compactDispatch;
+    // ReSTIR direct lighting: hybrid primary hits on rough metal resample many light samples into one per pixel
+    // (hybridPrimary and LightList sampling only). Two compute passes before the trace fill each pixel's
+    // reservoir from restirCandidates light samples, last frame's reservoir reprojected with the previous
+    // viewProjection, then the reservoirs of similar neighbours; the trace shades the kept sample with one shadow ray
+    extern bool restirEnabled;
+    extern int restirCandidates; // Initial light samples per pixel and frame
     extern ShaderBindingTableEntry callableSBT;
     extern RTOutput rtOutput;
+    extern RTOutput rtAccumulation; // Running average of rtOutput across frames (see Accumulation), always in General layout
     // Potentially add ahitSBT if using AnyHit shaders
 
     // --- Existing Function Declarations ---
+    /**
+     * @brief Creates the RT layouts, output image and acceleration structures. The RT pipeline is
+     * compiled on a worker thread in the meantime; call waitForPipeline() before the first trace.
+     */
     void initialize(VkExtent2D extent);
+    /**
+     * @brief Joins the pipeline compile started by initialize() and creates the shader binding table.
+     * Rethrows any error from the worker. No-op when already joined.
+     */
+    void waitForPipeline();
     void cleanup();
-    void allocateAndUpdateRtDescriptorSet(VkAccelerationStructureKHR tlasHandle, VkBuffer camBuffer, VkDeviceSize camBufSize);
+    /**
+     * @brief Selects the RT descriptor set for a frame slot and rewrites it only if one of the
+     * resources it references changed (tracked with generation counters) since the slot was last written.
+     */
+    void allocateAndUpdateRtDescriptorSet(VkAccelerationStructureKHR tlasHandle, int frameIndex);
     void updateDescriptorSet(VkAccelerationStructureKHR tlasHandle, VkImageView outputImgView, VkBuffer camBuffer, VkDeviceSize camBufSize /*, other resources...*/);
-    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalSet); // Should bind pipeline AND descriptor set
+    void bind(VkCommandBuffer commandBuffer, VkDescriptorSet globalSet, uint32_t globalOffset); // Binds the descriptor sets (traceRays binds the pipeline); globalOffset is the camera UBO dynamic offset
     uint64_t getBufferDeviceAddress(VkBuffer buffer); // Make public if needed outside
     ScratchBuffer create_scratch_buffer(VkDeviceSize size);
 	void delete_scratch_buffer(ScratchBuffer &scratch_buffer);
     void create_blas();
-	void create_tlas(bool allow_update = false); // Default allow_update to false
+    /**
+     * @brief (Re)builds the BLAS shared by every instance of each model. All builds are recorded into
+     * one command buffer (one submit, one wait) and suballocate a single scratch buffer, in batches
+     * whose scratch stays under BLAS_SCRATCH_BUDGET. Duplicates and models without geometry are skipped.
+     * Static models found in BlasCache (same geometry and flags, compatible driver) are deserialized instead,
+     * and newly built static BLAS are serialized into it for the next run.
+     * Blocks until the submission finished, so it is meant for load time; during frames, builds go
+     * through ASBuildScheduler / recordBlasBuilds instead.
+     */
+    void build_blas(const std::vector<Model *> &models);
+    void build_blas(Model *model); // Single-model convenience overload
+    /**
+     * @brief Replaces each BLAS (built with ALLOW_COMPACTION) by a copy of its compacted size, read from
+     * queryPool (one VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR query per structure, already
+     * written). The originals are retired; the per-model savings are logged. Called by build_blas when compactBlas is set.
+     */
+    void compact_blas(const std::vector<Model *> &models, std::vector<AccelerationStructure> &structures, VkQueryPool queryPool);
+    /**
+     * @brief Records the BLAS builds of the given models into the frame's command buffer instead of a
+     * blocking submission (no compaction, that would need a host readback). The new BLAS are usable by
+     * everything recorded after this call; their instances join the TLAS in this frame's updateTlas.
+     * Used by ASBuildScheduler. Must be recorded outside a render pass.
+     * @param timestampPool If set, bottom-of-pipe timestamps are written to queries firstTimestamp and
+     * firstTimestamp + 1 right before and after the build command, so they measure the builds alone.
+     * Nothing is written when there was nothing to build.
+     * @return The number of triangles built, for the scheduler's cost estimate.
+     */
+    uint32_t recordBlasBuilds(VkCommandBuffer commandBuffer, const std::vector<Model *> &models,
+                              VkQueryPool timestampPool = VK_NULL_HANDLE, uint32_t firstTimestamp = 0);
+    void release_blas(const Model *model); // Frees the model's BLAS; its instances drop out of the TLAS in the next updateTlas
+    const AccelerationStructure *getBlas(const Model *model); // nullptr if the model has no built BLAS
+	void create_tlas(bool allow_update = false); // Blocking (single-time submit); the old TLAS is retired, not destroyed
+    /**
+     * @brief Records refits of the BLAS of dynamic models (Model::setDynamic) whose vertices changed since
+     * their last build, batched into one build call in the frame's command buffer. Falls back to an in-place
+     * rebuild after blasRefitLimit refits or when the bounds grew past blasRebuildBoundsGrowth. Call before
+     * updateTlas, which then also refits the TLAS. Must be recorded outside a render pass.
+     */
+    void refitDynamicBlas(VkCommandBuffer commandBuffer);
+    /**
+     * @brief Records the per-frame TLAS refresh into the frame's command buffer: instance records of
+     * objects whose transform changed since they were last uploaded are copied from this frame slot's
+     * staging buffer into the persistent instance buffer, then the TLAS is updated in place
+     * (MODE_UPDATE), or rebuilt in place every tlasRebuildInterval updates. No-op when nothing moved
+     * and no BLAS was refit.
+     * After markTlasInstancesDirty the whole instance list is collected again and uploaded, and the TLAS
+     * (sized for MAX_SCENE_OBJECTS instances) is rebuilt in place, so BLAS that became ready or were
+     * released never need a blocking create_tlas. Must be recorded outside a render pass, before traceRays.
+     */
+    void updateTlas(VkCommandBuffer commandBuffer, int frameIndex);
+    void markTlasInstancesDirty(); // BLAS were added/removed; the next updateTlas rebuilds the instance list
 	void delete_acceleration_structure(AccelerationStructure &acceleration_structure);
     void updateGbufferDescriptors();
 
@@ -79,9 +187,30 @@ namespace Kinesis::RayTracerManager {
     VkShaderModule createShaderModule(const std::string& filePath);
     void createRtOutputImage(VkExtent2D extent); // Add declaration
     void destroyRtOutputImage(); // Add declaration
+
+    /**
+     * @brief Creates a device local image for the RT passes (tracked as MemoryBudget::Category::RTOutput)
+     * and transitions it to General layout. name is only used in messages.
+     */
+    void createRtImage(RTOutput &target, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage, const char *name);
+    void destroyRtImage(RTOutput &target); // Retired through the DeletionQueue, frames in flight may still use it
     void createRtDescriptorSetLayout(); // Add declaration
 
-    void traceRays(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height, int samplesPerPixel, int maxDepth);
+    /**
+     * @brief Binds the pipeline variant specialized for samplesPerPixel/maxDepth and traces. Variants are
+     * compiled on a worker thread the first time a combination is requested; until it is ready the
+     * previously active variant (and its settings) keeps tracing. A few inactive variants stay cached.
+     * With useRayQuery the same path tracer runs as a compute dispatch using ray queries instead (same
+     * specialization, shading code and descriptor sets, so the output matches). The GPU time of either
+     * backend is measured per frame slot and read back when the slot is reused.
+     * Each call adds one frame to the running average in rtAccumulation (see Accumulation::recordFrame).
+     * With hybridPrimary, paths start at the rasterized first hit in the G-buffer instead of a traced primary ray.
+     * viewProjection is this frame's camera (projection * view), kept for ReSTIR's reprojection next frame.
+     */
+    void traceRays(VkCommandBuffer commandBuffer, int frameIndex, uint32_t width, uint32_t height, int samplesPerPixel, int maxDepth, bool hybridPrimary,
+                   const glm::mat4 &viewProjection);
+    size_t getPipelineVariantCount(); // Compiled variants, active one included
+    bool isCompilingPipelineVariant();
 
     inline static const VkTransformMatrixKHR accel_transform = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
 }
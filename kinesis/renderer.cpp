@@ -1,5 +1,8 @@
 #include "renderer.h"
 #include "window.h" // Include Window header for extent and device access
+#include "deletionqueue.h"
+#include "framearena.h"
+#include "uniformring.h"
 #include <stdexcept> // For std::runtime_error
 #include <iostream>  // For std::cerr
 #include <array>     // For std::array
@@ -76,6 +79,8 @@ namespace Kinesis::Renderer
         }
         // Wait for the device to be idle before recreating resources
         vkDeviceWaitIdle(g_Device);
+        // Nothing is in flight anymore, and the new swapchain starts with fresh fences
+        DeletionQueue::flush();
 
         // If the swapchain doesn't exist, create it.
         if (SwapChain == nullptr) {
@@ -105,6 +110,8 @@ namespace Kinesis::Renderer
 
         // Acquire an image from the swap chain
         auto result = SwapChain->acquireNextImage(&currentImageIndex);
+        // acquireNextImage waited on this slot's fence, so resources retired by that frame can go
+        DeletionQueue::collect();
 
         // Handle swapchain becoming outdated or suboptimal
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
@@ -120,6 +127,10 @@ namespace Kinesis::Renderer
 
         isFrameStarted = true;
 
+        // This slot's previous frame has finished, so its transient CPU/GPU memory can be reused
+        FrameArena::reset();
+        UniformRing::beginFrame(currentFrameIndex);
+
         // Get the command buffer for the current frame in flight
         auto commandBuffer = currCommandBuffer();
 
@@ -153,6 +164,7 @@ namespace Kinesis::Renderer
         try {
             // Submit the command buffer to the graphics queue
             result = SwapChain->submitCommandBuffers(&commandBuffer, &currentImageIndex);
+            DeletionQueue::advanceFrame();
         } catch (...) {
             // Ensure we reset the frame state if submission fails so the next frame can try again
             isFrameStarted = false;
@@ -236,6 +248,7 @@ namespace Kinesis::Renderer
     {
          // Wait for device idle before cleanup
         vkDeviceWaitIdle(g_Device);
+        DeletionQueue::flush(); // Last chance to free retired resources while the device exists
 
         // Free command buffers first
         freeCommandBuffers();
@@ -3,6 +3,8 @@
 #include "mesh/mesh.h"     // <<< Added include for Mesh definition >>>
 #include "renderer.h" // Include renderer to access SwapChain object
 #include "gbuffer.h"  // <<< Include G-Buffer header >>>
+#include "geometrypool.h"
+#include "bindlessheap.h"
 #include <stdexcept> // For std::runtime_error
 #include <iostream>  // For std::cout/cerr
 #include <cassert>   // For assert
@@ -17,12 +19,9 @@ namespace Kinesis{
     {
         alignas(16) glm::mat4 modelMatrix{1.f};
         alignas(16) glm::mat4 normalMatrix{1.f}; // Often mat3 is enough, check shader
-        alignas(16) glm::vec3 baseColor{1.f};    // Pad vec3 to alignas(16)
-        alignas(4) float roughness{0.5f};
-        alignas(4) float metallic{0.0f};
-        alignas(4) float ior{1.5f};        // Default IOR
-        alignas(4) int materialType{0};    // Default to Diffuse
-        // Check shader definition for exact layout, ensure C++ matches std140/std430 rules if applicable
+        // Per-instance bindless handles: the fragment shader fetches its material from the heap
+        alignas(4) uint32_t materialBuffer{0};   // BindlessHeap storage buffer handle
+        alignas(4) uint32_t materialIndex{0};    // Element in that buffer (= object index)
     };
 
 
@@ -68,12 +67,12 @@ namespace Kinesis{
 
         // Descriptor Set Layouts
         // Set 0: Global data (like Camera UBO)
-        // Set 1: Per-Material data (like textures - if needed) - Add later if required
+        // Set 1: Bindless heap (materials, later textures), indexed through push constant handles
 
         VkDescriptorSetLayoutBinding globalUBOLayoutBinding{};
         globalUBOLayoutBinding.binding = 0; // Binding 0 in set 0
         globalUBOLayoutBinding.descriptorCount = 1;
-        globalUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        globalUBOLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         globalUBOLayoutBinding.pImmutableSamplers = nullptr;
         globalUBOLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT; // Accessible by VS & FS
 
@@ -105,8 +104,10 @@ namespace Kinesis{
         pushConstantRange.size = sizeof(GBufferPushConstantData); // Use the correct struct size
 
         // Pass the global descriptor set layout handle
-        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { tempGlobalLayout };
-        // Add other set layouts here if needed (e.g., texture set layout)
+        if (Kinesis::BindlessHeap::getLayout() == VK_NULL_HANDLE) {
+             throw std::runtime_error("Bindless heap not initialized before pipeline layout!");
+        }
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts = { tempGlobalLayout, Kinesis::BindlessHeap::getLayout() };
 
         pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
@@ -175,7 +176,7 @@ namespace Kinesis{
     }
 
     // Renders game objects into the G-Buffer
-    void RenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, const Camera& /*camera*/, VkDescriptorSet globalDescriptorSet) {
+    void RenderSystem::renderGameObjects(VkCommandBuffer commandBuffer, const Camera& /*camera*/, VkDescriptorSet globalDescriptorSet, uint32_t globalOffset) {
         // Bind the G-Buffer graphics pipeline (assuming Pipeline::bind binds the latest created one)
         Kinesis::Pipeline::bind(commandBuffer);
 
@@ -187,43 +188,32 @@ namespace Kinesis{
             0, // set number (assuming global data is at set 0)
             1, // descriptorSetCount
             &globalDescriptorSet, // The descriptor set passed in (contains camera UBO)
-            0, nullptr); // No dynamic offsets
+            1, &globalOffset); // This frame's camera UBO inside the uniform ring
+
+        // Bindless heap at set 1; it never changes, new resources just get new slots
+        Kinesis::BindlessHeap::bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1);
 
-        // --- Optional: Bind texture descriptor sets if needed (e.g., at set 1) ---
-        // vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, ...);
+        // All static geometry lives in the shared pool buffers, bind them once for the whole pass
+        Kinesis::GeometryPool::bind(commandBuffer);
 
-        // Iterate through game objects
-        for(GameObject& gObj : gameObjects){
+        // Iterate through game objects (the index doubles as the material index)
+        for(size_t objectIndex = 0; objectIndex < gameObjects.size(); ++objectIndex){
+            GameObject& gObj = gameObjects[objectIndex];
             // Skip objects without a valid model or mesh
             if (gObj.model == nullptr || gObj.model->getMesh() == nullptr || gObj.model->getMesh()->numVertices() == 0) continue;
+            // Evicted models have no range in the pool right now
+            if (!gObj.model->isResident()) continue;
 
-             // Get material - Assuming first material for simplicity.
-             // A real system would handle multiple materials per mesh.
-             Kinesis::Mesh::Material* mat = nullptr;
-             const auto& materials = gObj.model->getMesh()->getMaterials(); // Use accessor
-             if (!materials.empty()){
-                 mat = materials[0]; // Use accessor
-             } else {
-                 // Handle missing material? Use a default? Skip?
-                  std::cerr << "Warning: GameObject '" << gObj.name << "' has no materials, skipping draw." << std::endl;
-                 continue; // Skip rendering if no material
-             }
-             if (!mat) continue; // Should not happen if materials vector wasn't empty, but check anyway
-
-            // Prepare push constant data with transform and material info
+            // Prepare push constant data with transform and the object's material handles
             GBufferPushConstantData push{};
             push.modelMatrix = gObj.transform.mat4();
             // Calculate normal matrix (transpose of inverse of model matrix's upper 3x3)
             // Ensure the matrix used for inversion doesn't have scale if normals aren't scaled
             push.normalMatrix = glm::transpose(glm::inverse(glm::mat3(push.modelMatrix)));
 
-            // --- Get material properties ---
-            push.baseColor = mat->getDiffuseColor(); // Get base color from material
-            push.roughness = mat->getRoughness();
-            push.ior = mat->getIOR();
-            push.materialType = static_cast<int>(mat->getType());
-            // Determine metallic based on material type (simple example)
-            push.metallic = (mat->getType() == Kinesis::Mesh::MaterialType::METAL) ? 1.0f : 0.0f;
+            // --- Material lives in the material SSBO (one entry per object, see kinesis.cpp) ---
+            push.materialBuffer = Kinesis::materialBufferHandle;
+            push.materialIndex = static_cast<uint32_t>(objectIndex);
 
             // Push constants to the pipeline
             vkCmdPushConstants(
@@ -234,9 +224,7 @@ namespace Kinesis{
                 sizeof(GBufferPushConstantData), // Size
                 &push); // Pointer to the data
 
-            // Bind the game object's model (vertex/index buffers)
-            gObj.model->bind(commandBuffer);
-            // Issue the draw command
+            // Issue the draw command (firstIndex/vertexOffset into the shared buffers)
             gObj.model->draw(commandBuffer);
         }
     }
@@ -13,7 +13,12 @@ namespace Kinesis
         ~RenderSystem();
 
         VkPipelineLayout pipelineLayout;
-        void renderGameObjects(VkCommandBuffer commandBuffer, const Camera& camera, VkDescriptorSet globalDescriptorSet);
+        /**
+         * @brief Records the G-Buffer draws for all resident game objects.
+         * @param globalDescriptorSet Set 0 (camera UBO, dynamic).
+         * @param globalOffset Dynamic offset of this frame's camera UBO in the UniformRing.
+         */
+        void renderGameObjects(VkCommandBuffer commandBuffer, const Camera& camera, VkDescriptorSet globalDescriptorSet, uint32_t globalOffset);
 
         /**
          * @brief Creates the graphics pipeline.
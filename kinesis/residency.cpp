@@ -0,0 +1,265 @@
+// kinesis/residency.cpp
+#include "residency.h"
+#include "memorybudget.h"
+#include "gameobject.h"
+#include "GUI.h"
+#include "raytracer/raytracermanager.h"
+#include "raytracer/asbuildscheduler.h"
+#include "deletionqueue.h"
+#include "geometrypool.h"
+#include "swapchain.h"
+
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace Kinesis::Residency
+{
+    bool enabled = true;
+    int minIdleFrames = 120;
+
+    namespace
+    {
+        uint64_t frameCounter = 0;
+        std::unordered_map<const Model *, uint64_t> lastVisible;
+        uint64_t totalEvictions = 0;
+        uint64_t totalRestores = 0;
+        // Bytes each currently evicted model gave back, for Stats::evictedBytes
+        std::unordered_map<const Model *, VkDeviceSize> releasedBytes;
+        // DeletionQueue frame of the last eviction; its memory is only freed once that frame retires
+        uint64_t lastEvictionFrame = 0;
+        bool evictionPending = false;
+        // Reused every tick so residency doesn't allocate per frame
+        std::vector<Model *> sceneModels; // Unique models of gameObjects
+        std::vector<Model *> toRestore;
+        std::vector<Model *> candidates;
+        Stats stats{}; // Refreshed at the end of every update, returned by getStats
+
+        // Planes are (normal, d) with normals pointing inside the frustum
+        std::array<glm::vec4, 6> extractFrustumPlanes(const glm::mat4 &viewProjection)
+        {
+            auto row = [&](int i)
+            { return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+
+            std::array<glm::vec4, 6> planes = {
+                row(3) + row(0), // Left
+                row(3) - row(0), // Right
+                row(3) + row(1), // Bottom
+                row(3) - row(1), // Top
+                row(2),          // Near (Vulkan depth is [0, 1])
+                row(3) - row(2)  // Far
+            };
+            for (auto &plane : planes)
+            {
+                float len = glm::length(glm::vec3(plane));
+                if (len > 0.f)
+                    plane /= len;
+            }
+            return planes;
+        }
+
+        bool isSphereVisible(const std::array<glm::vec4, 6> &planes, const glm::vec3 &center, float radius)
+        {
+            for (const auto &plane : planes)
+            {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                    return false;
+            }
+            return true;
+        }
+
+        // GPU bytes evicting a model gives back: the BLAS shared by its instances, plus its geometry
+        // range, which is returned to the driver once GeometryPool::compact() shrinks the pool
+        VkDeviceSize evictionSize(const Model *model)
+        {
+            VkDeviceSize bytes = model->getGeometrySize();
+            if (const auto *modelBlas = RayTracerManager::getBlas(model))
+                bytes += modelBlas->size;
+            return bytes;
+        }
+
+        void evictModel(Model *model)
+        {
+            releasedBytes[model] = evictionSize(model);
+            if (GUI::raytracing_available)
+            {
+                ASBuildScheduler::cancel(model);
+                RayTracerManager::release_blas(model);
+            }
+            model->evictBuffers();
+            totalEvictions++;
+        }
+
+        // Geometry now; their BLAS are queued and built over the next frames within the AS build budget,
+        // instances join the TLAS once theirs is ready
+        void restoreModels(const std::vector<Model *> &restored)
+        {
+            for (Model *model : restored)
+            {
+                model->restoreBuffers();
+                releasedBytes.erase(model);
+                totalRestores++;
+                if (GUI::raytracing_available)
+                    ASBuildScheduler::enqueue(model);
+            }
+        }
+
+        // Evicted models change the TLAS instance list; updateTlas rebuilds it in the next frame
+        void rebuildTlas()
+        {
+            if (GUI::raytracing_available)
+                RayTracerManager::markTlasInstancesDirty();
+        }
+
+        void refreshStats()
+        {
+            stats.residentModels = 0;
+            stats.evictedModels = 0;
+            stats.evictedBytes = 0;
+            for (const Model *model : sceneModels)
+            {
+                if (model->isResident())
+                {
+                    stats.residentModels++;
+                }
+                else
+                {
+                    stats.evictedModels++;
+                    auto released = releasedBytes.find(model);
+                    if (released != releasedBytes.end())
+                        stats.evictedBytes += released->second;
+                }
+            }
+            stats.totalEvictions = totalEvictions;
+            stats.totalRestores = totalRestores;
+        }
+    }
+
+    void update(const Camera &camera)
+    {
+        frameCounter++;
+        MemoryBudget::update();
+
+        sceneModels.clear();
+        toRestore.clear();
+        const auto planes = extractFrustumPlanes(camera.getProjection() * camera.getView());
+        for (auto &obj : gameObjects)
+        {
+            Model *model = obj.model.get();
+            if (!model)
+                continue;
+            if (std::find(sceneModels.begin(), sceneModels.end(), model) == sceneModels.end())
+                sceneModels.push_back(model);
+
+            glm::mat4 modelMatrix = obj.transform.mat4();
+            glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model->getBoundsCenter(), 1.f));
+            float maxScale = glm::max(glm::abs(obj.transform.scale.x), glm::max(glm::abs(obj.transform.scale.y), glm::abs(obj.transform.scale.z)));
+            bool visible = isSphereVisible(planes, center, model->getBoundsRadius() * maxScale);
+
+            if (visible)
+                lastVisible[model] = frameCounter;
+            // Disabling the manager brings everything back
+            if ((visible || !enabled) && !model->isResident() &&
+                std::find(toRestore.begin(), toRestore.end(), model) == toRestore.end())
+            {
+                toRestore.push_back(model);
+            }
+        }
+
+        bool asDirty = false;
+        if (!toRestore.empty())
+        {
+            // Old TLAS/buffers are retired through the DeletionQueue, in-flight frames keep theirs
+            restoreModels(toRestore);
+            asDirty = true;
+        }
+
+        // Until the last eviction's resources are actually freed the budget still counts them,
+        // so evicting again now would throw out more than needed
+        if (evictionPending &&
+            DeletionQueue::getFrameNumber() > lastEvictionFrame + static_cast<uint64_t>(SwapChain::MAX_FRAMES_IN_FLIGHT))
+        {
+            evictionPending = false;
+            // The evicted ranges are on the pool's free lists by now. Shrinking the pool retires its old
+            // buffers, and those are only freed after another round of frames.
+            if (GeometryPool::compact())
+            {
+                lastEvictionFrame = DeletionQueue::getFrameNumber();
+                evictionPending = true;
+            }
+        }
+
+        VkDeviceSize overBudget = (enabled && !evictionPending) ? MemoryBudget::getOverBudgetBytes() : 0;
+        if (overBudget > 0)
+        {
+            // Candidates: resident models that have been off-screen long enough, oldest first
+            candidates.clear();
+            for (Model *model : sceneModels)
+            {
+                if (!model->isResident())
+                    continue;
+                if (frameCounter - getLastVisibleFrame(model) >= static_cast<uint64_t>(minIdleFrames))
+                    candidates.push_back(model);
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const Model *a, const Model *b)
+                      { return getLastVisibleFrame(a) < getLastVisibleFrame(b); });
+
+            if (!candidates.empty())
+            {
+                VkDeviceSize freed = 0;
+                for (Model *model : candidates)
+                {
+                    if (freed >= overBudget)
+                        break;
+                    freed += evictionSize(model);
+                    evictModel(model);
+                }
+                asDirty = true;
+                lastEvictionFrame = DeletionQueue::getFrameNumber();
+                evictionPending = true;
+                std::cout << "Residency: over budget by " << (overBudget >> 10) << " KiB, evicted ~"
+                          << (freed >> 10) << " KiB of geometry/BLAS." << std::endl;
+            }
+        }
+
+        if (asDirty)
+        {
+            rebuildTlas();
+            MemoryBudget::update();
+        }
+        refreshStats();
+    }
+
+    void ensureResident(Model *model)
+    {
+        if (!model || model->isResident())
+            return;
+        restoreModels({model});
+        rebuildTlas();
+    }
+
+    uint64_t getLastVisibleFrame(const Model *model)
+    {
+        auto it = lastVisible.find(model);
+        return it != lastVisible.end() ? it->second : 0;
+    }
+
+    Stats getStats()
+    {
+        return stats;
+    }
+
+    void cleanup()
+    {
+        lastVisible.clear();
+        releasedBytes.clear();
+        sceneModels.clear();
+        toRestore.clear();
+        candidates.clear();
+        stats = {};
+        frameCounter = 0;
+        evictionPending = false;
+    }
+}
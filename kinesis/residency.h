@@ -0,0 +1,58 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include "kinesis.h"
+#include "camera.h"
+
+namespace Kinesis::Residency
+{
+    struct Stats
+    {
+        uint32_t residentModels = 0;
+        uint32_t evictedModels = 0;
+        uint64_t totalEvictions = 0;
+        uint64_t totalRestores = 0;
+        VkDeviceSize evictedBytes = 0; // Estimated GPU bytes currently released by evictions
+    };
+
+    extern bool enabled;      // When false, nothing is evicted and evicted models are restored
+    extern int minIdleFrames; // A model must be off-screen this many frames before it may be evicted
+
+    /**
+     * @brief Per-frame residency tick. Marks models inside the camera frustum as visible,
+     * restores visible models that were evicted (their BLAS builds are queued on ASBuildScheduler),
+     * and, while MemoryBudget reports over-budget, evicts the geometry ranges and BLAS of the
+     * least-recently-visible models. Once the frames in flight have let go of the ranges,
+     * GeometryPool::compact() shrinks the pool so their memory is actually returned.
+     * Must be called outside of command buffer recording. Evicted resources are retired through
+     * the DeletionQueue, so the frames still in flight are never stalled on.
+     * Visibility is frustum-only. With ray tracing on, an evicted model also leaves the TLAS, so it
+     * is missing from reflections and shadows until it comes back into view.
+     * @param camera The camera used for the visibility test.
+     */
+    void update(const Camera &camera);
+
+    /**
+     * @brief Makes sure a model's geometry is on the GPU, restoring it if needed. Its BLAS is queued
+     * on ASBuildScheduler, so its instances are traced once that build ran.
+     * @param model The model to restore.
+     */
+    void ensureResident(Model *model);
+
+    /**
+     * @brief Frame index (residency ticks) at which a model was last inside the frustum, 0 if never.
+     */
+    uint64_t getLastVisibleFrame(const Model *model);
+
+    /**
+     * @brief Returns residency counters for the GUI / debugging, as of the last update.
+     */
+    Stats getStats();
+
+    /**
+     * @brief Forgets all residency bookkeeping. Call before the game objects are destroyed.
+     */
+    void cleanup();
+}
+
+#endif // RESIDENCY_H
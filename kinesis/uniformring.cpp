@@ -0,0 +1,103 @@
+// kinesis/uniformring.cpp
+#include "uniformring.h"
+#include "window.h" // For createBuffer
+#include "swapchain.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace Kinesis::UniformRing
+{
+    namespace
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        char *mapped = nullptr;
+        VkDeviceSize bytesPerFrame = 0;
+        VkDeviceSize alignment = 256;
+        VkDeviceSize regionStart = 0; // Start of the current frame's region
+        VkDeviceSize head = 0;        // Offset within the current region
+    }
+
+    void initialize(VkDeviceSize frameBytes)
+    {
+        if (g_Device == VK_NULL_HANDLE || g_PhysicalDevice == VK_NULL_HANDLE)
+        {
+            throw std::runtime_error("Device not created before UniformRing::initialize!");
+        }
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(g_PhysicalDevice, &props);
+        alignment = std::max<VkDeviceSize>(props.limits.minUniformBufferOffsetAlignment, 16);
+
+        bytesPerFrame = (frameBytes + alignment - 1) & ~(alignment - 1);
+        VkDeviceSize totalSize = bytesPerFrame * SwapChain::MAX_FRAMES_IN_FLIGHT;
+        Kinesis::Window::createBuffer(totalSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                      buffer, memory, MemoryBudget::Category::Other);
+        void *data = nullptr;
+        vkMapMemory(g_Device, memory, 0, totalSize, 0, &data);
+        mapped = static_cast<char *>(data);
+        regionStart = 0;
+        head = 0;
+    }
+
+    void beginFrame(int frameIndex)
+    {
+        regionStart = bytesPerFrame * static_cast<VkDeviceSize>(frameIndex);
+        head = 0;
+    }
+
+    Allocation push(const void *data, VkDeviceSize size)
+    {
+        if (!mapped)
+        {
+            throw std::runtime_error("UniformRing::push called before initialize!");
+        }
+        VkDeviceSize start = (head + alignment - 1) & ~(alignment - 1);
+        if (start + size > bytesPerFrame)
+        {
+            throw std::runtime_error("UniformRing: per-frame region exhausted, increase bytesPerFrame!");
+        }
+        head = start + size;
+
+        Allocation allocation{};
+        allocation.buffer = buffer;
+        allocation.offset = static_cast<uint32_t>(regionStart + start);
+        allocation.mapped = mapped + allocation.offset;
+        memcpy(allocation.mapped, data, static_cast<size_t>(size));
+        return allocation;
+    }
+
+    VkBuffer getBuffer() { return buffer; }
+
+    VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range)
+    {
+        return VkDescriptorBufferInfo{buffer, 0, range};
+    }
+
+    VkDeviceSize getUsedBytes() { return head; }
+    VkDeviceSize getBytesPerFrame() { return bytesPerFrame; }
+
+    void cleanup()
+    {
+        if (g_Device == VK_NULL_HANDLE)
+            return;
+        if (mapped)
+        {
+            vkUnmapMemory(g_Device, memory);
+            mapped = nullptr;
+        }
+        if (buffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer(g_Device, buffer, nullptr);
+            buffer = VK_NULL_HANDLE;
+        }
+        if (memory != VK_NULL_HANDLE)
+        {
+            MemoryBudget::untrack(memory);
+            vkFreeMemory(g_Device, memory, nullptr);
+            memory = VK_NULL_HANDLE;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef UNIFORMRING_H
+#define UNIFORMRING_H
+
+#include "kinesis.h"
+
+namespace Kinesis::UniformRing
+{
+    /**
+     * @brief A slice of the ring written this frame. Bind it with `offset` as the dynamic offset
+     * of a VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor pointing at getBuffer().
+     */
+    struct Allocation
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        uint32_t offset = 0;
+        void *mapped = nullptr;
+    };
+
+    /**
+     * @brief Creates one persistently mapped, host-coherent uniform buffer split into
+     * MAX_FRAMES_IN_FLIGHT regions of bytesPerFrame each.
+     */
+    void initialize(VkDeviceSize bytesPerFrame = 64 * 1024);
+
+    /**
+     * @brief Rewinds the region owned by this frame slot. Called by Renderer::beginFrame after
+     * the slot's fence has been waited on, so the GPU is done with the previous contents.
+     */
+    void beginFrame(int frameIndex);
+
+    /**
+     * @brief Copies data into the current frame's region (aligned to minUniformBufferOffsetAlignment).
+     * Throws if the region is exhausted.
+     */
+    Allocation push(const void *data, VkDeviceSize size);
+
+    template <typename T>
+    Allocation push(const T &value)
+    {
+        return push(&value, sizeof(T));
+    }
+
+    VkBuffer getBuffer();
+
+    /**
+     * @brief Descriptor info for a dynamic UBO binding of `range` bytes (offset supplied at bind time).
+     */
+    VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range);
+
+    VkDeviceSize getUsedBytes();     // In the current frame's region
+    VkDeviceSize getBytesPerFrame();
+
+    void cleanup();
+}
+
+#endif // UNIFORMRING_H
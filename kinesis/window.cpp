@@ -1,6 +1,7 @@
 #include "window.h"
 #include "renderer.h" // Include renderer for initialization order
 #include "GUI.h"      // Include GUI for initialization order
+#include "pipelinecache.h" // Persistent g_PipelineCache
 
 #define GLM_FORCE_RADIANS           // Ensure GLM uses radians
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE // Vulkan depth range is [0, 1]
@@ -27,7 +28,10 @@ namespace Kinesis::Window
     // We need to query and enable these if supported
     VkPhysicalDeviceAccelerationStructureFeaturesKHR enabledAccelerationStructureFeatures{};
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR enabledRayTracingPipelineFeatures{};
-    VkPhysicalDeviceBufferDeviceAddressFeatures enabledBufferDeviceAddressFeatures{};
+    VkPhysicalDeviceRayQueryFeaturesKHR enabledRayQueryFeatures{}; // Optional, for the compute (ray query) RT backend
+    // Vulkan 1.2 core features (buffer device address, descriptor indexing for the bindless heap).
+    // Replaces VkPhysicalDeviceBufferDeviceAddressFeatures, the two may not be chained together.
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features{};
     // ---
 
     void glfw_error_callback(int error, const char *description) { fprintf(stderr, "GLFW Error %d: %s\n", error, description); }
@@ -401,6 +405,60 @@ namespace Kinesis::Window
                 std::cout << "Enabling required ray tracing device extensions." << std::endl;
             }
 
+            // Optional VK_KHR_ray_query: inline ray queries let the RT pass also run as a compute shader
+            Kinesis::GUI::rayquery_available = false;
+            if (Kinesis::GUI::raytracing_available)
+            {
+                uint32_t rq_ext_count = 0;
+                vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &rq_ext_count, nullptr);
+                std::vector<VkExtensionProperties> rq_ext_props(rq_ext_count);
+                vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &rq_ext_count, rq_ext_props.data());
+                bool extensionFound = false;
+                for (const auto &prop : rq_ext_props)
+                {
+                    if (strcmp(prop.extensionName, VK_KHR_RAY_QUERY_EXTENSION_NAME) == 0)
+                    {
+                        extensionFound = true;
+                        break;
+                    }
+                }
+
+                VkPhysicalDeviceRayQueryFeaturesKHR supportedRayQuery{};
+                supportedRayQuery.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+                VkPhysicalDeviceFeatures2 rqFeatures2{};
+                rqFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+                rqFeatures2.pNext = &supportedRayQuery;
+                vkGetPhysicalDeviceFeatures2(g_PhysicalDevice, &rqFeatures2);
+
+                if (extensionFound && supportedRayQuery.rayQuery)
+                {
+                    device_extensions.push_back(VK_KHR_RAY_QUERY_EXTENSION_NAME);
+                    Kinesis::GUI::rayquery_available = true;
+                }
+                else
+                    std::cout << "VK_KHR_ray_query not available, only the ray tracing pipeline backend can be used." << std::endl;
+            }
+
+            // Enable VK_EXT_memory_budget so MemoryBudget can read real per-heap budget/usage
+            {
+                uint32_t budget_ext_count = 0;
+                vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &budget_ext_count, nullptr);
+                std::vector<VkExtensionProperties> budget_ext_props(budget_ext_count);
+                vkEnumerateDeviceExtensionProperties(g_PhysicalDevice, nullptr, &budget_ext_count, budget_ext_props.data());
+                MemoryBudget::budgetExtensionEnabled = false;
+                for (const auto &prop : budget_ext_props)
+                {
+                    if (strcmp(prop.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+                    {
+                        device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                        MemoryBudget::budgetExtensionEnabled = true;
+                        break;
+                    }
+                }
+                if (!MemoryBudget::budgetExtensionEnabled)
+                    std::cout << "VK_EXT_memory_budget not available, memory budget will be estimated from heap sizes." << std::endl;
+            }
+
             const float queue_priority[] = {1.0f};
             VkDeviceQueueCreateInfo queue_info[1] = {};
             queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
@@ -418,6 +476,40 @@ namespace Kinesis::Window
             create_info.ppEnabledExtensionNames = device_extensions.Data;
             create_info.pEnabledFeatures = &deviceFeatures; // Link basic features here
 
+            // Vulkan 1.2 features are always chained: the bindless heap needs descriptor indexing
+            // (update-after-bind, partially bound, runtime arrays) for both raster and RT shaders.
+            // Required even without RT, RenderSystem fetches materials through the heap and there is
+            // no non-bindless fallback.
+            VkPhysicalDeviceVulkan12Features supported12{};
+            supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 supported12Features2{};
+            supported12Features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supported12Features2.pNext = &supported12;
+            vkGetPhysicalDeviceFeatures2(g_PhysicalDevice, &supported12Features2);
+
+            if (!supported12.descriptorIndexing || !supported12.runtimeDescriptorArray ||
+                !supported12.descriptorBindingPartiallyBound || !supported12.descriptorBindingUpdateUnusedWhilePending ||
+                !supported12.descriptorBindingStorageBufferUpdateAfterBind || !supported12.descriptorBindingSampledImageUpdateAfterBind ||
+                !supported12.shaderStorageBufferArrayNonUniformIndexing || !supported12.shaderSampledImageArrayNonUniformIndexing ||
+                !supported12.scalarBlockLayout)
+            {
+                throw std::runtime_error("GPU does not support the descriptor indexing features required by the bindless heap!");
+            }
+
+            enabledVulkan12Features = {}; // Zero-initialize
+            enabledVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            enabledVulkan12Features.descriptorIndexing = VK_TRUE;
+            enabledVulkan12Features.runtimeDescriptorArray = VK_TRUE;
+            enabledVulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+            enabledVulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+            enabledVulkan12Features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+            enabledVulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+            enabledVulkan12Features.shaderStorageBufferArrayNonUniformIndexing = VK_TRUE;
+            enabledVulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            enabledVulkan12Features.scalarBlockLayout = VK_TRUE; // Material/vertex buffers use scalar layout
+            enabledVulkan12Features.pNext = nullptr;
+            create_info.pNext = &enabledVulkan12Features;
+
             // Chain raytracing features if available
             if (Kinesis::GUI::raytracing_available)
             {
@@ -427,9 +519,6 @@ namespace Kinesis::Window
                 VkPhysicalDeviceRayTracingPipelineFeaturesKHR supportedRtPipelineFeatures{};
                 supportedRtPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
                 supportedAccelFeatures.pNext = &supportedRtPipelineFeatures;
-                VkPhysicalDeviceBufferDeviceAddressFeatures supportedBufferAddrFeatures{};
-                supportedBufferAddrFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
-                supportedRtPipelineFeatures.pNext = &supportedBufferAddrFeatures;
 
                 VkPhysicalDeviceFeatures2 supportedFeatures2{};
                 supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
@@ -444,24 +533,27 @@ namespace Kinesis::Window
                 enabledRayTracingPipelineFeatures = {}; // Zero-initialize
                 enabledRayTracingPipelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
                 enabledRayTracingPipelineFeatures.rayTracingPipeline = supportedRtPipelineFeatures.rayTracingPipeline; // Enable IF supported
+                // Optional: lets the compacted RT dispatch size its launch on the GPU
+                enabledRayTracingPipelineFeatures.rayTracingPipelineTraceRaysIndirect = supportedRtPipelineFeatures.rayTracingPipelineTraceRaysIndirect;
+                Kinesis::GUI::traceindirect_available = supportedRtPipelineFeatures.rayTracingPipelineTraceRaysIndirect == VK_TRUE;
             
-                enabledBufferDeviceAddressFeatures = {}; // Zero-initialize
-                enabledBufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
-                enabledBufferDeviceAddressFeatures.bufferDeviceAddress = supportedBufferAddrFeatures.bufferDeviceAddress; // Enable IF supported
+                enabledVulkan12Features.bufferDeviceAddress = supported12.bufferDeviceAddress; // Enable IF supported
             
-                // **Chain the ENABLED features**
+                // **Chain the ENABLED features** behind the 1.2 features
+                enabledVulkan12Features.pNext = &enabledAccelerationStructureFeatures;
                 enabledAccelerationStructureFeatures.pNext = &enabledRayTracingPipelineFeatures;
-                enabledRayTracingPipelineFeatures.pNext = &enabledBufferDeviceAddressFeatures;
-                enabledBufferDeviceAddressFeatures.pNext = nullptr; // End of RT chain
-            
-                // **Link the start of the chain to the main create_info**
-                create_info.pNext = &enabledAccelerationStructureFeatures;
+                enabledRayTracingPipelineFeatures.pNext = nullptr; // End of RT chain
+
+                if (Kinesis::GUI::rayquery_available)
+                {
+                    enabledRayQueryFeatures = {};
+                    enabledRayQueryFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+                    enabledRayQueryFeatures.rayQuery = VK_TRUE;
+                    enabledRayTracingPipelineFeatures.pNext = &enabledRayQueryFeatures;
+                }
             
                 std::cout << "Chaining enabled Raytracing features for logical device creation." << std::endl;
             }
-            else{
-                create_info.pNext = nullptr;
-            }
 
 
             err = vkCreateDevice(g_PhysicalDevice, &create_info, g_Allocator, &g_Device);
@@ -470,6 +562,8 @@ namespace Kinesis::Window
             if(g_Device) volkLoadDevice(g_Device); // <<< Ensure Volk loads device functions >>>
 #endif
             vkGetDeviceQueue(g_Device, g_QueueFamily, 0, &g_Queue);
+            MemoryBudget::initialize();
+            PipelineCache::load(); // Before anything (ImGui included) creates a pipeline
         }
 
         // Create Descriptor Pool
@@ -479,6 +573,7 @@ namespace Kinesis::Window
                     // Existing types...
                     {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000},
                     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000},
+                    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 16}, // Global camera UBO (UniformRing)
                     // Add/ensure types for Ray Tracing if available
                     // Ensure counts are sufficient for your needs!
                     {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000} // Increase count if needed
@@ -488,7 +583,7 @@ namespace Kinesis::Window
             if (Kinesis::GUI::raytracing_available) // Use your flag indicating RT support
             {
                 pool_sizes.push_back({VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR, 10}); // For TLAS/BLAS
-                pool_sizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 10});             // For RT output image
+                pool_sizes.push_back({VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 32});             // RT output/accumulation, denoiser images
                 // Add other types if needed (e.g., more storage buffers)
                 std::cout << "Adding Raytracing descriptor types to the pool." << std::endl;
             }
@@ -538,6 +633,10 @@ namespace Kinesis::Window
             g_DescriptorPool = VK_NULL_HANDLE;
         }
 
+        // Persist whatever got compiled this run, then drop the cache
+        PipelineCache::save();
+        PipelineCache::cleanup();
+
         // Destroy device before instance
         if (g_Device != VK_NULL_HANDLE)
         {
@@ -618,7 +717,7 @@ namespace Kinesis::Window
 
     // --- createBuffer ---
     // Correct helper function for buffer creation.
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, MemoryBudget::Category category)
     {
         if (g_Device == VK_NULL_HANDLE)
         {
@@ -684,6 +783,8 @@ namespace Kinesis::Window
             bufferMemory = VK_NULL_HANDLE;
             throw std::runtime_error("failed to bind buffer memory!");
         }
+
+        MemoryBudget::track(bufferMemory, allocInfo.allocationSize, allocInfo.memoryTypeIndex, category);
     }
 
     // --- fbResizeCallback ---
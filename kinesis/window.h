@@ -9,6 +9,7 @@
 #include "model.h"
 #include "pipeline.h"
 #include "swapchain.h"
+#include "memorybudget.h"
 
 
 
@@ -99,9 +100,11 @@ namespace Kinesis::Window
       * @param properties Required memory property flags (e.g., host visible, device local).
       * @param buffer Output handle for the created buffer.
       * @param bufferMemory Output handle for the allocated device memory.
+      * @param category Memory budget category the allocation is accounted under.
       * @throws std::runtime_error on failure to create buffer or allocate/bind memory.
       */
-    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory,
+                      MemoryBudget::Category category = MemoryBudget::Category::Other);
 
 
     